@@ -0,0 +1,88 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_AUTO_CORE_H
+#define DOSBOX_AUTO_CORE_H
+
+#include <cstdint>
+#include <optional>
+
+// Adaptive core selection for 'core = auto'
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Every second of emulated time, the host's idle time and the dynamic core's
+// code-page writes, translations, and invalidations are sampled:
+//
+//  - A program that keeps the host busy on the normal core is moved to the
+//    dynamic core, whether it runs in real or protected mode.
+//
+//  - A program whose self-modifying code keeps invalidating the dynamic
+//    core's translations is moved back to the normal core for a while. The
+//    dynamic core is tried again later, after longer and longer intervals
+//    if the program keeps thrashing it.
+//
+// Decisions are remembered per executable, identified by its full DOS path
+// and file size, in the 'core_profiles.conf' file in the config directory,
+// so the next launch starts on the right core.
+
+struct AutoCoreSamples {
+	int64_t code_page_writes   = 0;
+	int64_t blocks_translated  = 0;
+	int64_t blocks_invalidated = 0;
+	int64_t host_idle_us       = 0;
+};
+
+// Incremented directly by the dynamic cores and the main loop
+extern AutoCoreSamples autocore_samples;
+
+enum class CoreProfile { Normal, Dynamic };
+
+// Carried from one slice to the next, so a switch needs its condition to
+// persist for several slices
+struct AutoCoreSliceState {
+	int busy_slices      = 0;
+	int thrashing_slices = 0;
+
+	// While non-zero, the normal core isn't left
+	int pinned_slices_left = 0;
+
+	// Length of the next pin; doubles each time the dynamic core thrashes
+	int next_pin_slices = 0;
+};
+
+void AUTOCORE_Configure(const bool is_enabled, const bool use_profiles);
+
+// Identifies the program just loaded into the given PSP segment
+void AUTOCORE_AddProgram(const uint16_t psp_segment, const char* dos_path,
+                         const uint32_t file_size);
+
+void AUTOCORE_RemoveProgram(const uint16_t psp_segment);
+
+// Applies the stored profile, if any, to the program in the given PSP
+// segment, which has just started or has been returned to
+void AUTOCORE_SetProgram(const uint16_t psp_segment);
+
+// The running programs aren't tracked anymore once a guest OS is booted
+void AUTOCORE_NotifyBooting();
+
+// True while the running program is kept off the dynamic core because it
+// recently thrashed it
+bool AUTOCORE_IsNormalCorePinned();
+
+#endif // DOSBOX_AUTO_CORE_H
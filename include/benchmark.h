@@ -0,0 +1,55 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef DOSBOX_BENCHMARK_H
+#define DOSBOX_BENCHMARK_H
+
+#include <cstdint>
+
+#include "render.h"
+
+// Headless benchmark runner
+// ~~~~~~~~~~~~~~~~~~~~~~~~~
+// Enabled with the '--benchmark <seconds>' command-line option, it runs the
+// emulator without a window or audio device for the given number of
+// emulated seconds. The emulated time runs freely (as in fast-forward mode)
+// instead of being paced against the host's clock, so a run at a fixed
+// cycle count executes the same emulated work every time.
+//
+// At the end, the wall time, the emulated MIPS, and the performance
+// counters are printed, along with hashes of every Nth rendered frame and of
+// all the mixed audio, so optimisations can be checked for bit-exactness.
+
+constexpr int DefaultBenchmarkFrameHashInterval = 70;
+
+void BENCHMARK_Enable(const int emulated_seconds, const int frame_hash_interval);
+bool BENCHMARK_IsEnabled();
+
+// Starts the clocks; call once all config sections have been initialised
+void BENCHMARK_Start();
+
+void BENCHMARK_AddFrame(const RenderedImage& image);
+void BENCHMARK_AddAudio(const int16_t* frames, const int num_frames);
+
+// Prints the results to the standard output
+void BENCHMARK_PrintReport();
+
+#endif // DOSBOX_BENCHMARK_H
@@ -0,0 +1,88 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_CGA_LINE_DECODERS_H
+#define DOSBOX_CGA_LINE_DECODERS_H
+
+#include <cstdint>
+
+// Line decoders of the CGA, Tandy and PCjr graphics modes.
+//
+// Each decoder has a vectorised implementation (SSE2 or NEON, where
+// available) and a scalar reference implementation with a 'Scalar' suffix.
+// Both produce bit-identical output; the scalar ones are the original
+// per-pixel table lookups and are kept for non-SIMD hosts and for testing.
+
+// Expands 'num_bytes' of 1 bit-per-pixel video memory into 8-bit pixels (8
+// per byte, most significant bit first) using the CGA_2_Table layout.
+void CGA_Decode1Bpp(const uint8_t* src, const int num_bytes,
+                    const uint32_t table[16], uint8_t* dest);
+
+void CGA_Decode1BppScalar(const uint8_t* src, const int num_bytes,
+                          const uint32_t table[16], uint8_t* dest);
+
+// Expands 'num_bytes' of 2 bits-per-pixel video memory into 8-bit pixels (4
+// per byte, most significant bits first) using the CGA_4_Table layout.
+void CGA_Decode2Bpp(const uint8_t* src, const int num_bytes,
+                    const uint32_t table[256], uint8_t* dest);
+
+void CGA_Decode2BppScalar(const uint8_t* src, const int num_bytes,
+                          const uint32_t table[256], uint8_t* dest);
+
+// Expands 'num_bytes' of 4 bits-per-pixel video memory into 8-bit pixels
+// through the 16-colour palette, optionally doubling every pixel.
+void CGA_Decode4Bpp(const uint8_t* src, const int num_bytes,
+                    const uint8_t palette[16], const bool double_pixels,
+                    uint8_t* dest);
+
+void CGA_Decode4BppScalar(const uint8_t* src, const int num_bytes,
+                          const uint8_t palette[16], const bool double_pixels,
+                          uint8_t* dest);
+
+// The current composite monitor emulation parameters (see vga.composite)
+struct CgaCompositeSettings {
+	// The 1024-entry CGA_Composite_Table
+	const int* table = nullptr;
+
+	int32_t ri = 0;
+	int32_t rq = 0;
+	int32_t gi = 0;
+	int32_t gq = 0;
+	int32_t bi = 0;
+	int32_t bq = 0;
+
+	int32_t sharpness = 0;
+
+	bool is_black_and_white = false;
+};
+
+// Runs the NTSC composite filter over the line of 'blocks' * 4 RGBI pixels
+// held in 'line' and replaces them with 32-bit RGB pixels. With
+// 'double_width' set, every input pixel is doubled first, so twice as many
+// pixels are output.
+void CGA_CompositeProcess(uint8_t* line, const uint8_t border,
+                          const uint32_t blocks, const bool double_width,
+                          const CgaCompositeSettings& settings);
+
+void CGA_CompositeProcessScalar(uint8_t* line, const uint8_t border,
+                                const uint32_t blocks, const bool double_width,
+                                const CgaCompositeSettings& settings);
+
+#endif // DOSBOX_CGA_LINE_DECODERS_H
@@ -59,10 +59,13 @@ struct CommandLineArguments {
 	std::string working_dir;
 	std::string lang;
 	std::string machine;
+	std::string startup_trace;
 	std::vector<std::string> conf;
 	std::vector<std::string> set;
 	std::optional<std::vector<std::string>> editconf;
 	std::optional<int> socket;
+	std::optional<int> benchmark;
+	std::optional<int> benchmark_hash_interval;
 };
 
 class Config {
@@ -91,6 +91,10 @@ Bits CPU_Core_Prefetch_Trap_Run() noexcept;
 
 void CPU_Reset_AutoAdjust(void);
 
+// Swaps between the normal and the dynamic core at the next cycle check;
+// does nothing if no dynamic core is built in
+void CPU_SwitchDynamicCore(const bool use_dynamic_core);
+
 
 //CPU Stuff
 
@@ -191,6 +195,8 @@ void CPU_Push32(const uint32_t value);
 #define CR0_FPUPRESENT			0x00000010
 #define CR0_PAGING				0x80000000
 
+#define CR4_PAGEGLOBALENABLE	0x00000080
+
 // reasons for triggering a debug exception
 #define DBINT_BP0               0x00000001
 #define DBINT_BP1               0x00000002
@@ -497,6 +503,7 @@ struct CPUBlock {
 	Bitu cpl;							/* Current Privilege */
 	Bitu mpl;
 	Bitu cr0;
+	Bitu cr4;
 	bool pmode;							/* Is Protected mode enabled */
 	GDTDescriptorTable gdt;
 	DescriptorTable idt;
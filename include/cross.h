@@ -26,6 +26,7 @@
 
 #include <cstdio>
 #include <ctime>
+#include <optional>
 #include <string>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -158,6 +159,10 @@ bool get_expanded_files(const std::string &path,
 
 std::string get_language_from_os();
 
+// The process's resident set size (the memory actually backed by RAM), if
+// the host OS lets us query it
+std::optional<size_t> get_resident_memory_bytes();
+
 // A printf variant outputting UTF-8 strings
 template <typename... Arguments>
 void printf_utf8(const char* format, Arguments... arguments)
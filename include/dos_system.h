@@ -193,6 +193,13 @@ public:
 	uint16_t GetInformation() override;
 	bool UpdateDateTimeFromHost() override;
 	void Flush();
+	bool CopyFrom(localFile& source);
+
+	// Called before anything gets written to the file
+	virtual bool PrepareForWrite()
+	{
+		return true;
+	}
 	void SetFlagReadOnlyMedium() override
 	{
 		read_only_medium = true;
@@ -55,6 +55,10 @@ void DOSBOX_RunMachine();
 void DOSBOX_SetLoop(LoopHandler * handler);
 void DOSBOX_SetNormalLoop();
 
+// True while the fast-forward hotkey is held; rendering and audio can cut
+// corners during this time
+bool DOSBOX_IsFastForwarding();
+
 void DOSBOX_Init(void);
 
 void DOSBOX_SetMachineTypeFromConfig(Section_prop* section);
@@ -0,0 +1,101 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_FRAME_MAILBOX_H
+#define DOSBOX_FRAME_MAILBOX_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Triple-buffered hand-over of rendered frames from the emulation thread (the
+// producer) to a presentation thread (the consumer).
+//
+// The producer renders into the back buffer and publishes it, which turns it
+// into the ready buffer. The consumer swaps the ready buffer with its front
+// buffer whenever a new frame has been published. Neither side waits for the
+// other beyond a short critical section; if the producer publishes again
+// before the consumer took the previous frame, that frame is dropped.
+//
+// The renderer only writes the lines that changed since the previous frame.
+// So each buffer tracks the rows it's missing compared to the most recently
+// published frame and has them copied over when it next becomes the back
+// buffer. Likewise, the consumer gets the rows changed by all the frames
+// published since it last took one.
+class FrameMailbox {
+public:
+	// Reallocates the buffers and forgets about any published frames. The
+	// consumer must not access the mailbox while this runs.
+	void Resize(const int pitch, const int height);
+
+	int GetPitch() const
+	{
+		return pitch;
+	}
+
+	int GetHeight() const
+	{
+		return height;
+	}
+
+	// Producer side: returns the buffer to render the next frame into,
+	// holding the most recently published frame.
+	uint8_t* AcquireBackBuffer();
+
+	// Producer side: publishes the back buffer. 'changed_lines' is the
+	// renderer's list of alternating unchanged and changed line counts,
+	// starting with unchanged lines.
+	void Publish(const uint16_t* changed_lines);
+
+	// Consumer side: returns the front buffer if a frame was published
+	// since the last call, or nullptr otherwise. 'changed_rows' gets one
+	// non-zero entry per row that changed since the previous frame taken.
+	const uint8_t* TakeFrame(std::vector<uint8_t>& changed_rows);
+
+	uint32_t GetNumPublished() const;
+	uint32_t GetNumDropped() const;
+
+private:
+	static constexpr int NumBuffers = 3;
+
+	std::array<std::vector<uint8_t>, NumBuffers> buffers = {};
+
+	// Producer only: rows each buffer is missing compared to the latest
+	// published frame, and the rows changed by the frame being published
+	std::array<std::vector<uint8_t>, NumBuffers> stale_rows = {};
+	std::vector<uint8_t> published_rows                    = {};
+	int latest                                             = -1;
+
+	// Guarded by the mutex
+	mutable std::mutex mutex          = {};
+	std::vector<uint8_t> pending_rows = {};
+	int back                          = 0;
+	int ready                         = 1;
+	int front                         = 2;
+	bool has_new_frame                = false;
+	uint32_t num_published            = 0;
+	uint32_t num_dropped              = 0;
+
+	int pitch  = 0;
+	int height = 0;
+};
+
+#endif // DOSBOX_FRAME_MAILBOX_H
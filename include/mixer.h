@@ -258,6 +258,9 @@ public:
 	// Timing on how many sample frames have been done by the mixer
 	std::atomic<int> frames_done = 0;
 
+	// Frames mixed while the performance counters are enabled
+	uint64_t num_frames_mixed = 0;
+
 	bool is_enabled = false;
 
 private:
@@ -274,6 +277,7 @@ private:
 
 	void ConfigureResampler();
 	void ClearResampler();
+	void ResampleNearest();
 	void InitZohUpsamplerState();
 	void InitLerpUpsamplerState();
 
@@ -367,6 +371,12 @@ private:
 		SpeexResamplerState* state = nullptr;
 	} speex_resampler = {};
 
+	// Position of the cheap resampler used while fast-forwarding
+	struct {
+		float pos      = 0.0f;
+		bool is_active = false;
+	} nearest_resampler = {};
+
 	struct {
 		struct {
 			std::array<Iir::Butterworth::HighPass<max_filter_order>, 2> hpf = {};
@@ -456,6 +466,10 @@ void MIXER_SetMasterVolume(const AudioFrame volume);
 void MIXER_Mute();
 void MIXER_Unmute();
 
+// While fast-forwarding, the devices keep generating their audio, but the
+// mixer skips the filters, effects, and high-quality resampling
+void MIXER_SetFastForward(const bool is_fast_forwarding);
+
 void MIXER_LockAudioDevice();
 void MIXER_UnlockAudioDevice();
 
@@ -89,12 +89,35 @@ bool PAGING_Enabled();
 
 Bitu PAGING_GetDirBase();
 void PAGING_SetDirBase(Bitu cr3);
+void PAGING_SetGlobalPagesEnabled(bool enabled);
 void PAGING_InitTLB();
 void PAGING_ClearTLB();
 
+// Cumulative counters of the TLB and its address-space switching
+struct PagingStats {
+	// Entries into the page-linking handlers, i.e. TLB misses
+	uint64_t num_tlb_misses = 0;
+
+	// Page faults raised in the guest
+	uint64_t num_page_faults = 0;
+
+	// CR3 writes and task switches while paging is enabled
+	uint64_t num_dir_base_loads = 0;
+
+	// Pages relinked from a saved TLB set or kept as global pages instead
+	// of being rebuilt through a TLB miss
+	uint64_t num_pages_restored = 0;
+};
+
+PagingStats PAGING_GetStats();
+
 void PAGING_LinkPage(uint32_t lin_page,uint32_t phys_page);
 void PAGING_LinkPage_ReadOnly(uint32_t lin_page,uint32_t phys_page);
 void PAGING_UnlinkPages(Bitu lin_page,Bitu pages);
+// Refreshes the host pointers of the linked pages backed by the given
+// physical pages, for when their handler maps them elsewhere (e.g. after a
+// video memory bank switch) without the handler itself changing
+void PAGING_RelinkPhysPages(uint32_t phys_page, uint32_t pages);
 /* This maps the page directly, only use when paging is disabled */
 void PAGING_MapPage(Bitu lin_page,Bitu phys_page);
 bool PAGING_MakePhysPage(Bitu & page);
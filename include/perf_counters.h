@@ -0,0 +1,171 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_PERF_COUNTERS_H
+#define DOSBOX_PERF_COUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Section;
+
+// Performance counters
+// ~~~~~~~~~~~~~~~~~~~~
+// A registry of named event counters and timers that show where the
+// emulation time goes. They're enabled with the 'perf_counters' setting,
+// shown by the STATS command, and optionally dumped periodically to a CSV or
+// JSON file.
+//
+// Counters are static objects owned by the module that counts, for example:
+//
+//   static PerfCounter pic_events("pic.events");
+//   ...
+//   pic_events.Add();
+//
+// While disabled, counting costs a single predictable branch. Once enabled,
+// every thread counts into its own shard of plain (uncontended) memory
+// locations, which are only summed up when the values are read.
+
+constexpr int MaxPerfCounters = 128;
+
+struct PerfCounterShard {
+	// Only ever written by the thread owning the shard; relaxed atomics
+	// let the other threads read the values without tearing. The extra
+	// last value takes the counts of the counters registered past
+	// MaxPerfCounters, and is never reported.
+	std::array<std::atomic<uint64_t>, MaxPerfCounters + 1> values = {};
+};
+
+extern std::atomic<bool> perf_counters_enabled;
+extern thread_local PerfCounterShard* perf_thread_shard;
+
+PerfCounterShard* PERF_CreateThreadShard();
+
+inline bool PERF_IsEnabled()
+{
+	return perf_counters_enabled.load(std::memory_order_relaxed);
+}
+
+class PerfCounter {
+public:
+	PerfCounter(const char* name);
+
+	void Add(const uint64_t amount = 1)
+	{
+		if (PERF_IsEnabled()) {
+			AddToShard(amount);
+		}
+	}
+
+	PerfCounter(const PerfCounter&)            = delete;
+	PerfCounter& operator=(const PerfCounter&) = delete;
+
+private:
+	void AddToShard(const uint64_t amount)
+	{
+		auto shard = perf_thread_shard;
+		if (!shard) {
+			shard = PERF_CreateThreadShard();
+		}
+		auto& value = shard->values[index];
+		value.store(value.load(std::memory_order_relaxed) + amount,
+		            std::memory_order_relaxed);
+	}
+
+	int index = 0;
+};
+
+// Counts the calls of a piece of code and the total time spent in them, as
+// the '<name>.calls' and '<name>.ns' counters
+class PerfTimer {
+public:
+	PerfTimer(const std::string& name);
+
+	void Add(const std::chrono::steady_clock::duration elapsed)
+	{
+		using namespace std::chrono;
+		calls.Add();
+		nanoseconds.Add(static_cast<uint64_t>(
+		        duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+	}
+
+private:
+	std::string calls_name       = {};
+	std::string nanoseconds_name = {};
+	PerfCounter calls;
+	PerfCounter nanoseconds;
+};
+
+// Times its own lifetime with the given timer
+class PerfTimerScope {
+public:
+	PerfTimerScope(PerfTimer& perf_timer)
+	        : timer(perf_timer),
+	          is_enabled(PERF_IsEnabled())
+	{
+		if (is_enabled) {
+			start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~PerfTimerScope()
+	{
+		if (is_enabled) {
+			timer.Add(std::chrono::steady_clock::now() - start);
+		}
+	}
+
+	PerfTimerScope(const PerfTimerScope&)            = delete;
+	PerfTimerScope& operator=(const PerfTimerScope&) = delete;
+
+private:
+	PerfTimer& timer;
+	std::chrono::steady_clock::time_point start = {};
+	bool is_enabled = false;
+};
+
+struct PerfSample {
+	std::string name = {};
+	uint64_t value   = 0;
+};
+
+// Providers report counters that don't fit a fixed name, such as one per
+// mixer channel. They're only called on the main thread.
+using PerfCounterProvider = std::function<void(std::vector<PerfSample>& samples)>;
+
+void PERF_AddProvider(PerfCounterProvider provider);
+
+// The non-zero counter values since they were enabled or last reset, sorted
+// by name
+std::vector<PerfSample> PERF_GetSamples();
+
+// Milliseconds since the counters were enabled or last reset
+int64_t PERF_GetSampledMs();
+
+void PERF_Reset();
+
+void PERF_Init(Section* sec);
+
+#endif // DOSBOX_PERF_COUNTERS_H
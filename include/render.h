@@ -27,6 +27,7 @@
 #include "../src/gui/render_scalers.h"
 #include "fraction.h"
 #include "rect.h"
+#include "render_rotation.h"
 #include "vga.h"
 
 enum class ViewportMode { Fit, Relative };
@@ -192,6 +193,9 @@ void RENDER_AddConfigSection(const config_ptr_t& conf);
 
 AspectRatioCorrectionMode RENDER_GetAspectRatioCorrectionMode();
 
+// The rotation of the output currently in effect (see the 'rotation' setting)
+Rotation RENDER_GetRotation();
+
 DosBox::Rect RENDER_CalcRestrictedViewportSizeInPixels(const DosBox::Rect& canvas_px);
 
 const std::string RENDER_GetCgaColorsSetting();
@@ -206,6 +210,19 @@ void RENDER_SetSize(const ImageInfo& image_info, const double frames_per_second)
 bool RENDER_StartUpdate(void);
 void RENDER_EndUpdate(bool abort);
 
+// Counters of the adaptive frameskip (see the 'auto_frameskip' setting)
+struct FrameSkipStats {
+	uint32_t num_rendered = 0;
+
+	// Skipped because the frame wouldn't have been presented anyway
+	uint32_t num_skipped_not_due = 0;
+
+	// Skipped because the emulation fell behind the wall clock
+	uint32_t num_skipped_behind = 0;
+};
+
+FrameSkipStats RENDER_GetFrameSkipStats();
+
 void RENDER_SetPalette(const uint8_t entry, const uint8_t red,
                        const uint8_t green, const uint8_t blue);
 
@@ -0,0 +1,71 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_RENDER_ROTATION_H
+#define DOSBOX_RENDER_ROTATION_H
+
+#include <cstdint>
+
+#include "rect.h"
+
+// Clockwise rotation applied to the scaler output before it's handed over to
+// the rendering backend (e.g., for vertically oriented arcade-style games
+// played on a rotated monitor).
+enum class Rotation : uint16_t {
+	Deg0   = 0,
+	Deg90  = 90,
+	Deg180 = 180,
+	Deg270 = 270,
+};
+
+constexpr bool is_rotated_sideways(const Rotation rotation)
+{
+	return rotation == Rotation::Deg90 || rotation == Rotation::Deg270;
+}
+
+// Rotates the rows [first_row, first_row + num_rows) of a 'width' x 'height'
+// source image into the destination image. The destination is 'height' x
+// 'width' pixels for 90 and 270 degree rotations, and 'width' x 'height'
+// pixels otherwise. Only the destination pixels belonging to the given
+// source rows are written, so the changed line bands reported by the scaler
+// can be rotated individually.
+//
+// Supports 8, 16 and 32-bit pixels. Rotation::Deg0 is a plain row copy.
+void RENDER_RotateRows(const Rotation rotation, const uint8_t bytes_per_pixel,
+                       const uint8_t* src, const int src_pitch,
+                       const int width, const int height, const int first_row,
+                       const int num_rows, uint8_t* dst, const int dst_pitch);
+
+// The rotated output drawn into 'output_rect' covers the same area as the
+// unrotated image drawn into the returned rectangle: same origin, with the
+// width and height swapped for 90 and 270 degree rotations. Used to map host
+// mouse positions back to the guest's orientation.
+DosBox::Rect RENDER_UnrotateRect(const Rotation rotation,
+                                 const DosBox::Rect& output_rect);
+
+// Maps a position in the rotated output drawn into 'output_rect' to the
+// matching position in RENDER_UnrotateRect(rotation, output_rect).
+void RENDER_UnrotatePoint(const Rotation rotation,
+                          const DosBox::Rect& output_rect, float& x, float& y);
+
+// Maps a relative movement in the rotated output to the unrotated image.
+void RENDER_UnrotateDelta(const Rotation rotation, float& dx, float& dy);
+
+#endif // DOSBOX_RENDER_ROTATION_H
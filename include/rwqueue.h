@@ -93,6 +93,11 @@ public:
 	//  return false and the item will not be queued.
 	bool Enqueue(T&& item);
 
+	// Queues the item only if there's room for it right away; otherwise
+	// returns false and leaves the item untouched. Never blocks, so
+	// real-time producers can apply their own overflow policy.
+	bool NonblockingEnqueue(T&& item);
+
 	// The method potentially blocks until there is at least a single item
 	// in the queue to dequeue.
 
@@ -250,6 +250,7 @@ struct SDL_Block {
 		std::string hint_mouse_str  = {};
 		std::string hint_paused_str = {};
 		std::string cycles_ms_str   = {};
+		double fast_forward_speed   = 0.0;
 	} title_bar = {};
 
 	struct {
@@ -284,6 +285,9 @@ struct SDL_Block {
 
 		GLuint actual_frame_count;
 		GLfloat vertex_data[2 * 3];
+
+		// Present frames from a separate thread ('threaded_presentation')
+		bool use_presentation_thread = false;
 	} opengl = {};
 #endif // C_OPENGL
 
@@ -26,6 +26,7 @@
 
 #include <cstdio>
 #include <deque>
+#include <future>
 #include <list>
 #include <map>
 #include <memory>
@@ -321,6 +322,8 @@ private:
 
 	std::deque<Function_wrapper> init_functions   = {};
 	std::deque<Function_wrapper> destroyfunctions = {};
+	std::deque<SectionFunction> prepare_functions = {};
+	std::vector<std::future<void>> preparations   = {};
 	std::string sectionname                       = {};
 
 public:
@@ -339,6 +342,17 @@ public:
 	void AddDestroyFunction(SectionFunction func,
 	                        bool changeable_at_runtime = false);
 
+	// Preparation functions do expensive work that doesn't depend on any
+	// other section having been initialised, such as parsing resource
+	// files. They run on worker threads while the preceding sections
+	// initialise and are finished before this section's init functions
+	// are called, so they must only read this section's settings and
+	// touch state of their own.
+	void AddPrepareFunction(SectionFunction func);
+
+	void StartPreparation();
+	void FinishPreparation();
+
 	void ExecuteInit(bool initall = true);
 	void ExecuteDestroy(bool destroyall = true);
 
@@ -0,0 +1,70 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_STARTUP_TRACE_H
+#define DOSBOX_STARTUP_TRACE_H
+
+#include <chrono>
+#include <string>
+
+#include "std_filesystem.h"
+
+// Startup timeline
+// ~~~~~~~~~~~~~~~~
+// Records how long each step of the emulator's startup takes (parsing the
+// configuration, initialising every config section, preparing resources on
+// worker threads, and so on) up to the first DOS prompt.
+//
+// Enabled with the '--startup-trace <file>' command-line option; the
+// timeline is written in the Chrome trace event format, which can be loaded
+// into chrome://tracing or https://ui.perfetto.dev. Recording is thread-safe
+// and costs nothing while tracing is disabled.
+
+void STARTUP_EnableTrace(const std_fs::path& path);
+bool STARTUP_IsTraceEnabled();
+
+using startup_trace_clock = std::chrono::steady_clock;
+
+void STARTUP_TraceEvent(const std::string& name,
+                        const startup_trace_clock::time_point start,
+                        const startup_trace_clock::time_point end);
+
+// Records a point in time, such as reaching the first DOS prompt
+void STARTUP_TraceMilestone(const std::string& name);
+
+// Writes the recorded timeline to the file; only the first call does so
+void STARTUP_WriteTrace();
+
+// Records its own lifetime as an event on the calling thread's timeline
+class StartupTraceScope {
+public:
+	StartupTraceScope(std::string event_name);
+	~StartupTraceScope();
+
+	StartupTraceScope(const StartupTraceScope&)            = delete;
+	StartupTraceScope& operator=(const StartupTraceScope&) = delete;
+
+private:
+	std::string name = {};
+	startup_trace_clock::time_point start = {};
+	bool is_enabled = false;
+};
+
+#endif // DOSBOX_STARTUP_TRACE_H
@@ -292,6 +292,10 @@ std::string join_with_commas(const std::vector<std::string>& items,
 // Clear the language if it's set to the POSIX default
 void clear_language_if_default(std::string& language);
 
+// Load the mapping resources used by the code page conversions below ahead of
+// their first use; this is safe to call from any thread
+void load_unicode_mappings();
+
 // Get recommended DOS code page to render the UTF-8 strings to. This
 // might not be the code page set using KEYB command, for example due
 // to emulated hardware limitations, or duplicated code page numbers
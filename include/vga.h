@@ -37,7 +37,12 @@
 
 //Don't enable keeping changes and mapping lfb probably...
 #define VGA_LFB_MAPPED
-//#define VGA_KEEP_CHANGES
+
+// Keep track of video memory writes in blocks of 1 << VGA_CHANGE_SHIFT bytes
+// so lines whose memory hasn't changed can be skipped when drawing. Only
+// covers memory written through the VGA page handlers, i.e., not the
+// directly mapped linear modes (see VGA_LFB_MAPPED).
+#define VGA_KEEP_CHANGES
 #define VGA_CHANGE_SHIFT	9
 
 class PageHandler;
@@ -259,6 +264,12 @@ struct VgaDraw {
 
 	bool is_double_scanning = false;
 
+	// Set once the DAC palette is written while a 256-colour frame is
+	// being drawn; the mode is then drawn with the colours expanded per
+	// line instead of handing the palette indexes to the renderer. Reset
+	// on mode changes.
+	bool has_mid_frame_palette_changes = false;
+
 	// When drawing in parts, how many many 'chunks' should we draw at a
 	// time? A value of 1 is the entire frame where as a value of 2 will
 	// draw the top then the bottom, 4 will draw in quarters, and so on.
@@ -313,6 +324,14 @@ struct VgaDraw {
 	Drawmode mode       = {};
 	bool vret_triggered = false;
 	bool vga_override   = false;
+
+	// Draw the whole virtual height of video memory instead of just the
+	// visible window, for games that scroll a tall playfield by moving
+	// the display start address (see the 'vga_full_playfield' setting).
+	struct {
+		bool enabled = false;
+		bool active  = false;
+	} full_playfield = {};
 };
 
 struct VGA_HWCURSOR {
@@ -950,6 +969,10 @@ struct VgaDac {
 	Rgb666 rgb[NumVgaColors]           = {};
 	Bgrx8888 palette_map[NumVgaColors] = {};
 
+	// Incremented on every palette_map change so renderers caching
+	// palettized pixels know when to refresh them
+	uint32_t palette_map_generation = 0;
+
 	uint8_t combine[16] = {};
 
 	// DAC 8-bit registers
@@ -980,18 +1003,21 @@ struct VgaMemory {
 	uint8_t* linear = {};
 };
 
-struct VGA_Changes {
-	// Add a few more just to be safe
-	// Allocated dynamically: [(VGA_MEMORY >> VGA_CHANGE_SHIFT) + 32]
-	uint8_t* map = nullptr;
-
-	uint8_t checkMask    = 0;
-	uint8_t frame        = 0;
-	uint8_t writeMask    = 0;
-	bool active          = 0;
-	uint32_t clearMask   = 0;
-	uint32_t start       = 0;
-	uint32_t last        = 0;
+struct VgaChanges {
+	// Dirty bitmaps with one bit per block, indexed by draw address. Planar
+	// modes address pixels, so they cover twice the video memory. The
+	// memory handlers flag writes in 'map'; at the start of each rendered
+	// frame it becomes 'previous_map' and a cleared map takes its place.
+	// Lines are redrawn if either map flags them, as a line drawn before a
+	// write in the same frame only shows it in the next one.
+	uint64_t* map          = nullptr;
+	uint64_t* previous_map = nullptr;
+	uint32_t num_words     = 0;
+
+	// Skip drawing and comparing frames and lines whose memory hasn't
+	// changed (set by the 'vga_render_skip' setting)
+	bool skip_unchanged = false;
+
 	uint32_t lastAddress = 0;
 };
 
@@ -1127,6 +1153,19 @@ double VGA_GetPreferredRate();
 void VGA_DACSetEntirePalette(void);
 void VGA_StartRetrace(void);
 void VGA_StartUpdateLFB(void);
+
+// Planar writes defer the expansion into vga.fastmem; these bring the given
+// span (in pixels, i.e., fastmem offsets) or all stale pixels up to date.
+void VGA_ExpandPlanarPixels(const uint32_t pixel_offset, const uint32_t num_pixels);
+void VGA_ExpandAllPlanarPixels();
+
+// Forgets the pending planar writes, e.g. after clearing all video memory
+void VGA_DiscardPlanarPixels();
+
+// Chained mode 13h memory can be mapped straight to vga.fastmem; this brings
+// the change maps and the replicated first line up to date before a frame.
+void VGA_SyncDirectChain4Memory();
+
 void VGA_SetBlinking(uint8_t enabled);
 void VGA_SetCGA2Table(uint8_t val0, uint8_t val1);
 void VGA_SetCGA4Table(uint8_t val0, uint8_t val1, uint8_t val2, uint8_t val3);
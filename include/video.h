@@ -398,7 +398,15 @@ void GFX_Stop(void);
 void GFX_SwitchFullScreen(void);
 bool GFX_StartUpdate(uint8_t * &pixels, int &pitch);
 void GFX_EndUpdate( const uint16_t *changedLines );
+
+// Whether a frame finishing 'frame_duration_us' from now would be presented;
+// only the throttled variable frame rate mode drops frames
+bool GFX_IsPresentationDue(const int64_t frame_duration_us);
 void GFX_LosingFocus();
+
+// Shows the measured fast-forward speed-up factor in the title bar; pass 0
+// to hide it
+void GFX_SetFastForwardSpeed(const double speed);
 void GFX_RegenerateWindow(Section *sec);
 
 enum class MouseHint {
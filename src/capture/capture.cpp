@@ -28,7 +28,9 @@
 
 #include "capture_audio.h"
 #include "capture_midi.h"
+#include "capture_replay.h"
 #include "capture_video.h"
+#include "capture_writer.h"
 #include "checks.h"
 #include "control.h"
 #include "fs_utils.h"
@@ -96,10 +98,16 @@ bool CAPTURE_IsCapturingVideo()
 	return capture.state.video != CaptureState::Off;
 }
 
+bool CAPTURE_IsRecordingReplay()
+{
+	return capture_replay_is_enabled();
+}
+
 static const char* capture_type_to_string(const CaptureType type)
 {
 	switch (type) {
 	case CaptureType::Audio: return "audio output";
+	case CaptureType::FlacAudio: return "audio output as FLAC";
 	case CaptureType::Midi: return "MIDI output";
 	case CaptureType::RawOplStream: return "rawl OPL output";
 	case CaptureType::RadOplInstruments: return "RAD capture";
@@ -119,7 +127,8 @@ static const char* capture_type_to_string(const CaptureType type)
 static const char* capture_type_to_basename(const CaptureType type)
 {
 	switch (type) {
-	case CaptureType::Audio: return "audio";
+	case CaptureType::Audio:
+	case CaptureType::FlacAudio: return "audio";
 	case CaptureType::Midi: return "midi";
 	case CaptureType::RawOplStream: return "rawopl";
 	case CaptureType::RadOplInstruments: return "oplinstr";
@@ -140,6 +149,7 @@ static const char* capture_type_to_extension(const CaptureType type)
 {
 	switch (type) {
 	case CaptureType::Audio: return ".wav";
+	case CaptureType::FlacAudio: return ".flac";
 	case CaptureType::Midi: return ".mid";
 	case CaptureType::RawOplStream: return ".dro";
 	case CaptureType::RadOplInstruments: return ".rad";
@@ -223,7 +233,8 @@ static std::optional<int32_t> find_highest_capture_index(const CaptureType type)
 static void set_next_capture_index(const CaptureType type, int32_t index)
 {
 	switch (type) {
-	case CaptureType::Audio: capture.next_index.audio = index; break;
+	case CaptureType::Audio:
+	case CaptureType::FlacAudio: capture.next_index.audio = index; break;
 	case CaptureType::Midi: capture.next_index.midi = index; break;
 
 	case CaptureType::RawOplStream:
@@ -250,11 +261,13 @@ static void set_next_capture_index(const CaptureType type, int32_t index)
 	}
 }
 
-static bool maybe_create_capture_dir_and_init_capture_indices()
-{
-	static std::mutex mutex = {};
-	std::lock_guard<std::mutex> lock(mutex);
+// Instant replays are saved from a background thread, so the lazy
+// initialisation and the index increments are done under the same lock
+static std::mutex capture_index_mutex = {};
 
+// Must be called with 'capture_index_mutex' held
+static bool init_capture_dir_and_indices()
+{
 	if (capture.path_initialised) {
 		return true;
 	}
@@ -262,6 +275,7 @@ static bool maybe_create_capture_dir_and_init_capture_indices()
 		return false;
 	}
 
+	// FLAC audio captures share the index of the WAV audio captures
 	constexpr CaptureType all_capture_types[] = {CaptureType::Audio,
 	                                             CaptureType::Midi,
 	                                             CaptureType::RawOplStream,
@@ -286,14 +300,23 @@ static bool maybe_create_capture_dir_and_init_capture_indices()
 	return true;
 }
 
+static bool maybe_create_capture_dir_and_init_capture_indices()
+{
+	std::lock_guard<std::mutex> lock(capture_index_mutex);
+	return init_capture_dir_and_indices();
+}
+
 int32_t get_next_capture_index(const CaptureType type)
 {
-	if (!maybe_create_capture_dir_and_init_capture_indices()) {
+	std::lock_guard<std::mutex> lock(capture_index_mutex);
+
+	if (!init_capture_dir_and_indices()) {
 		return 0;
 	}
 
 	switch (type) {
-	case CaptureType::Audio: return capture.next_index.audio++;
+	case CaptureType::Audio:
+	case CaptureType::FlacAudio: return capture.next_index.audio++;
 	case CaptureType::Midi: return capture.next_index.midi++;
 
 	case CaptureType::RawOplStream:
@@ -399,6 +422,20 @@ void CAPTURE_AddFrame(const RenderedImage& image, const float frames_per_second)
 		capture_video_add_frame(image, frames_per_second);
 		break;
 	}
+
+	if (capture_replay_is_enabled()) {
+		capture_replay_add_frame(image, frames_per_second);
+	}
+}
+
+void CAPTURE_AddReplayFrame(const RenderedImage& image, const float frames_per_second)
+{
+	capture_replay_add_frame(image, frames_per_second);
+}
+
+void CAPTURE_AddReplayDuplicateFrame(const float frames_per_second)
+{
+	capture_replay_add_duplicate_frame(frames_per_second);
 }
 
 void CAPTURE_AddPostRenderImage(const RenderedImage& image)
@@ -432,6 +469,12 @@ void CAPTURE_AddAudioData(const uint32_t sample_rate, const uint32_t num_sample_
 		capture_audio_add_data(sample_rate, num_sample_frames, sample_frames);
 		break;
 	}
+
+	if (capture_replay_is_enabled()) {
+		capture_replay_add_audio_data(sample_rate,
+		                              num_sample_frames,
+		                              sample_frames);
+	}
 }
 
 void CAPTURE_AddMidiData(const bool sysex, const size_t len, const uint8_t* data)
@@ -542,6 +585,20 @@ static void handle_capture_single_rendered_screenshot_event(const bool pressed)
 	}
 }
 
+static void handle_save_replay_event(const bool pressed)
+{
+	// Ignore key-release events
+	if (!pressed) {
+		return;
+	}
+	if (!capture_replay_is_enabled()) {
+		LOG_WARNING("CAPTURE: Instant replay is disabled; set 'replay_length' "
+		            "to enable it");
+		return;
+	}
+	capture_replay_save();
+}
+
 static void handle_capture_video_event(bool pressed)
 {
 	// Ignore key-release events
@@ -573,6 +630,10 @@ static void capture_destroy(Section* /*sec*/)
 		capture_video_finalise();
 		capture.state.video = CaptureState::Off;
 	}
+	capture_replay_destroy();
+
+	// Wait until the audio and MIDI captures are written out
+	capture_writer_stop();
 
 	capture = {};
 }
@@ -601,6 +662,14 @@ static void capture_init(Section* sec)
 
 	image_capturer = std::make_unique<ImageCapturer>(prefs);
 
+	capture_replay_init(secprop->Get_int("replay_length"),
+	                    secprop->Get_int("replay_memory_limit"));
+
+	capture_audio_set_format(secprop->Get_string("audio_capture_format") == "flac"
+	                                 ? AudioCaptureFormat::Flac
+	                                 : AudioCaptureFormat::Wav);
+	capture_writer_start();
+
 	constexpr auto changeable_at_runtime = true;
 	sec->AddDestroyFunction(&capture_destroy, changeable_at_runtime);
 }
@@ -648,6 +717,12 @@ static void init_key_mappings()
 	                  PRIMARY_MOD,
 	                  "video",
 	                  "Rec. Video");
+
+	MAPPER_AddHandler(handle_save_replay_event,
+	                  SDL_SCANCODE_F7,
+	                  MMOD2,
+	                  "savereplay",
+	                  "Save Replay");
 }
 
 static void init_capture_dosbox_settings(Section_prop& secprop)
@@ -686,6 +761,30 @@ static void init_capture_dosbox_settings(Section_prop& secprop)
 	        "Keybindings for taking single screenshots in specific formats are also\n"
 	        "available.");
 	assert(str_prop);
+
+	str_prop = secprop.Add_string("audio_capture_format", when_idle, "wav");
+	str_prop->Set_values({"wav", "flac"});
+	str_prop->Set_help(
+	        "File format of the audio output captures ('wav' by default):\n"
+	        "  wav:   Uncompressed 16-bit stereo WAV file.\n"
+	        "  flac:  Losslessly compressed FLAC file, typically around half the size of\n"
+	        "         the WAV file. The encoding happens in the background.");
+	assert(str_prop);
+
+	auto* int_prop = secprop.Add_int("replay_length", when_idle, 0);
+	int_prop->SetMinMax(0, 600);
+	int_prop->Set_help(
+	        "Number of seconds of video and audio output to keep in memory for instant\n"
+	        "replays (0 by default, which disables instant replays). Use the 'Save Replay'\n"
+	        "hotkey to write the last seconds to an AVI file in the capture directory.");
+	assert(int_prop);
+
+	int_prop = secprop.Add_int("replay_memory_limit", when_idle, 256);
+	int_prop->SetMinMax(16, 4096);
+	int_prop->Set_help(
+	        "Maximum amount of memory the instant replay can use, in megabytes (256 by\n"
+	        "default). The oldest frames are dropped earlier if the limit is reached.");
+	assert(int_prop);
 }
 
 void CAPTURE_AddConfigSection(const config_ptr_t& conf)
@@ -31,6 +31,7 @@
 
 enum class CaptureType {
 	Audio,
+	FlacAudio,
 	Midi,
 	RawOplStream,
 	RadOplInstruments,
@@ -57,6 +58,12 @@ FILE* CAPTURE_CreateFile(const CaptureType type,
 // or as a video recording (or both).
 void CAPTURE_AddFrame(const RenderedImage& image, const float frames_per_second);
 
+// Used to feed the instant replay when no screenshot or video is being
+// captured; frames that weren't rendered are added as duplicates of the
+// previous frame
+void CAPTURE_AddReplayFrame(const RenderedImage& image, const float frames_per_second);
+void CAPTURE_AddReplayDuplicateFrame(const float frames_per_second);
+
 void CAPTURE_AddPostRenderImage([[maybe_unused]] const RenderedImage& image);
 
 // Used to add the last rendered chunk of audio output to be captured either
@@ -75,6 +82,9 @@ bool CAPTURE_IsCapturingPostRenderImage();
 bool CAPTURE_IsCapturingMidi();
 bool CAPTURE_IsCapturingVideo();
 
+// True if the last seconds of the output are kept for instant replays
+bool CAPTURE_IsRecordingReplay();
+
 // Only used internally in the capture module
 int32_t get_next_capture_index(const CaptureType type);
 
@@ -21,41 +21,43 @@
 
 #include "capture.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
 
+#include "capture_audio.h"
+#include "capture_writer.h"
+#include "flac_encoder.h"
 #include "mem.h"
 #include "setup.h"
 
-static constexpr auto SampleFrameSize   = 4;
-static constexpr auto NumFramesInBuffer = 16 * 1024;
-static constexpr auto NumChannels       = 2;
+static constexpr auto SampleFrameSize = 4;
 
+static AudioCaptureFormat capture_format = AudioCaptureFormat::Wav;
+
+// The file is created on the calling thread; the sample data and the final
+// headers are written on the capture writer thread
 static struct {
 	FILE* handle = nullptr;
 
-	uint16_t buf[NumFramesInBuffer][NumChannels] = {};
+	// Only used when capturing to FLAC; encoding happens on the writer
+	// thread as well
+	std::shared_ptr<FlacEncoder> flac_encoder = {};
 
-	uint32_t sample_rate        = 0;
-	uint32_t buf_frames_used    = 0;
-	
-	// TODO A 16-bit / 44.1kHz WAV file is limited to a bit less than 4GB
-	// worth of sample data because the chunk sizes are stored as 32-bit
-	// unsigned integers in the RIFF container the WAV format uses.
-	//
-	// So technically we should chunk the recording into separate WAV files at
-	// ~3.4 hour intervals, which is the duration of a recording of a 2GB
-	// WAV file recorded at 16-bit/44.1kHz (some programs use 32-bit signed
-	// integers when handling WAV files, therefore 2GB is the safe limit).
-	//
-	// This will be more of a problem when adding support for 24 and 32-bit
-	// formats, as in case of a 32-bit float WAV file, the safe duration is
-	// reduced to ~1.7 hour.
-	uint32_t data_bytes_written = 0;
+	// Writes a full block to the file
+	CaptureWriteFunction write = {};
+
+	// The block being filled with sample frames
+	CaptureBlock block = {};
+
+	uint32_t sample_rate = 0;
 } wave = {};
 
 // clang-format off
-static uint8_t wav_header[] = {
+static const uint8_t wav_header[] = {
 	'R',  'I',  'F',  'F',   // uint32 - RIFF chunk ID
 	0x00, 0x00, 0x00, 0x00,	 // uint32 - RIFF chunk size
 	'W',  'A',  'V',  'E',   // uint32 - RIFF format
@@ -72,18 +74,86 @@ static uint8_t wav_header[] = {
 };
 // clang-format on
 
-static void create_wave_file(const uint32_t sample_rate)
+void capture_audio_set_format(const AudioCaptureFormat format)
+{
+	capture_format = format;
+}
+
+static void finalise_wave_file(FILE* handle, const uint32_t sample_rate)
+{
+	// TODO A 16-bit / 44.1kHz WAV file is limited to a bit less than 4GB
+	// worth of sample data because the chunk sizes are stored as 32-bit
+	// unsigned integers in the RIFF container the WAV format uses.
+	//
+	// So technically we should chunk the recording into separate WAV files at
+	// ~3.4 hour intervals, which is the duration of a recording of a 2GB
+	// WAV file recorded at 16-bit/44.1kHz (some programs use 32-bit signed
+	// integers when handling WAV files, therefore 2GB is the safe limit).
+	//
+	// This will be more of a problem when adding support for 24 and 32-bit
+	// formats, as in case of a 32-bit float WAV file, the safe duration is
+	// reduced to ~1.7 hour.
+	//
+	// Blocks might have been dropped, so the file size tells how much sample
+	// data was actually written.
+	const auto file_size          = std::max(ftell(handle), 0L);
+	const auto data_bytes_written = static_cast<uint32_t>(
+	        std::max(file_size - static_cast<long>(sizeof(wav_header)), 0L));
+
+	// Update headers
+	std::array<uint8_t, sizeof(wav_header)> header = {};
+	std::memcpy(header.data(), wav_header, sizeof(wav_header));
+
+	constexpr auto chunk_header_size = 8;
+
+	const auto riff_chunk_size = static_cast<uint32_t>(
+	        data_bytes_written + sizeof(wav_header) - chunk_header_size);
+
+	constexpr auto riff_chunk_size_offset = 0x04;
+	host_writed(&header[riff_chunk_size_offset], riff_chunk_size);
+
+	constexpr auto sample_rate_offset = 0x18;
+	host_writed(&header[sample_rate_offset], sample_rate);
+
+	constexpr auto byte_rate_offset = 0x1c;
+	host_writed(&header[byte_rate_offset], sample_rate * SampleFrameSize);
+
+	constexpr auto data_chunk_size_offset = 0x28;
+	host_writed(&header[data_chunk_size_offset], data_bytes_written);
+
+	fseek(handle, 0, 0);
+	fwrite(header.data(), 1, header.size(), handle);
+	fclose(handle);
+}
+
+static void create_audio_file(const uint32_t sample_rate)
 {
-	wave.handle = CAPTURE_CreateFile(CaptureType::Audio);
+	const auto is_flac = (capture_format == AudioCaptureFormat::Flac);
+
+	wave.handle = CAPTURE_CreateFile(is_flac ? CaptureType::FlacAudio
+	                                         : CaptureType::Audio);
 	if (!wave.handle) {
 		return;
 	}
 
-	wave.sample_rate        = sample_rate;
-	wave.buf_frames_used    = 0;
-	wave.data_bytes_written = 0;
+	wave.sample_rate = sample_rate;
+	wave.block       = capture_writer_get_block();
+
+	if (is_flac) {
+		wave.flac_encoder = std::make_shared<FlacEncoder>(wave.handle,
+		                                                  sample_rate);
 
-	fwrite(wav_header, 1, sizeof(wav_header), wave.handle);
+		wave.write = [encoder = wave.flac_encoder](const CaptureBlock& block) {
+			encoder->AddFrames(reinterpret_cast<const int16_t*>(block.data()),
+			                   block.size() / SampleFrameSize);
+		};
+	} else {
+		fwrite(wav_header, 1, sizeof(wav_header), wave.handle);
+
+		wave.write = [handle = wave.handle](const CaptureBlock& block) {
+			fwrite(block.data(), 1, block.size(), handle);
+		};
+	}
 }
 
 void capture_audio_add_data(const uint32_t sample_rate,
@@ -91,38 +161,30 @@ void capture_audio_add_data(const uint32_t sample_rate,
                             const int16_t* sample_frames)
 {
 	if (!wave.handle) {
-		create_wave_file(sample_rate);
+		create_audio_file(sample_rate);
 	}
 	if (!wave.handle) {
 		return;
 	}
 
-	const int16_t* data   = sample_frames;
-	auto remaining_frames = num_sample_frames;
+	auto data = reinterpret_cast<const uint8_t*>(sample_frames);
+	auto remaining_bytes = static_cast<size_t>(num_sample_frames) *
+	                       SampleFrameSize;
 
-	while (remaining_frames > 0) {
-		uint32_t frames_left = NumFramesInBuffer - wave.buf_frames_used;
-		if (!frames_left) {
-			const auto bytes_to_write = NumFramesInBuffer * SampleFrameSize;
-			fwrite(wave.buf, 1, bytes_to_write, wave.handle);
+	// The block size is a multiple of the sample frame size, so blocks
+	// always hold whole sample frames
+	while (remaining_bytes > 0) {
+		const auto num_bytes = std::min(remaining_bytes,
+		                                CaptureBlockSize - wave.block.size());
 
-			wave.data_bytes_written += bytes_to_write;
-			wave.buf_frames_used = 0;
-
-			frames_left = NumFramesInBuffer;
-		}
+		wave.block.insert(wave.block.end(), data, data + num_bytes);
+		data += num_bytes;
+		remaining_bytes -= num_bytes;
 
-		if (frames_left > remaining_frames) {
-			frames_left = remaining_frames;
+		if (wave.block.size() == CaptureBlockSize) {
+			capture_writer_queue_block(std::move(wave.block), wave.write);
+			wave.block = capture_writer_get_block();
 		}
-
-		memcpy(&wave.buf[wave.buf_frames_used],
-		       data,
-		       frames_left * SampleFrameSize);
-
-		wave.buf_frames_used += frames_left;
-		data += frames_left * NumChannels;
-		remaining_frames -= frames_left;
 	}
 }
 
@@ -131,34 +193,19 @@ void capture_audio_finalise()
 	if (!wave.handle) {
 		return;
 	}
+	if (!wave.block.empty()) {
+		capture_writer_queue_block(std::move(wave.block), wave.write);
+	}
 
-	// Flush audio buffer
-	const auto bytes_to_write = wave.buf_frames_used * SampleFrameSize;
-	fwrite(wave.buf, 1, bytes_to_write, wave.handle);
-	wave.data_bytes_written += bytes_to_write;
-
-	// Update headers
-	constexpr auto chunk_header_size = 8;
-
-	const auto riff_chunk_size = static_cast<uint32_t>(wave.data_bytes_written +
-	                             sizeof(wav_header) - chunk_header_size);
-
-	constexpr auto riff_chunk_size_offset = 0x04;
-	host_writed(&wav_header[riff_chunk_size_offset], riff_chunk_size);
-
-	constexpr auto sample_rate_offset = 0x18;
-	host_writed(&wav_header[sample_rate_offset], wave.sample_rate);
-
-	constexpr auto byte_rate_offset = 0x1c;
-	host_writed(&wav_header[byte_rate_offset], wave.sample_rate * SampleFrameSize);
-
-	constexpr auto data_chunk_size_offset = 0x28;
-	host_writed(&wav_header[data_chunk_size_offset], wave.data_bytes_written);
-
-	fseek(wave.handle, 0, 0);
-	fwrite(wav_header, 1, sizeof(wav_header), wave.handle);
-	fclose(wave.handle);
+	if (wave.flac_encoder) {
+		capture_writer_queue_task(
+		        [encoder = wave.flac_encoder] { encoder->Finish(); });
+	} else {
+		capture_writer_queue_task(
+		        [handle = wave.handle, sample_rate = wave.sample_rate] {
+			        finalise_wave_file(handle, sample_rate);
+		        });
+	}
 
 	wave = {};
 }
-
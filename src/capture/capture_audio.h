@@ -22,6 +22,13 @@
 #ifndef DOSBOX_CAPTURE_AUDIO_H
 #define DOSBOX_CAPTURE_AUDIO_H
 
+#include <cstdint>
+
+enum class AudioCaptureFormat { Wav, Flac };
+
+// Takes effect when the next audio capture starts
+void capture_audio_set_format(const AudioCaptureFormat format);
+
 void capture_audio_add_data(const uint32_t sample_rate,
                             const uint32_t num_sample_frames,
                             const int16_t* sample_frames);
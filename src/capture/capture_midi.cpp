@@ -21,24 +21,28 @@
 
 #include "capture.h"
 
-#include <array>
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
+#include "capture_midi.h"
+#include "capture_writer.h"
 #include "midi.h"
 #include "pic.h"
 #include "support.h"
 
+// Whole MIDI events are collected into blocks that are written on the
+// capture writer thread, so a dropped block never splits an event
+static constexpr auto MinBlockBytes = 4 * 1024;
+
 static struct {
 	FILE* handle = nullptr;
 
-	std::array<uint8_t, 4 * 1024> buffer = {};
+	CaptureBlock block = {};
 
-	uint32_t bytes_used    = 0;
-	uint32_t bytes_written = 0;
-	uint32_t last_tick     = 0;
+	uint32_t last_tick = 0;
 } midi = {};
 
 // clang-format off
@@ -55,13 +59,18 @@ static uint8_t midi_header[] = {
 
 static void raw_midi_add(const uint8_t data)
 {
-	midi.buffer[midi.bytes_used++] = data;
+	midi.block.push_back(data);
+}
 
-	if (midi.bytes_used >= midi.buffer.size()) {
-		midi.bytes_written += midi.bytes_used;
-		fwrite(midi.buffer.data(), 1, midi.buffer.size(), midi.handle);
-		midi.bytes_used = 0;
-	}
+static void queue_block()
+{
+	const auto handle = midi.handle;
+
+	capture_writer_queue_block(std::move(midi.block),
+	                           [handle](const CaptureBlock& block) {
+		                           fwrite(block.data(), 1, block.size(), handle);
+	                           });
+	midi.block = capture_writer_get_block();
 }
 
 static void raw_midi_add_number(const uint32_t val)
@@ -86,6 +95,7 @@ static void create_midi_file()
 	}
 	fwrite(midi_header, 1, sizeof(midi_header), midi.handle);
 	midi.last_tick = PIC_Ticks;
+	midi.block     = capture_writer_get_block();
 }
 
 void capture_midi_add_data(const bool sysex, const size_t len, const uint8_t* data)
@@ -109,6 +119,37 @@ void capture_midi_add_data(const bool sysex, const size_t len, const uint8_t* da
 	for (size_t i = 0; i < len; ++i) {
 		raw_midi_add(data[i]);
 	}
+
+	if (midi.block.size() >= MinBlockBytes) {
+		queue_block();
+	}
+}
+
+static void finalise_midi_file(FILE* handle)
+{
+	// Blocks might have been dropped, so the file size tells how much
+	// track data was actually written
+	const auto file_size     = std::max(ftell(handle), 0L);
+	const auto bytes_written = static_cast<uint32_t>(std::max(
+	        file_size - static_cast<long>(sizeof(midi_header)), 0L));
+
+	constexpr auto midi_header_size_offset = 18;
+	if (fseek(handle, midi_header_size_offset, SEEK_SET) != 0) {
+		LOG_WARNING("CAPTURE: Failed to seek in captured MIDI file '%s'",
+		            safe_strerror(errno).c_str());
+		fclose(handle);
+		return;
+	}
+
+	uint8_t size[4];
+
+	size[0] = (uint8_t)(bytes_written >> 24);
+	size[1] = (uint8_t)(bytes_written >> 16);
+	size[2] = (uint8_t)(bytes_written >> 8);
+	size[3] = (uint8_t)(bytes_written >> 0);
+	fwrite(&size, 1, 4, handle);
+
+	fclose(handle);
 }
 
 void capture_midi_finalise()
@@ -124,29 +165,12 @@ void capture_midi_finalise()
 	raw_midi_add(0x2f);
 	raw_midi_add(0x00);
 
-	// Flush buffer
-	fwrite(midi.buffer.data(), 1, midi.bytes_used, midi.handle);
-	midi.bytes_written += midi.bytes_used;
-
-	constexpr auto midi_header_size_offset = 18;
-	if (fseek(midi.handle, midi_header_size_offset, SEEK_SET) != 0) {
-		LOG_WARNING("CAPTURE: Failed to seek in captured MIDI file '%s'",
-		            safe_strerror(errno).c_str());
-		fclose(midi.handle);
-		midi = {};
-		return;
-	}
-
-	uint8_t size[4];
-
-	size[0] = (uint8_t)(midi.bytes_written >> 24);
-	size[1] = (uint8_t)(midi.bytes_written >> 16);
-	size[2] = (uint8_t)(midi.bytes_written >> 8);
-	size[3] = (uint8_t)(midi.bytes_written >> 0);
-	fwrite(&size, 1, 4, midi.handle);
+	// The end of the track must not be dropped
+	capture_writer_queue_task([handle = midi.handle, block = midi.block] {
+		fwrite(block.data(), 1, block.size(), handle);
+		finalise_midi_file(handle);
+	});
 
-	fclose(midi.handle);
 	midi = {};
-	return;
 }
 
@@ -0,0 +1,478 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "capture_replay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "capture.h"
+#include "capture_video.h"
+#include "checks.h"
+#include "logging.h"
+
+CHECK_NARROWING();
+
+// Every group of frames starts with a keyframe that stores all rows, so the
+// oldest group can be dropped without losing the reference for the rest
+static constexpr auto KeyframeIntervalSeconds = 2;
+
+// Recycling the buffers of dropped frames avoids allocations in the steady
+// state
+static constexpr size_t MaxUnusedFrames = 256;
+
+static constexpr auto PaletteNumBytes = 256 * 4;
+
+// A frame in the replay buffer. Only the rows that changed since the
+// previous frame are stored, except for keyframes that store every row.
+struct ReplayFrame {
+	uint16_t width           = 0;
+	uint16_t height          = 0;
+	PixelFormat pixel_format = {};
+	float frames_per_second  = 0.0f;
+
+	bool is_keyframe = false;
+
+	// One flag per row; the changed rows are stored back-to-back
+	std::vector<uint8_t> is_row_changed = {};
+	std::vector<uint8_t> rows           = {};
+
+	// Only stored if the palette changed since the previous frame
+	std::vector<uint8_t> palette = {};
+
+	// The audio output since the previous frame
+	uint32_t sample_rate       = 0;
+	std::vector<int16_t> audio = {};
+
+	size_t GetNumBytes() const
+	{
+		return is_row_changed.size() + rows.size() + palette.size() +
+		       audio.size() * sizeof(int16_t);
+	}
+};
+
+static struct {
+	int length_seconds        = 0;
+	size_t memory_limit_bytes = 0;
+
+	std::deque<ReplayFrame> frames         = {};
+	std::vector<ReplayFrame> unused_frames = {};
+
+	size_t num_bytes          = 0;
+	double duration_seconds   = 0.0;
+	int frames_since_keyframe = 0;
+
+	// The newest frame in the buffer and its palette, used to find the
+	// changed rows and palette of the next frame
+	std::vector<uint8_t> last_image   = {};
+	std::vector<uint8_t> last_palette = {};
+
+	// Row with "baked-in" pixel doubling removed
+	std::vector<uint8_t> row_buf = {};
+
+	uint32_t sample_rate               = 0;
+	std::vector<int16_t> pending_audio = {};
+
+	std::thread saver           = {};
+	std::atomic<bool> is_saving = false;
+} replay = {};
+
+// PixelFormat's underlying value is the colour depth in number of bits
+static size_t to_bytes_per_pixel(const PixelFormat format)
+{
+	return (static_cast<size_t>(format) + 7) / 8;
+}
+
+static ReplayFrame take_unused_frame()
+{
+	if (replay.unused_frames.empty()) {
+		return {};
+	}
+	auto frame = std::move(replay.unused_frames.back());
+	replay.unused_frames.pop_back();
+	return frame;
+}
+
+static void drop_oldest_frame()
+{
+	assert(!replay.frames.empty());
+	auto& frame = replay.frames.front();
+
+	replay.num_bytes -= frame.GetNumBytes();
+	replay.duration_seconds -= 1.0 / frame.frames_per_second;
+
+	if (replay.unused_frames.size() < MaxUnusedFrames) {
+		replay.unused_frames.emplace_back(std::move(frame));
+	}
+	replay.frames.pop_front();
+}
+
+// Drops the oldest groups of frames while the buffer is longer than needed or
+// it uses too much memory. The newest group is always kept.
+static void drop_old_frames()
+{
+	while (!replay.frames.empty()) {
+		size_t group_size     = 1;
+		double group_duration = 1.0 / replay.frames[0].frames_per_second;
+
+		while (group_size < replay.frames.size() &&
+		       !replay.frames[group_size].is_keyframe) {
+			group_duration += 1.0 / replay.frames[group_size].frames_per_second;
+			++group_size;
+		}
+		if (group_size == replay.frames.size()) {
+			return;
+		}
+
+		const auto is_over_memory_limit = replay.num_bytes >
+		                                  replay.memory_limit_bytes;
+		const auto is_too_long = (replay.duration_seconds - group_duration >=
+		                          replay.length_seconds);
+
+		if (!is_over_memory_limit && !is_too_long) {
+			return;
+		}
+		for (size_t i = 0; i < group_size; ++i) {
+			drop_oldest_frame();
+		}
+	}
+}
+
+static void clear_frames()
+{
+	while (!replay.frames.empty()) {
+		drop_oldest_frame();
+	}
+	replay.num_bytes        = 0;
+	replay.duration_seconds = 0.0;
+
+	replay.last_image.clear();
+	replay.last_palette.clear();
+}
+
+// Takes a frame for the next position in the buffer and decides whether it
+// has to be a keyframe
+static ReplayFrame start_frame(const uint16_t width, const uint16_t height,
+                               const PixelFormat pixel_format,
+                               const float frames_per_second,
+                               const bool is_new_format)
+{
+	const auto keyframe_interval = static_cast<int>(frames_per_second *
+	                                                KeyframeIntervalSeconds);
+
+	auto frame = take_unused_frame();
+
+	frame.width             = width;
+	frame.height            = height;
+	frame.pixel_format      = pixel_format;
+	frame.frames_per_second = frames_per_second;
+	frame.is_keyframe       = (is_new_format ||
+	                           replay.frames_since_keyframe >= keyframe_interval);
+
+	if (frame.is_keyframe) {
+		replay.frames_since_keyframe = 0;
+	} else {
+		++replay.frames_since_keyframe;
+	}
+	return frame;
+}
+
+// Attaches the audio output since the previous frame and appends the frame
+// to the buffer
+static void push_frame(ReplayFrame&& frame)
+{
+	frame.sample_rate = replay.sample_rate;
+	std::swap(frame.audio, replay.pending_audio);
+	replay.pending_audio.clear();
+
+	replay.num_bytes += frame.GetNumBytes();
+	replay.duration_seconds += 1.0 / frame.frames_per_second;
+	replay.frames.emplace_back(std::move(frame));
+
+	drop_old_frames();
+}
+
+void capture_replay_init(const int length_seconds, const int memory_limit_mb)
+{
+	assert(length_seconds >= 0);
+	assert(memory_limit_mb >= 0);
+
+	replay.length_seconds     = length_seconds;
+	replay.memory_limit_bytes = static_cast<size_t>(memory_limit_mb) * 1024 * 1024;
+
+	if (capture_replay_is_enabled()) {
+		LOG_MSG("CAPTURE: Keeping the last %d seconds of video and audio output "
+		        "for instant replays (using up to %d MB of memory)",
+		        length_seconds,
+		        memory_limit_mb);
+	}
+}
+
+bool capture_replay_is_enabled()
+{
+	return replay.length_seconds > 0;
+}
+
+void capture_replay_add_frame(const RenderedImage& image,
+                              const float frames_per_second)
+{
+	if (!capture_replay_is_enabled() || frames_per_second <= 0.0f) {
+		return;
+	}
+
+	// Store the raw image without "baked-in" double scanning and pixel
+	// doubling, same as the video capture
+	const auto& src = image.params;
+
+	const auto raw_width = check_cast<uint16_t>(
+	        src.width / (src.rendered_pixel_doubling ? 2 : 1));
+	const auto raw_height = check_cast<uint16_t>(
+	        src.height / (src.rendered_double_scan ? 2 : 1));
+	const auto src_pitch = image.pitch * (src.rendered_double_scan ? 2 : 1);
+
+	const auto bpp       = to_bytes_per_pixel(src.pixel_format);
+	const auto row_bytes = raw_width * bpp;
+
+	const auto is_new_format = replay.frames.empty() ||
+	                           replay.frames.back().width != raw_width ||
+	                           replay.frames.back().height != raw_height ||
+	                           replay.frames.back().pixel_format !=
+	                                   src.pixel_format;
+
+	auto frame = start_frame(raw_width,
+	                         raw_height,
+	                         src.pixel_format,
+	                         frames_per_second,
+	                         is_new_format);
+
+	if (is_new_format) {
+		replay.last_image.resize(row_bytes * raw_height);
+	}
+
+	frame.is_row_changed.resize(raw_height);
+	frame.rows.clear();
+
+	auto src_row  = image.image_data;
+	auto last_row = replay.last_image.data();
+
+	for (size_t y = 0; y < raw_height; ++y) {
+		const uint8_t* row = src_row;
+
+		if (src.rendered_pixel_doubling) {
+			replay.row_buf.resize(row_bytes);
+
+			auto src_pixel  = src_row;
+			auto dest_pixel = replay.row_buf.data();
+			for (auto x = 0; x < raw_width; ++x) {
+				std::memcpy(dest_pixel, src_pixel, bpp);
+				src_pixel += bpp * 2;
+				dest_pixel += bpp;
+			}
+			row = replay.row_buf.data();
+		}
+
+		// In the steady state, this compare and the copy of the changed
+		// rows is all the work done per frame
+		const auto is_changed = frame.is_keyframe ||
+		                        std::memcmp(last_row, row, row_bytes) != 0;
+		if (is_changed) {
+			std::memcpy(last_row, row, row_bytes);
+			frame.rows.insert(frame.rows.end(), row, row + row_bytes);
+		}
+		frame.is_row_changed[y] = is_changed ? 1 : 0;
+
+		src_row += src_pitch;
+		last_row += row_bytes;
+	}
+
+	frame.palette.clear();
+	if (image.is_paletted() && image.palette_data) {
+		const auto palette_end = image.palette_data + PaletteNumBytes;
+
+		const auto is_palette_changed =
+		        replay.last_palette.empty() ||
+		        !std::equal(image.palette_data,
+		                    palette_end,
+		                    replay.last_palette.begin());
+
+		if (frame.is_keyframe || is_palette_changed) {
+			replay.last_palette.assign(image.palette_data, palette_end);
+			frame.palette = replay.last_palette;
+		}
+	}
+
+	push_frame(std::move(frame));
+}
+
+void capture_replay_add_duplicate_frame(const float frames_per_second)
+{
+	if (!capture_replay_is_enabled() || frames_per_second <= 0.0f ||
+	    replay.frames.empty()) {
+		return;
+	}
+	const auto& last_frame = replay.frames.back();
+
+	auto frame = start_frame(last_frame.width,
+	                         last_frame.height,
+	                         last_frame.pixel_format,
+	                         frames_per_second,
+	                         false);
+
+	// Nothing changed, so only keyframes need the rows and the palette
+	// from the previous frame
+	frame.is_row_changed.assign(frame.height, frame.is_keyframe ? 1 : 0);
+	frame.rows.clear();
+	frame.palette.clear();
+
+	if (frame.is_keyframe) {
+		frame.rows    = replay.last_image;
+		frame.palette = replay.last_palette;
+	}
+
+	push_frame(std::move(frame));
+}
+
+void capture_replay_add_audio_data(const uint32_t sample_rate,
+                                   const uint32_t num_sample_frames,
+                                   const int16_t* sample_frames)
+{
+	if (!capture_replay_is_enabled()) {
+		return;
+	}
+	replay.sample_rate = sample_rate;
+
+	// The video capture can't take more audio per frame either; this also
+	// bounds the buffer if no frames are rendered for a while
+	constexpr size_t MaxPendingSamples = NumSampleFramesInBuffer *
+	                                     NumAudioChannels;
+
+	const auto num_samples = std::min(static_cast<size_t>(num_sample_frames) *
+	                                          NumAudioChannels,
+	                                  MaxPendingSamples -
+	                                          replay.pending_audio.size());
+
+	replay.pending_audio.insert(replay.pending_audio.end(),
+	                            sample_frames,
+	                            sample_frames + num_samples);
+}
+
+// Rebuilds the stored frames one by one and passes them to the ZMBV encoder
+static void save_replay(std::deque<ReplayFrame> frames)
+{
+	auto video = std::make_unique<VideoCaptureFile>();
+
+	std::vector<uint8_t> image_data = {};
+	std::vector<uint8_t> palette(PaletteNumBytes, 0);
+
+	for (const auto& frame : frames) {
+		const auto row_bytes = frame.width *
+		                       to_bytes_per_pixel(frame.pixel_format);
+
+		if (frame.is_keyframe) {
+			image_data.resize(row_bytes * frame.height);
+		}
+		assert(image_data.size() == row_bytes * frame.height);
+
+		auto src_row  = frame.rows.data();
+		auto dest_row = image_data.data();
+
+		for (const auto is_changed : frame.is_row_changed) {
+			if (is_changed) {
+				std::memcpy(dest_row, src_row, row_bytes);
+				src_row += row_bytes;
+			}
+			dest_row += row_bytes;
+		}
+		if (!frame.palette.empty()) {
+			palette = frame.palette;
+		}
+
+		if (!frame.audio.empty()) {
+			capture_video_add_audio_data(
+			        *video,
+			        frame.sample_rate,
+			        check_cast<uint32_t>(frame.audio.size() / NumAudioChannels),
+			        frame.audio.data());
+		}
+
+		RenderedImage image = {};
+
+		image.params.width        = frame.width;
+		image.params.height       = frame.height;
+		image.params.pixel_format = frame.pixel_format;
+		image.pitch               = check_cast<uint16_t>(row_bytes);
+		image.image_data          = image_data.data();
+		image.palette_data        = palette.data();
+
+		capture_video_add_frame(*video, image, frame.frames_per_second);
+	}
+	capture_video_finalise(*video);
+
+	LOG_MSG("CAPTURE: Finished saving the instant replay");
+	replay.is_saving = false;
+}
+
+void capture_replay_save()
+{
+	if (replay.is_saving) {
+		LOG_WARNING("CAPTURE: Still saving the previous instant replay");
+		return;
+	}
+	if (replay.frames.empty()) {
+		LOG_WARNING("CAPTURE: The instant replay buffer is empty");
+		return;
+	}
+	if (replay.saver.joinable()) {
+		replay.saver.join();
+	}
+
+	LOG_MSG("CAPTURE: Saving the last %.1f seconds as an instant replay",
+	        replay.duration_seconds);
+
+	// Hand the frames over to the encoder thread as they are; the buffer
+	// starts filling again with a keyframe
+	auto frames = std::move(replay.frames);
+	replay.frames.clear();
+	clear_frames();
+
+	replay.is_saving = true;
+	replay.saver     = std::thread(save_replay, std::move(frames));
+}
+
+void capture_replay_destroy()
+{
+	if (replay.saver.joinable()) {
+		replay.saver.join();
+	}
+	clear_frames();
+
+	replay.unused_frames.clear();
+	replay.unused_frames.shrink_to_fit();
+	replay.last_image.shrink_to_fit();
+	replay.pending_audio.clear();
+
+	replay.length_seconds = 0;
+}
@@ -0,0 +1,50 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_CAPTURE_REPLAY_H
+#define DOSBOX_CAPTURE_REPLAY_H
+
+#include "render.h"
+
+// The instant replay keeps the last 'length_seconds' of the video and audio
+// output in memory (using at most 'memory_limit_mb' megabytes), and writes it
+// to an AVI file on request. Passing 0 seconds disables the replay.
+void capture_replay_init(const int length_seconds, const int memory_limit_mb);
+bool capture_replay_is_enabled();
+
+void capture_replay_add_frame(const RenderedImage& image,
+                              const float frames_per_second);
+
+// Records that the previous frame is shown again; used for frames the renderer
+// skipped or found unchanged, so they cost no image comparison
+void capture_replay_add_duplicate_frame(const float frames_per_second);
+
+void capture_replay_add_audio_data(const uint32_t sample_rate,
+                                   const uint32_t num_sample_frames,
+                                   const int16_t* sample_frames);
+
+// Encodes the contents of the replay buffer in a background thread, then
+// starts filling the buffer again from scratch
+void capture_replay_save();
+
+// Waits for a pending save to finish, then releases the replay buffer
+void capture_replay_destroy();
+
+#endif
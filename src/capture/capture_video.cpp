@@ -24,6 +24,7 @@
 #include <cassert>
 #include <cmath>
 
+#include "capture_video.h"
 #include "math_utils.h"
 #include "mem.h"
 #include "render.h"
@@ -31,37 +32,11 @@
 
 #include "zmbv/zmbv.h"
 
-static constexpr auto NumSampleFramesInBuffer = 16 * 1024;
-
-static constexpr auto SampleFrameSize  = 4;
-static constexpr auto NumAudioChannels = 2;
+static constexpr auto SampleFrameSize = 4;
 
 static constexpr auto AviHeaderSize = 500;
 
-static struct {
-	FILE* handle = nullptr;
-
-	uint32_t frames          = 0;
-	VideoCodec* codec        = nullptr;
-	int width                = 0;
-	int height               = 0;
-	PixelFormat pixel_format = {};
-	float frames_per_second  = 0.0f;
-
-	uint32_t written           = 0;
-	uint32_t buf_size          = 0;
-	std::vector<uint8_t> buf   = {};
-	std::vector<uint8_t> index = {};
-	uint32_t index_used        = 0;
-
-	struct {
-		int16_t buf[NumSampleFramesInBuffer][NumAudioChannels] = {};
-
-		uint32_t sample_rate     = 0;
-		uint32_t buf_frames_used = 0;
-		uint32_t bytes_written   = 0;
-	} audio = {};
-} video = {};
+static VideoCaptureFile video_capture = {};
 
 static ZMBV_FORMAT to_zmbv_format(const PixelFormat format)
 {
@@ -98,8 +73,9 @@ static uint8_t to_bytes_per_pixel(const ZMBV_FORMAT format)
 	return ZMBV_ToBytesPerPixel(format);
 }
 
-static void add_avi_chunk(const char* tag, const uint32_t size,
-                          const void* data, const uint32_t flags)
+static void add_avi_chunk(VideoCaptureFile& video, const char* tag,
+                          const uint32_t size, const void* data,
+                          const uint32_t flags)
 {
 	uint8_t chunk[8] = {};
 
@@ -136,7 +112,7 @@ static void add_avi_chunk(const char* tag, const uint32_t size,
 	host_writed(index + 12, size);
 }
 
-void capture_video_finalise()
+void capture_video_finalise(VideoCaptureFile& video)
 {
 	if (!video.handle) {
 		return;
@@ -301,7 +277,8 @@ void capture_video_finalise()
 	video.handle = nullptr;
 }
 
-void capture_video_add_audio_data(const uint32_t sample_rate,
+void capture_video_add_audio_data(VideoCaptureFile& video,
+                                  const uint32_t sample_rate,
                                   const uint32_t num_sample_frames,
                                   const int16_t* sample_frames)
 {
@@ -321,8 +298,8 @@ void capture_video_add_audio_data(const uint32_t sample_rate,
 	video.audio.sample_rate = sample_rate;
 }
 
-static void create_avi_file(const uint16_t width, const uint16_t height,
-                            const PixelFormat pixel_format,
+static void create_avi_file(VideoCaptureFile& video, const uint16_t width,
+                            const uint16_t height, const PixelFormat pixel_format,
                             const float frames_per_second, ZMBV_FORMAT format)
 {
 	video.handle = CAPTURE_CreateFile(CaptureType::Video);
@@ -379,7 +356,8 @@ static void create_avi_file(const uint16_t width, const uint16_t height,
 // artifacts (so 320x200 is rendered as 640x200, and 640x200 as 1280x200).
 // These are written as-is, otherwise we'd be losing information.
 //
-static void compress_raw_frame(const RenderedImage& image)
+static void compress_raw_frame(VideoCaptureFile& video,
+                               const RenderedImage& image)
 {
 	const auto& src = image.params;
 	auto src_row    = image.image_data;
@@ -420,7 +398,7 @@ static void compress_raw_frame(const RenderedImage& image)
 
 	// Grow the target row buffer if needed
 	const auto dest_row_bytes = check_cast<uint16_t>(src.width * dest_bpp);
-	static std::vector<uint8_t> dest_row = {};
+	auto& dest_row = video.row_buf;
 	if (dest_row.size() < dest_row_bytes) {
 		dest_row.resize(dest_row_bytes, 0);
 	}
@@ -439,7 +417,8 @@ static void compress_raw_frame(const RenderedImage& image)
 	}
 }
 
-void capture_video_add_frame(const RenderedImage& image, const float frames_per_second)
+void capture_video_add_frame(VideoCaptureFile& video, const RenderedImage& image,
+                             const float frames_per_second)
 {
 	const auto& src = image.params;
 	assert(src.width <= SCALER_MAXWIDTH);
@@ -458,13 +437,14 @@ void capture_video_add_frame(const RenderedImage& image, const float frames_per_
 	if (video.handle && (video.width != raw_width || video.height != raw_height ||
 	                     video.pixel_format != src.pixel_format ||
 	                     video.frames_per_second != frames_per_second)) {
-		capture_video_finalise();
+		capture_video_finalise(video);
 	}
 
 	const auto zmbv_format = to_zmbv_format(src.pixel_format);
 
 	if (!video.handle) {
-		create_avi_file(raw_width,
+		create_avi_file(video,
+		                raw_width,
 		                raw_height,
 		                src.pixel_format,
 		                frames_per_second,
@@ -484,26 +464,51 @@ void capture_video_add_frame(const RenderedImage& image, const float frames_per_
 		return;
 	}
 
-	compress_raw_frame(image);
+	compress_raw_frame(video, image);
 
 	const auto written = video.codec->FinishCompressFrame();
 	if (written < 0) {
 		return;
 	}
 
-	add_avi_chunk("00dc", written, video.buf.data(), codec_flags & 1 ? 0x10 : 0x0);
+	add_avi_chunk(video,
+	              "00dc",
+	              written,
+	              video.buf.data(),
+	              codec_flags & 1 ? 0x10 : 0x0);
 	video.frames++;
 
 	//		LOG_MSG("CAPTURE: Frame %d video %d audio
 	//%d",video.frames, written, video.audio_buf_frames_used *4 );
 	if (video.audio.buf_frames_used) {
-		add_avi_chunk("01wb",
+		add_avi_chunk(video,
+		              "01wb",
 		              video.audio.buf_frames_used * SampleFrameSize,
 		              video.audio.buf,
 		              0);
 
-		video.audio.bytes_written = video.audio.buf_frames_used *
-		                            SampleFrameSize;
+		video.audio.bytes_written += video.audio.buf_frames_used *
+		                             SampleFrameSize;
 		video.audio.buf_frames_used = 0;
 	}
 }
+
+void capture_video_add_frame(const RenderedImage& image, const float frames_per_second)
+{
+	capture_video_add_frame(video_capture, image, frames_per_second);
+}
+
+void capture_video_add_audio_data(const uint32_t sample_rate,
+                                  const uint32_t num_sample_frames,
+                                  const int16_t* sample_frames)
+{
+	capture_video_add_audio_data(video_capture,
+	                             sample_rate,
+	                             num_sample_frames,
+	                             sample_frames);
+}
+
+void capture_video_finalise()
+{
+	capture_video_finalise(video_capture);
+}
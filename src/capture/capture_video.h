@@ -24,6 +24,46 @@
 
 #include "render.h"
 
+#include <cstdio>
+#include <vector>
+
+class VideoCodec;
+
+static constexpr auto NumSampleFramesInBuffer = 16 * 1024;
+static constexpr auto NumAudioChannels        = 2;
+
+// A ZMBV-encoded AVI file being written, with an interleaved 16-bit stereo
+// audio stream
+struct VideoCaptureFile {
+	FILE* handle = nullptr;
+
+	uint32_t frames          = 0;
+	VideoCodec* codec        = nullptr;
+	int width                = 0;
+	int height               = 0;
+	PixelFormat pixel_format = {};
+	float frames_per_second  = 0.0f;
+
+	uint32_t written           = 0;
+	uint32_t buf_size          = 0;
+	std::vector<uint8_t> buf   = {};
+	std::vector<uint8_t> index = {};
+	uint32_t index_used        = 0;
+
+	// Rearranged source row, if the pixels can't be passed to the codec
+	// as-is
+	std::vector<uint8_t> row_buf = {};
+
+	struct {
+		int16_t buf[NumSampleFramesInBuffer][NumAudioChannels] = {};
+
+		uint32_t sample_rate     = 0;
+		uint32_t buf_frames_used = 0;
+		uint32_t bytes_written   = 0;
+	} audio = {};
+};
+
+// The regular video capture
 void capture_video_add_frame(const RenderedImage& image,
                              const float frames_per_second);
 
@@ -33,4 +73,17 @@ void capture_video_add_audio_data(const uint32_t sample_rate,
 
 void capture_video_finalise();
 
+// Writes to a separate AVI file (e.g., for saving the instant replay from a
+// background thread without disturbing the regular video capture). A new
+// file is started when the frame dimensions or the frame rate change.
+void capture_video_add_frame(VideoCaptureFile& video, const RenderedImage& image,
+                             const float frames_per_second);
+
+void capture_video_add_audio_data(VideoCaptureFile& video,
+                                  const uint32_t sample_rate,
+                                  const uint32_t num_sample_frames,
+                                  const int16_t* sample_frames);
+
+void capture_video_finalise(VideoCaptureFile& video);
+
 #endif
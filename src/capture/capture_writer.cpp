@@ -0,0 +1,152 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "capture_writer.h"
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "checks.h"
+#include "logging.h"
+#include "perf_counters.h"
+#include "rwqueue.h"
+#include "support.h"
+
+CHECK_NARROWING();
+
+// Up to 4 MB of captured data in flight, which is over 20 seconds of
+// 16-bit stereo audio at 48 kHz
+static constexpr auto MaxQueuedTasks = 64;
+
+static PerfCounter blocks_written("capture.blocks_written");
+static PerfCounter blocks_dropped("capture.blocks_dropped");
+
+static struct {
+	std::thread thread                               = {};
+	std::unique_ptr<RWQueue<CaptureWriteTask>> queue = {};
+
+	std::mutex pool_mutex          = {};
+	std::vector<CaptureBlock> pool = {};
+
+	std::atomic<int> num_dropped = 0;
+} writer = {};
+
+static void return_block_to_pool(CaptureBlock&& block)
+{
+	block.clear();
+
+	std::lock_guard<std::mutex> lock(writer.pool_mutex);
+	if (writer.pool.size() < MaxQueuedTasks) {
+		writer.pool.emplace_back(std::move(block));
+	}
+}
+
+static void write_queued_tasks()
+{
+	while (auto task = writer.queue->Dequeue()) {
+		task->write(task->block);
+
+		if (!task->block.empty()) {
+			blocks_written.Add();
+		}
+		return_block_to_pool(std::move(task->block));
+	}
+}
+
+void capture_writer_start()
+{
+	if (writer.thread.joinable()) {
+		return;
+	}
+	writer.num_dropped = 0;
+
+	writer.queue  = std::make_unique<RWQueue<CaptureWriteTask>>(MaxQueuedTasks);
+	writer.thread = std::thread(write_queued_tasks);
+	set_thread_name(writer.thread, "dosbox:capwrite");
+}
+
+void capture_writer_stop()
+{
+	if (!writer.thread.joinable()) {
+		return;
+	}
+	// The writer thread finishes the remaining tasks before exiting
+	writer.queue->Stop();
+	writer.thread.join();
+	writer.queue = {};
+
+	if (writer.num_dropped > 0) {
+		LOG_WARNING("CAPTURE: Dropped %d blocks of captured data because "
+		            "writing to disk couldn't keep up",
+		            writer.num_dropped.load());
+	}
+
+	std::lock_guard<std::mutex> lock(writer.pool_mutex);
+	writer.pool.clear();
+}
+
+CaptureBlock capture_writer_get_block()
+{
+	std::lock_guard<std::mutex> lock(writer.pool_mutex);
+
+	if (writer.pool.empty()) {
+		CaptureBlock block = {};
+		block.reserve(CaptureBlockSize);
+		return block;
+	}
+	auto block = std::move(writer.pool.back());
+	writer.pool.pop_back();
+	return block;
+}
+
+bool capture_writer_queue_block(CaptureBlock&& block,
+                                const CaptureWriteFunction& write)
+{
+	// Write synchronously if the capture module isn't running
+	if (!writer.queue) {
+		write(block);
+		return true;
+	}
+
+	CaptureWriteTask task = {std::move(block), write};
+	if (writer.queue->NonblockingEnqueue(std::move(task))) {
+		return true;
+	}
+
+	blocks_dropped.Add();
+	if (writer.num_dropped++ == 0) {
+		LOG_WARNING("CAPTURE: Writing to disk can't keep up; dropping "
+		            "captured data");
+	}
+	return_block_to_pool(std::move(task.block));
+	return false;
+}
+
+void capture_writer_queue_task(const std::function<void()>& task)
+{
+	if (!writer.queue) {
+		task();
+		return;
+	}
+	writer.queue->Enqueue({{}, [task](const CaptureBlock&) { task(); }});
+}
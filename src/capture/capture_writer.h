@@ -0,0 +1,64 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_CAPTURE_WRITER_H
+#define DOSBOX_CAPTURE_WRITER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Captured audio and MIDI data is written to disk by a dedicated thread, so
+// slow storage can't stall the emulation or the audio output.
+//
+// The data is passed in blocks taken from a pool. If the disk can't keep up
+// and the write queue fills up, new data blocks are dropped instead of
+// blocking the caller, and the dropped blocks are counted. Tasks that finish
+// a capture file are never dropped.
+
+static constexpr size_t CaptureBlockSize = 64 * 1024;
+
+using CaptureBlock         = std::vector<uint8_t>;
+using CaptureWriteFunction = std::function<void(const CaptureBlock& block)>;
+
+struct CaptureWriteTask {
+	CaptureBlock block = {};
+
+	// Called on the writer thread; the block is returned to the pool
+	// afterwards
+	CaptureWriteFunction write = {};
+};
+
+void capture_writer_start();
+
+// Waits until all queued tasks are done, then stops the writer thread
+void capture_writer_stop();
+
+// Returns an empty block with room for at least 'CaptureBlockSize' bytes
+CaptureBlock capture_writer_get_block();
+
+// Returns false if the block had to be dropped
+bool capture_writer_queue_block(CaptureBlock&& block,
+                                const CaptureWriteFunction& write);
+
+// Finalising tasks wait for room in the queue instead of being dropped
+void capture_writer_queue_task(const std::function<void()>& task);
+
+#endif
@@ -0,0 +1,365 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "flac_encoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#include "checks.h"
+#include "support.h"
+
+CHECK_NARROWING();
+
+// The stream header is "fLaC", followed by a single STREAMINFO metadata block
+static constexpr auto StreamInfoSize = 34;
+
+static constexpr auto BitsPerSample = 16;
+
+// Orders of the fixed linear predictors defined by the FLAC format
+static constexpr auto MaxFixedOrder = 4;
+
+static constexpr auto MaxRiceParameter = 14;
+
+static uint8_t calc_crc8(const std::vector<uint8_t>& data)
+{
+	// x^8 + x^2 + x^1 + x^0
+	constexpr uint8_t Polynomial = 0x07;
+
+	uint8_t crc = 0;
+	for (const auto byte : data) {
+		crc ^= byte;
+		for (auto i = 0; i < 8; ++i) {
+			crc = static_cast<uint8_t>((crc & 0x80) ? (crc << 1) ^ Polynomial
+			                                        : (crc << 1));
+		}
+	}
+	return crc;
+}
+
+static uint16_t calc_crc16(const std::vector<uint8_t>& data)
+{
+	// x^16 + x^15 + x^2 + x^0
+	constexpr uint16_t Polynomial = 0x8005;
+
+	uint16_t crc = 0;
+	for (const auto byte : data) {
+		crc ^= static_cast<uint16_t>(byte << 8);
+		for (auto i = 0; i < 8; ++i) {
+			crc = static_cast<uint16_t>((crc & 0x8000)
+			                                    ? (crc << 1) ^ Polynomial
+			                                    : (crc << 1));
+		}
+	}
+	return crc;
+}
+
+static int32_t calc_fixed_residual(const std::vector<int32_t>& s,
+                                   const size_t i, const int order)
+{
+	switch (order) {
+	case 0: return s[i];
+	case 1: return s[i] - s[i - 1];
+	case 2: return s[i] - 2 * s[i - 1] + s[i - 2];
+	case 3: return s[i] - 3 * s[i - 1] + 3 * s[i - 2] - s[i - 3];
+	case 4:
+		return s[i] - 4 * s[i - 1] + 6 * s[i - 2] - 4 * s[i - 3] + s[i - 4];
+	default: assertm(false, "Invalid fixed predictor order"); return 0;
+	}
+}
+
+// Maps signed residuals to unsigned values: 0, -1, 1, -2, 2, etc.
+static uint32_t fold_residual(const int32_t residual)
+{
+	return (static_cast<uint32_t>(residual) << 1) ^
+	       static_cast<uint32_t>(residual >> 31);
+}
+
+FlacEncoder::FlacEncoder(FILE* _fp, const uint32_t _sample_rate)
+        : fp(_fp),
+          sample_rate(_sample_rate)
+{
+	assert(fp);
+
+	for (auto& channel : block) {
+		channel.reserve(BlockSize);
+	}
+	WriteStreamInfo();
+}
+
+FlacEncoder::~FlacEncoder()
+{
+	Finish();
+}
+
+void FlacEncoder::WriteStreamInfo()
+{
+	out.clear();
+
+	for (const auto c : {'f', 'L', 'a', 'C'}) {
+		WriteBits(static_cast<uint8_t>(c), 8);
+	}
+
+	// Metadata block header: last block, type 0 (STREAMINFO)
+	WriteBits(1, 1);
+	WriteBits(0, 7);
+	WriteBits(StreamInfoSize, 24);
+
+	// Minimum and maximum block sizes
+	WriteBits(BlockSize, 16);
+	WriteBits(BlockSize, 16);
+
+	// Minimum and maximum frame sizes; 0 means unknown
+	WriteBits(0, 24);
+	WriteBits(0, 24);
+
+	WriteBits(sample_rate, 20);
+	WriteBits(NumChannels - 1, 3);
+	WriteBits(BitsPerSample - 1, 5);
+
+	// Total number of sample frames as a 36-bit value
+	WriteBits(static_cast<uint32_t>(total_frames >> 32), 4);
+	WriteBits(static_cast<uint32_t>(total_frames), 32);
+
+	// MD5 signature of the decoded audio; all zeros means unknown
+	for (auto i = 0; i < 4; ++i) {
+		WriteBits(0, 32);
+	}
+
+	fwrite(out.data(), 1, out.size(), fp);
+}
+
+void FlacEncoder::AddFrames(const int16_t* sample_frames, const size_t num_frames)
+{
+	assert(fp);
+
+	for (size_t i = 0; i < num_frames; ++i) {
+		for (auto& channel : block) {
+			channel.push_back(*sample_frames++);
+		}
+		if (block[0].size() == BlockSize) {
+			EncodeBlock();
+		}
+	}
+}
+
+void FlacEncoder::Finish()
+{
+	if (!fp) {
+		return;
+	}
+	if (!block[0].empty()) {
+		EncodeBlock();
+	}
+
+	// Update the stream header with the final number of sample frames; this
+	// is optional if the file can't be rewound
+	if (fseek(fp, 0, SEEK_SET) == 0) {
+		WriteStreamInfo();
+	}
+	fclose(fp);
+	fp = nullptr;
+}
+
+void FlacEncoder::EncodeBlock()
+{
+	const auto num_frames = block[0].size();
+	assert(num_frames > 0 && num_frames <= BlockSize);
+
+	out.clear();
+
+	// Frame header: sync code, reserved bit, fixed block size strategy
+	WriteBits(0b11111111111110, 14);
+	WriteBits(0, 1);
+	WriteBits(0, 1);
+
+	// Block size stored as a 16-bit value at the end of the header
+	WriteBits(0b0111, 4);
+
+	// Sample rate as in STREAMINFO
+	WriteBits(0b0000, 4);
+
+	// Independent left and right channels
+	WriteBits(0b0001, 4);
+
+	// 16 bits per sample, reserved bit
+	WriteBits(0b100, 3);
+	WriteBits(0, 1);
+
+	// Frame number in the UTF-8-like variable length coding
+	if (frame_number < 0x80) {
+		WriteBits(frame_number, 8);
+	} else {
+		auto num_bytes = 2;
+		for (const auto limit : {0x800u, 0x10000u, 0x200000u, 0x4000000u}) {
+			if (frame_number < limit) {
+				break;
+			}
+			++num_bytes;
+		}
+		auto shift = 6 * (num_bytes - 1);
+
+		const auto lead_bits = (0xff00u >> num_bytes) & 0xffu;
+		WriteBits(lead_bits | (frame_number >> shift), 8);
+
+		while (shift > 0) {
+			shift -= 6;
+			WriteBits(0x80 | ((frame_number >> shift) & 0x3f), 8);
+		}
+	}
+
+	WriteBits(static_cast<uint32_t>(num_frames - 1), 16);
+	WriteBits(calc_crc8(out), 8);
+
+	for (const auto& channel : block) {
+		EncodeSubframe(channel);
+	}
+
+	AlignToByte();
+	WriteBits(calc_crc16(out), 16);
+
+	fwrite(out.data(), 1, out.size(), fp);
+
+	total_frames += num_frames;
+	++frame_number;
+
+	for (auto& channel : block) {
+		channel.clear();
+	}
+}
+
+void FlacEncoder::EncodeSubframe(const std::vector<int32_t>& samples)
+{
+	const auto num_samples = samples.size();
+
+	// Silence and other constant signals
+	const auto is_constant = std::all_of(samples.begin(),
+	                                     samples.end(),
+	                                     [&](const int32_t s) {
+		                                     return s == samples[0];
+	                                     });
+	if (is_constant) {
+		WriteBits(0, 1);
+		WriteBits(0b000000, 6);
+		WriteBits(0, 1);
+		WriteBits(static_cast<uint32_t>(samples[0]) & 0xffff, BitsPerSample);
+		return;
+	}
+
+	// Pick the predictor with the smallest residuals
+	auto best_order = 0;
+	auto best_sum   = std::numeric_limits<uint64_t>::max();
+
+	for (auto order = 0; order <= MaxFixedOrder; ++order) {
+		if (num_samples <= static_cast<size_t>(order)) {
+			break;
+		}
+		uint64_t sum = 0;
+		for (auto i = static_cast<size_t>(order); i < num_samples; ++i) {
+			sum += fold_residual(calc_fixed_residual(samples, i, order));
+		}
+		if (sum < best_sum) {
+			best_sum   = sum;
+			best_order = order;
+		}
+	}
+
+	// Fixed predictor subframe without wasted bits
+	WriteBits(0, 1);
+	WriteBits(0b001000 | static_cast<uint32_t>(best_order), 6);
+	WriteBits(0, 1);
+
+	// Warm-up samples
+	for (auto i = 0; i < best_order; ++i) {
+		WriteBits(static_cast<uint32_t>(samples[static_cast<size_t>(i)]) & 0xffff,
+		          BitsPerSample);
+	}
+	WriteResidual(samples, best_order);
+}
+
+void FlacEncoder::WriteResidual(const std::vector<int32_t>& samples, const int order)
+{
+	const auto first = static_cast<size_t>(order);
+	const auto count = samples.size() - first;
+	assert(count > 0);
+
+	uint64_t sum = 0;
+	for (auto i = first; i < samples.size(); ++i) {
+		sum += fold_residual(calc_fixed_residual(samples, i, order));
+	}
+
+	// Estimate the Rice parameter from the mean of the folded residuals
+	uint32_t rice_param = 0;
+	while (rice_param < MaxRiceParameter && (count << (rice_param + 1)) < sum) {
+		++rice_param;
+	}
+
+	// Rice coding with 4-bit parameters and a single partition
+	WriteBits(0b00, 2);
+	WriteBits(0, 4);
+	WriteBits(rice_param, 4);
+
+	const auto low_bits_mask = (1u << rice_param) - 1;
+
+	for (auto i = first; i < samples.size(); ++i) {
+		const auto value = fold_residual(calc_fixed_residual(samples, i, order));
+
+		WriteUnary(value >> rice_param);
+		if (rice_param > 0) {
+			WriteBits(value & low_bits_mask, static_cast<int>(rice_param));
+		}
+	}
+}
+
+void FlacEncoder::WriteBits(const uint32_t value, const int num_bits)
+{
+	assert(num_bits > 0 && num_bits <= 32);
+
+	const auto mask = (uint64_t(1) << num_bits) - 1;
+
+	bit_buf = (bit_buf << num_bits) | (value & mask);
+	num_buffered_bits += num_bits;
+
+	while (num_buffered_bits >= 8) {
+		num_buffered_bits -= 8;
+		out.push_back(static_cast<uint8_t>(bit_buf >> num_buffered_bits));
+	}
+}
+
+void FlacEncoder::WriteUnary(const uint32_t value)
+{
+	auto num_zeros = value;
+	while (num_zeros >= 32) {
+		WriteBits(0, 32);
+		num_zeros -= 32;
+	}
+	if (num_zeros > 0) {
+		WriteBits(0, static_cast<int>(num_zeros));
+	}
+	WriteBits(1, 1);
+}
+
+void FlacEncoder::AlignToByte()
+{
+	if (num_buffered_bits > 0) {
+		WriteBits(0, 8 - num_buffered_bits);
+	}
+}
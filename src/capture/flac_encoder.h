@@ -0,0 +1,78 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_FLAC_ENCODER_H
+#define DOSBOX_FLAC_ENCODER_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// A minimal FLAC encoder for 16-bit stereo audio captures. Every channel of
+// a block is encoded with the best-fitting fixed linear predictor and
+// Rice-coded residuals, which typically halves the size of the captured
+// audio compared to WAV at a fraction of the cost of a full-blown encoder.
+class FlacEncoder {
+public:
+	// Writes the stream header; the file is owned by the encoder from now on
+	FlacEncoder(FILE* fp, const uint32_t sample_rate);
+	~FlacEncoder();
+
+	// Takes interleaved stereo sample frames
+	void AddFrames(const int16_t* sample_frames, const size_t num_frames);
+
+	// Encodes the remaining frames, updates the stream header, then closes
+	// the file
+	void Finish();
+
+	// prevent copying
+	FlacEncoder(const FlacEncoder&) = delete;
+	// prevent assignment
+	FlacEncoder& operator=(const FlacEncoder&) = delete;
+
+	static constexpr auto BlockSize   = 4096;
+	static constexpr auto NumChannels = 2;
+
+private:
+	void WriteStreamInfo();
+	void EncodeBlock();
+	void EncodeSubframe(const std::vector<int32_t>& samples);
+	void WriteResidual(const std::vector<int32_t>& samples, const int order);
+
+	void WriteBits(const uint32_t value, const int num_bits);
+	void WriteUnary(const uint32_t value);
+	void AlignToByte();
+
+	FILE* fp             = nullptr;
+	uint32_t sample_rate = 0;
+
+	uint64_t total_frames = 0;
+	uint32_t frame_number = 0;
+
+	std::array<std::vector<int32_t>, NumChannels> block = {};
+
+	// The frame being encoded
+	std::vector<uint8_t> out = {};
+	uint64_t bit_buf         = 0;
+	int num_buffered_bits    = 0;
+};
+
+#endif
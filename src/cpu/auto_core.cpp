@@ -0,0 +1,414 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "auto_core.h"
+
+#include <cassert>
+#include <fstream>
+#include <istream>
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "cpu.h"
+#include "cross.h"
+#include "logging.h"
+#include "string_utils.h"
+#include "timer.h"
+
+extern bool ticksLocked;
+
+AutoCoreSamples autocore_samples = {};
+
+// Length of a sampling slice, in emulated milliseconds
+constexpr int SliceMs = 1000;
+
+// The normal core is considered CPU-bound when the host idled for less than
+// this share of the slice, for this many slices in a row
+constexpr double MaxIdleShareWhenBusy = 0.1;
+constexpr int BusySlicesToSwitch      = 2;
+
+// The dynamic core is considered to thrash when, within a slice, at least
+// this many blocks were invalidated and at least half of the translations
+// only replaced invalidated blocks, or when the code pages are written to so
+// often that the invalidation checks on every write dominate
+constexpr int64_t MinThrashingInvalidations = 2000;
+constexpr int64_t MaxCodePageWrites         = 4'000'000;
+
+// The dynamic core has to thrash for this many slices in a row before the
+// normal core takes over, so a short loader or unpacker stage doesn't count
+constexpr int ThrashingSlicesToSwitch = 3;
+
+// The normal core is then kept for this many slices before the dynamic core
+// may be tried again; the interval doubles up to the maximum every time
+constexpr int InitialPinSlices = 30;
+constexpr int MaxPinSlices     = 480;
+
+constexpr auto ProfilesFilename = "core_profiles.conf";
+
+static struct {
+	bool is_enabled          = false;
+	bool use_profiles        = false;
+	bool are_profiles_loaded = false;
+
+	std::map<std::string, CoreProfile> profiles = {};
+
+	// Profile keys of the programs loaded into each PSP segment
+	std::map<uint16_t, std::string> programs = {};
+
+	// Empty while the running program isn't known, e.g. for the shell or
+	// after booting a guest OS; no decisions are recorded then
+	std::string program = {};
+
+	AutoCoreSliceState state = {};
+
+	int slice_ms           = 0;
+	int64_t slice_start_us = 0;
+} auto_core = {};
+
+static const char* to_string(const CoreProfile profile)
+{
+	return (profile == CoreProfile::Dynamic) ? "dynamic" : "normal";
+}
+
+static std_fs::path get_profiles_path()
+{
+	return GetConfigDir() / ProfilesFilename;
+}
+
+// A program is identified by its full DOS path and its size, so programs
+// with the same name in different directories, and different versions of
+// the same program, get separate profiles
+std::string make_core_profile_key(const std::string& dos_path,
+                                  const uint32_t file_size)
+{
+	auto key = dos_path;
+	trim(key);
+	upcase(key);
+	return key + " " + std::to_string(file_size);
+}
+
+// Parses 'KEY = normal|dynamic' lines; the key is everything before the last
+// '=' sign
+std::map<std::string, CoreProfile> parse_core_profiles(std::istream& in)
+{
+	std::map<std::string, CoreProfile> profiles = {};
+
+	std::string line = {};
+	while (std::getline(in, line)) {
+		trim(line);
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		const auto separator = line.rfind('=');
+		if (separator == std::string::npos) {
+			continue;
+		}
+		auto key  = line.substr(0, separator);
+		auto core = line.substr(separator + 1);
+		trim(key);
+		trim(core);
+		upcase(key);
+		lowcase(core);
+
+		if (key.empty()) {
+			continue;
+		}
+		if (core == "dynamic") {
+			profiles[key] = CoreProfile::Dynamic;
+		} else if (core == "normal") {
+			profiles[key] = CoreProfile::Normal;
+		} else {
+			LOG_WARNING("AUTOCORE: Invalid core '%s' for '%s' in '%s'",
+			            core.c_str(),
+			            key.c_str(),
+			            ProfilesFilename);
+		}
+	}
+	return profiles;
+}
+
+static void load_profiles()
+{
+	auto_core.are_profiles_loaded = true;
+
+	std::ifstream in(get_profiles_path());
+	if (!in) {
+		return;
+	}
+	auto_core.profiles = parse_core_profiles(in);
+}
+
+static void save_profiles()
+{
+	const auto path = get_profiles_path();
+	std::ofstream out(path);
+	if (!out) {
+		LOG_WARNING("AUTOCORE: Could not write '%s'", path.string().c_str());
+		return;
+	}
+	out << "# Cores chosen by 'core = auto', one 'PATH SIZE = normal|dynamic' per line\n";
+	for (const auto& [name, profile] : auto_core.profiles) {
+		out << name << " = " << to_string(profile) << '\n';
+	}
+}
+
+static void record_decision(const CoreProfile profile)
+{
+	if (auto_core.program.empty()) {
+		return;
+	}
+	auto_core.profiles[auto_core.program] = profile;
+	if (auto_core.use_profiles) {
+		save_profiles();
+	}
+}
+
+static bool is_auto_core_mode()
+{
+	// The mode bits are shifted up while protected mode is active
+	constexpr auto CoreBits = CPU_AUTODETERMINE_CORE |
+	                          (CPU_AUTODETERMINE_CORE << CPU_AUTODETERMINE_SHIFT);
+	return CPU_AutoDetermineMode & CoreBits;
+}
+
+static bool is_on_dynamic_core()
+{
+#if (C_DYNAMIC_X86)
+	return cpudecoder == &CPU_Core_Dyn_X86_Run;
+#elif (C_DYNREC)
+	return cpudecoder == &CPU_Core_Dynrec_Run;
+#else
+	return false;
+#endif
+}
+
+static bool is_on_normal_core()
+{
+	return cpudecoder == &CPU_Core_Normal_Run;
+}
+
+static std::string describe_program()
+{
+	return auto_core.program.empty() ? std::string("The running program")
+	                                 : "'" + auto_core.program + "'";
+}
+
+// The normal core keeps the host busy if the host idled for less than a
+// small share of the slice
+bool is_host_busy(const AutoCoreSamples& samples, const int64_t slice_us)
+{
+	return samples.host_idle_us < slice_us * MaxIdleShareWhenBusy;
+}
+
+bool is_dynamic_core_thrashing(const AutoCoreSamples& samples)
+{
+	return (samples.blocks_invalidated >= MinThrashingInvalidations &&
+	        samples.blocks_invalidated * 2 >= samples.blocks_translated) ||
+	       samples.code_page_writes >= MaxCodePageWrites;
+}
+
+// Returns the core to switch to after a slice, if any. 'active_core' is empty
+// while neither of the plain cores runs.
+std::optional<CoreProfile> decide_core_switch(
+        AutoCoreSliceState& state, const std::optional<CoreProfile> active_core,
+        const bool is_busy, const bool is_thrashing)
+{
+	if (state.pinned_slices_left > 0) {
+		--state.pinned_slices_left;
+		state.busy_slices = 0;
+		return {};
+	}
+	if (active_core == CoreProfile::Normal) {
+		state.thrashing_slices = 0;
+		state.busy_slices      = is_busy ? state.busy_slices + 1 : 0;
+
+		if (state.busy_slices < BusySlicesToSwitch) {
+			return {};
+		}
+		state.busy_slices = 0;
+		return CoreProfile::Dynamic;
+	}
+	if (active_core == CoreProfile::Dynamic) {
+		state.busy_slices      = 0;
+		state.thrashing_slices = is_thrashing ? state.thrashing_slices + 1 : 0;
+
+		if (state.thrashing_slices < ThrashingSlicesToSwitch) {
+			return {};
+		}
+		state.thrashing_slices   = 0;
+		state.pinned_slices_left = std::max(state.next_pin_slices,
+		                                    InitialPinSlices);
+		state.next_pin_slices = std::min(state.pinned_slices_left * 2,
+		                                 MaxPinSlices);
+		return CoreProfile::Normal;
+	}
+	return {};
+}
+
+static void start_slice()
+{
+	auto_core.slice_ms       = 0;
+	auto_core.slice_start_us = GetTicksUs();
+	autocore_samples         = {};
+}
+
+static void evaluate_slice()
+{
+	// Fast-forward and benchmark runs keep the host busy by design
+	if (ticksLocked || !is_auto_core_mode()) {
+		auto_core.state.busy_slices      = 0;
+		auto_core.state.thrashing_slices = 0;
+		return;
+	}
+	const auto& samples = autocore_samples;
+	const auto slice_us = GetTicksUsSince(auto_core.slice_start_us);
+
+	// Only the plain cores are swapped; the trap variants run while the
+	// program single-steps and restore their own core afterwards
+	std::optional<CoreProfile> active_core = {};
+	if (is_on_normal_core()) {
+		active_core = CoreProfile::Normal;
+	} else if (is_on_dynamic_core()) {
+		active_core = CoreProfile::Dynamic;
+	}
+
+	const auto new_core = decide_core_switch(auto_core.state,
+	                                         active_core,
+	                                         is_host_busy(samples, slice_us),
+	                                         is_dynamic_core_thrashing(samples));
+	if (new_core == CoreProfile::Dynamic) {
+		LOG_MSG("AUTOCORE: %s keeps the host busy, switching to the dynamic core",
+		        describe_program().c_str());
+
+		CPU_SwitchDynamicCore(true);
+		record_decision(CoreProfile::Dynamic);
+
+	} else if (new_core == CoreProfile::Normal) {
+		LOG_MSG("AUTOCORE: %s keeps modifying its code, switching to the "
+		        "normal core for %d seconds",
+		        describe_program().c_str(),
+		        auto_core.state.pinned_slices_left * SliceMs / 1000);
+
+		CPU_SwitchDynamicCore(false);
+		record_decision(CoreProfile::Normal);
+	}
+}
+
+static void auto_core_tick_handler()
+{
+	// Every tick is one emulated millisecond
+	if (++auto_core.slice_ms < SliceMs) {
+		return;
+	}
+	evaluate_slice();
+	start_slice();
+}
+
+void AUTOCORE_Configure(const bool is_enabled, const bool use_profiles)
+{
+	if (auto_core.is_enabled) {
+		TIMER_DelTickHandler(&auto_core_tick_handler);
+	}
+	auto_core.is_enabled   = is_enabled;
+	auto_core.use_profiles = use_profiles;
+
+	if (!is_enabled) {
+		return;
+	}
+	auto_core.state = {};
+	start_slice();
+	TIMER_AddTickHandler(&auto_core_tick_handler);
+}
+
+void AUTOCORE_AddProgram(const uint16_t psp_segment, const char* dos_path,
+                         const uint32_t file_size)
+{
+	assert(dos_path);
+	auto_core.programs[psp_segment] = make_core_profile_key(dos_path, file_size);
+}
+
+void AUTOCORE_RemoveProgram(const uint16_t psp_segment)
+{
+	auto_core.programs.erase(psp_segment);
+}
+
+void AUTOCORE_SetProgram(const uint16_t psp_segment)
+{
+	const auto program = auto_core.programs.find(psp_segment);
+
+	auto_core.program = (program != auto_core.programs.end())
+	                          ? program->second
+	                          : std::string();
+
+	if (!auto_core.is_enabled) {
+		return;
+	}
+	if (auto_core.use_profiles && !auto_core.are_profiles_loaded) {
+		load_profiles();
+	}
+
+	auto_core.state = {};
+	start_slice();
+
+	const auto it = auto_core.profiles.find(auto_core.program);
+	const auto has_profile = !auto_core.program.empty() &&
+	                         (it != auto_core.profiles.end());
+
+	// A stored normal core decision only pins the core for a while, as if
+	// the dynamic core had just thrashed; it's re-evaluated afterwards
+	if (has_profile && it->second == CoreProfile::Normal) {
+		auto_core.state.pinned_slices_left = InitialPinSlices;
+		auto_core.state.next_pin_slices    = InitialPinSlices * 2;
+	}
+
+	if (!is_auto_core_mode() || !(is_on_normal_core() || is_on_dynamic_core())) {
+		return;
+	}
+	// Without a profile, fall back to the classic rule: the dynamic core
+	// in protected mode, the normal core in real mode
+	const auto use_dynamic_core = has_profile
+	                                    ? (it->second == CoreProfile::Dynamic)
+	                                    : cpu.pmode;
+
+	if (use_dynamic_core == is_on_dynamic_core()) {
+		return;
+	}
+	if (has_profile) {
+		LOG_MSG("AUTOCORE: Starting '%s' on the %s core, as in '%s'",
+		        auto_core.program.c_str(),
+		        to_string(it->second),
+		        ProfilesFilename);
+	}
+	CPU_SwitchDynamicCore(use_dynamic_core);
+}
+
+void AUTOCORE_NotifyBooting()
+{
+	auto_core.programs.clear();
+	auto_core.program.clear();
+
+	auto_core.state = {};
+}
+
+bool AUTOCORE_IsNormalCorePinned()
+{
+	return auto_core.is_enabled && auto_core.state.pinned_slices_left > 0;
+}
@@ -47,6 +47,7 @@
 #include "inout.h"
 #include "mem.h"
 #include "paging.h"
+#include "perf_counters.h"
 #include "regs.h"
 #include "tracy.h"
 
@@ -158,6 +159,9 @@ static struct {
 #define dyn_return(a,b) gen_return(a)
 #include "dyn_cache.h"
 
+static PerfCounter blocks_translated("cpu.dyn_x86.blocks_translated");
+static PerfTimer translate_timer("cpu.dyn_x86.translate");
+
 static struct {
 	Bitu callback;
 	uint32_t readdata;
@@ -285,7 +289,7 @@ static BlockReturn sync_normal_fpu_and_run_dyn_code(const uint8_t* code) noexcep
 	return gen_runcode(code);
 }
 
-static Bits sync_dh_fpu_and_run_normal_core() noexcept
+static void sync_dh_fpu_to_normal_core()
 {
 	if (last_core == CoreType::Dynamic) {
 		maybe_sync_host_fpu_to_dh();
@@ -296,6 +300,11 @@ static Bits sync_dh_fpu_and_run_normal_core() noexcept
 		FPU_SetPRegsFrom(dyn_dh_fpu.state.st_reg);
 		last_core = CoreType::Normal;
 	}
+}
+
+static Bits sync_dh_fpu_and_run_normal_core() noexcept
+{
+	sync_dh_fpu_to_normal_core();
 	assert(!dyn_dh_fpu.state_used);
 	return CPU_Core_Normal_Run();
 }
@@ -341,7 +350,10 @@ restart_core:
 	CacheBlock * block=chandler->FindCacheBlock(ip_point&4095);
 	if (!block) {
 		if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
+			const PerfTimerScope perf_scope(translate_timer);
 			block=CreateCacheBlock(chandler,ip_point,32);
+			blocks_translated.Add();
+			++autocore_samples.blocks_translated;
 		} else {
 			int32_t old_cycles=CPU_Cycles;
 			CPU_Cycles=1;
@@ -521,4 +533,17 @@ void CPU_Core_Dyn_X86_SetFPUMode(bool dh_fpu) {
 #endif
 }
 
+// Hands the FPU state over to the core that runs after a core switch
+void CPU_Core_Dyn_X86_PrepareCoreSwitch([[maybe_unused]] const bool to_dynamic)
+{
+#if defined(X86_DYNFPU_DH_ENABLED)
+	if (to_dynamic) {
+		// The normal core ran on its own, so its FPU state is current
+		last_core = CoreType::Normal;
+	} else {
+		sync_dh_fpu_to_normal_core();
+	}
+#endif
+}
+
 #endif
@@ -53,7 +53,7 @@ static struct DynDecode {
 	DynReg * segprefix;
 } decode;
 
-static bool MakeCodePage(Bitu lin_addr,CodePageHandler * &cph) {
+static bool MakeCodePage(Bitu lin_addr,CodePageHandler * &cph,const bool is_cross_page_fetch=false) {
 	uint8_t rdval;
 	const Bitu cflag = cpu.code.big ? PFLAG_HASCODE32:PFLAG_HASCODE16;
 	//Ensure page contains memory:
@@ -94,6 +94,11 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandler * &cph) {
 		cph = nullptr;
 		return false;
 	}
+	/* Demoted pages run on the normal core, unless a block runs into them */
+	if (!is_cross_page_fetch && cache_is_page_demoted(phys_page)) {
+		cph = nullptr;
+		return false;
+	}
 	/* Find a free CodePage */
 	if (!cache.free_pages && cache.used_pages) {
 		if (cache.used_pages != decode.page.code)
@@ -129,11 +134,12 @@ static uint8_t decode_fetchb(void) {
 	if (GCC_UNLIKELY(decode.page.index>=4096)) {
         /* Advance to the next page */
 		decode.active_block->page.end=4095;
+		decode.page.code->AddBlockExtent(decode.active_block);
 		/* trigger possible page fault here */
 		++decode.page.first;
 		Bitu fetchaddr=decode.page.first << 12;
 		mem_readb(fetchaddr);
-		MakeCodePage(fetchaddr,decode.page.code);
+		MakeCodePage(fetchaddr,decode.page.code,true);
 		CacheBlock * newblock=cache_getblock();
 		decode.active_block->crossblock=newblock;
 		newblock->crossblock=decode.active_block;
@@ -2920,6 +2926,7 @@ illegalopcode:
 finish_block:
 	/* Setup the correct end-address */
 	decode.active_block->page.end=--decode.page.index;
+	decode.page.code->AddBlockExtent(decode.active_block);
 	dyn_mem_execute(cache_addr, cache_bytes);
 	const auto cache_flush_bytes = decode.block->cache.size;
 	dyn_cache_invalidate(cache_addr, cache_flush_bytes);
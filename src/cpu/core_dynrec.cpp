@@ -50,6 +50,7 @@
 #include "lazyflags.h"
 #include "mem.h"
 #include "paging.h"
+#include "perf_counters.h"
 #include "pic.h"
 #include "regs.h"
 #include "tracy.h"
@@ -151,6 +152,9 @@ static_assert(offsetof(core_dynrec_t, readdata) % sizeof(uint32_t) == 0,
 
 #include "dyn_cache.h"
 
+static PerfCounter blocks_translated("cpu.dynrec.blocks_translated");
+static PerfTimer translate_timer("cpu.dynrec.translate");
+
 #define X86			0x01
 #define X86_64		0x02
 #define MIPSEL		0x03
@@ -256,7 +260,10 @@ Bits CPU_Core_Dynrec_Run() noexcept
 			// unless the instruction is known to be modified
 			if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
 				// translate up to 32 instructions
+				const PerfTimerScope perf_scope(translate_timer);
 				block=CreateCacheBlock(chandler,ip_point,32);
+				blocks_translated.Add();
+				++autocore_samples.blocks_translated;
 			} else {
 				// let the normal core handle this instruction to avoid zero-sized blocks
 				Bitu old_cycles=CPU_Cycles;
@@ -620,6 +620,7 @@ finish_block:
 	// setup the correct end-address
 	decode.page.index--;
 	decode.active_block->page.end=(uint16_t)decode.page.index;
+	decode.page.code->AddBlockExtent(decode.active_block);
 	dyn_mem_execute(cache_addr, cache_bytes);
 	const auto cache_flush_bytes = static_cast<size_t>(decode.block->cache.size);
 	dyn_cache_invalidate(cache_addr, cache_flush_bytes);
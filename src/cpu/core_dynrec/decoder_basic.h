@@ -116,7 +116,8 @@ static struct DynDecode {
 	} modrm;
 } decode;
 
-static bool MakeCodePage(Bitu lin_addr, CodePageHandler *&cph)
+static bool MakeCodePage(Bitu lin_addr, CodePageHandler *&cph,
+                         const bool is_cross_page_fetch = false)
 {
 	uint8_t rdval;
 	const Bitu cflag = cpu.code.big ? PFLAG_HASCODE32:PFLAG_HASCODE16;
@@ -161,6 +162,11 @@ static bool MakeCodePage(Bitu lin_addr, CodePageHandler *&cph)
 		cph = nullptr;
 		return false;
 	}
+	// demoted pages run on the normal core, unless a block runs into them
+	if (!is_cross_page_fetch && cache_is_page_demoted(phys_page)) {
+		cph = nullptr;
+		return false;
+	}
 	// find a free CodePage
 	if (!cache.free_pages) {
 		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
@@ -195,11 +201,12 @@ static bool MakeCodePage(Bitu lin_addr, CodePageHandler *&cph)
 static void decode_advancepage(void) {
 	// Advance to the next page
 	decode.active_block->page.end=4095;
+	decode.page.code->AddBlockExtent(decode.active_block);
 	// trigger possible page fault here
 	++decode.page.first;
 	Bitu faddr=decode.page.first << 12;
 	mem_readb(faddr);
-	MakeCodePage(faddr,decode.page.code);
+	MakeCodePage(faddr,decode.page.code,true);
 	CacheBlock *newblock = cache_getblock();
 	decode.active_block->crossblock=newblock;
 	newblock->crossblock=decode.active_block;
@@ -23,6 +23,7 @@
 #include <sstream>
 #include <stddef.h>
 
+#include "auto_core.h"
 #include "memory.h"
 #include "debug.h"
 #include "mapper.h"
@@ -76,6 +77,7 @@ void CPU_Core_Dyn_X86_Init(void);
 void CPU_Core_Dyn_X86_Cache_Init(bool enable_cache);
 void CPU_Core_Dyn_X86_Cache_Close(void);
 void CPU_Core_Dyn_X86_SetFPUMode(bool dh_fpu);
+void CPU_Core_Dyn_X86_PrepareCoreSwitch(const bool to_dynamic);
 #elif (C_DYNREC)
 void CPU_Core_Dynrec_Init(void);
 void CPU_Core_Dynrec_Cache_Init(bool enable_cache);
@@ -1603,17 +1605,10 @@ void CPU_SET_CRX(Bitu cr,Bitu value) {
 				} else {
 				        GFX_RefreshTitle();
 			        }
-#if (C_DYNAMIC_X86)
-				if (CPU_AutoDetermineMode&CPU_AUTODETERMINE_CORE) {
-					CPU_Core_Dyn_X86_Cache_Init(true);
-					cpudecoder=&CPU_Core_Dyn_X86_Run;
-				}
-#elif (C_DYNREC)
-				if (CPU_AutoDetermineMode&CPU_AUTODETERMINE_CORE) {
-					CPU_Core_Dynrec_Cache_Init(true);
-					cpudecoder=&CPU_Core_Dynrec_Run;
+				if ((CPU_AutoDetermineMode & CPU_AUTODETERMINE_CORE) &&
+				    !AUTOCORE_IsNormalCorePinned()) {
+					CPU_SwitchDynamicCore(true);
 				}
-#endif
 				CPU_AutoDetermineMode<<=CPU_AUTODETERMINE_SHIFT;
 			} else {
 				cpu.pmode=false;
@@ -1629,6 +1624,10 @@ void CPU_SET_CRX(Bitu cr,Bitu value) {
 	case 3:
 		PAGING_SetDirBase(value);
 		break;
+	case 4:
+		cpu.cr4 = value;
+		PAGING_SetGlobalPagesEnabled(value & CR4_PAGEGLOBALENABLE);
+		break;
 	default:
 		LOG(LOG_CPU,LOG_ERROR)("Unhandled MOV CR%d,%X",cr,value);
 		break;
@@ -1656,6 +1655,8 @@ Bitu CPU_GET_CRX(Bitu cr) {
 		return paging.cr2;
 	case 3:
 		return PAGING_GetDirBase() & 0xfffff000;
+	case 4:
+		return cpu.cr4;
 	default:
 		LOG(LOG_CPU,LOG_ERROR)("Unhandled MOV XXX, CR%d",cr);
 		break;
@@ -2045,14 +2046,16 @@ bool CPU_CPUID(void) {
 			reg_ecx = 0;     // No features
 		} else if (CPU_ArchitectureType == ArchitectureType::PentiumSlow) {
 #if (C_FPU)
-			reg_eax = 0x517; // Intel Pentium P5 60/66 MHz D1-step
-			reg_edx = 0x11;  // FPU + Time Stamp Counter (RDTSC)
+			reg_eax = 0x517;  // Intel Pentium P5 60/66 MHz D1-step
+			reg_edx = 0x2011; // FPU + Time Stamp Counter (RDTSC) +
+			                  // Page Global Enable (CR4.PGE)
 #else
 			// All Pentiums had FPU built-in, so when FPU is
 			// disabled, we pretend to have early Pentium model with
 			// FDIV bug present.
-			reg_eax = 0x513; // Intel Pentium P5 60/66 MHz B1-step
-			reg_edx = 0x10;  // Time Stamp Counter (RDTSC)
+			reg_eax = 0x513;  // Intel Pentium P5 60/66 MHz B1-step
+			reg_edx = 0x2010; // Time Stamp Counter (RDTSC) +
+			                  // Page Global Enable (CR4.PGE)
 #endif
 			reg_ebx = 0;     // Not supported
 			reg_ecx = 0;     // No features
@@ -2186,6 +2189,29 @@ void CPU_Reset_AutoAdjust(void) {
 	ticksScheduled = 0;
 }
 
+void CPU_SwitchDynamicCore([[maybe_unused]] const bool use_dynamic_core)
+{
+#if (C_DYNAMIC_X86)
+	CPU_Core_Dyn_X86_PrepareCoreSwitch(use_dynamic_core);
+	if (use_dynamic_core) {
+		CPU_Core_Dyn_X86_Cache_Init(true);
+		cpudecoder = &CPU_Core_Dyn_X86_Run;
+	} else {
+		cpudecoder = &CPU_Core_Normal_Run;
+	}
+#elif (C_DYNREC)
+	if (use_dynamic_core) {
+		CPU_Core_Dynrec_Cache_Init(true);
+		cpudecoder = &CPU_Core_Dynrec_Run;
+	} else {
+		cpudecoder = &CPU_Core_Normal_Run;
+	}
+#endif
+	// Let the running core return so the new one takes over
+	CPU_CycleLeft += CPU_Cycles;
+	CPU_Cycles = 0;
+}
+
 class CPU final : public Module_base {
 private:
 	static bool inited;
@@ -2216,6 +2242,7 @@ public:
 		CPU_SetFlags(FLAG_IF,FMASK_ALL);		//Enable interrupts
 		cpu.cr0=0xffffffff;
 		CPU_SET_CRX(0,0);						//Initialize
+		CPU_SET_CRX(4,0);
 		cpu.code.big=false;
 		cpu.stack.mask=0xffff;
 		cpu.stack.notmask=0xffff0000;
@@ -2411,6 +2438,11 @@ public:
 		else if (CPU_ArchitectureType>=ArchitectureType::Intel486OldSlow) CPU_extflags_toggle=(FLAG_AC);
 		else CPU_extflags_toggle=0;
 
+		// Only set if a dynamic core is built in and no prefetch queue
+		// emulation is requested
+		const auto is_auto_core = (CPU_AutoDetermineMode & CPU_AUTODETERMINE_CORE) != 0;
+		AUTOCORE_Configure(is_auto_core, section->Get_bool("auto_core_profiles"));
+
 
 		if(CPU_CycleMax <= 0) CPU_CycleMax = 3000;
 		if(CPU_CycleUp <= 0)   CPU_CycleUp = 500;
@@ -2427,6 +2459,7 @@ public:
 static CPU * test;
 
 void CPU_ShutDown([[maybe_unused]] Section* sec) {
+	AUTOCORE_Configure(false, false);
 #if (C_DYNAMIC_X86)
 	CPU_Core_Dyn_X86_Cache_Close();
 #elif (C_DYNREC)
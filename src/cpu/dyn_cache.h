@@ -23,15 +23,30 @@
 #include <cerrno>
 #include <new>
 #include <type_traits>
+#include <unordered_map>
 
+#include "auto_core.h"
 #include "mem_unaligned.h"
 #include "paging.h"
+#include "perf_counters.h"
+#include "pic.h"
 #include "types.h"
 
 #if defined(HAVE_MMAP)
 #include <sys/mman.h>
 #endif
 
+// The code cache can be backed by an anonymous memory file mapped twice: an
+// executable view that runs the generated code and a writable view that the
+// code generator emits into. This keeps the cache W^X without toggling page
+// protections on every translation. Only the backends that write to the cache
+// exclusively through the cache_add* functions can use it.
+#if defined(HAVE_MEMFD_CREATE) && defined(C_PER_PAGE_W_OR_X) && \
+        (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+#define DYN_CACHE_DUAL_MAPPING 1
+#include <unistd.h>
+#endif
+
 #if defined(HAVE_PTHREAD_WRITE_PROTECT_NP)
 #include <pthread.h>
 #endif
@@ -151,9 +166,55 @@ static uint8_t* cache_code_start_ptr   = {};
 static uint8_t* cache_code             = {};
 static uint8_t* cache_code_link_blocks = {};
 
-static std::vector<CacheBlock> cache_blocks(CACHE_BLOCKS);
+// distance from an executable address in the cache to its writable alias;
+// zero unless the cache is dual-mapped
+static uintptr_t cache_write_offset = 0;
+
+// allocated along with the code cache, only once a dynamic core is used
+static std::vector<CacheBlock> cache_blocks = {};
 static CacheBlock link_blocks[2] = {}; // default linking (specially marked)
 
+static PerfCounter code_page_data_writes("cpu.dyn_cache.data_writes");
+static PerfCounter code_page_invalidations("cpu.dyn_cache.invalidations");
+static PerfCounter hash_buckets_scanned("cpu.dyn_cache.buckets_scanned");
+static PerfCounter code_pages_demoted("cpu.dyn_cache.pages_demoted");
+
+// A code page that is written to this often keeps costing more in write
+// checks and retranslations than its translated code saves, so it's handed
+// to the normal core for a while. Writes that invalidate code weigh more
+// than plain data writes, as they also throw away translations.
+constexpr int DemoteDataWriteCost    = 1;
+constexpr int DemoteInvalidationCost = 64;
+constexpr int DemoteCostPerMs        = 8192;
+constexpr int DemoteAfterBusyMs      = 16;
+constexpr uint32_t DemotedPageMs     = 1000;
+
+// physical pages run by the normal core, with the PIC tick at which they
+// can be translated again
+static std::unordered_map<Bitu, uint32_t> demoted_pages = {};
+
+static void cache_demote_page(const Bitu phys_page)
+{
+	demoted_pages[phys_page] = PIC_Ticks + DemotedPageMs;
+	code_pages_demoted.Add();
+}
+
+static bool cache_is_page_demoted(const Bitu phys_page)
+{
+	if (GCC_LIKELY(demoted_pages.empty())) {
+		return false;
+	}
+	const auto it = demoted_pages.find(phys_page);
+	if (it == demoted_pages.end()) {
+		return false;
+	}
+	if (static_cast<int32_t>(it->second - PIC_Ticks) > 0) {
+		return true;
+	}
+	demoted_pages.erase(it);
+	return false;
+}
+
 // the CodePageHandler class provides access to the contained
 // cache blocks and intercepts writes to the code for special treatment
 class CodePageHandler final : public PageHandler {
@@ -181,15 +242,41 @@ public:
 		// code present)
 		memset(&hash_map,0,sizeof(hash_map));
 		memset(&write_map,0,sizeof(write_map));
+		code_chunks    = 0;
+		max_block_span = 0;
+		write_cost     = {};
 		if (invalidation_map) {
 			delete [] invalidation_map;
 			invalidation_map = nullptr;
 		}
 	}
 
+	// note the extent of a finished block; the block must be in this page
+	void AddBlockExtent(const CacheBlock *block)
+	{
+		const auto start = block->page.start;
+		const auto end   = block->page.end;
+		assert(start <= end);
+
+		code_chunks |= ChunkBitsFor(start, end);
+		max_block_span = std::max(max_block_span,
+		                          static_cast<Bitu>(end - start));
+	}
+
 	// clear out blocks that contain code which has been modified
 	bool InvalidateRange(Bitu start, Bitu end)
 	{
+		code_page_invalidations.Add();
+
+		// blocks are hashed by their start, and none spans more than
+		// max_block_span bytes, so only the buckets from that far
+		// before the range onwards can hold overlapping blocks; the
+		// blocks that started in the page before are kept in bucket 0
+		const Bits first_index = 1 + ((start > max_block_span
+		                                       ? start - max_block_span
+		                                       : 0) >>
+		                              DYN_HASH_SHIFT);
+
 		Bits index=1+(end>>DYN_HASH_SHIFT);
 		bool is_current_block = false; // if the current block is
 		                               // modified, it has to be exited
@@ -215,10 +302,14 @@ public:
 					block->Clear(); // clear the block,
 					                // decrements the
 					                // write_map accordingly
+					++autocore_samples.blocks_invalidated;
 				}
 				block=nextblock;
 			}
-			index--;
+			hash_buckets_scanned.Add();
+			// after the last bucket that can hold an overlapping
+			// block, continue with the cross-page blocks
+			index = (index == first_index) ? 0 : index - 1;
 		}
 		return is_current_block;
 	}
@@ -233,8 +324,39 @@ public:
 		return map;
 	}
 
+	// bits of the 64-byte chunks in code_chunks that hold the given bytes
+	static constexpr uint64_t ChunkBitsFor(const Bitu first, const Bitu last)
+	{
+		constexpr auto all_bits = ~uint64_t{0};
+		return (all_bits >> (63 - (last >> 6))) & (all_bits << (first >> 6));
+	}
+
+	// account for a write to a page that still has blocks; returns true
+	// once the page has been written to often enough to be demoted
+	bool AddWriteCost(const int cost)
+	{
+		if (write_cost.tick != PIC_Ticks) {
+			const auto was_busy = (write_cost.tick + 1 == PIC_Ticks) &&
+			                      (write_cost.amount >= DemoteCostPerMs);
+
+			write_cost.busy_ms = was_busy ? write_cost.busy_ms + 1 : 0;
+			write_cost.tick    = PIC_Ticks;
+			write_cost.amount  = 0;
+		}
+		write_cost.amount += cost;
+		return write_cost.busy_ms >= DemoteAfterBusyMs;
+	}
+
+	// drop all blocks and let the normal core run this page for a while
+	void Demote()
+	{
+		cache_demote_page(phys_page);
+		ClearRelease();
+	}
+
 	// the following functions will clean all cache blocks that are invalid
-	// now due to the write
+	// now due to the write; a clear bit in code_chunks lets a write that
+	// hits no block skip the write map
 
 	void writeb(PhysPt addr, const uint8_t val) override
 	{
@@ -246,10 +368,16 @@ public:
 		if (host_readb(hostmem + addr) == val)
 			return;
 		host_writeb(hostmem + addr, val);
+		++autocore_samples.code_page_writes;
 		// see if there's code where we are writing to
-		if (!write_map[addr]) {
-			if (active_blocks)
-				return; // still some blocks in this page
+		if (!(code_chunks & ChunkBitsFor(addr, addr)) || !write_map[addr]) {
+			if (active_blocks) {
+				// still some blocks in this page
+				code_page_data_writes.Add();
+				if (AddWriteCost(DemoteDataWriteCost))
+					Demote();
+				return;
+			}
 			active_count--;
 			if (!active_count)
 				Release(); // delay page releasing until
@@ -260,6 +388,8 @@ public:
 		}
 		invalidation_map[addr]++;
 		InvalidateRange(addr,addr);
+		if (AddWriteCost(DemoteInvalidationCost))
+			Demote();
 	}
 
 	void writew(PhysPt addr, const uint16_t val) override
@@ -272,10 +402,17 @@ public:
 		if (host_readw(hostmem + addr) == val)
 			return;
 		host_writew(hostmem + addr, val);
+		++autocore_samples.code_page_writes;
 		// see if there's code where we are writing to
-		if (!read_unaligned_uint16(&write_map[addr])) {
-			if (active_blocks)
-				return; // still some blocks in this page
+		if (!(code_chunks & ChunkBitsFor(addr, addr + 1)) ||
+		    !read_unaligned_uint16(&write_map[addr])) {
+			if (active_blocks) {
+				// still some blocks in this page
+				code_page_data_writes.Add();
+				if (AddWriteCost(DemoteDataWriteCost))
+					Demote();
+				return;
+			}
 			active_count--;
 			if (!active_count)
 				Release(); // delay page releasing until
@@ -286,6 +423,8 @@ public:
 		}
 		host_addw(&invalidation_map[addr], 0x0101);
 		InvalidateRange(addr,addr+1);
+		if (AddWriteCost(DemoteInvalidationCost))
+			Demote();
 	}
 
 	void writed(PhysPt addr, const uint32_t val) override
@@ -298,10 +437,17 @@ public:
 		if (host_readd(hostmem + addr) == val)
 			return;
 		host_writed(hostmem + addr, val);
+		++autocore_samples.code_page_writes;
 		// see if there's code where we are writing to
-		if (!read_unaligned_uint32(&write_map[addr])) {
-			if (active_blocks)
-				return; // still some blocks in this page
+		if (!(code_chunks & ChunkBitsFor(addr, addr + 3)) ||
+		    !read_unaligned_uint32(&write_map[addr])) {
+			if (active_blocks) {
+				// still some blocks in this page
+				code_page_data_writes.Add();
+				if (AddWriteCost(DemoteDataWriteCost))
+					Demote();
+				return;
+			}
 			active_count--;
 			if (!active_count)
 				Release(); // delay page releasing until
@@ -312,8 +458,13 @@ public:
 		}
 		host_addd(&invalidation_map[addr], 0x01010101);
 		InvalidateRange(addr,addr+3);
+		if (AddWriteCost(DemoteInvalidationCost))
+			Demote();
 	}
 
+	// the checked writes are issued by the translated code, so a demotion
+	// exits the running block and lets the normal core redo the write
+
 	bool writeb_checked(PhysPt addr, const uint8_t val) override
 	{
 		if (GCC_UNLIKELY(old_pagehandler->flags&PFLAG_HASROM)) return false;
@@ -323,20 +474,34 @@ public:
 		addr&=4095;
 		if (host_readb(hostmem + addr) == val)
 			return false;
+		++autocore_samples.code_page_writes;
 		// see if there's code where we are writing to
-		if (!write_map[addr]) {
+		if (!(code_chunks & ChunkBitsFor(addr, addr)) || !write_map[addr]) {
 			if (!active_blocks) {
 				// no blocks left in this page, still delay
 				// the page releasing a bit
 				active_count--;
 				if (!active_count) Release();
+			} else {
+				code_page_data_writes.Add();
+				if (AddWriteCost(DemoteDataWriteCost)) {
+					Demote();
+					cpu.exception.which=SMC_CURRENT_BLOCK;
+					return true;
+				}
 			}
 		} else {
 			if (!invalidation_map)
 				invalidation_map = alloc_invalidation_map();
 
 			invalidation_map[addr]++;
-			if (InvalidateRange(addr,addr)) {
+			const auto is_current_block = InvalidateRange(addr,addr);
+			if (AddWriteCost(DemoteInvalidationCost)) {
+				Demote();
+				cpu.exception.which=SMC_CURRENT_BLOCK;
+				return true;
+			}
+			if (is_current_block) {
 				cpu.exception.which=SMC_CURRENT_BLOCK;
 				return true;
 			}
@@ -354,20 +519,35 @@ public:
 		addr&=4095;
 		if (host_readw(hostmem + addr) == val)
 			return false;
+		++autocore_samples.code_page_writes;
 		// see if there's code where we are writing to
-		if (!read_unaligned_uint16(&write_map[addr])) {
+		if (!(code_chunks & ChunkBitsFor(addr, addr + 1)) ||
+		    !read_unaligned_uint16(&write_map[addr])) {
 			if (!active_blocks) {
 				// no blocks left in this page, still delay
 				// the page releasing a bit
 				active_count--;
 				if (!active_count) Release();
+			} else {
+				code_page_data_writes.Add();
+				if (AddWriteCost(DemoteDataWriteCost)) {
+					Demote();
+					cpu.exception.which=SMC_CURRENT_BLOCK;
+					return true;
+				}
 			}
 		} else {
 			if (!invalidation_map)
 				invalidation_map = alloc_invalidation_map();
 
 			host_addw(&invalidation_map[addr], 0x0101);
-			if (InvalidateRange(addr,addr+1)) {
+			const auto is_current_block = InvalidateRange(addr,addr+1);
+			if (AddWriteCost(DemoteInvalidationCost)) {
+				Demote();
+				cpu.exception.which=SMC_CURRENT_BLOCK;
+				return true;
+			}
+			if (is_current_block) {
 				cpu.exception.which=SMC_CURRENT_BLOCK;
 				return true;
 			}
@@ -385,20 +565,35 @@ public:
 		addr&=4095;
 		if (host_readd(hostmem + addr) == val)
 			return false;
+		++autocore_samples.code_page_writes;
 		// see if there's code where we are writing to
-		if (!read_unaligned_uint32(&write_map[addr])) {
+		if (!(code_chunks & ChunkBitsFor(addr, addr + 3)) ||
+		    !read_unaligned_uint32(&write_map[addr])) {
 			if (!active_blocks) {
 				// no blocks left in this page, still delay
 				// the page releasing a bit
 				active_count--;
 				if (!active_count) Release();
+			} else {
+				code_page_data_writes.Add();
+				if (AddWriteCost(DemoteDataWriteCost)) {
+					Demote();
+					cpu.exception.which=SMC_CURRENT_BLOCK;
+					return true;
+				}
 			}
 		} else {
 			if (!invalidation_map)
 				invalidation_map = alloc_invalidation_map();
 
 			host_addd(&invalidation_map[addr], 0x01010101);
-			if (InvalidateRange(addr,addr+3)) {
+			const auto is_current_block = InvalidateRange(addr,addr+3);
+			if (AddWriteCost(DemoteInvalidationCost)) {
+				Demote();
+				cpu.exception.which=SMC_CURRENT_BLOCK;
+				return true;
+			}
+			if (is_current_block) {
 				cpu.exception.which=SMC_CURRENT_BLOCK;
 				return true;
 			}
@@ -434,6 +629,10 @@ public:
 	{
 		active_blocks--;
 		active_count       = 16;
+		if (!active_blocks) {
+			code_chunks    = 0;
+			max_block_span = 0;
+		}
 		CacheBlock** where = &hash_map[block->hash.index];
 		while (*where != block) {
 			where = &((*where)->hash.next);
@@ -534,6 +733,9 @@ public:
 	uint8_t write_map[4096] = {};
 	uint8_t *invalidation_map = nullptr;
 
+	// one bit per 64-byte chunk that may hold code of a finished block
+	uint64_t code_chunks = 0;
+
 	CodePageHandler *prev = nullptr;
 	CodePageHandler *next = nullptr;
 
@@ -546,6 +748,14 @@ private:
 	Bitu active_blocks = 0; // the number of cache blocks in this page
 	Bitu active_count = 0;  // delaying parameter to not immediately release
 	                        // a page
+	Bitu max_block_span = 0; // the longest block in this page, in bytes
+
+	// weighted writes in the current and the consecutive busy milliseconds
+	struct {
+		uint32_t tick = 0;
+		int amount    = 0;
+		int busy_ms   = 0;
+	} write_cost = {};
 	HostPt hostmem = nullptr;
 	Bitu phys_page = 0;
 };
@@ -778,15 +988,24 @@ static void cache_closeblock()
 // mistake or as WIP change) and relies on silently C-casting the constness
 // away.
 //
-// Replaced silent C-casting with explicit const-casting; when upstream will
-// revert this change bring back the previous version and remove this comment.
+// Replaced silent C-casting with an explicit cast in cache_rw_ptr; when
+// upstream will revert this change bring back the previous version and remove
+// this comment.
 //
 
+// writable alias of a position in the cache (the position itself if the
+// cache isn't dual-mapped)
+static inline uint8_t *cache_rw_ptr(const uint8_t *pos)
+{
+	return reinterpret_cast<uint8_t *>(reinterpret_cast<uintptr_t>(pos) +
+	                                   cache_write_offset);
+}
+
 // place an 8bit value into the cache
 
 static inline void cache_addb(uint8_t val, const uint8_t *pos)
 {
-	*const_cast<uint8_t *>(pos) = val;
+	*cache_rw_ptr(pos) = val;
 }
 
 static inline void cache_addb(uint8_t val)
@@ -799,7 +1018,7 @@ static inline void cache_addb(uint8_t val)
 
 static inline void cache_addw(uint16_t val, const uint8_t *pos)
 {
-	write_unaligned_uint16(const_cast<uint8_t *>(pos), val);
+	write_unaligned_uint16(cache_rw_ptr(pos), val);
 }
 
 static inline void cache_addw(uint16_t val)
@@ -812,7 +1031,7 @@ static inline void cache_addw(uint16_t val)
 
 static inline void cache_addd(uint32_t val, const uint8_t *pos)
 {
-	write_unaligned_uint32(const_cast<uint8_t *>(pos), val);
+	write_unaligned_uint32(cache_rw_ptr(pos), val);
 }
 
 static inline void cache_addd(uint32_t val)
@@ -825,7 +1044,7 @@ static inline void cache_addd(uint32_t val)
 
 static inline void cache_addq(uint64_t val, const uint8_t *pos)
 {
-	write_unaligned_uint64(const_cast<uint8_t *>(pos), val);
+	write_unaligned_uint64(cache_rw_ptr(pos), val);
 }
 
 static inline void cache_addq(uint64_t val)
@@ -910,6 +1129,8 @@ static inline void dyn_mem_set_access([[maybe_unused]] void *ptr,
 static inline void dyn_mem_execute(void *ptr, size_t size)
 {
 #if defined(C_PER_PAGE_W_OR_X)
+	if (cache_write_offset)
+		return; // the executable view is never writable
 	dyn_mem_set_access(ptr, size, true);
 #else
 	// Skip per-page execute-flagging
@@ -919,6 +1140,8 @@ static inline void dyn_mem_execute(void *ptr, size_t size)
 static inline void dyn_mem_write(void *ptr, size_t size)
 {
 #if defined(C_PER_PAGE_W_OR_X)
+	if (cache_write_offset)
+		return; // writes always go through the writable view
 	dyn_mem_set_access(ptr, size, false);
 #else
 	// Skip per-page write-flagging
@@ -952,6 +1175,41 @@ static inline void dyn_cache_invalidate([[maybe_unused]] void *ptr,
 #endif
 }
 
+#if defined(DYN_CACHE_DUAL_MAPPING)
+// Maps the code cache twice from a memory file, read+execute for running and
+// read+write for code generation. Returns false if the host doesn't allow it,
+// leaving the caller to fall back to a single mapping with per-page W^X.
+static bool cache_map_dual(const size_t size)
+{
+	const int fd = memfd_create("dosbox-dyncache", MFD_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		close(fd);
+		return false;
+	}
+	auto rx_ptr = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+	auto rw_ptr = MAP_FAILED;
+	if (rx_ptr != MAP_FAILED) {
+		rw_ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	// the mappings keep the memory file alive
+	close(fd);
+
+	if (rw_ptr == MAP_FAILED) {
+		if (rx_ptr != MAP_FAILED) {
+			munmap(rx_ptr, size);
+		}
+		return false;
+	}
+	cache_code_start_ptr = static_cast<uint8_t *>(rx_ptr);
+	cache_write_offset = reinterpret_cast<uintptr_t>(rw_ptr) -
+	                     reinterpret_cast<uintptr_t>(rx_ptr);
+	return true;
+}
+#endif
+
 static bool cache_initialized = false;
 
 static void cache_init(bool enable) {
@@ -961,6 +1219,7 @@ static void cache_init(bool enable) {
 			return;
 		}
 		cache_initialized = true;
+		cache_blocks = std::vector<CacheBlock>(CACHE_BLOCKS);
 		cache.block.free = &cache_blocks[0];
 		// initialize the cache blocks
 		for (int i=0;i<CACHE_BLOCKS-1;i++) {
@@ -984,14 +1243,22 @@ static void cache_init(bool enable) {
 			assert(lp_vmem);
 			cache_code_start_ptr = static_cast<uint8_t *>(lp_vmem);
 #elif defined(HAVE_MMAP)
-			int map_flags = MAP_PRIVATE | MAP_ANON;
-			int prot_flags = PROT_READ | PROT_WRITE | PROT_EXEC;
+#if defined(DYN_CACHE_DUAL_MAPPING)
+			if (!cache_map_dual(cache_code_size)) {
+				LOG_MSG("DYNCACHE: Dual-mapped code cache unavailable (%s), using per-page W^X",
+				        strerror(errno));
+			}
+#endif
+			if (cache_code_start_ptr == nullptr) {
+				int map_flags = MAP_PRIVATE | MAP_ANON;
+				int prot_flags = PROT_READ | PROT_WRITE | PROT_EXEC;
 #if defined(HAVE_MAP_JIT)
-			map_flags |= MAP_JIT;
+				map_flags |= MAP_JIT;
 #endif
-			cache_code_start_ptr=static_cast<uint8_t *>(mmap(nullptr, cache_code_size, prot_flags, map_flags, -1, 0));
-			if (cache_code_start_ptr == MAP_FAILED) {
-				E_Exit("DYNCACHE: Failed memory-mapping cache memory because: %s", strerror(errno));
+				cache_code_start_ptr=static_cast<uint8_t *>(mmap(nullptr, cache_code_size, prot_flags, map_flags, -1, 0));
+				if (cache_code_start_ptr == MAP_FAILED) {
+					E_Exit("DYNCACHE: Failed memory-mapping cache memory because: %s", strerror(errno));
+				}
 			}
 #else
 			cache_code_start_ptr=static_cast<uint8_t *>(malloc(cache_code_size));
@@ -1072,6 +1339,7 @@ static void cache_init(bool enable) {
 }
 
 static void cache_close(void) {
+	demoted_pages.clear();
 /*	for (;;) {
 		if (cache.used_pages) {
 			CodePageHandler * cpage=cache.used_pages;
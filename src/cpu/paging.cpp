@@ -19,10 +19,13 @@
 
 #include "paging.h"
 
+#include <array>
 #include <cassert>
+#include <cinttypes>
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <unordered_set>
 
 #include "mem.h"
 #include "regs.h"
@@ -30,6 +33,7 @@
 #include "cpu.h"
 #include "debug.h"
 #include "setup.h"
+#include "timer.h"
 
 #define LINK_TOTAL		(64*1024)
 
@@ -38,6 +42,8 @@
 
 PagingBlock paging;
 
+static PagingStats paging_stats = {};
+
 uint8_t PageHandler::readb(PhysPt addr)
 {
 	E_Exit("No byte handler for read from %d",addr);	
@@ -177,6 +183,7 @@ void PAGING_PageFault(PhysPt lin_addr,uint32_t page_addr,uint32_t faultcode) {
 	cpudecoder=&PageFaultCore;
 	paging.cr2=lin_addr;
 	PF_Entry * entry=&pf_queue.entries[pf_queue.used++];
+	++paging_stats.num_page_faults;
 	LOG(LOG_PAGING, LOG_NORMAL)("PageFault at %X type [%x] queue %u", lin_addr, faultcode, pf_queue.used);
 	// LOG_MSG("EAX:%04X ECX:%04X EDX:%04X EBX:%04X",reg_eax,reg_ecx,reg_edx,reg_ebx);
 	// LOG_MSG("CS:%04X EIP:%08X SS:%04x SP:%08X",SegValue(cs),reg_eip,SegValue(ss),reg_esp);
@@ -392,6 +399,7 @@ public:
 	}
 	uint32_t InitPage(uint32_t lin_addr, bool writing)
 	{
+		++paging_stats.num_tlb_misses;
 		const auto lin_page = lin_addr >> 12;
 		uint32_t phys_page;
 		if (paging.enabled) {
@@ -509,6 +517,7 @@ public:
 		return 0;
 	}
 	bool InitPageCheckOnly(uint32_t lin_addr,bool writing) {
+		++paging_stats.num_tlb_misses;
 		const auto lin_page=lin_addr >> 12;
 		if (paging.enabled) {
 			X86PageEntry table;
@@ -626,6 +635,7 @@ public:
 		return true;
 	}
 	void InitPage(uint32_t lin_addr, [[maybe_unused]] uint32_t val) {
+		++paging_stats.num_tlb_misses;
 		const auto lin_page=lin_addr >> 12;
 		uint32_t phys_page;
 		if (paging.enabled) {
@@ -668,6 +678,7 @@ public:
 		}
 	}
 	uint32_t InitPageCheckOnly(uint32_t lin_addr, [[maybe_unused]] uint32_t val) {
+		++paging_stats.num_tlb_misses;
 		const auto lin_page=lin_addr >> 12;
 		if (paging.enabled) {
 			if (!USERWRITE_PROHIBITED) return 2;
@@ -808,6 +819,28 @@ void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
 	}
 }
 
+void PAGING_RelinkPhysPages(const uint32_t phys_page, const uint32_t pages)
+{
+	// Entries that were unlinked or linked read-only since have no host
+	// pointer and are left alone
+	for (uint32_t i = 0; i < paging.links.used; ++i) {
+		const auto lin_page = paging.links.entries[i];
+		const auto page     = paging.tlb.phys_page[lin_page];
+		if (page < phys_page || page >= phys_page + pages) {
+			continue;
+		}
+		const auto lin_base = lin_page << 12;
+		if (paging.tlb.read[lin_page]) {
+			const auto handler = paging.tlb.readhandler[lin_page];
+			paging.tlb.read[lin_page] = handler->GetHostReadPt(page) - lin_base;
+		}
+		if (paging.tlb.write[lin_page]) {
+			const auto handler = paging.tlb.writehandler[lin_page];
+			paging.tlb.write[lin_page] = handler->GetHostWritePt(page) - lin_base;
+		}
+	}
+}
+
 void PAGING_MapPage(Bitu lin_page,Bitu phys_page) {
 	if (lin_page<LINK_START) {
 		paging.firstmb[lin_page]=phys_page;
@@ -913,6 +946,27 @@ void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
 	}
 }
 
+void PAGING_RelinkPhysPages(const uint32_t phys_page, const uint32_t pages)
+{
+	// Entries that were unlinked or linked read-only since have no host
+	// pointer and are left alone
+	for (uint32_t i = 0; i < paging.links.used; ++i) {
+		const auto lin_page = paging.links.entries[i];
+		const auto entry    = get_tlb_entry(lin_page << 12);
+		const auto page     = entry->phys_page;
+		if (page < phys_page || page >= phys_page + pages) {
+			continue;
+		}
+		const auto lin_base = lin_page << 12;
+		if (entry->read) {
+			entry->read = entry->readhandler->GetHostReadPt(page) - lin_base;
+		}
+		if (entry->write) {
+			entry->write = entry->writehandler->GetHostWritePt(page) - lin_base;
+		}
+	}
+}
+
 void PAGING_MapPage(Bitu lin_page,Bitu phys_page) {
 	if (lin_page<LINK_START) {
 		paging.firstmb[lin_page]=phys_page;
@@ -975,15 +1029,250 @@ void PAGING_LinkPage_ReadOnly(uint32_t lin_page, uint32_t phys_page)
 #endif
 
 
+// Address-space switching
+// ~~~~~~~~~~~~~~~~~~~~~~~
+// Loading CR3 flushes the TLB, and multitasking guests do that on every task
+// switch, which used to mean rebuilding every translation one TLB miss at a
+// time. Instead, the linked pages of the outgoing address space are saved
+// into a small LRU cache of TLB sets keyed by page directory base, and
+// relinked when that directory gets loaded again.
+//
+// A saved entry records the directory and table entries it was linked from
+// and is only relinked if both are unchanged, so page table writes made in
+// the meantime (including right before the CR3 reload meant to flush them)
+// invalidate it. Only user-accessible pages whose accessed and dirty bits
+// are already set are kept, so relinking never skips a privilege check,
+// page fault or A/D update that a fresh walk would have done. Global pages
+// (with CR4.PGE set) survive the switch outright, as on real hardware.
+
+struct TlbSetEntry {
+	uint32_t lin_page  = 0;
+	uint32_t phys_page = 0;
+	uint32_t dir_entry = 0;
+	uint32_t table_entry = 0;
+	bool is_read_only  = false;
+};
+
+struct TlbSet {
+	uint32_t dir_base_page = 0;
+	uint32_t last_used     = 0;
+	std::vector<TlbSetEntry> entries = {};
+};
+
+constexpr size_t NumTlbSets = 8;
+
+// Bounds the work of saving and restoring a set on every switch
+constexpr size_t MaxTlbSetEntries = 4096;
+
+static struct {
+	std::array<TlbSet, NumTlbSets> sets = {};
+	uint32_t use_counter = 0;
+
+	bool global_pages_enabled = false;
+	std::vector<TlbSetEntry> global_entries = {};
+
+	// Pages already saved by the current save_tlb_set() call
+	std::unordered_set<uint32_t> saved_pages = {};
+
+	int64_t last_report_ms = 0;
+	PagingStats last_report_stats = {};
+} tlb_sets = {};
+
+static void clear_tlb_sets()
+{
+	for (auto& set : tlb_sets.sets) {
+		set.entries.clear();
+		set.last_used = 0;
+	}
+}
+
+static bool is_page_linked(const uint32_t lin_page)
+{
+	const auto lin_addr = lin_page << 12;
+	return get_tlb_readhandler(lin_addr) != &init_page_handler ||
+	       get_tlb_writehandler(lin_addr) != &init_page_handler;
+}
+
+static void relink(const TlbSetEntry& entry)
+{
+	if (entry.is_read_only) {
+		PAGING_LinkPage_ReadOnly(entry.lin_page, entry.phys_page);
+	} else {
+		PAGING_LinkPage(entry.lin_page, entry.phys_page);
+	}
+	++paging_stats.num_pages_restored;
+}
+
+// Walks the page tables of the given directory for the linked page without
+// side effects; returns false if the page isn't mapped there anymore
+static bool read_page_entries(const uint32_t dir_base_page, TlbSetEntry& entry)
+{
+	const auto dir_entry = phys_readd((dir_base_page << 12) +
+	                                  (entry.lin_page >> 10) * 4);
+	X86PageEntry table = {};
+	table.set(dir_entry);
+	if (!table.p) {
+		return false;
+	}
+	entry.dir_entry   = dir_entry;
+	entry.table_entry = phys_readd((table.base << 12) +
+	                               (entry.lin_page & 0x3ff) * 4);
+	return true;
+}
+
+// Saves the currently linked pages under the outgoing directory and sets
+// the global ones aside
+static void save_tlb_set(const uint32_t dir_base_page)
+{
+	TlbSet* target = &tlb_sets.sets[0];
+	for (auto& set : tlb_sets.sets) {
+		if (set.dir_base_page == dir_base_page || set.last_used == 0) {
+			target = &set;
+			break;
+		}
+		if (set.last_used < target->last_used) {
+			target = &set;
+		}
+	}
+	target->dir_base_page = dir_base_page;
+	target->last_used     = ++tlb_sets.use_counter;
+	target->entries.clear();
+	tlb_sets.global_entries.clear();
+	tlb_sets.saved_pages.clear();
+
+	// The most recently linked pages are at the end of the list
+	const auto num_links = paging.links.used;
+	const auto first     = num_links > MaxTlbSetEntries
+	                             ? num_links - MaxTlbSetEntries
+	                             : 0;
+
+	for (auto i = first; i < num_links; ++i) {
+		TlbSetEntry entry = {};
+		entry.lin_page    = paging.links.entries[i];
+
+		// Skip pages unlinked since, and pages relinked (e.g. after a
+		// write to a read-only link) that already have an entry
+		if (!is_page_linked(entry.lin_page) ||
+		    !tlb_sets.saved_pages.insert(entry.lin_page).second) {
+			continue;
+		}
+		const auto lin_addr = entry.lin_page << 12;
+		entry.phys_page     = PAGING_GetPhysicalPage(lin_addr) >> 12;
+		entry.is_read_only  = (get_tlb_writehandler(lin_addr) ==
+		                      &init_page_handler_userro);
+
+		// The link must still match the tables; if the guest changed
+		// them before this reload it has to see the new mapping
+		if (!read_page_entries(dir_base_page, entry)) {
+			continue;
+		}
+		X86PageEntry table = {};
+		X86PageEntry page  = {};
+		table.set(entry.dir_entry);
+		page.set(entry.table_entry);
+		if (!page.p || page.base != entry.phys_page) {
+			continue;
+		}
+		if (tlb_sets.global_pages_enabled && page.g) {
+			tlb_sets.global_entries.push_back(entry);
+			continue;
+		}
+		const auto is_user_page = table.us && page.us;
+		const auto is_writable  = table.wr && page.wr;
+		const auto is_tracked   = table.a && page.a &&
+		                        (page.d || entry.is_read_only);
+
+		if (is_user_page && is_tracked && (is_writable || entry.is_read_only)) {
+			target->entries.push_back(entry);
+		}
+	}
+}
+
+static void restore_tlb_set(const uint32_t dir_base_page)
+{
+	for (auto& set : tlb_sets.sets) {
+		if (set.last_used == 0 || set.dir_base_page != dir_base_page) {
+			continue;
+		}
+		set.last_used = ++tlb_sets.use_counter;
+
+		for (const auto& saved : set.entries) {
+			auto current = saved;
+			if (read_page_entries(dir_base_page, current) &&
+			    current.dir_entry == saved.dir_entry &&
+			    current.table_entry == saved.table_entry) {
+				relink(saved);
+			}
+		}
+		return;
+	}
+}
+
+static void maybe_report_paging_stats()
+{
+	constexpr int64_t ReportIntervalMs = 1000;
+
+	const auto now = GetTicks();
+	if (now - tlb_sets.last_report_ms < ReportIntervalMs) {
+		return;
+	}
+	const auto& prev = tlb_sets.last_report_stats;
+	LOG(LOG_PAGING, LOG_NORMAL)
+	("TLB misses/s: %" PRIu64 ", page faults/s: %" PRIu64
+	 ", CR3 loads/s: %" PRIu64 ", restored pages/s: %" PRIu64,
+	 paging_stats.num_tlb_misses - prev.num_tlb_misses,
+	 paging_stats.num_page_faults - prev.num_page_faults,
+	 paging_stats.num_dir_base_loads - prev.num_dir_base_loads,
+	 paging_stats.num_pages_restored - prev.num_pages_restored);
+
+	tlb_sets.last_report_ms    = now;
+	tlb_sets.last_report_stats = paging_stats;
+}
+
+static void switch_tlb_set(const uint32_t old_dir_base_page,
+                           const uint32_t new_dir_base_page)
+{
+	++paging_stats.num_dir_base_loads;
+
+	save_tlb_set(old_dir_base_page);
+	PAGING_ClearTLB();
+
+	for (const auto& entry : tlb_sets.global_entries) {
+		relink(entry);
+	}
+	restore_tlb_set(new_dir_base_page);
+
+	maybe_report_paging_stats();
+}
+
+PagingStats PAGING_GetStats()
+{
+	return paging_stats;
+}
+
+void PAGING_SetGlobalPagesEnabled(const bool enabled)
+{
+	if (tlb_sets.global_pages_enabled == enabled) {
+		return;
+	}
+	// Toggling CR4.PGE flushes the global pages as well
+	tlb_sets.global_pages_enabled = enabled;
+	tlb_sets.global_entries.clear();
+	clear_tlb_sets();
+	PAGING_ClearTLB();
+}
+
 void PAGING_SetDirBase(Bitu cr3) {
 	assert(cr3 <= UINT32_MAX);
+	const auto old_dir_base_page = paging.base.page;
+
 	paging.cr3=static_cast<uint32_t>(cr3);
 	
 	paging.base.page=static_cast<uint32_t>(cr3 >> 12);
 	paging.base.addr=static_cast<PhysPt>(cr3 & ~4095);
 //	LOG(LOG_PAGING,LOG_NORMAL)("CR3:%X Base %X",cr3,paging.base.page);
 	if (paging.enabled) {
-		PAGING_ClearTLB();
+		switch_tlb_set(old_dir_base_page, paging.base.page);
 	}
 }
 
@@ -999,6 +1288,9 @@ void PAGING_Enable(bool enabled) {
 			CPU_Cycles=0;
 		}
 //		LOG(LOG_PAGING,LOG_NORMAL)("Enabled");
+		// Nothing linked so far was translated through page tables
+		clear_tlb_sets();
+		PAGING_ClearTLB();
 		PAGING_SetDirBase(paging.cr3);
 	}
 	PAGING_ClearTLB();
@@ -19,6 +19,7 @@
 #include "dos_inc.h"
 
 #include <cstring>
+#include <vector>
 
 #include "../ints/int10.h"
 
@@ -50,8 +51,12 @@ public:
 private:
 	void ClearAnsi();
 	void Output(uint8_t chr);
+	uint16_t WriteTextRun(const uint8_t* data, const uint16_t size);
 
 	uint8_t readcache = 0;
+
+	// Host copy of the text page while WriteTextRun() scrolls it
+	std::vector<uint8_t> text_page = {};
 	struct ansi {
 		bool esc = false;
 		bool sci = false;
@@ -164,6 +169,11 @@ bool device_CON::Write(uint8_t * data,uint16_t * size) {
 				} while(col%8);
 				count++;
 				continue;
+			} else if (const auto num_written = WriteTextRun(&data[count],
+			                                                 *size - count);
+			           num_written > 0) {
+				count += num_written;
+				continue;
 			} else {
 				Output(data[count]);
 				count++;
@@ -454,3 +464,118 @@ void device_CON::Output(uint8_t chr) {
 		INT10_TeletypeOutputViaInterrupt(chr, 7);
 	}
 }
+
+// Bytes the teletype output draws or treats as a plain cursor movement.
+// Everything else goes through Output() one at a time.
+static bool is_plain_text_char(const uint8_t chr)
+{
+	constexpr uint8_t code_bell      = 0x07;
+	constexpr uint8_t code_backspace = 0x08;
+	constexpr uint8_t code_escape    = 0x1b;
+
+	return chr != code_bell && chr != code_backspace && chr != '\t' &&
+	       chr != code_escape;
+}
+
+// Bulk path of Output() for runs of plain text in text modes: the characters
+// go straight into video memory instead of one INT 10h teletype call each,
+// and the cursor is only updated once at the end. Gives the same result as
+// Output(), including the scroll fill attribute. Returns the number of bytes
+// written, or 0 if the run has to take the per-character path.
+uint16_t device_CON::WriteTextRun(const uint8_t* data, const uint16_t size)
+{
+	// Programs hooking INT 10h must see every character
+	if (CurMode->type != M_TEXT || !INT10_IsBiosHandlerActive()) {
+		return 0;
+	}
+
+	uint16_t run_length = 0;
+	while (run_length < size && is_plain_text_char(data[run_length])) {
+		++run_length;
+	}
+	if (run_length == 0) {
+		return 0;
+	}
+
+	const uint8_t page = real_readb(BIOSMEM_SEG, BIOSMEM_CURRENT_PAGE);
+	BIOS_NCOLS;
+	BIOS_NROWS;
+	int col = CURSOR_POS_COL(page);
+	int row = CURSOR_POS_ROW(page);
+
+	if (page > 7 || ncols == 0 || ncols != CurMode->twidth || col >= ncols ||
+	    row >= nrows) {
+		return 0;
+	}
+
+	const auto use_attribute = dos.internal_output || ansi.enabled;
+
+	const PhysPt base = CurMode->pstart +
+	                    page * real_readw(BIOSMEM_SEG, BIOSMEM_PAGE_SIZE);
+	const auto row_bytes       = ncols * 2;
+	const auto last_row_offset = (nrows - 1) * row_bytes;
+
+	// Characters are written to video memory directly until the first
+	// scroll. From then on the page lives in host memory, so every further
+	// scroll is one memmove, and it gets written back once at the end.
+	auto is_page_in_host = false;
+
+	for (uint16_t i = 0; i < run_length; ++i) {
+		const auto chr      = data[i];
+		const auto prev_col = col;
+
+		if (chr == '\r') {
+			col = 0;
+		} else if (chr == '\n') {
+			++row;
+		} else {
+			const auto offset = (row * ncols + col) * 2;
+			if (is_page_in_host) {
+				text_page[offset] = chr;
+				if (use_attribute) {
+					text_page[offset + 1] = ansi.attr;
+				}
+			} else {
+				mem_writeb(base + offset, chr);
+				if (use_attribute) {
+					mem_writeb(base + offset + 1, ansi.attr);
+				}
+			}
+			if (++col == ncols) {
+				col = 0;
+				++row;
+			}
+		}
+
+		if (row == nrows) {
+			if (!is_page_in_host) {
+				text_page.resize(nrows * row_bytes);
+				MEM_BlockRead(base, text_page.data(), text_page.size());
+				is_page_in_host = true;
+			}
+			// ANSI output fills with its own colour, the teletype
+			// with the attribute under the cursor
+			const uint8_t fill_attr =
+			        use_attribute
+			                ? ansi.attr
+			                : text_page[last_row_offset + prev_col * 2 + 1];
+
+			std::memmove(text_page.data(),
+			             text_page.data() + row_bytes,
+			             last_row_offset);
+
+			for (auto x = 0; x < ncols; ++x) {
+				text_page[last_row_offset + x * 2]     = ' ';
+				text_page[last_row_offset + x * 2 + 1] = fill_attr;
+			}
+			row = nrows - 1;
+		}
+	}
+
+	if (is_page_in_host) {
+		MEM_BlockWrite(base, text_page.data(), text_page.size());
+	}
+	INT10_SetCursorPos(check_cast<uint8_t>(row), check_cast<uint8_t>(col), page);
+
+	return run_length;
+}
@@ -22,6 +22,7 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "auto_core.h"
 #include "callback.h"
 #include "cpu.h"
 #include "debug.h"
@@ -81,6 +82,7 @@ void DOS_UpdatePSPName(void) {
 	}
 	RunningProgram = name;
 	GFX_RefreshTitle();
+	AUTOCORE_SetProgram(dos.psp());
 }
 
 void DOS_Terminate(uint16_t pspseg,bool tsr,uint8_t exitcode) {
@@ -122,7 +124,10 @@ void DOS_Terminate(uint16_t pspseg,bool tsr,uint8_t exitcode) {
 	   interrupts enabled, test flags cleared */
 	real_writew(SegValue(ss),reg_sp+4,0x7202);
 	// Free memory owned by process
-	if (!tsr) DOS_FreeProcessMemory(pspseg);
+	if (!tsr) {
+		DOS_FreeProcessMemory(pspseg);
+		AUTOCORE_RemoveProgram(pspseg);
+	}
 	DOS_UpdatePSPName();
 
 	if ((!(CPU_AutoDetermineMode>>CPU_AUTODETERMINE_SHIFT)) || (cpu.pmode)) return;
@@ -139,7 +144,7 @@ void DOS_Terminate(uint16_t pspseg,bool tsr,uint8_t exitcode) {
 	}
 #if (C_DYNAMIC_X86) || (C_DYNREC)
 	if (CPU_AutoDetermineMode&CPU_AUTODETERMINE_CORE) {
-		cpudecoder=&CPU_Core_Normal_Run;
+		CPU_SwitchDynamicCore(false);
 		CPU_CycleLeft=0;
 		CPU_Cycles=0;
 	}
@@ -264,6 +269,12 @@ bool DOS_Execute(char * name,PhysPt block_pt,uint8_t flags) {
 		DOS_SetError(DOSERR_FILE_NOT_FOUND);
 		return false;
 	}
+	/* The full path and size identify the program for 'core = auto' */
+	char full_name[DOS_PATHLENGTH] = {};
+	if (!DOS_Canonicalize(name,full_name)) full_name[0]=0;
+	uint32_t file_size=0;
+	DOS_SeekFile(fhandle,&file_size,DOS_SEEK_END);
+	pos=0;DOS_SeekFile(fhandle,&pos,DOS_SEEK_SET);
 	len=sizeof(EXE_Header);
 	if (!DOS_ReadFile(fhandle,(uint8_t *)&head,&len)) {
 		DOS_CloseFile(fhandle);
@@ -466,6 +477,11 @@ bool DOS_Execute(char * name,PhysPt block_pt,uint8_t flags) {
 		memset(&stripname[index],0,8-index);
 		DOS_MCB pspmcb(dos.psp()-1);
 		pspmcb.SetFileName(stripname);
+		if (full_name[0]) {
+			AUTOCORE_AddProgram(pspseg,full_name,file_size);
+		} else {
+			AUTOCORE_RemoveProgram(pspseg);
+		}
 		DOS_UpdatePSPName();
 	}
 
@@ -495,6 +495,26 @@ bool DOS_WriteFile(uint16_t entry,uint8_t * data,uint16_t * amount,bool fcb) {
 	return ret;
 }
 
+// Copies the rest of the source file into the target at its current position
+// on the host, if both are host files. Returns false if that wasn't possible
+// or stopped early; the positions of both files then reflect what was copied
+// so far, so the caller can carry on with DOS_ReadFile()/DOS_WriteFile().
+bool DOS_CopyFileOnHost(const uint16_t source_entry, const uint16_t target_entry)
+{
+	const auto source_handle = RealHandle(source_entry);
+	const auto target_handle = RealHandle(target_entry);
+	if (source_handle >= DOS_FILES || target_handle >= DOS_FILES) {
+		return false;
+	}
+	auto source = dynamic_cast<localFile*>(Files[source_handle]);
+	auto target = dynamic_cast<localFile*>(Files[target_handle]);
+	if (!source || !target || source == target || !source->IsOpen() ||
+	    !target->IsOpen()) {
+		return false;
+	}
+	return target->CopyFrom(*source);
+}
+
 bool DOS_SeekFile(uint16_t entry,uint32_t * pos,uint32_t type,bool fcb) {
 	uint32_t handle = fcb?entry:RealHandle(entry);
 	if (handle>=DOS_FILES) {
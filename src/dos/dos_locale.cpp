@@ -3493,6 +3493,12 @@ void DOS_Locale_ShutDown(Section*)
 	Locale.reset();
 }
 
+void DOS_Locale_Prepare(Section*)
+{
+	// Parsing the code page mappings doesn't depend on the emulated machine
+	load_unicode_mappings();
+}
+
 void DOS_Locale_Init(Section* sec)
 {
 	assert(sec);
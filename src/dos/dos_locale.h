@@ -49,6 +49,7 @@ std::string DOS_GetLayoutFromHost();
 
 // Lifecycle
 
+void DOS_Locale_Prepare(Section* sec);
 void DOS_Locale_Init(Section* sec);
 
 // We need a separate function to support '--list-countries' command line switch
@@ -32,6 +32,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <vector>
+
+#if defined(HAVE_COPY_FILE_RANGE)
+#include <unistd.h>
+#endif
+#if defined(HAVE_SENDFILE)
+#include <sys/sendfile.h>
+#endif
 
 #ifdef _MSC_VER
 #include <sys/utime.h>
@@ -869,6 +877,141 @@ bool localFile::Close()
 	return result;
 }
 
+// Copies up to 'num_bytes' between the two host files at the given offsets
+// inside the kernel where possible. Neither file's offset is relied upon.
+// Returns the number of bytes copied, which is short if the kernel can't do
+// the copy (e.g. across filesystems on older kernels) or on errors.
+static int64_t copy_in_kernel([[maybe_unused]] const int in_fd,
+                              [[maybe_unused]] const int64_t in_pos,
+                              [[maybe_unused]] const int out_fd,
+                              [[maybe_unused]] const int64_t out_pos,
+                              [[maybe_unused]] const int64_t num_bytes)
+{
+	int64_t num_copied = 0;
+
+#if defined(HAVE_COPY_FILE_RANGE)
+	while (num_copied < num_bytes) {
+		off_t in_off  = in_pos + num_copied;
+		off_t out_off = out_pos + num_copied;
+
+		const auto result = copy_file_range(
+		        in_fd, &in_off, out_fd, &out_off, num_bytes - num_copied, 0);
+		if (result <= 0) {
+			break;
+		}
+		num_copied += result;
+	}
+#endif
+
+#if defined(HAVE_SENDFILE)
+	// Writes at the output's file offset, so position it first
+	if (num_copied < num_bytes &&
+	    lseek(out_fd, out_pos + num_copied, SEEK_SET) >= 0) {
+		while (num_copied < num_bytes) {
+			off_t in_off = in_pos + num_copied;
+
+			const auto result = sendfile(out_fd,
+			                             in_fd,
+			                             &in_off,
+			                             num_bytes - num_copied);
+			if (result <= 0) {
+				break;
+			}
+			num_copied += result;
+		}
+	}
+#endif
+
+	return num_copied;
+}
+
+// Copies everything from the source's position to its end into this file at
+// this file's position, entirely on the host. Both positions advance by the
+// amount copied. Returns false if not everything could be copied.
+bool localFile::CopyFrom(localFile& source)
+{
+	const auto source_mode = source.flags & 0xf;
+	const auto target_mode = flags & 0xf;
+	if (source_mode == OPEN_WRITE || target_mode == OPEN_READ ||
+	    target_mode == OPEN_READ_NO_MOD) {
+		DOS_SetError(DOSERR_ACCESS_DENIED);
+		return false;
+	}
+	// Overlay files switch to their overlay copy here
+	if (!PrepareForWrite()) {
+		return false;
+	}
+	if (!source.fhandle || !fhandle) {
+		return false;
+	}
+
+	// Hand over any buffered data, then work with plain file offsets
+	fflush(fhandle);
+	const auto in_fd  = cross_fileno(source.fhandle);
+	const auto out_fd = cross_fileno(fhandle);
+	if (in_fd == -1 || out_fd == -1 || !source.ftell_and_check() ||
+	    !ftell_and_check()) {
+		return false;
+	}
+
+	struct stat source_stat;
+	if (fstat(in_fd, &source_stat) == -1) {
+		return false;
+	}
+	const int64_t num_bytes = source_stat.st_size - source.stream_pos;
+
+	const auto num_copied = num_bytes > 0 ? copy_in_kernel(in_fd,
+	                                                       source.stream_pos,
+	                                                       out_fd,
+	                                                       stream_pos,
+	                                                       num_bytes)
+	                                      : 0;
+
+	// Re-sync the streams with where the copy got to
+	set_archive_on_close = true;
+	last_action          = LastAction::None;
+	source.last_action   = LastAction::None;
+
+	if (!source.fseek_to_and_check(source.stream_pos + num_copied, SEEK_SET) ||
+	    !fseek_to_and_check(stream_pos + num_copied, SEEK_SET)) {
+		return false;
+	}
+
+	// Copy whatever the kernel couldn't through a large buffer
+	constexpr size_t BufferSize = 1024 * 1024;
+	std::vector<uint8_t> buffer = {};
+
+	for (auto remaining = num_bytes - num_copied; remaining > 0;) {
+		if (buffer.empty()) {
+			buffer.resize(BufferSize);
+		}
+		const auto chunk = static_cast<size_t>(
+		        std::min(remaining, static_cast<int64_t>(BufferSize)));
+
+		const auto num_read = fread(buffer.data(), 1, chunk, source.fhandle);
+		const auto num_written = fwrite(buffer.data(), 1, num_read, fhandle);
+
+		source.stream_pos += static_cast<long>(num_read);
+		stream_pos += static_cast<long>(num_written);
+
+		if (num_read != chunk || num_written != num_read) {
+			clearerr(source.fhandle);
+			clearerr(fhandle);
+			static_cast<void>(source.ftell_and_check());
+			static_cast<void>(ftell_and_check());
+			last_action        = LastAction::Write;
+			source.last_action = LastAction::Read;
+			return false;
+		}
+		remaining -= static_cast<int64_t>(chunk);
+	}
+	if (!buffer.empty()) {
+		last_action        = LastAction::Write;
+		source.last_action = LastAction::Read;
+	}
+	return true;
+}
+
 uint16_t localFile::GetInformation(void)
 {
 	return read_only_medium ? 0x40 : 0;
@@ -217,12 +217,14 @@ public:
 	}
 
 	bool Write(uint8_t * data,uint16_t * size) override {
+		if (logoverlay && !overlay_active && *data == 0) LOG_MSG("OPTIMISE: truncate on switch!!!!");
+		if (!PrepareForWrite()) return false;
+		return localFile::Write(data,size);
+	}
+	bool PrepareForWrite() override {
 		uint32_t f = flags&0xf;
 		if (!overlay_active && (f == OPEN_READWRITE || f == OPEN_WRITE)) {
 			if (logoverlay) LOG_MSG("write detected, switching file for %s",GetName());
-			if (*data == 0) {
-				if (logoverlay) LOG_MSG("OPTIMISE: truncate on switch!!!!");
-			}
 			const auto a = logoverlay ? GetTicks() : 0;
 			bool r = create_copy();
 			const auto b = logoverlay ? GetTicksSince(a) : 0;
@@ -233,7 +235,7 @@ public:
 			overlay_active = true;
 			
 		}
-		return localFile::Write(data,size);
+		return true;
 	}
 	bool create_copy();
 //private:
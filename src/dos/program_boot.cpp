@@ -24,6 +24,7 @@
 #include <limits>
 #include <stdio.h>
 
+#include "auto_core.h"
 #include "bios_disk.h"
 #include "callback.h"
 #include "control.h"
@@ -531,6 +532,7 @@ void BOOT::NotifyBooting()
 {
 	MOUSE_NotifyBooting();
 	VIRTUALBOX_NotifyBooting();
+	AUTOCORE_NotifyBooting();
 }
 
 void BOOT::AddMessages()
@@ -0,0 +1,104 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "program_stats.h"
+
+#include <cinttypes>
+
+#include "perf_counters.h"
+#include "program_more_output.h"
+
+void STATS::Run(void)
+{
+	if (HelpRequested()) {
+		MoreOutputStrings output(*this);
+		output.AddString(MSG_Get("PROGRAM_STATS_HELP_LONG"));
+		output.Display();
+		return;
+	}
+	if (!PERF_IsEnabled()) {
+		WriteOut(MSG_Get("PROGRAM_STATS_DISABLED"));
+		return;
+	}
+	if (cmd->FindExist("/reset", false)) {
+		PERF_Reset();
+		WriteOut(MSG_Get("PROGRAM_STATS_RESET"));
+		return;
+	}
+
+	const auto samples = PERF_GetSamples();
+	const auto seconds = static_cast<double>(PERF_GetSampledMs()) / 1000.0;
+
+	if (samples.empty()) {
+		WriteOut(MSG_Get("PROGRAM_STATS_NONE"));
+		return;
+	}
+
+	MoreOutputStrings output(*this);
+	output.AddString(MSG_Get("PROGRAM_STATS_HEADER"), seconds);
+	output.AddString("\n");
+	output.AddString(MSG_Get("PROGRAM_STATS_COLUMNS"));
+
+	for (const auto& sample : samples) {
+		const auto per_second = seconds > 0.0
+		                              ? static_cast<double>(sample.value) / seconds
+		                              : 0.0;
+		output.AddString("%-34s %20" PRIu64 " %15.1f\n",
+		                 sample.name.c_str(),
+		                 sample.value,
+		                 per_second);
+	}
+	output.Display();
+}
+
+void STATS::AddMessages()
+{
+	MSG_Add("PROGRAM_STATS_HELP_LONG",
+	        "Display the performance counters of the emulator.\n"
+	        "\n"
+	        "Usage:\n"
+	        "  [color=light-green]stats[reset]\n"
+	        "  [color=light-green]stats[reset] /reset\n"
+	        "\n"
+	        "Parameters:\n"
+	        "  /reset  start counting again from zero\n"
+	        "\n"
+	        "Notes:\n"
+	        "  - The counters show where the emulation time goes, such as the emulated\n"
+	        "    CPU cycles per core type, I/O port accesses, mixed audio frames per\n"
+	        "    channel, and drawn, rendered, and presented video lines and frames.\n"
+	        "  - The counters need to be enabled first with the [color=light-cyan]perf_counters[reset]\n"
+	        "    setting in the [color=white][dosbox][reset] section.\n"
+	        "\n"
+	        "Examples:\n"
+	        "  [color=light-green]stats[reset]\n"
+	        "  [color=light-green]stats[reset] /reset\n");
+
+	MSG_Add("PROGRAM_STATS_DISABLED",
+	        "The performance counters are disabled; enable them with the\n"
+	        "'perf_counters' setting in the [dosbox] section, for example by running\n"
+	        "'config -set perf_counters=on'.\n");
+
+	MSG_Add("PROGRAM_STATS_RESET", "The performance counters have been reset.\n");
+	MSG_Add("PROGRAM_STATS_NONE", "Nothing has been counted yet.\n");
+	MSG_Add("PROGRAM_STATS_HEADER", "Performance counters over the last %.1f seconds:\n");
+	MSG_Add("PROGRAM_STATS_COLUMNS",
+	        "[color=white]Counter                                           Total      Per second[reset]\n");
+}
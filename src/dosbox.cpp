@@ -30,6 +30,8 @@
 #include <thread>
 #include <unistd.h>
 
+#include "auto_core.h"
+#include "benchmark.h"
 #include "callback.h"
 #include "capture/capture.h"
 #include "control.h"
@@ -48,6 +50,7 @@
 #include "mouse.h"
 #include "ne2000.h"
 #include "pci_bus.h"
+#include "perf_counters.h"
 #include "pic.h"
 #include "programs.h"
 #include "reelmagic.h"
@@ -133,17 +136,97 @@ int64_t ticksScheduled;
 bool ticksLocked;
 void increaseticks();
 
+// Fast-forward state, toggled by the speedlock hotkey. Measures how many
+// times faster than real-time the emulation is running.
+static struct {
+	bool is_active           = false;
+	int64_t emulated_ms      = 0;
+	int64_t measure_start_us = 0;
+} fast_forward = {};
+
+bool DOSBOX_IsFastForwarding()
+{
+	return fast_forward.is_active;
+}
+
+static void update_fast_forward_speed(const int64_t emulated_ms)
+{
+	constexpr auto MeasurePeriodUs = 1'000'000;
+
+	fast_forward.emulated_ms += emulated_ms;
+
+	const auto elapsed_us = GetTicksUsSince(fast_forward.measure_start_us);
+	if (elapsed_us < MeasurePeriodUs) {
+		return;
+	}
+
+	const auto speed = static_cast<double>(fast_forward.emulated_ms) * 1000.0 /
+	                   static_cast<double>(elapsed_us);
+	GFX_SetFastForwardSpeed(speed);
+
+	fast_forward.emulated_ms      = 0;
+	fast_forward.measure_start_us = GetTicksUs();
+}
+
 bool mono_cga=false;
 
 void Null_Init([[maybe_unused]] Section *sec) {
 	// do nothing
 }
 
+// Emulated CPU cycles executed by each type of core
+static PerfCounter cycles_normal("cpu.cycles.normal");
+static PerfCounter cycles_simple("cpu.cycles.simple");
+static PerfCounter cycles_full("cpu.cycles.full");
+static PerfCounter cycles_prefetch("cpu.cycles.prefetch");
+static PerfCounter cycles_dynamic("cpu.cycles.dynamic");
+static PerfCounter cycles_other("cpu.cycles.other");
+
+static PerfCounter& get_cycles_counter(const CPU_Decoder* decoder)
+{
+	if (decoder == &CPU_Core_Normal_Run) {
+		return cycles_normal;
+	}
+	if (decoder == &CPU_Core_Simple_Run) {
+		return cycles_simple;
+	}
+	if (decoder == &CPU_Core_Full_Run) {
+		return cycles_full;
+	}
+	if (decoder == &CPU_Core_Prefetch_Run) {
+		return cycles_prefetch;
+	}
+#if (C_DYNAMIC_X86)
+	if (decoder == &CPU_Core_Dyn_X86_Run) {
+		return cycles_dynamic;
+	}
+#elif (C_DYNREC)
+	if (decoder == &CPU_Core_Dynrec_Run) {
+		return cycles_dynamic;
+	}
+#endif
+	// Trap, halt, and page fault handling
+	return cycles_other;
+}
+
+static Bits run_cpu_decoder_counted()
+{
+	auto& counter = get_cycles_counter(cpudecoder);
+
+	const auto cycles_before = CPU_Cycles;
+	const auto ret = (*cpudecoder)();
+	if (CPU_Cycles < cycles_before) {
+		counter.Add(static_cast<uint64_t>(cycles_before - CPU_Cycles));
+	}
+	return ret;
+}
+
 static Bitu Normal_Loop() {
 	Bits ret;
 	while (1) {
 		if (PIC_RunQueue()) {
-			ret = (*cpudecoder)();
+			ret = PERF_IsEnabled() ? run_cpu_decoder_counted()
+			                       : (*cpudecoder)();
 			if (GCC_UNLIKELY(ret<0)) return 1;
 			if (ret>0) {
 				if (GCC_UNLIKELY(ret >= CB_MAX)) return 0;
@@ -168,6 +251,9 @@ void increaseticks() { //Make it return ticksRemain and set it in the function a
 	ZoneScoped;
 	if (GCC_UNLIKELY(ticksLocked)) { // For Fast Forward Mode
 		ticksRemain=5;
+		if (fast_forward.is_active) {
+			update_fast_forward_speed(ticksRemain);
+		}
 		/* Reset any auto cycle guessing for this frame */
 		ticksLast = GetTicks();
 		ticksAdded = 0;
@@ -191,6 +277,7 @@ void increaseticks() { //Make it return ticksRemain and set it in the function a
 		const auto timeslept = GetTicksUsSince(ticksNewUs);
 
 		cumulativeTimeSlept += timeslept;
+		autocore_samples.host_idle_us += timeslept;
 
 		// Update ticksDone with the total time spent sleeping
 		if (cumulativeTimeSlept >= 1000) {
@@ -328,6 +415,12 @@ static void DOSBOX_UnlockSpeed( bool pressed ) {
 	if (pressed) {
 		LOG_MSG("Fast Forward ON");
 		ticksLocked = true;
+
+		fast_forward.is_active        = true;
+		fast_forward.emulated_ms      = 0;
+		fast_forward.measure_start_us = GetTicksUs();
+		MIXER_SetFastForward(true);
+
 		if (CPU_CycleAutoAdjust) {
 			autoadjust = true;
 			CPU_CycleAutoAdjust = false;
@@ -337,6 +430,11 @@ static void DOSBOX_UnlockSpeed( bool pressed ) {
 	} else {
 		LOG_MSG("Fast Forward OFF");
 		ticksLocked = false;
+
+		fast_forward.is_active = false;
+		MIXER_SetFastForward(false);
+		GFX_SetFastForwardSpeed(0.0);
+
 		if (autoadjust) {
 			autoadjust = false;
 			CPU_CycleAutoAdjust = true;
@@ -395,7 +493,9 @@ static void DOSBOX_RealInit(Section* sec)
 	/* Initialize some dosbox internals */
 	ticksRemain = 0;
 	ticksLast   = GetTicks();
-	ticksLocked = false;
+
+	// Benchmark runs are never paced against the host's clock
+	ticksLocked = BENCHMARK_IsEnabled();
 	DOSBOX_SetLoop(&Normal_Loop);
 
 	MAPPER_AddHandler(DOSBOX_UnlockSpeed, SDL_SCANCODE_F12, MMOD2, "speedlock", "Speedlock");
@@ -578,6 +678,22 @@ void DOSBOX_Init()
 	pbool = secprop->Add_bool("vga_8dot_font", only_at_start, false);
 	pbool->Set_help("Use 8-pixel-wide fonts on VGA adapters (disabled by default).");
 
+	pbool = secprop->Add_bool("vga_full_playfield", only_at_start, false);
+	pbool->Set_help(
+	        "Render the entire height of video memory instead of only the visible part of\n"
+	        "the screen in 256-colour and 16-colour VGA modes (disabled by default).\n"
+	        "Useful for pinball and other games that scroll a playfield taller than the\n"
+	        "screen, so the whole playfield can be displayed on a rotated or tall monitor\n"
+	        "(see the 'rotation' setting). Only lines whose video memory has changed are\n"
+	        "redrawn.");
+
+	pbool = secprop->Add_bool("vga_render_skip", only_at_start, true);
+	pbool->Set_help(
+	        "Skip drawing frames and lines whose video memory hasn't changed in the\n"
+	        "256-colour and 16-colour VGA modes (enabled by default). Lowers the host CPU\n"
+	        "load of mostly static screens; disable it if you notice parts of the screen\n"
+	        "not updating.");
+
 	pbool = secprop->Add_bool("speed_mods", only_at_start, true);
 	pbool->Set_help(
 	        "Permit changes known to improve performance (enabled by default).\n"
@@ -589,6 +705,18 @@ void DOSBOX_Init()
 	secprop->AddInitFunction(&PIC_Init);
 	secprop->AddInitFunction(&PROGRAMS_Init);
 	secprop->AddInitFunction(&TIMER_Init);
+	secprop->AddInitFunction(&PERF_Init, changeable_at_runtime);
+	pstring = secprop->Add_string("perf_counters", when_idle, "off");
+	pstring->Set_help(
+	        "Count where the emulation time goes ('off' by default). Possible values:\n"
+	        "  off:     Disable the performance counters (default).\n"
+	        "  on:      Enable the counters; show them with the STATS command.\n"
+	        "  <file>:  Enable the counters and also write them to the given file every\n"
+	        "           second, as JSON Lines if it ends with '.json' or as CSV otherwise.\n"
+	        "The counters include the emulated CPU cycles per core type, dynamic core\n"
+	        "translations, PIC events, I/O port accesses, mixed audio frames per channel,\n"
+	        "drawn and skipped VGA lines, and rendered, skipped and presented frames.");
+
 	secprop->AddInitFunction(&CMOS_Init);
 
 	const char *autoexec_section_choices[] = {
@@ -666,6 +794,12 @@ void DOSBOX_Init()
 	pstring->Set_help("CPU core used in emulation ('auto' by default). 'auto' will switch to dynamic\n"
 	                  "if available and appropriate.");
 
+	pbool = secprop->Add_bool("auto_core_profiles", when_idle, true);
+	pbool->Set_help(
+	        "Remember per program which core 'core = auto' settled on (enabled by default).\n"
+	        "The choices are stored in 'core_profiles.conf' in the config directory, so\n"
+	        "the next launch starts on the right core.");
+
 	const char* cputype_values[] = { "auto", "386", "386_slow", "486_slow", "pentium_slow", "386_prefetch", nullptr};
 	pstring = secprop->Add_string("cputype", always, "auto");
 	pstring->Set_values(cputype_values);
@@ -1160,6 +1294,7 @@ void DOSBOX_Init()
 
 	// DOS locale settings
 
+	secprop->AddPrepareFunction(&DOS_Locale_Prepare);
 	secprop->AddInitFunction(&DOS_Locale_Init, changeable_at_runtime);
 	pstring = secprop->Add_string("locale_period", when_idle, "modern");
 	pstring->Set_help(
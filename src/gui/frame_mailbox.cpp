@@ -0,0 +1,148 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "frame_mailbox.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+void FrameMailbox::Resize(const int new_pitch, const int new_height)
+{
+	assert(new_pitch >= 0 && new_height >= 0);
+
+	pitch  = new_pitch;
+	height = new_height;
+
+	const auto num_bytes = static_cast<size_t>(pitch) * height;
+	const auto num_rows  = static_cast<size_t>(height);
+
+	for (auto& buffer : buffers) {
+		buffer.assign(num_bytes, 0);
+	}
+	for (auto& rows : stale_rows) {
+		rows.assign(num_rows, 0);
+	}
+	published_rows.assign(num_rows, 0);
+	latest = -1;
+
+	const std::lock_guard<std::mutex> lock(mutex);
+	pending_rows.assign(num_rows, 0);
+	back          = 0;
+	ready         = 1;
+	front         = 2;
+	has_new_frame = false;
+}
+
+uint8_t* FrameMailbox::AcquireBackBuffer()
+{
+	// Only the producer changes which buffer is the back buffer and it's
+	// never the latest one, which the consumer may be reading concurrently
+	auto& buffer = buffers[back];
+	auto& rows   = stale_rows[back];
+
+	if (latest >= 0) {
+		assert(latest != back);
+		const auto& source = buffers[latest];
+
+		for (auto y = 0; y < height; ++y) {
+			if (rows[y]) {
+				const auto offset = static_cast<size_t>(y) * pitch;
+				std::memcpy(&buffer[offset], &source[offset], pitch);
+			}
+		}
+	}
+	std::fill(rows.begin(), rows.end(), 0);
+
+	return buffer.data();
+}
+
+void FrameMailbox::Publish(const uint16_t* changed_lines)
+{
+	assert(changed_lines);
+
+	std::fill(published_rows.begin(), published_rows.end(), 0);
+
+	int y      = 0;
+	size_t idx = 0;
+	while (y < height) {
+		const int num_lines = changed_lines[idx];
+		if (idx & 1) {
+			const auto last = std::min(y + num_lines, height);
+			std::fill(published_rows.begin() + y,
+			          published_rows.begin() + last,
+			          1);
+		}
+		y += num_lines;
+		++idx;
+	}
+
+	for (auto i = 0; i < NumBuffers; ++i) {
+		if (i == back) {
+			continue;
+		}
+		auto& rows = stale_rows[i];
+		for (auto row = 0; row < height; ++row) {
+			rows[row] |= published_rows[row];
+		}
+	}
+
+	const std::lock_guard<std::mutex> lock(mutex);
+	for (auto row = 0; row < height; ++row) {
+		pending_rows[row] |= published_rows[row];
+	}
+	if (has_new_frame) {
+		++num_dropped;
+	}
+	has_new_frame = true;
+	++num_published;
+
+	std::swap(back, ready);
+	latest = ready;
+}
+
+const uint8_t* FrameMailbox::TakeFrame(std::vector<uint8_t>& changed_rows)
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	if (!has_new_frame) {
+		return nullptr;
+	}
+	has_new_frame = false;
+	std::swap(ready, front);
+
+	changed_rows.swap(pending_rows);
+	pending_rows.resize(static_cast<size_t>(height));
+	std::fill(pending_rows.begin(), pending_rows.end(), 0);
+
+	return buffers[front].data();
+}
+
+uint32_t FrameMailbox::GetNumPublished() const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return num_published;
+}
+
+uint32_t FrameMailbox::GetNumDropped() const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return num_dropped;
+}
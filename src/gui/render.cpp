@@ -19,23 +19,29 @@
 
 #include "dosbox.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include "../capture/capture.h"
+#include "benchmark.h"
 #include "control.h"
 #include "fraction.h"
 #include "mapper.h"
 #include "math_utils.h"
+#include "perf_counters.h"
 #include "render.h"
+#include "render_rotation.h"
 #include "setup.h"
 #include "shader_manager.h"
 #include "shell.h"
 #include "string_utils.h"
 #include "support.h"
+#include "timer.h"
 #include "vga.h"
 #include "video.h"
 
@@ -67,6 +73,131 @@ uint8_t get_bits_per_pixel(const PixelFormat pf)
 
 static void render_callback(GFX_CallBackFunctions_t function);
 
+// When the output is rotated, the scalers draw into an unrotated intermediate
+// buffer and the changed line bands get rotated into the real output surface
+// at the end of the frame.
+static struct {
+	Rotation rotation = Rotation::Deg0;
+
+	// Unrotated scaler output
+	std::vector<uint8_t> buffer = {};
+	int buffer_pitch            = 0;
+	int width_px                = 0;
+	int height_px               = 0;
+	uint8_t bytes_per_pixel     = 0;
+
+	// The rendering backend's surface, as returned by GFX_StartUpdate()
+	uint8_t* out_write = nullptr;
+	int out_pitch      = 0;
+
+	// Changed lines of the rotated output in the Scaler_ChangedLines format
+	std::vector<uint16_t> changed_lines = {};
+} rotation_stage = {};
+
+// Adaptive frameskip: frames that wouldn't be presented, or that can't be
+// afforded because the emulation has fallen behind the wall clock, are
+// skipped before any line conversion, scaling or change detection happens.
+// The VGA keeps running its retrace timing as usual, and the change
+// detection of the next rendered frame picks up everything that changed in
+// the meantime because the scaler cache isn't touched by skipped frames.
+static struct {
+	// Maximum number of consecutively skipped frames; 0 disables skipping
+	int max_consecutive = 0;
+	int num_consecutive = 0;
+
+	int64_t last_frame_start_us = 0;
+
+	// Smoothed wall-clock interval between emulated frames. A single slow
+	// interval barely moves it, so only a lag that persists over several
+	// frames gets frames skipped as "behind".
+	int64_t avg_frame_interval_us = 0;
+
+	// While fast-forwarding, only a low-rate preview is rendered; 0 renders
+	// every frame
+	int fast_forward_fps               = 0;
+	int64_t last_fast_forward_frame_us = 0;
+
+	FrameSkipStats stats = {};
+} frameskip = {};
+
+static bool is_rotating()
+{
+	return rotation_stage.rotation != Rotation::Deg0;
+}
+
+static bool start_gfx_update()
+{
+	if (!GFX_StartUpdate(render.scale.outWrite, render.scale.outPitch)) {
+		return false;
+	}
+	if (is_rotating()) {
+		rotation_stage.out_write = render.scale.outWrite;
+		rotation_stage.out_pitch = render.scale.outPitch;
+
+		render.scale.outWrite = rotation_stage.buffer.data();
+		render.scale.outPitch = rotation_stage.buffer_pitch;
+	}
+	return true;
+}
+
+// Rotates the line bands the scalers have marked as changed into the output
+// surface and returns the changed lines of the rotated image.
+static const uint16_t* rotate_changed_lines()
+{
+	auto& rs = rotation_stage;
+
+	rs.changed_lines.clear();
+
+	// Walk the alternating unchanged/changed run lengths
+	int y = 0;
+	for (Bitu i = 0; i <= Scaler_ChangedLineIndex && y < rs.height_px; ++i) {
+		const auto num_lines = std::min(static_cast<int>(Scaler_ChangedLines[i]),
+		                                rs.height_px - y);
+		const auto is_changed = (i & 1) != 0;
+
+		if (is_changed && num_lines > 0) {
+			RENDER_RotateRows(rs.rotation,
+			                  rs.bytes_per_pixel,
+			                  rs.buffer.data(),
+			                  rs.buffer_pitch,
+			                  rs.width_px,
+			                  rs.height_px,
+			                  y,
+			                  num_lines,
+			                  rs.out_write,
+			                  rs.out_pitch);
+		}
+		if (rs.rotation == Rotation::Deg180) {
+			// The bands keep their size but appear in reverse order
+			// from the bottom of the output.
+			rs.changed_lines.push_back(static_cast<uint16_t>(num_lines));
+		} else if (is_changed && num_lines > 0) {
+			// Every changed source row touches a column across the
+			// full output height, so report a single changed band.
+			rs.changed_lines = {0, static_cast<uint16_t>(rs.width_px)};
+		}
+		y += num_lines;
+	}
+
+	if (rs.rotation == Rotation::Deg180) {
+		// Unchanged lines at the bottom of the source become the
+		// leading unchanged run of the output.
+		const auto trailing_lines = static_cast<uint16_t>(rs.height_px - y);
+		if (rs.changed_lines.size() % 2 == 0) {
+			rs.changed_lines.push_back(0);
+		}
+		rs.changed_lines.back() = static_cast<uint16_t>(
+		        rs.changed_lines.back() + trailing_lines);
+
+		std::reverse(rs.changed_lines.begin(), rs.changed_lines.end());
+	}
+	if (rs.changed_lines.empty()) {
+		rs.changed_lines.push_back(static_cast<uint16_t>(
+		        is_rotated_sideways(rs.rotation) ? rs.width_px : rs.height_px));
+	}
+	return rs.changed_lines.data();
+}
+
 static void check_palette(void)
 {
 	// Clean up any previous changed palette data
@@ -143,8 +274,7 @@ static void start_line_handler(const void* s)
 			const auto src_ptr = reinterpret_cast<const uint8_t*>(src);
 			const auto src_val = read_unaligned_size_t(src_ptr);
 			if (GCC_UNLIKELY(src_val != cache[0])) {
-				if (!GFX_StartUpdate(render.scale.outWrite,
-				                     render.scale.outPitch)) {
+				if (!start_gfx_update()) {
 					RENDER_DrawLine = empty_line_handler;
 					return;
 				}
@@ -165,21 +295,6 @@ static void start_line_handler(const void* s)
 	render.scale.outLine++;
 }
 
-static void finish_line_handler(const void* s)
-{
-	if (s) {
-		auto src = static_cast<const uintptr_t*>(s);
-		auto cache = reinterpret_cast<uintptr_t*>(render.scale.cacheRead);
-		for (Bits x = render.src_start; x > 0;) {
-			cache[0] = src[0];
-			x--;
-			src++;
-			cache++;
-		}
-	}
-	render.scale.cacheRead += render.scale.cachePitch;
-}
-
 static void clear_cache_handler(const void* src)
 {
 	Bitu x, width;
@@ -193,6 +308,110 @@ static void clear_cache_handler(const void* src)
 	render.scale.lineHandler(src);
 }
 
+// Captures need the complete image of every frame. The instant replay and
+// benchmark runs don't: the scaler source cache always holds the complete
+// image, so they can read it even when only a few lines have changed.
+static bool is_capturing_frames()
+{
+	return CAPTURE_IsCapturingImage() || CAPTURE_IsCapturingVideo();
+}
+
+static PerfCounter frames_rendered("render.frames_rendered");
+static PerfCounter frames_skipped_not_due("render.frames_skipped_not_due");
+static PerfCounter frames_skipped_behind("render.frames_skipped_behind");
+static PerfCounter frames_skipped_fast_forward(
+        "render.frames_skipped_fast_forward");
+
+static bool should_skip_fast_forward_frame(const int64_t now)
+{
+	const auto preview_period_us = 1'000'000 / frameskip.fast_forward_fps;
+
+	if (now - frameskip.last_fast_forward_frame_us < preview_period_us) {
+		frames_skipped_fast_forward.Add();
+		return true;
+	}
+	frameskip.last_fast_forward_frame_us = now;
+	return false;
+}
+
+// Returns true if the emulated frames have been arriving noticeably slower
+// than the DOS refresh rate for a while, i.e., the host can't keep up
+static bool update_frame_interval(const int64_t interval_us)
+{
+	if (render.fps <= 0.0) {
+		frameskip.avg_frame_interval_us = 0;
+		return false;
+	}
+	const auto frame_period_us = static_cast<int64_t>(1'000'000 / render.fps);
+
+	// Capping each interval keeps one long stall (e.g., a scheduler hiccup
+	// or the burst after the speed lock is released) from dominating
+	const auto capped_interval_us = std::min(interval_us, frame_period_us * 2);
+
+	auto& avg_us = frameskip.avg_frame_interval_us;
+	avg_us += (capped_interval_us - avg_us) / 8;
+
+	return avg_us > frame_period_us * 5 / 4;
+}
+
+static bool should_skip_frame()
+{
+	const auto now = GetTicksUs();
+	const auto interval_us = now - frameskip.last_frame_start_us;
+	frameskip.last_frame_start_us = now;
+
+	const auto is_behind = update_frame_interval(interval_us);
+
+	// Pending cache clears, captures, and benchmark runs need every frame
+	// rendered
+	if (render.scale.clearCache || is_capturing_frames() ||
+	    BENCHMARK_IsEnabled()) {
+		return false;
+	}
+	if (frameskip.fast_forward_fps > 0 && DOSBOX_IsFastForwarding()) {
+		return should_skip_fast_forward_frame(now);
+	}
+	if (frameskip.max_consecutive == 0) {
+		return false;
+	}
+	if (frameskip.num_consecutive >= frameskip.max_consecutive ||
+	    render.fps <= 0.0) {
+		return false;
+	}
+	const auto frame_period_us = static_cast<int64_t>(1'000'000 / render.fps);
+
+	if (!GFX_IsPresentationDue(frame_period_us)) {
+		++frameskip.stats.num_skipped_not_due;
+		frames_skipped_not_due.Add();
+		return true;
+	}
+	// Shed the rendering work while the host can't keep up
+	if (is_behind) {
+		++frameskip.stats.num_skipped_behind;
+		frames_skipped_behind.Add();
+		return true;
+	}
+	return false;
+}
+
+FrameSkipStats RENDER_GetFrameSkipStats()
+{
+	return frameskip.stats;
+}
+
+static void log_frameskip_stats()
+{
+	const auto& stats = frameskip.stats;
+	if (stats.num_skipped_not_due == 0 && stats.num_skipped_behind == 0) {
+		return;
+	}
+	LOG_MSG("RENDER: Rendered %u frames, skipped %u not due for presentation "
+	        "and %u while behind",
+	        stats.num_rendered,
+	        stats.num_skipped_not_due,
+	        stats.num_skipped_behind);
+}
+
 bool RENDER_StartUpdate(void)
 {
 	if (GCC_UNLIKELY(render.updating)) {
@@ -201,12 +420,23 @@ bool RENDER_StartUpdate(void)
 	if (GCC_UNLIKELY(!render.active)) {
 		return false;
 	}
+	if (should_skip_frame()) {
+		++frameskip.num_consecutive;
+		if (CAPTURE_IsRecordingReplay()) {
+			CAPTURE_AddReplayDuplicateFrame(static_cast<float>(render.fps));
+		}
+		return false;
+	}
+	frameskip.num_consecutive = 0;
+	++frameskip.stats.num_rendered;
+	frames_rendered.Add();
+
 	if (render.scale.inMode == scalerMode8) {
 		check_palette();
 	}
 	render.scale.inLine     = 0;
 	render.scale.outLine    = 0;
-	render.scale.cacheRead  = (uint8_t*)&scalerSourceCache;
+	render.scale.cacheRead  = scalerSourceCache.data();
 	render.scale.outWrite   = nullptr;
 	render.scale.outPitch   = 0;
 	Scaler_ChangedLines[0]  = 0;
@@ -219,8 +449,7 @@ bool RENDER_StartUpdate(void)
 
 		// Will always have to update the screen with this one anyway,
 		// so let's update already
-		if (GCC_UNLIKELY(!GFX_StartUpdate(render.scale.outWrite,
-		                                  render.scale.outPitch))) {
+		if (GCC_UNLIKELY(!start_gfx_update())) {
 			return false;
 		}
 		render.fullFrame        = true;
@@ -230,16 +459,14 @@ bool RENDER_StartUpdate(void)
 		if (render.pal.changed) {
 			// Assume pal changes always do a full screen update
 			// anyway
-			if (GCC_UNLIKELY(!GFX_StartUpdate(render.scale.outWrite,
-			                                  render.scale.outPitch))) {
+			if (GCC_UNLIKELY(!start_gfx_update())) {
 				return false;
 			}
 			RENDER_DrawLine  = render.scale.linePalHandler;
 			render.fullFrame = true;
 		} else {
 			RENDER_DrawLine = start_line_handler;
-			if (GCC_UNLIKELY(CAPTURE_IsCapturingImage() ||
-			                 CAPTURE_IsCapturingVideo())) {
+			if (GCC_UNLIKELY(is_capturing_frames())) {
 				render.fullFrame = true;
 			} else {
 				render.fullFrame = false;
@@ -250,6 +477,33 @@ bool RENDER_StartUpdate(void)
 	return true;
 }
 
+// The complete source image of the current frame, as kept in the scaler
+// source cache
+static RenderedImage get_source_image()
+{
+	bool double_width  = false;
+	bool double_height = false;
+	if (render.src.double_width != render.src.double_height) {
+		if (render.src.double_width) {
+			double_width = true;
+		}
+		if (render.src.double_height) {
+			double_height = true;
+		}
+	}
+
+	RenderedImage image = {};
+
+	image.params               = render.src;
+	image.params.double_width  = double_width;
+	image.params.double_height = double_height;
+	image.pitch                = render.scale.cachePitch;
+	image.image_data           = scalerSourceCache.data();
+	image.palette_data         = (uint8_t*)&render.pal.rgb;
+
+	return image;
+}
+
 static void halt_render(void)
 {
 	RENDER_DrawLine = empty_line_handler;
@@ -268,34 +522,35 @@ void RENDER_EndUpdate(bool abort)
 
 	RENDER_DrawLine = empty_line_handler;
 
-	if (GCC_UNLIKELY((CAPTURE_IsCapturingImage() || CAPTURE_IsCapturingVideo()))) {
-		bool double_width  = false;
-		bool double_height = false;
-		if (render.src.double_width != render.src.double_height) {
-			if (render.src.double_width) {
-				double_width = true;
-			}
-			if (render.src.double_height) {
-				double_height = true;
-			}
-		}
-
-		RenderedImage image = {};
+	if (GCC_UNLIKELY(BENCHMARK_IsEnabled()) && !abort) {
+		// Hashed from the cache, so unchanged frames are counted too
+		BENCHMARK_AddFrame(get_source_image());
+	}
 
-		image.params               = render.src;
-		image.params.double_width  = double_width;
-		image.params.double_height = double_height;
-		image.pitch                = render.scale.cachePitch;
-		image.image_data           = (uint8_t*)&scalerSourceCache;
-		image.palette_data         = (uint8_t*)&render.pal.rgb;
+	if (GCC_UNLIKELY(is_capturing_frames())) {
+		const auto frames_per_second = static_cast<float>(render.fps);
 
+		// Also feeds the instant replay
+		CAPTURE_AddFrame(get_source_image(), frames_per_second);
+	} else if (CAPTURE_IsRecordingReplay()) {
 		const auto frames_per_second = static_cast<float>(render.fps);
 
-		CAPTURE_AddFrame(image, frames_per_second);
+		// Without any changed lines the cache holds the previous frame
+		if (render.scale.outWrite && !abort) {
+			CAPTURE_AddReplayFrame(get_source_image(), frames_per_second);
+		} else {
+			CAPTURE_AddReplayDuplicateFrame(frames_per_second);
+		}
 	}
 
 	if (render.scale.outWrite) {
-		GFX_EndUpdate(abort ? nullptr : Scaler_ChangedLines);
+		if (abort) {
+			GFX_EndUpdate(nullptr);
+		} else if (is_rotating()) {
+			GFX_EndUpdate(rotate_changed_lines());
+		} else {
+			GFX_EndUpdate(Scaler_ChangedLines);
+		}
 	} else {
 		// If we made it here, then there's nothing new to render.
 		GFX_EndUpdate(nullptr);
@@ -429,10 +684,28 @@ static void render_reset(void)
 		              get_shader_manager().GetCurrentShaderSource());
 	}
 
-	const auto render_pixel_aspect_ratio = render.src.pixel_aspect_ratio;
+	auto render_pixel_aspect_ratio = render.src.pixel_aspect_ratio;
+
+	// The backend only ever sees the rotated image
+	int output_width_px  = render_width_px;
+	int output_height_px = check_cast<int>(render_height_px);
+
+	if (is_rotated_sideways(rotation_stage.rotation)) {
+		std::swap(output_width_px, output_height_px);
+		render_pixel_aspect_ratio = render_pixel_aspect_ratio.Inverse();
+
+		const auto dbl_flags = gfx_flags & (GFX_DBL_W | GFX_DBL_H);
+		gfx_flags &= ~(GFX_DBL_W | GFX_DBL_H);
+		if (dbl_flags & GFX_DBL_W) {
+			gfx_flags |= GFX_DBL_H;
+		}
+		if (dbl_flags & GFX_DBL_H) {
+			gfx_flags |= GFX_DBL_W;
+		}
+	}
 
-	gfx_flags = GFX_SetSize(render_width_px,
-	                        render_height_px,
+	gfx_flags = GFX_SetSize(output_width_px,
+	                        output_height_px,
 	                        render_pixel_aspect_ratio,
 	                        gfx_flags,
 	                        render.src.video_mode,
@@ -450,6 +723,23 @@ static void render_reset(void)
 		E_Exit("Failed to create a rendering output");
 	}
 
+	if (is_rotating()) {
+		auto& rs = rotation_stage;
+
+		switch (render.scale.outMode) {
+		case scalerMode8: rs.bytes_per_pixel = 1; break;
+		case scalerMode15:
+		case scalerMode16: rs.bytes_per_pixel = 2; break;
+		case scalerMode32: rs.bytes_per_pixel = 4; break;
+		}
+		rs.width_px     = render_width_px;
+		rs.height_px    = check_cast<int>(render_height_px);
+		rs.buffer_pitch = rs.width_px * rs.bytes_per_pixel;
+		rs.buffer.resize(static_cast<size_t>(rs.buffer_pitch * rs.height_px));
+	} else {
+		rotation_stage.buffer = {};
+	}
+
 	const auto lineBlock = gfx_flags & GFX_CAN_RANDOM ? &simpleBlock->Random
 	                                                  : &simpleBlock->Linear;
 	switch (render.src.pixel_format) {
@@ -488,6 +778,16 @@ static void render_reset(void)
 		       static_cast<uint8_t>(render.src.pixel_format));
 	}
 
+	// Only hold as much of the source image as the video mode needs. The
+	// line handlers compare whole machine words, so they can read up to a
+	// line past the last one.
+	const auto cache_bytes = static_cast<size_t>(render.scale.cachePitch) *
+	                                 render.src.height +
+	                         SCALER_MAXWIDTH * sizeof(uint32_t);
+	if (scalerSourceCache.size() != cache_bytes) {
+		scalerSourceCache = std::vector<uint8_t>(cache_bytes);
+	}
+
 	render.scale.blocks    = render.src.width / SCALER_BLOCKSIZE;
 	render.scale.lastBlock = render.src.width % SCALER_BLOCKSIZE;
 	render.scale.inHeight  = render.src.height;
@@ -498,8 +798,10 @@ static void render_reset(void)
 	render.pal.changed = false;
 	memset(render.pal.modified, 0, sizeof(render.pal.modified));
 
-	// Finish this frame using a copy only handler
-	RENDER_DrawLine       = finish_line_handler;
+	// Drop the rest of this frame; the cache might have been reallocated
+	// for the new mode, and it gets fully reinitialised with the next one
+	// anyway
+	RENDER_DrawLine       = empty_line_handler;
 	render.scale.outWrite = nullptr;
 
 	// Signal the next frame to first reinit the cache
@@ -536,6 +838,9 @@ void RENDER_SetSize(const ImageInfo& image_info, const double frames_per_second)
 	render.src = image_info;
 	render.fps = frames_per_second;
 
+	log_frameskip_stats();
+	frameskip.stats = {};
+
 	render_reset();
 }
 
@@ -739,6 +1044,26 @@ AspectRatioCorrectionMode RENDER_GetAspectRatioCorrectionMode()
 	return aspect_ratio_correction_mode;
 }
 
+Rotation RENDER_GetRotation()
+{
+	return rotation_stage.rotation;
+}
+
+static Rotation get_rotation_setting()
+{
+	const std::string rotation = get_render_section()->Get_string("rotation");
+
+	if (rotation == "90") {
+		return Rotation::Deg90;
+	} else if (rotation == "180") {
+		return Rotation::Deg180;
+	} else if (rotation == "270") {
+		return Rotation::Deg270;
+	} else {
+		return Rotation::Deg0;
+	}
+}
+
 static IntegerScalingMode get_integer_scaling_mode_setting()
 {
 	const std::string mode = get_render_section()->Get_string("integer_scaling");
@@ -1021,6 +1346,22 @@ static void init_render_settings(Section_prop& secprop)
 	int_prop->Set_help(
 	        "Consider capping frame rates using the 'host_rate' setting.");
 
+	int_prop = secprop.Add_int("auto_frameskip", always, 2);
+	int_prop->SetMinMax(0, 10);
+	int_prop->Set_help(
+	        "Maximum number of consecutive emulated frames to skip rendering (2 by\n"
+	        "default). Frames are only skipped if they would be dropped by the\n"
+	        "'host_rate' limit, or if the host can't keep up with the emulation over\n"
+	        "several frames. Set to 0 to render every frame. Frames are never skipped\n"
+	        "while capturing.");
+
+	int_prop = secprop.Add_int("fast_forward_fps", always, 10);
+	int_prop->SetMinMax(0, 60);
+	int_prop->Set_help(
+	        "Number of frames per second to render while fast-forwarding (10 by default).\n"
+	        "The emulation runs at full speed, and only a preview of the output is shown.\n"
+	        "Set to 0 to render every frame. Frames are never skipped while capturing.");
+
 	auto* string_prop = secprop.Add_string("aspect", always, "auto");
 	string_prop->Set_help(
 	        "Set the aspect ratio correction mode (enabled by default):\n"
@@ -1147,6 +1488,15 @@ static void init_render_settings(Section_prop& secprop)
 	        "  #000000 #0000aa #00aa00 #00aaaa #aa0000 #aa00aa #aa5500 #aaaaaa\n"
 	        "  #555555 #5555ff #55ff55 #55ffff #ff5555 #ff55ff #ffff55 #ffffff");
 
+	string_prop = secprop.Add_string("rotation", always, "0");
+	string_prop->Set_help(
+	        "Rotate the emulated video output clockwise by the given number of degrees\n"
+	        "(0 by default). Useful for vertically oriented games when playing on a\n"
+	        "rotated monitor. Possible values: 0, 90, 180, 270.");
+
+	const char* rotation_values[] = {"0", "90", "180", "270", nullptr};
+	string_prop->Set_values(rotation_values);
+
 	string_prop = secprop.Add_string("scaler", deprecated, "none");
 	string_prop->Set_help(
 	        "Software scalers are deprecated in favour of hardware-accelerated options:\n"
@@ -1354,6 +1704,7 @@ void RENDER_Init(Section* sec)
 	const auto prev_integer_scaling_mode    = GFX_GetIntegerScalingMode();
 	const auto prev_viewport_settings       = viewport_settings;
 	const auto prev_aspect_ratio_correction_mode = aspect_ratio_correction_mode;
+	const auto prev_rotation = rotation_stage.rotation;
 
 	render.pal.first = 256;
 	render.pal.last  = 0;
@@ -1380,6 +1731,11 @@ void RENDER_Init(Section* sec)
 
 	GFX_SetIntegerScalingMode(get_integer_scaling_mode_setting());
 
+	rotation_stage.rotation = get_rotation_setting();
+
+	frameskip.max_consecutive = section->Get_int("auto_frameskip");
+	frameskip.fast_forward_fps = section->Get_int("fast_forward_fps");
+
 	auto shader_changed = handle_shader_changes();
 
 	setup_scan_and_pixel_doubling();
@@ -1388,6 +1744,7 @@ void RENDER_Init(Section* sec)
 	        ((aspect_ratio_correction_mode != prev_aspect_ratio_correction_mode) ||
 	         (viewport_settings != prev_viewport_settings) ||
 	         (render.scale.size != prev_scale_size) ||
+	         (rotation_stage.rotation != prev_rotation) ||
 	         (GFX_GetIntegerScalingMode() != prev_integer_scaling_mode) ||
 	         shader_changed ||
 	         (prev_force_vga_single_scan != force_vga_single_scan) ||
@@ -0,0 +1,413 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "render_rotation.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Sideways rotations walk the source in square tiles so both the source rows
+// and the destination rows of a tile stay cache-resident; rotating the whole
+// image in one pass would touch a new destination cache line for every
+// source pixel.
+constexpr int TileSize = 32;
+
+template <typename pixel_t>
+static inline const pixel_t* get_row(const uint8_t* image, const int pitch,
+                                     const int y)
+{
+	return reinterpret_cast<const pixel_t*>(image + y * pitch);
+}
+
+template <typename pixel_t>
+static inline pixel_t* get_row(uint8_t* image, const int pitch, const int y)
+{
+	return reinterpret_cast<pixel_t*>(image + y * pitch);
+}
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+
+#if defined(__SSE2__)
+using vec_u32x4_t = __m128i;
+
+static inline vec_u32x4_t load_u32x4(const uint32_t* p)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+static inline void store_u32x4(uint32_t* p, const vec_u32x4_t v)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+static inline vec_u32x4_t reverse_u32x4(const vec_u32x4_t v)
+{
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// Transposes the 4x4 block held in rows a, b, c and d in place, so 'a'
+// becomes the first column, 'b' the second column, and so on.
+static inline void transpose_u32x4x4(vec_u32x4_t& a, vec_u32x4_t& b,
+                                     vec_u32x4_t& c, vec_u32x4_t& d)
+{
+	const auto ab_lo = _mm_unpacklo_epi32(a, b);
+	const auto cd_lo = _mm_unpacklo_epi32(c, d);
+	const auto ab_hi = _mm_unpackhi_epi32(a, b);
+	const auto cd_hi = _mm_unpackhi_epi32(c, d);
+
+	a = _mm_unpacklo_epi64(ab_lo, cd_lo);
+	b = _mm_unpackhi_epi64(ab_lo, cd_lo);
+	c = _mm_unpacklo_epi64(ab_hi, cd_hi);
+	d = _mm_unpackhi_epi64(ab_hi, cd_hi);
+}
+
+#else // __ARM_NEON
+using vec_u32x4_t = uint32x4_t;
+
+static inline vec_u32x4_t load_u32x4(const uint32_t* p)
+{
+	return vld1q_u32(p);
+}
+
+static inline void store_u32x4(uint32_t* p, const vec_u32x4_t v)
+{
+	vst1q_u32(p, v);
+}
+
+static inline vec_u32x4_t reverse_u32x4(const vec_u32x4_t v)
+{
+	const auto pairs_reversed = vrev64q_u32(v);
+	return vcombine_u32(vget_high_u32(pairs_reversed),
+	                    vget_low_u32(pairs_reversed));
+}
+
+static inline void transpose_u32x4x4(vec_u32x4_t& a, vec_u32x4_t& b,
+                                     vec_u32x4_t& c, vec_u32x4_t& d)
+{
+	const auto ab = vtrnq_u32(a, b);
+	const auto cd = vtrnq_u32(c, d);
+
+	a = vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0]));
+	b = vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1]));
+	c = vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0]));
+	d = vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1]));
+}
+#endif
+
+// Rotates the 4x4 block of 32-bit pixels whose top-left corner is at (x, y)
+static inline void rotate_block_u32x4x4(const Rotation rotation,
+                                        const uint8_t* src, const int src_pitch,
+                                        const int width, const int height,
+                                        const int x, const int y,
+                                        uint8_t* dst, const int dst_pitch)
+{
+	auto r0 = load_u32x4(get_row<uint32_t>(src, src_pitch, y + 0) + x);
+	auto r1 = load_u32x4(get_row<uint32_t>(src, src_pitch, y + 1) + x);
+	auto r2 = load_u32x4(get_row<uint32_t>(src, src_pitch, y + 2) + x);
+	auto r3 = load_u32x4(get_row<uint32_t>(src, src_pitch, y + 3) + x);
+
+	if (rotation == Rotation::Deg90) {
+		// Source column x + i becomes destination row x + i, read from
+		// the bottom up.
+		transpose_u32x4x4(r3, r2, r1, r0);
+
+		const auto dst_x = height - 4 - y;
+		store_u32x4(get_row<uint32_t>(dst, dst_pitch, x + 0) + dst_x, r3);
+		store_u32x4(get_row<uint32_t>(dst, dst_pitch, x + 1) + dst_x, r2);
+		store_u32x4(get_row<uint32_t>(dst, dst_pitch, x + 2) + dst_x, r1);
+		store_u32x4(get_row<uint32_t>(dst, dst_pitch, x + 3) + dst_x, r0);
+	} else {
+		assert(rotation == Rotation::Deg270);
+
+		// Source column x + i becomes destination row (width - 1 - x -
+		// i), read from the top down.
+		transpose_u32x4x4(r0, r1, r2, r3);
+
+		const auto dst_y = width - 1 - x;
+		store_u32x4(get_row<uint32_t>(dst, dst_pitch, dst_y - 0) + y, r0);
+		store_u32x4(get_row<uint32_t>(dst, dst_pitch, dst_y - 1) + y, r1);
+		store_u32x4(get_row<uint32_t>(dst, dst_pitch, dst_y - 2) + y, r2);
+		store_u32x4(get_row<uint32_t>(dst, dst_pitch, dst_y - 3) + y, r3);
+	}
+}
+
+#endif
+
+template <typename pixel_t>
+static void rotate_area_sideways_scalar(const Rotation rotation,
+                                        const uint8_t* src, const int src_pitch,
+                                        const int width, const int height,
+                                        const int x_begin, const int x_end,
+                                        const int y_begin, const int y_end,
+                                        uint8_t* dst, const int dst_pitch)
+{
+	for (auto y = y_begin; y < y_end; ++y) {
+		const auto src_row = get_row<pixel_t>(src, src_pitch, y);
+
+		for (auto x = x_begin; x < x_end; ++x) {
+			if (rotation == Rotation::Deg90) {
+				get_row<pixel_t>(dst, dst_pitch, x)[height - 1 - y] =
+				        src_row[x];
+			} else {
+				get_row<pixel_t>(dst, dst_pitch, width - 1 - x)[y] =
+				        src_row[x];
+			}
+		}
+	}
+}
+
+template <typename pixel_t>
+static void rotate_tile_sideways(const Rotation rotation, const uint8_t* src,
+                                 const int src_pitch, const int width,
+                                 const int height, const int x_begin,
+                                 const int x_end, const int y_begin,
+                                 const int y_end, uint8_t* dst,
+                                 const int dst_pitch)
+{
+	auto x_vec_end = x_begin;
+	auto y_vec_end = y_begin;
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+	if constexpr (sizeof(pixel_t) == sizeof(uint32_t)) {
+		x_vec_end = x_begin + ((x_end - x_begin) & ~3);
+		y_vec_end = y_begin + ((y_end - y_begin) & ~3);
+
+		for (auto y = y_begin; y < y_vec_end; y += 4) {
+			for (auto x = x_begin; x < x_vec_end; x += 4) {
+				rotate_block_u32x4x4(rotation,
+				                     src,
+				                     src_pitch,
+				                     width,
+				                     height,
+				                     x,
+				                     y,
+				                     dst,
+				                     dst_pitch);
+			}
+		}
+	}
+#endif
+
+	// Right edge of the vector-processed area, then the bottom edge
+	rotate_area_sideways_scalar<pixel_t>(rotation,
+	                                     src,
+	                                     src_pitch,
+	                                     width,
+	                                     height,
+	                                     x_vec_end,
+	                                     x_end,
+	                                     y_begin,
+	                                     y_end,
+	                                     dst,
+	                                     dst_pitch);
+
+	rotate_area_sideways_scalar<pixel_t>(rotation,
+	                                     src,
+	                                     src_pitch,
+	                                     width,
+	                                     height,
+	                                     x_begin,
+	                                     x_vec_end,
+	                                     y_vec_end,
+	                                     y_end,
+	                                     dst,
+	                                     dst_pitch);
+}
+
+template <typename pixel_t>
+static void rotate_rows_sideways(const Rotation rotation, const uint8_t* src,
+                                 const int src_pitch, const int width,
+                                 const int height, const int first_row,
+                                 const int num_rows, uint8_t* dst,
+                                 const int dst_pitch)
+{
+	const auto last_row = first_row + num_rows;
+
+	for (auto y = first_row; y < last_row; y += TileSize) {
+		const auto y_end = std::min(y + TileSize, last_row);
+
+		for (auto x = 0; x < width; x += TileSize) {
+			const auto x_end = std::min(x + TileSize, width);
+
+			rotate_tile_sideways<pixel_t>(rotation,
+			                              src,
+			                              src_pitch,
+			                              width,
+			                              height,
+			                              x,
+			                              x_end,
+			                              y,
+			                              y_end,
+			                              dst,
+			                              dst_pitch);
+		}
+	}
+}
+
+template <typename pixel_t>
+static void rotate_rows_upside_down(const uint8_t* src, const int src_pitch,
+                                    const int width, const int height,
+                                    const int first_row, const int num_rows,
+                                    uint8_t* dst, const int dst_pitch)
+{
+	for (auto y = first_row; y < first_row + num_rows; ++y) {
+		const auto src_row = get_row<pixel_t>(src, src_pitch, y);
+		const auto dst_row = get_row<pixel_t>(dst, dst_pitch, height - 1 - y);
+
+		auto x = 0;
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+		if constexpr (sizeof(pixel_t) == sizeof(uint32_t)) {
+			for (; x + 4 <= width; x += 4) {
+				const auto pixels = load_u32x4(src_row + x);
+				store_u32x4(dst_row + width - 4 - x,
+				            reverse_u32x4(pixels));
+			}
+		}
+#endif
+		for (; x < width; ++x) {
+			dst_row[width - 1 - x] = src_row[x];
+		}
+	}
+}
+
+template <typename pixel_t>
+static void rotate_rows(const Rotation rotation, const uint8_t* src,
+                        const int src_pitch, const int width, const int height,
+                        const int first_row, const int num_rows, uint8_t* dst,
+                        const int dst_pitch)
+{
+	switch (rotation) {
+	case Rotation::Deg0:
+		for (auto y = first_row; y < first_row + num_rows; ++y) {
+			memcpy(get_row<pixel_t>(dst, dst_pitch, y),
+			       get_row<pixel_t>(src, src_pitch, y),
+			       width * sizeof(pixel_t));
+		}
+		break;
+
+	case Rotation::Deg90:
+	case Rotation::Deg270:
+		rotate_rows_sideways<pixel_t>(rotation,
+		                              src,
+		                              src_pitch,
+		                              width,
+		                              height,
+		                              first_row,
+		                              num_rows,
+		                              dst,
+		                              dst_pitch);
+		break;
+
+	case Rotation::Deg180:
+		rotate_rows_upside_down<pixel_t>(
+		        src, src_pitch, width, height, first_row, num_rows, dst, dst_pitch);
+		break;
+	}
+}
+
+void RENDER_RotateRows(const Rotation rotation, const uint8_t bytes_per_pixel,
+                       const uint8_t* src, const int src_pitch,
+                       const int width, const int height, const int first_row,
+                       const int num_rows, uint8_t* dst, const int dst_pitch)
+{
+	assert(src && dst && src != dst);
+	assert(first_row >= 0 && num_rows >= 0);
+	assert(first_row + num_rows <= height);
+
+	switch (bytes_per_pixel) {
+	case 1:
+		rotate_rows<uint8_t>(rotation, src, src_pitch, width, height,
+		                     first_row, num_rows, dst, dst_pitch);
+		break;
+	case 2:
+		rotate_rows<uint16_t>(rotation, src, src_pitch, width, height,
+		                      first_row, num_rows, dst, dst_pitch);
+		break;
+	case 4:
+		rotate_rows<uint32_t>(rotation, src, src_pitch, width, height,
+		                      first_row, num_rows, dst, dst_pitch);
+		break;
+	default: assert(false); break;
+	}
+}
+
+DosBox::Rect RENDER_UnrotateRect(const Rotation rotation,
+                                 const DosBox::Rect& output_rect)
+{
+	if (!is_rotated_sideways(rotation)) {
+		return output_rect;
+	}
+	return {output_rect.x, output_rect.y, output_rect.h, output_rect.w};
+}
+
+void RENDER_UnrotatePoint(const Rotation rotation,
+                          const DosBox::Rect& output_rect, float& x, float& y)
+{
+	// Inverse of the pixel mappings in rotate_rows(), relative to the
+	// top-left corner
+	const auto dx = x - output_rect.x;
+	const auto dy = y - output_rect.y;
+
+	switch (rotation) {
+	case Rotation::Deg0: return;
+	case Rotation::Deg90:
+		x = output_rect.x + dy;
+		y = output_rect.y + (output_rect.w - dx);
+		break;
+	case Rotation::Deg180:
+		x = output_rect.x + (output_rect.w - dx);
+		y = output_rect.y + (output_rect.h - dy);
+		break;
+	case Rotation::Deg270:
+		x = output_rect.x + (output_rect.h - dy);
+		y = output_rect.y + dx;
+		break;
+	}
+}
+
+void RENDER_UnrotateDelta(const Rotation rotation, float& dx, float& dy)
+{
+	const auto out_dx = dx;
+	const auto out_dy = dy;
+
+	switch (rotation) {
+	case Rotation::Deg0: return;
+	case Rotation::Deg90:
+		dx = out_dy;
+		dy = -out_dx;
+		break;
+	case Rotation::Deg180:
+		dx = -out_dx;
+		dy = -out_dy;
+		break;
+	case Rotation::Deg270:
+		dx = -out_dy;
+		dy = out_dx;
+		break;
+	}
+}
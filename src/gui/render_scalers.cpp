@@ -38,7 +38,7 @@ static union {
 	 uint8_t b8[SCALER_MAX_MUL_HEIGHT + 1][SCALER_MAXWIDTH] = {};
 } scalerWriteCache;
 //scalerFrameCache_t scalerFrameCache;
-scalerSourceCache_t scalerSourceCache;
+std::vector<uint8_t> scalerSourceCache = {};
 #if RENDER_USE_ADVANCED_SCALERS>1
 scalerChangeCache_t scalerChangeCache;
 #endif
@@ -96,6 +96,10 @@ static inline void ScalerAddLines( Bitu changed, Bitu count ) {
 
 #define CC scalerChangeCache
 
+// The VGA line drawers pass nullptr for lines whose video memory hasn't
+// changed since the previous frame (see VGA_Draw_Changes_Line)
+#define RENDER_NULL_INPUT
+
 /* Include the different rendering routines */
 #define SBPP 8
 #define DBPP 8
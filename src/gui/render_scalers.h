@@ -19,6 +19,9 @@
 #ifndef _RENDER_SCALERS_H
 #define _RENDER_SCALERS_H
 
+#include <cstdint>
+#include <vector>
+
 //#include "render.h"
 #include "video.h"
 
@@ -50,13 +53,10 @@ extern uint8_t diff_table[];
 extern Bitu Scaler_ChangedLineIndex;
 extern uint16_t Scaler_ChangedLines[];
 
-union scalerSourceCache_t {
-	uint32_t b32	[SCALER_MAXHEIGHT] [SCALER_MAXWIDTH];
-	uint16_t b16	[SCALER_MAXHEIGHT] [SCALER_MAXWIDTH];
-	uint8_t b8	[SCALER_MAXHEIGHT] [SCALER_MAXWIDTH];
-};
-
-extern scalerSourceCache_t scalerSourceCache;
+// The previous frame's source image, which the line handlers compare the
+// incoming lines against to only scale the changed parts. It's sized to the
+// current video mode by the renderer.
+extern std::vector<uint8_t> scalerSourceCache;
 
 typedef ScalerLineHandler_t ScalerLineBlock_t[6][4];
 
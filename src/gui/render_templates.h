@@ -20,8 +20,6 @@
 #	define PSIZE 1
 #	define PTYPE uint8_t
 #	define WC    scalerWriteCache.b8
-// #define FC scalerFrameCache.b8
-#	define FC         (*(scalerFrameCache_t*)(&scalerSourceCache.b32[400][0])).b8
 #	define redMask    0
 #	define greenMask  0
 #	define blueMask   0
@@ -35,8 +33,6 @@
 #	define PSIZE 2
 #	define PTYPE uint16_t
 #	define WC    scalerWriteCache.b16
-// #define FC scalerFrameCache.b16
-#	define FC    (*(scalerFrameCache_t*)(&scalerSourceCache.b32[400][0])).b16
 #	if DBPP == 15
 #		define redMask    0x7C00
 #		define greenMask  0x03E0
@@ -62,8 +58,6 @@
 #	define PSIZE      4
 #	define PTYPE      uint32_t
 #	define WC         scalerWriteCache.b32
-// #define FC scalerFrameCache.b32
-#	define FC         (*(scalerFrameCache_t*)(&scalerSourceCache.b32[400][0])).b32
 #	define redMask    0xff0000
 #	define greenMask  0x00ff00
 #	define blueMask   0x0000ff
@@ -78,7 +72,6 @@
 #define redblueMask (redMask | blueMask)
 
 #if SBPP == 8 || SBPP == 9
-#	define SC scalerSourceCache.b8
 #	if DBPP == 8
 #		define PMAKE(_VAL) (_VAL)
 #	elif DBPP == 15
@@ -92,7 +85,6 @@
 #endif
 
 #if SBPP == 15
-#	define SC scalerSourceCache.b16
 #	ifdef WORDS_BIGENDIAN
 #		if DBPP == 15 // GGGBBBBBxRRRRRGG -> xRRRRRGGGGGBBBBB
 #			define PMAKE(_VAL) (((_VAL >> 8) & 0x00FF) | ((_VAL << 8) & 0xFF00))
@@ -124,7 +116,6 @@
 #endif
 
 #if SBPP == 16
-#	define SC scalerSourceCache.b16
 #	ifdef WORDS_BIGENDIAN
 #		if DBPP == 15 // GGgBBBBBRRRRRGGG -> 0RRRRRGGGGGBBBBB
 #			define PMAKE(_VAL) \
@@ -155,7 +146,6 @@
 #endif
 
 #if SBPP == 24
-#	define SC scalerSourceCache.b32
 #	if DBPP == 15
 #		define PMAKE(_VAL) \
 			(PTYPE)(((_VAL & (31 << 19)) >> 9) | ((_VAL & (31 << 11)) >> 6) | \
@@ -172,7 +162,6 @@
 #endif
 
 #if SBPP == 32
-#	define SC scalerSourceCache.b32
 #	ifdef WORDS_BIGENDIAN
 #		if DBPP == 15 // BBBBBbbbGGGGGgggRRRRRrrrxxxxxxxx -> 0RRRRRGGGGGBBBBB
 #			define PMAKE(_VAL) \
@@ -287,8 +276,6 @@
 #undef PMAKE
 #undef WC
 #undef LC
-#undef FC
-#undef SC
 #undef redMask
 #undef greenMask
 #undef blueMask
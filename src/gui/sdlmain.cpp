@@ -25,13 +25,17 @@
 #include <cassert>
 #include <cerrno>
 #include <cmath>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
 #include <sys/types.h>
+#include <thread>
 #include <tuple>
 #include <unistd.h>
+#include <utility>
 
 #if C_DEBUG
 #include <queue>
@@ -51,10 +55,12 @@
 #include "../capture/capture.h"
 #include "../dos/dos_locale.h"
 #include "../ints/int10.h"
+#include "benchmark.h"
 #include "control.h"
 #include "cpu.h"
 #include "cross.h"
 #include "debug.h"
+#include "frame_mailbox.h"
 #include "fs_utils.h"
 #include "gui_msgs.h"
 #include "joystick.h"
@@ -64,11 +70,13 @@
 #include "mixer.h"
 #include "mouse.h"
 #include "pacer.h"
+#include "perf_counters.h"
 #include "pic.h"
 #include "rect.h"
 #include "render.h"
 #include "sdlmain.h"
 #include "setup.h"
+#include "startup_trace.h"
 #include "string_utils.h"
 #include "timer.h"
 #include "tracy.h"
@@ -321,6 +329,14 @@ void GFX_SetTitle(const int32_t new_num_cycles, const bool is_paused = false)
 		hint_paused_str = std::string(" ") + MSG_GetRaw("TITLEBAR_HINT_PAUSED");
 	}
 
+	// Show how many times faster than real-time we're running
+	auto cycles_str = cycles_ms_str;
+	if (sdl.title_bar.fast_forward_speed > 0.0) {
+		cycles_str += format_string(" - %s %.1fx",
+		                            MSG_GetRaw("TITLEBAR_FAST_FORWARD"),
+		                            sdl.title_bar.fast_forward_speed);
+	}
+
 	const auto& hint_str = is_paused ? hint_paused_str : hint_mouse_str;
 	if (CPU_CycleAutoAdjust) {
 		if (CPU_CycleLimit > 0) {
@@ -329,14 +345,14 @@ void GFX_SetTitle(const int32_t new_num_cycles, const bool is_paused = false)
 			             RunningProgram,
 			             num_cycles,
 			             CPU_CycleLimit,
-			             cycles_ms_str.c_str(),
+			             cycles_str.c_str(),
 			             hint_str.c_str());
 		} else {
 			safe_sprintf(title_buf,
 			             "%8s - max %d%% %s - " APP_NAME_STR "%s",
 			             RunningProgram,
 			             num_cycles,
-			             cycles_ms_str.c_str(),
+			             cycles_str.c_str(),
 			             hint_str.c_str());
 		}
 	} else {
@@ -344,7 +360,7 @@ void GFX_SetTitle(const int32_t new_num_cycles, const bool is_paused = false)
 		             "%8s - %d %s - " APP_NAME_STR "%s",
 		             RunningProgram,
 		             num_cycles,
-		             cycles_ms_str.c_str(),
+		             cycles_str.c_str(),
 		             hint_str.c_str());
 	}
 
@@ -357,6 +373,12 @@ void GFX_RefreshTitle(const bool is_paused = false)
 	GFX_SetTitle(refresh_cycle_count, is_paused);
 }
 
+void GFX_SetFastForwardSpeed(const double speed)
+{
+	sdl.title_bar.fast_forward_speed = speed;
+	GFX_RefreshTitle();
+}
+
 // Detects if we're running within a desktop environment (or window manager).
 bool GFX_HaveDesktopEnvironment()
 {
@@ -1031,13 +1053,317 @@ static void remove_window()
 	}
 }
 
+#if C_OPENGL
+// Presentation thread
+// ~~~~~~~~~~~~~~~~~~~
+// With 'threaded_presentation' enabled, OpenGL frames are uploaded and
+// presented from a dedicated thread, so the emulation never blocks on vsync
+// or the video driver. Rendered frames are handed over through a triple-
+// buffered FrameMailbox, and presenting a frame merely signals the thread.
+//
+// The thread owns the OpenGL context while it runs. The main thread pauses it
+// with a PresenterPause guard around any GL work of its own (e.g., setting up
+// the output or reacting to window events), which hands the context back for
+// the duration.
+static struct {
+	std::thread thread         = {};
+	std::mutex mutex           = {};
+	std::condition_variable cv = {};
+
+	FrameMailbox mailbox = {};
+
+	// Main thread only
+	int pause_depth      = 0;
+	uint8_t* back_buffer = nullptr;
+
+	// Guarded by the mutex
+	bool should_pause  = false;
+	bool is_paused     = false;
+	bool should_stop   = false;
+	bool has_new_frame = false;
+	bool wants_present = false;
+
+	uint32_t num_unchanged_frames = 0;
+
+	// Presentation thread only, until it's joined
+	struct {
+		uint32_t num_presented    = 0;
+		int64_t last_present_us   = 0;
+		int64_t total_interval_us = 0;
+		int64_t max_interval_us   = 0;
+	} stats = {};
+} presenter = {};
+
+static bool is_presenter_running()
+{
+	return presenter.thread.joinable() && presenter.pause_depth == 0;
+}
+
+static void upload_rows_gl(const uint8_t* pixels, const int pitch,
+                           const std::vector<uint8_t>& changed_rows)
+{
+	const auto height = std::min(static_cast<int>(changed_rows.size()),
+	                             sdl.draw.render_height_px);
+	int y = 0;
+	while (y < height) {
+		if (!changed_rows[y]) {
+			++y;
+			continue;
+		}
+		const auto first_row = y;
+		while (y < height && changed_rows[y]) {
+			++y;
+		}
+		glTexSubImage2D(GL_TEXTURE_2D,
+		                0,
+		                0,
+		                first_row,
+		                sdl.draw.render_width_px,
+		                y - first_row,
+		                GL_BGRA_EXT,
+		                GL_UNSIGNED_INT_8_8_8_8_REV,
+		                pixels + first_row * pitch);
+	}
+}
+
+// Uploads the rows changed by the frames published since the last upload.
+// Runs on whichever thread owns the OpenGL context.
+static void upload_published_frame_gl()
+{
+	static std::vector<uint8_t> changed_rows = {};
+
+	const auto pixels = presenter.mailbox.TakeFrame(changed_rows);
+	if (pixels) {
+		upload_rows_gl(pixels, presenter.mailbox.GetPitch(), changed_rows);
+	}
+}
+
+static void record_presentation_stats()
+{
+	auto& stats = presenter.stats;
+
+	const auto now = GetTicksUs();
+	if (stats.last_present_us) {
+		const auto interval_us = now - stats.last_present_us;
+		stats.total_interval_us += interval_us;
+		stats.max_interval_us = std::max(stats.max_interval_us, interval_us);
+	}
+	stats.last_present_us = now;
+	++stats.num_presented;
+}
+
+static void log_presentation_stats()
+{
+	const auto& stats = presenter.stats;
+	if (stats.num_presented < 2) {
+		return;
+	}
+	const auto avg_interval_ms = static_cast<double>(stats.total_interval_us) /
+	                             (stats.num_presented - 1) / 1000.0;
+
+	LOG_MSG("OPENGL: Presentation thread showed %u frames, %.2f ms apart "
+	        "on average and %.2f ms at most; dropped %u of %u rendered frames",
+	        stats.num_presented,
+	        avg_interval_ms,
+	        static_cast<double>(stats.max_interval_us) / 1000.0,
+	        presenter.mailbox.GetNumDropped(),
+	        presenter.mailbox.GetNumPublished());
+}
+
+static void presenter_run()
+{
+	SDL_GL_MakeCurrent(sdl.window, sdl.opengl.context);
+
+	std::unique_lock<std::mutex> lock(presenter.mutex);
+	while (true) {
+		presenter.cv.wait(lock, [] {
+			return presenter.should_stop || presenter.should_pause ||
+			       presenter.has_new_frame || presenter.wants_present;
+		});
+		if (presenter.should_stop) {
+			break;
+		}
+		if (presenter.should_pause) {
+			SDL_GL_MakeCurrent(sdl.window, nullptr);
+			presenter.is_paused = true;
+			presenter.cv.notify_all();
+
+			presenter.cv.wait(lock, [] {
+				return !presenter.should_pause || presenter.should_stop;
+			});
+			presenter.is_paused = false;
+			if (presenter.should_stop) {
+				// The main thread kept the context
+				return;
+			}
+			// The context or window might have been recreated
+			SDL_GL_MakeCurrent(sdl.window, sdl.opengl.context);
+			continue;
+		}
+		const auto has_new_frame = std::exchange(presenter.has_new_frame, false);
+		const auto wants_present = std::exchange(presenter.wants_present, false);
+		sdl.opengl.actual_frame_count += std::exchange(
+		        presenter.num_unchanged_frames, 0);
+		lock.unlock();
+
+		if (has_new_frame) {
+			upload_published_frame_gl();
+		}
+		if (wants_present && present_frame_gl()) {
+			record_presentation_stats();
+		}
+		lock.lock();
+	}
+	SDL_GL_MakeCurrent(sdl.window, nullptr);
+}
+
+static void update_frame_gl_threaded(const uint16_t* changedLines)
+{
+	if (changedLines && presenter.back_buffer) {
+		presenter.mailbox.Publish(changedLines);
+
+		const std::lock_guard<std::mutex> lock(presenter.mutex);
+		presenter.has_new_frame = true;
+		presenter.cv.notify_all();
+	} else if (!changedLines) {
+		// The shaders' frame count is owned by the presentation thread
+		const std::lock_guard<std::mutex> lock(presenter.mutex);
+		++presenter.num_unchanged_frames;
+	}
+	presenter.back_buffer = nullptr;
+}
+
+static bool present_frame_gl_threaded()
+{
+	const std::lock_guard<std::mutex> lock(presenter.mutex);
+	presenter.wants_present = true;
+	presenter.cv.notify_all();
+	return true;
+}
+
+// Waits for the presentation thread to release the OpenGL context and takes
+// it over on the main thread
+static void presenter_pause()
+{
+	if (presenter.pause_depth++ > 0 || !presenter.thread.joinable()) {
+		return;
+	}
+	{
+		std::unique_lock<std::mutex> lock(presenter.mutex);
+		presenter.should_pause = true;
+		presenter.cv.notify_all();
+		presenter.cv.wait(lock, [] { return presenter.is_paused; });
+	}
+	SDL_GL_MakeCurrent(sdl.window, sdl.opengl.context);
+
+	sdl.frame.update  = update_frame_gl;
+	sdl.frame.present = present_frame_gl;
+}
+
+// Stops the presentation thread, which must be paused
+static void join_paused_presenter()
+{
+	{
+		const std::lock_guard<std::mutex> lock(presenter.mutex);
+		presenter.should_stop = true;
+		presenter.cv.notify_all();
+	}
+	presenter.thread.join();
+
+	presenter.should_pause  = false;
+	presenter.is_paused     = false;
+	presenter.should_stop   = false;
+	presenter.has_new_frame = false;
+	presenter.wants_present = false;
+	presenter.back_buffer   = nullptr;
+
+	sdl.opengl.actual_frame_count += std::exchange(
+	        presenter.num_unchanged_frames, 0);
+
+	log_presentation_stats();
+	presenter.stats = {};
+}
+
+// Hands the OpenGL context back to the presentation thread, or starts or
+// stops the thread if the output was changed in the meantime
+static void presenter_resume()
+{
+	assert(presenter.pause_depth > 0);
+	if (--presenter.pause_depth > 0) {
+		return;
+	}
+
+	const auto should_run = sdl.opengl.use_presentation_thread &&
+	                        sdl.rendering_backend == RenderingBackend::OpenGl &&
+	                        sdl.frame.update == update_frame_gl &&
+	                        sdl.opengl.context && sdl.window;
+	if (!should_run) {
+		if (presenter.thread.joinable()) {
+			join_paused_presenter();
+		}
+		return;
+	}
+
+	if (presenter.mailbox.GetPitch() != sdl.opengl.pitch ||
+	    presenter.mailbox.GetHeight() != sdl.draw.render_height_px) {
+		presenter.mailbox.Resize(sdl.opengl.pitch, sdl.draw.render_height_px);
+	}
+
+	SDL_GL_MakeCurrent(sdl.window, nullptr);
+
+	sdl.frame.update  = update_frame_gl_threaded;
+	sdl.frame.present = present_frame_gl_threaded;
+
+	if (presenter.thread.joinable()) {
+		const std::lock_guard<std::mutex> lock(presenter.mutex);
+		presenter.should_pause = false;
+		presenter.cv.notify_all();
+	} else {
+		presenter.thread = std::thread(presenter_run);
+	}
+}
+
+static void presenter_stop()
+{
+	if (!presenter.thread.joinable()) {
+		return;
+	}
+	presenter_pause();
+	join_paused_presenter();
+	--presenter.pause_depth;
+}
+
+// Keeps the presentation thread (if any) paused while in scope, so the main
+// thread can use the OpenGL context
+struct PresenterPause {
+	PresenterPause()
+	{
+		presenter_pause();
+	}
+	~PresenterPause()
+	{
+		presenter_resume();
+	}
+	PresenterPause(const PresenterPause&)            = delete;
+	PresenterPause& operator=(const PresenterPause&) = delete;
+};
+#else
+struct PresenterPause {
+	PresenterPause() {}
+};
+#endif // C_OPENGL
+
 // The throttled presenter skips frames that have inter-frame spacing narrower
 // than the allowed frame period (sdl.frame.period_us). When a frame is skipped,
 // the presenter still tries to present it at its next oppourtunity.
 //
+// Shared with GFX_IsPresentationDue() so the renderer can tell ahead of time
+// whether a throttled frame would be dropped
+static int64_t last_throttled_present_time = 0;
+
 static void maybe_present_throttled(const bool frame_is_new)
 {
-	static int64_t last_present_time = 0;
+	auto& last_present_time = last_throttled_present_time;
 	static auto was_new_and_throttled = false;
 
 	const auto now     = GetTicksUs();
@@ -1060,6 +1386,17 @@ static void maybe_present_throttled(const bool frame_is_new)
 	}
 }
 
+bool GFX_IsPresentationDue(const int64_t frame_duration_us)
+{
+	if (sdl.frame.mode != FrameMode::ThrottledVfr) {
+		return true;
+	}
+	const auto elapsed_at_end = GetTicksUsSince(last_throttled_present_time) +
+	                            frame_duration_us;
+
+	return elapsed_at_end >= sdl.frame.period_us;
+}
+
 static void maybe_present_synced(const bool present_if_last_skipped)
 {
 	// state tracking across runs
@@ -1178,6 +1515,14 @@ static void setup_presentation_mode(FrameMode &previous_mode)
 	previous_mode = mode;
 }
 
+// The draw rectangle in logical units
+static DosBox::Rect get_draw_rect()
+{
+	// It is important to scale not just the size of the rectangle but also
+	// its starting point by the inverse of the DPI scale factor.
+	return to_rect(sdl.draw_rect_px).Copy().Scale(1.0f / sdl.desktop.dpi_scale);
+}
+
 static void notify_new_mouse_screen_params()
 {
 	if (sdl.draw_rect_px.w <= 0 || sdl.draw_rect_px.h <= 0) {
@@ -1188,17 +1533,22 @@ static void notify_new_mouse_screen_params()
 
 	MouseScreenParams params = {};
 
-	// It is important to scale not just the size of the rectangle but also
-	// its starting point by the inverse of the DPI scale factor.
-	params.draw_rect =
-	        to_rect(sdl.draw_rect_px).Copy().Scale(1.0f / sdl.desktop.dpi_scale);
+	// The mouse emulation works in the orientation of the unrotated image
+	const auto rotation  = RENDER_GetRotation();
+	const auto draw_rect = get_draw_rect();
+
+	params.draw_rect = RENDER_UnrotateRect(rotation, draw_rect);
 
 	int abs_x = 0;
 	int abs_y = 0;
 	SDL_GetMouseState(&abs_x, &abs_y);
 
-	params.x_abs = check_cast<int32_t>(abs_x);
-	params.y_abs = check_cast<int32_t>(abs_y);
+	auto x_abs = static_cast<float>(abs_x);
+	auto y_abs = static_cast<float>(abs_y);
+	RENDER_UnrotatePoint(rotation, draw_rect, x_abs, y_abs);
+
+	params.x_abs = iroundf(x_abs);
+	params.y_abs = iroundf(y_abs);
 
 	params.is_fullscreen    = sdl.desktop.fullscreen;
 	params.is_multi_display = (SDL_GetNumVideoDisplays() > 1);
@@ -1717,6 +2067,9 @@ uint8_t GFX_SetSize(const int render_width_px, const int render_height_px,
                     const Fraction& render_pixel_aspect_ratio, const uint8_t flags,
                     const VideoMode& video_mode, GFX_CallBack_t callback)
 {
+	// The output is set up on this thread
+	const PresenterPause pause = {};
+
 	uint8_t retFlags = 0;
 	if (sdl.updating)
 		GFX_EndUpdate(nullptr);
@@ -2237,6 +2590,7 @@ void GFX_SetShader([[maybe_unused]] const ShaderInfo& shader_info,
 		return;
 	}
 	if (sdl.opengl.program_object) {
+		const PresenterPause pause = {};
 		glDeleteProgram(sdl.opengl.program_object);
 		sdl.opengl.program_object = 0;
 	}
@@ -2384,6 +2738,8 @@ void sticky_keys(bool restore){
 
 void GFX_SwitchFullScreen()
 {
+	const PresenterPause pause = {};
+
 	sdl.desktop.switching_fullscreen = true;
 
 	// Record the window's current canvas size if we're departing window-mode
@@ -2438,6 +2794,14 @@ bool GFX_StartUpdate(uint8_t * &pixels, int &pitch)
 		return true;
 	case RenderingBackend::OpenGl:
 #if C_OPENGL
+		if (is_presenter_running()) {
+			presenter.back_buffer = presenter.mailbox.AcquireBackBuffer();
+
+			pixels       = presenter.back_buffer;
+			pitch        = presenter.mailbox.GetPitch();
+			sdl.updating = true;
+			return true;
+		}
 		pixels = static_cast<uint8_t*>(sdl.opengl.framebuf);
 		OPENGL_ERROR("end of start update");
 		if (pixels == nullptr) {
@@ -2470,7 +2834,9 @@ void GFX_EndUpdate(const uint16_t* changedLines)
 		// frame, regardless of the presentation mode. This is necessary to
 		// keep the contents of rendered and raw/upscaled screenshots in sync
 		// (so they capture the exact same frame) in multi-output image
-		// capture modes.
+		// capture modes. The image capturer isn't thread-safe, so the
+		// presentation thread (if any) is paused to present on this one.
+		const PresenterPause pause = {};
 		sdl.frame.present();
 	} else {
 		// Helper lambda indicating whether the frame should be presented.
@@ -2645,9 +3011,16 @@ static std::optional<RenderedImage> get_rendered_output_from_backbuffer()
 	return image;
 }
 
+static PerfTimer present_timer("gfx.present");
+static PerfCounter frames_presented("gfx.frames_presented");
+static PerfCounter frames_paced_out("gfx.frames_skipped_by_pacer");
+
 static bool present_frame_texture()
 {
+	const PerfTimerScope perf_scope(present_timer);
+
 	const auto is_presenting = render_pacer->CanRun();
+	(is_presenting ? frames_presented : frames_paced_out).Add();
 	if (is_presenting) {
 		SDL_RenderClear(sdl.renderer);
 		SDL_RenderCopy(sdl.renderer, sdl.texture.texture, nullptr, nullptr);
@@ -2699,7 +3072,13 @@ static void update_frame_gl(const uint16_t* changedLines)
 
 static bool present_frame_gl()
 {
+	const PerfTimerScope perf_scope(present_timer);
+
+	// Frames rendered for the presentation thread
+	upload_published_frame_gl();
+
 	const auto is_presenting = render_pacer->CanRun();
+	(is_presenting ? frames_presented : frames_paced_out).Add();
 	if (is_presenting) {
 		glClear(GL_COLOR_BUFFER_BIT);
 		if (sdl.opengl.program_object) {
@@ -2792,6 +3171,9 @@ static void clean_up_sdl_resources()
 
 static void GUI_ShutDown(Section *)
 {
+#if C_OPENGL
+	presenter_stop();
+#endif
 	GFX_Stop();
 	if (sdl.draw.callback)
 		(sdl.draw.callback)( GFX_CallBackStop );
@@ -3560,6 +3942,11 @@ static void GUI_StartUp(Section* sec)
 		            presentation_mode_pref.c_str());
 	}
 
+#if C_OPENGL
+	sdl.opengl.use_presentation_thread = section->Get_bool(
+	        "threaded_presentation");
+#endif
+
 	sdl.desktop.full.display_res = sdl.desktop.full.fixed && (!sdl.desktop.full.width || !sdl.desktop.full.height);
 	if (sdl.desktop.full.display_res) {
 		GFX_ObtainDisplayDimensions();
@@ -3605,10 +3992,26 @@ static void GUI_StartUp(Section* sec)
 
 static void handle_mouse_motion(SDL_MouseMotionEvent* motion)
 {
-	MOUSE_EventMoved(static_cast<float>(motion->xrel),
-	                 static_cast<float>(motion->yrel),
-	                 check_cast<int32_t>(motion->x),
-	                 check_cast<int32_t>(motion->y));
+	const auto rotation = RENDER_GetRotation();
+	if (rotation == Rotation::Deg0) {
+		MOUSE_EventMoved(static_cast<float>(motion->xrel),
+		                 static_cast<float>(motion->yrel),
+		                 check_cast<int32_t>(motion->x),
+		                 check_cast<int32_t>(motion->y));
+		return;
+	}
+
+	// Rotate the pointer back to the orientation of the unrotated image,
+	// which is what the mouse emulation's draw rectangle describes
+	auto x_rel = static_cast<float>(motion->xrel);
+	auto y_rel = static_cast<float>(motion->yrel);
+	RENDER_UnrotateDelta(rotation, x_rel, y_rel);
+
+	auto x_abs = static_cast<float>(motion->x);
+	auto y_abs = static_cast<float>(motion->y);
+	RENDER_UnrotatePoint(rotation, get_draw_rect(), x_abs, y_abs);
+
+	MOUSE_EventMoved(x_rel, y_rel, iroundf(x_abs), iroundf(y_abs));
 }
 
 static void handle_mouse_wheel(SDL_MouseWheelEvent* wheel)
@@ -3650,6 +4053,8 @@ void GFX_RegenerateWindow(Section *sec) {
 		first_window = false;
 		return;
 	}
+	const PresenterPause pause = {};
+
 	remove_window();
 	set_output(sec, is_aspect_ratio_correction_enabled());
 	GFX_ResetScreen();
@@ -3664,6 +4069,8 @@ void GFX_RegenerateWindow(Section *sec) {
 
 static void handle_video_resize(int width, int height)
 {
+	const PresenterPause pause = {};
+
 	/* Maybe a screen rotation has just occurred, so we simply resize.
 	There may be a different cause for a forced resized, though.    */
 	if (sdl.desktop.full.display_res && sdl.desktop.fullscreen) {
@@ -3831,6 +4238,7 @@ bool GFX_Events()
 				// LOG_DEBUG("SDL: Reset macOS's GL viewport
 				// after window-restore");
 				if (sdl.rendering_backend == RenderingBackend::OpenGl) {
+					const PresenterPause pause = {};
 					glViewport(sdl.draw_rect_px.x,
 					           sdl.draw_rect_px.y,
 					           sdl.draw_rect_px.w,
@@ -3938,6 +4346,7 @@ bool GFX_Events()
 				//               event.window.data1,
 				//               event.window.data2);
 				if (sdl.rendering_backend == RenderingBackend::OpenGl) {
+					const PresenterPause pause = {};
 					glViewport(sdl.draw_rect_px.x,
 					           sdl.draw_rect_px.y,
 					           sdl.draw_rect_px.w,
@@ -3974,6 +4383,7 @@ bool GFX_Events()
 				}
 #	if C_OPENGL
 				if (sdl.rendering_backend == RenderingBackend::OpenGl) {
+					const PresenterPause pause = {};
 					glViewport(sdl.draw_rect_px.x,
 					           sdl.draw_rect_px.y,
 					           sdl.draw_rect_px.w,
@@ -4250,6 +4660,18 @@ static void messages_add_command_line()
 	        "\n"
 	        "  --socket <num>           Run nullmodem on the specified socket number.\n"
 	        "\n"
+	        "  --startup-trace <file>   Write a timeline of the startup up to the first DOS\n"
+	        "                           prompt to <file> (Chrome trace event format).\n"
+	        "\n"
+	        "  --benchmark <seconds>    Run headless (without a window or sound) for the given\n"
+	        "                           number of emulated seconds as fast as possible, then\n"
+	        "                           print the timings, counters, and video and audio\n"
+	        "                           hashes. Use fixed cycles for repeatable results.\n"
+	        "\n"
+	        "  --benchmark-hash-interval <num>\n"
+	        "                           Print the hash of every <num>th rendered frame in the\n"
+	        "                           benchmark results (70 by default).\n"
+	        "\n"
 	        "  -h, -?, --help           Print help message and exit.\n"
 	        "\n"
 	        "  -V, --version            Print version information and exit.\n");
@@ -4268,6 +4690,7 @@ static void messages_add_sdl()
 
 	MSG_Add("TITLEBAR_CYCLES_MS",    "cycles/ms");
 	MSG_Add("TITLEBAR_HINT_PAUSED",  "(PAUSED)");
+	MSG_Add("TITLEBAR_FAST_FORWARD", "fast-forward");
 	MSG_Add("TITLEBAR_HINT_NOMOUSE", "no-mouse mode");
 	MSG_Add("TITLEBAR_HINT_CAPTURED_HOTKEY",
 	        "mouse captured, %s+F10 to release");
@@ -4392,6 +4815,13 @@ static void config_add_sdl() {
 	        "  vfr:   Always present changed DOS frames at a variable frame rate.");
 	pstring->Set_values(presentation_modes);
 
+	pbool = sdl_sec->Add_bool("threaded_presentation", on_start, false);
+	pbool->Set_help(
+	        "Upload and present frames from a separate thread (disabled by default).\n"
+	        "This keeps waiting for vsync and the GPU driver off the emulation\n"
+	        "thread, at the cost of up to one frame of extra latency. Only applies\n"
+	        "to the 'opengl' and 'openglnb' outputs. Experimental.");
+
 	const char* outputs[] =
 	{ "texture",
 	  "texturenb",
@@ -4688,6 +5118,25 @@ int sdl_main(int argc, char* argv[])
 	int return_code = 0;
 
 	try {
+		if (!arguments->startup_trace.empty()) {
+			// Resolved before we change the working directory
+			std::error_code ec;
+			const auto trace_path = std_fs::absolute(arguments->startup_trace,
+			                                         ec);
+			STARTUP_EnableTrace(ec ? std_fs::path(arguments->startup_trace)
+			                       : trace_path);
+		}
+
+		if (arguments->benchmark) {
+			if (*arguments->benchmark < 1) {
+				LOG_ERR("BENCHMARK: The number of emulated seconds must be at least 1");
+				return 1;
+			}
+			BENCHMARK_Enable(*arguments->benchmark,
+			                 arguments->benchmark_hash_interval.value_or(
+			                         DefaultBenchmarkFrameHashInterval));
+		}
+
 		if (!arguments->working_dir.empty()) {
 			std::error_code ec;
 			std_fs::current_path(arguments->working_dir, ec);
@@ -4718,7 +5167,10 @@ int sdl_main(int argc, char* argv[])
 		config_add_sdl();
 
 		// Register DOSBox's (and all modules) messages and conf sections
-		DOSBOX_Init();
+		{
+			const StartupTraceScope trace_scope("Registering sections");
+			DOSBOX_Init();
+		}
 
 		// Before loading any configs, write the default primary config if it
 		// doesn't exist when:
@@ -4747,7 +5199,10 @@ int sdl_main(int argc, char* argv[])
 		// After DOSBOX_Init() is done, all the conf sections have been
 		// registered, so we're ready to parse the conf files.
 		//
-		control->ParseConfigFiles(GetConfigDir());
+		{
+			const StartupTraceScope trace_scope("Parsing config files");
+			control->ParseConfigFiles(GetConfigDir());
+		}
 
 		// Handle command line options that don't start the emulator but only
 		// perform some actions and print the results to the console.
@@ -4834,8 +5289,17 @@ int sdl_main(int argc, char* argv[])
 			return err;
 		}
 
-		if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO) < 0) {
-			E_Exit("SDL: Can't init SDL %s", SDL_GetError());
+		if (BENCHMARK_IsEnabled()) {
+			// Run headless; nothing is shown or played on the host
+			SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+			SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+		}
+
+		{
+			const StartupTraceScope trace_scope("SDL_Init");
+			if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO) < 0) {
+				E_Exit("SDL: Can't init SDL %s", SDL_GetError());
+			}
 		}
 		if (SDL_CDROMInit() < 0) {
 			LOG_WARNING("SDL: Failed to initialise CD-ROM support");
@@ -4856,6 +5320,18 @@ int sdl_main(int argc, char* argv[])
 		        SDL_GetCurrentVideoDriver(),
 		        SDL_GetCurrentAudioDriver());
 
+		if (BENCHMARK_IsEnabled()) {
+			// The dummy video driver only supports software
+			// rendering, the mixed audio is hashed instead of
+			// played, and the counters provide the executed cycles
+			for (const auto setting : {"output=texture",
+			                           "texture_renderer=software",
+			                           "nosound=true",
+			                           "perf_counters=on"}) {
+				arguments->set.emplace_back(setting);
+			}
+		}
+
 		for (auto line : arguments->set) {
 			trim(line);
 
@@ -4947,8 +5423,14 @@ int sdl_main(int argc, char* argv[])
 		}
 
 		// Run the machine until shutdown
+		BENCHMARK_Start();
 		control->StartUp();
 
+		BENCHMARK_PrintReport();
+
+		// In case we never made it to a DOS prompt
+		STARTUP_WriteTrace();
+
 		// Shutdown and release
 		control.reset();
 
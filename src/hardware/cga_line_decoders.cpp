@@ -0,0 +1,759 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "cga_line_decoders.h"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "../gui/render_scalers.h"
+#include "math_utils.h"
+#include "mem_unaligned.h"
+
+// Scalar reference implementations
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+void CGA_Decode1BppScalar(const uint8_t* src, const int num_bytes,
+                          const uint32_t table[16], uint8_t* dest)
+{
+	uint16_t i = 0;
+	for (auto x = 0; x < num_bytes; ++x) {
+		const auto val = src[x];
+		write_unaligned_uint32_at(dest, i++, table[val >> 4]);
+		write_unaligned_uint32_at(dest, i++, table[val & 0xf]);
+	}
+}
+
+void CGA_Decode2BppScalar(const uint8_t* src, const int num_bytes,
+                          const uint32_t table[256], uint8_t* dest)
+{
+	uint16_t i = 0;
+	for (auto x = 0; x < num_bytes; ++x) {
+		write_unaligned_uint32_at(dest, i++, table[src[x]]);
+	}
+}
+
+void CGA_Decode4BppScalar(const uint8_t* src, const int num_bytes,
+                          const uint8_t palette[16], const bool double_pixels,
+                          uint8_t* dest)
+{
+	for (auto x = 0; x < num_bytes; ++x) {
+		const auto byte = src[x];
+		if (double_pixels) {
+			uint8_t data = palette[byte >> 4];
+			*dest++ = data; *dest++ = data;
+			data = palette[byte & 0x0f];
+			*dest++ = data; *dest++ = data;
+		} else {
+			*dest++ = palette[byte >> 4];
+			*dest++ = palette[byte & 0x0f];
+		}
+	}
+}
+
+static uint8_t byte_clamp(int v)
+{
+	v >>= 13;
+	return v < 0 ? 0u : (v > 255 ? 255u : static_cast<uint8_t>(v));
+}
+
+void CGA_CompositeProcessScalar(uint8_t* line, const uint8_t border,
+                                uint32_t blocks, const bool double_width,
+                                const CgaCompositeSettings& settings)
+{
+	static int temp[SCALER_MAXWIDTH + 10] = {0};
+	static int atemp[SCALER_MAXWIDTH + 2] = {0};
+	static int btemp[SCALER_MAXWIDTH + 2] = {0};
+
+	int w = blocks * 4;
+
+	if (double_width) {
+		uint8_t *source = line + w - 1;
+		uint8_t *dest = line + w * 2 - 2;
+		for (int x = 0; x < w; ++x) {
+			*dest = *source;
+			*(dest + 1) = *source;
+			--source;
+			dest -= 2;
+		}
+		blocks *= 2;
+		w *= 2;
+	}
+
+	// Simulate CGA composite output
+	int *o = temp;
+	auto push_pixel = [&o](const int v) {
+		*o = v;
+		++o;
+	};
+
+	const auto table = settings.table;
+
+	uint8_t *rgbi = line;
+	const int *b = &table[border * 68];
+	for (int x = 0; x < 4; ++x)
+		push_pixel(b[(x + 3) & 3]);
+	push_pixel(table[(border << 6) | ((*rgbi) << 2) | 3]);
+	for (int x = 0; x < w - 1; ++x) {
+		push_pixel(table[(rgbi[0] << 6) | (rgbi[1] << 2) | (x & 3)]);
+		++rgbi;
+	}
+	push_pixel(table[((*rgbi) << 6) | (border << 2) | 3]);
+	for (int x = 0; x < 5; ++x)
+		push_pixel(b[x & 3]);
+
+	if (settings.is_black_and_white) {
+		// Decode
+		int *i = temp + 5;
+		uint16_t idx = 0;
+		for (uint32_t x = 0; x < blocks * 4; ++x) {
+			int c = (i[0] + i[0]) << 3;
+			int d = (i[-1] + i[1]) << 3;
+			int y = ((c + d) << 8) + settings.sharpness * (c - d);
+			++i;
+			write_unaligned_uint32_at(line, idx++,
+			                          byte_clamp(y) * 0x10101);
+		}
+	} else {
+		// Store chroma
+		int *i = temp + 4;
+		int *ap = atemp + 1;
+		int *bp = btemp + 1;
+		for (int x = -1; x < w + 1; ++x) {
+			ap[x] = i[-4] - left_shift_signed(i[-2] - i[0] + i[2], 1) + i[4];
+			bp[x] = left_shift_signed(i[-3] - i[-1] + i[1] - i[3], 1);
+			++i;
+		}
+
+		// Decode
+		i = temp + 5;
+		i[-1] = (i[-1] << 3) - ap[-1];
+		i[0] = (i[0] << 3) - ap[0];
+
+		uint16_t idx = 0;
+
+		auto composite_convert = [&](const int ii, const int q) {
+			i[1]        = (i[1] << 3) - ap[1];
+			const int c = i[0] + i[0];
+			const int d = i[-1] + i[1];
+
+			const int y = left_shift_signed(c + d, 8) +
+			              settings.sharpness * (c - d);
+
+			const int rr = y + settings.ri * (ii) + settings.rq * (q);
+			const int gg = y + settings.gi * (ii) + settings.gq * (q);
+			const int bb = y + settings.bi * (ii) + settings.bq * (q);
+			++i;
+			++ap;
+			++bp;
+
+			const auto srgb = (byte_clamp(rr) << 16) |
+			                  (byte_clamp(gg) << 8) | byte_clamp(bb);
+
+			write_unaligned_uint32_at(line, idx++, srgb);
+		};
+
+		for (uint32_t x = 0; x < blocks; ++x) {
+			composite_convert(ap[0], bp[0]);
+			composite_convert(-bp[0], ap[0]);
+			composite_convert(-ap[0], -bp[0]);
+			composite_convert(bp[0], -ap[0]);
+		}
+	}
+}
+
+// The 4-bit decoder looks up both pixels of a byte at once from tables built
+// for the current palette; SSE2 has no byte shuffle to do the lookup with.
+struct PalettePairs {
+	std::array<uint8_t, 16> palette = {};
+	std::array<std::array<uint8_t, 2>, 256> pairs = {};
+	std::array<std::array<uint8_t, 4>, 256> doubled_pairs = {};
+	bool is_valid = false;
+};
+
+static const PalettePairs& get_palette_pairs(const uint8_t palette[16])
+{
+	static PalettePairs cache = {};
+
+	if (cache.is_valid &&
+	    std::memcmp(cache.palette.data(), palette, cache.palette.size()) == 0) {
+		return cache;
+	}
+	std::memcpy(cache.palette.data(), palette, cache.palette.size());
+
+	for (auto byte = 0; byte < 256; ++byte) {
+		const auto left  = palette[byte >> 4];
+		const auto right = palette[byte & 0x0f];
+
+		cache.pairs[byte]         = {left, right};
+		cache.doubled_pairs[byte] = {left, left, right, right};
+	}
+	cache.is_valid = true;
+	return cache;
+}
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+
+// Vectorised implementations
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#if defined(__SSE2__)
+using vec_u8x16_t = __m128i;
+using vec_i32x4_t = __m128i;
+
+static inline vec_u8x16_t load_u8x16(const uint8_t* p)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+static inline void store_u8x16(uint8_t* p, const vec_u8x16_t v)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+static inline vec_u8x16_t set1_u8x16(const uint8_t v)
+{
+	return _mm_set1_epi8(static_cast<char>(v));
+}
+
+// Returns each byte of 'v' twice: the low 8 bytes in 'lo' and the high 8
+// bytes in 'hi'
+static inline void double_u8x16(const vec_u8x16_t v, vec_u8x16_t& lo,
+                                vec_u8x16_t& hi)
+{
+	lo = _mm_unpacklo_epi8(v, v);
+	hi = _mm_unpackhi_epi8(v, v);
+}
+
+// Same as above for pairs of bytes
+static inline void double_u16x8(const vec_u8x16_t v, vec_u8x16_t& lo,
+                                vec_u8x16_t& hi)
+{
+	lo = _mm_unpacklo_epi16(v, v);
+	hi = _mm_unpackhi_epi16(v, v);
+}
+
+// Same as above for groups of four bytes
+static inline void double_u32x4(const vec_u8x16_t v, vec_u8x16_t& lo,
+                                vec_u8x16_t& hi)
+{
+	lo = _mm_unpacklo_epi32(v, v);
+	hi = _mm_unpackhi_epi32(v, v);
+}
+
+// Sets all bits of the bytes in 'v' that have any of the bits in 'bits' set
+static inline vec_u8x16_t test_bits_u8x16(const vec_u8x16_t v,
+                                          const vec_u8x16_t bits)
+{
+	const auto masked = _mm_and_si128(v, bits);
+	return _mm_andnot_si128(_mm_cmpeq_epi8(masked, _mm_setzero_si128()),
+	                        _mm_set1_epi8(-1));
+}
+
+// Picks the bytes of 'a' where 'mask' is set and those of 'b' elsewhere
+static inline vec_u8x16_t select_u8x16(const vec_u8x16_t mask,
+                                       const vec_u8x16_t a, const vec_u8x16_t b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline vec_i32x4_t load_i32x4(const int* p)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+static inline void store_i32x4(int* p, const vec_i32x4_t v)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+static inline vec_i32x4_t set_i32x4(const int a, const int b, const int c,
+                                    const int d)
+{
+	return _mm_setr_epi32(a, b, c, d);
+}
+
+static inline vec_i32x4_t add_i32x4(const vec_i32x4_t a, const vec_i32x4_t b)
+{
+	return _mm_add_epi32(a, b);
+}
+
+static inline vec_i32x4_t sub_i32x4(const vec_i32x4_t a, const vec_i32x4_t b)
+{
+	return _mm_sub_epi32(a, b);
+}
+
+// SSE2 lacks a 32-bit multiply keeping the low halves, so it's built from two
+// unsigned 32 x 32 -> 64-bit multiplies, which have the same low halves
+static inline vec_i32x4_t mul_i32x4(const vec_i32x4_t a, const vec_i32x4_t b)
+{
+	const auto even = _mm_mul_epu32(a, b);
+	const auto odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+                                       _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+template <int Bits>
+static inline vec_i32x4_t shl_i32x4(const vec_i32x4_t v)
+{
+	return _mm_slli_epi32(v, Bits);
+}
+
+static inline vec_i32x4_t select_i32x4(const vec_i32x4_t mask,
+                                       const vec_i32x4_t a, const vec_i32x4_t b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Negates the lanes of 'v' where 'mask' is all ones
+static inline vec_i32x4_t negate_i32x4(const vec_i32x4_t v,
+                                       const vec_i32x4_t mask)
+{
+	return _mm_sub_epi32(_mm_xor_si128(v, mask), mask);
+}
+
+// Stores four 32-bit RGB pixels from the unscaled components, applying the
+// same scaling and clamping as byte_clamp()
+static inline void store_rgb_x4(uint8_t* dest, const vec_i32x4_t r,
+                                const vec_i32x4_t g, const vec_i32x4_t b)
+{
+	const auto zero = _mm_setzero_si128();
+
+	// Saturate to 16 bits, then interleave into B, G, R, 0 order
+	const auto bg = _mm_packs_epi32(_mm_srai_epi32(b, 13),
+	                                _mm_srai_epi32(g, 13));
+	const auto r0 = _mm_packs_epi32(_mm_srai_epi32(r, 13), zero);
+
+	const auto bg_pairs = _mm_unpacklo_epi16(bg, _mm_srli_si128(bg, 8));
+	const auto r0_pairs = _mm_unpacklo_epi16(r0, zero);
+
+	const auto pixels_01 = _mm_unpacklo_epi32(bg_pairs, r0_pairs);
+	const auto pixels_23 = _mm_unpackhi_epi32(bg_pairs, r0_pairs);
+
+	// Saturating to unsigned bytes completes the clamping to [0, 255]
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+	                 _mm_packus_epi16(pixels_01, pixels_23));
+}
+
+#else // __ARM_NEON
+using vec_u8x16_t = uint8x16_t;
+using vec_i32x4_t = int32x4_t;
+
+static inline vec_u8x16_t load_u8x16(const uint8_t* p)
+{
+	return vld1q_u8(p);
+}
+
+static inline void store_u8x16(uint8_t* p, const vec_u8x16_t v)
+{
+	vst1q_u8(p, v);
+}
+
+static inline vec_u8x16_t set1_u8x16(const uint8_t v)
+{
+	return vdupq_n_u8(v);
+}
+
+static inline void double_u8x16(const vec_u8x16_t v, vec_u8x16_t& lo,
+                                vec_u8x16_t& hi)
+{
+	const auto zipped = vzipq_u8(v, v);
+	lo = zipped.val[0];
+	hi = zipped.val[1];
+}
+
+static inline void double_u16x8(const vec_u8x16_t v, vec_u8x16_t& lo,
+                                vec_u8x16_t& hi)
+{
+	const auto v16    = vreinterpretq_u16_u8(v);
+	const auto zipped = vzipq_u16(v16, v16);
+	lo = vreinterpretq_u8_u16(zipped.val[0]);
+	hi = vreinterpretq_u8_u16(zipped.val[1]);
+}
+
+static inline void double_u32x4(const vec_u8x16_t v, vec_u8x16_t& lo,
+                                vec_u8x16_t& hi)
+{
+	const auto v32    = vreinterpretq_u32_u8(v);
+	const auto zipped = vzipq_u32(v32, v32);
+	lo = vreinterpretq_u8_u32(zipped.val[0]);
+	hi = vreinterpretq_u8_u32(zipped.val[1]);
+}
+
+static inline vec_u8x16_t test_bits_u8x16(const vec_u8x16_t v,
+                                          const vec_u8x16_t bits)
+{
+	return vtstq_u8(v, bits);
+}
+
+static inline vec_u8x16_t select_u8x16(const vec_u8x16_t mask,
+                                       const vec_u8x16_t a, const vec_u8x16_t b)
+{
+	return vbslq_u8(mask, a, b);
+}
+
+static inline vec_i32x4_t load_i32x4(const int* p)
+{
+	return vld1q_s32(p);
+}
+
+static inline void store_i32x4(int* p, const vec_i32x4_t v)
+{
+	vst1q_s32(p, v);
+}
+
+static inline vec_i32x4_t set_i32x4(const int a, const int b, const int c,
+                                    const int d)
+{
+	const int values[4] = {a, b, c, d};
+	return vld1q_s32(values);
+}
+
+static inline vec_i32x4_t add_i32x4(const vec_i32x4_t a, const vec_i32x4_t b)
+{
+	return vaddq_s32(a, b);
+}
+
+static inline vec_i32x4_t sub_i32x4(const vec_i32x4_t a, const vec_i32x4_t b)
+{
+	return vsubq_s32(a, b);
+}
+
+static inline vec_i32x4_t mul_i32x4(const vec_i32x4_t a, const vec_i32x4_t b)
+{
+	return vmulq_s32(a, b);
+}
+
+template <int Bits>
+static inline vec_i32x4_t shl_i32x4(const vec_i32x4_t v)
+{
+	return vshlq_n_s32(v, Bits);
+}
+
+static inline vec_i32x4_t select_i32x4(const vec_i32x4_t mask,
+                                       const vec_i32x4_t a, const vec_i32x4_t b)
+{
+	return vbslq_s32(vreinterpretq_u32_s32(mask), a, b);
+}
+
+static inline vec_i32x4_t negate_i32x4(const vec_i32x4_t v,
+                                       const vec_i32x4_t mask)
+{
+	return vsubq_s32(veorq_s32(v, mask), mask);
+}
+
+static inline void store_rgb_x4(uint8_t* dest, const vec_i32x4_t r,
+                                const vec_i32x4_t g, const vec_i32x4_t b)
+{
+	const auto zero = vdupq_n_s32(0);
+	const auto max  = vdupq_n_s32(255);
+
+	auto clamp = [&](const vec_i32x4_t v) {
+		return vreinterpretq_u32_s32(
+		        vminq_s32(vmaxq_s32(vshrq_n_s32(v, 13), zero), max));
+	};
+	const auto pixels = vorrq_u32(vorrq_u32(vshlq_n_u32(clamp(r), 16),
+	                                        vshlq_n_u32(clamp(g), 8)),
+	                              clamp(b));
+
+	// The destination is 32-bit aligned, just like the scalar writes
+	vst1q_u32(reinterpret_cast<uint32_t*>(dest), pixels);
+}
+#endif
+
+static inline vec_i32x4_t set1_i32x4(const int v)
+{
+	return set_i32x4(v, v, v, v);
+}
+
+void CGA_Decode1Bpp(const uint8_t* src, const int num_bytes,
+                    const uint32_t table[16], uint8_t* dest)
+{
+	// All bytes of the first and last entries hold the two colours
+	const auto background = set1_u8x16(table[0x0] & 0xff);
+	const auto foreground = set1_u8x16(table[0xf] & 0xff);
+
+	alignas(16) static constexpr uint8_t bit_masks[16] = {
+	        0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	        0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+	const auto bits = load_u8x16(bit_masks);
+
+	auto x = 0;
+	for (; x + 16 <= num_bytes; x += 16) {
+		// Repeat every source byte 8 times, once per pixel
+		vec_u8x16_t twice[2];
+		double_u8x16(load_u8x16(src + x), twice[0], twice[1]);
+
+		for (const auto& v2 : twice) {
+			vec_u8x16_t fourfold[2];
+			double_u16x8(v2, fourfold[0], fourfold[1]);
+
+			for (const auto& v4 : fourfold) {
+				vec_u8x16_t eightfold[2];
+				double_u32x4(v4, eightfold[0], eightfold[1]);
+
+				for (const auto& v8 : eightfold) {
+					const auto is_set = test_bits_u8x16(v8, bits);
+					store_u8x16(dest,
+					            select_u8x16(is_set,
+					                         foreground,
+					                         background));
+					dest += 16;
+				}
+			}
+		}
+	}
+	CGA_Decode1BppScalar(src + x, num_bytes - x, table, dest);
+}
+
+void CGA_Decode2Bpp(const uint8_t* src, const int num_bytes,
+                    const uint32_t table[256], uint8_t* dest)
+{
+	// The entries with four identical pixels hold the colours
+	const auto color_0 = set1_u8x16(table[0x00] & 0xff);
+	const auto color_1 = set1_u8x16(table[0x55] & 0xff);
+	const auto color_2 = set1_u8x16(table[0xaa] & 0xff);
+	const auto color_3 = set1_u8x16(table[0xff] & 0xff);
+
+	alignas(16) static constexpr uint8_t high_bit_masks[16] = {
+	        0x80, 0x20, 0x08, 0x02, 0x80, 0x20, 0x08, 0x02,
+	        0x80, 0x20, 0x08, 0x02, 0x80, 0x20, 0x08, 0x02};
+	alignas(16) static constexpr uint8_t low_bit_masks[16] = {
+	        0x40, 0x10, 0x04, 0x01, 0x40, 0x10, 0x04, 0x01,
+	        0x40, 0x10, 0x04, 0x01, 0x40, 0x10, 0x04, 0x01};
+	const auto high_bits = load_u8x16(high_bit_masks);
+	const auto low_bits  = load_u8x16(low_bit_masks);
+
+	auto x = 0;
+	for (; x + 16 <= num_bytes; x += 16) {
+		// Repeat every source byte 4 times, once per pixel
+		vec_u8x16_t twice[2];
+		double_u8x16(load_u8x16(src + x), twice[0], twice[1]);
+
+		for (const auto& v2 : twice) {
+			vec_u8x16_t fourfold[2];
+			double_u16x8(v2, fourfold[0], fourfold[1]);
+
+			for (const auto& v4 : fourfold) {
+				const auto is_high = test_bits_u8x16(v4, high_bits);
+				const auto is_low  = test_bits_u8x16(v4, low_bits);
+
+				const auto pixels = select_u8x16(
+				        is_high,
+				        select_u8x16(is_low, color_3, color_2),
+				        select_u8x16(is_low, color_1, color_0));
+				store_u8x16(dest, pixels);
+				dest += 16;
+			}
+		}
+	}
+	CGA_Decode2BppScalar(src + x, num_bytes - x, table, dest);
+}
+
+void CGA_CompositeProcess(uint8_t* line, const uint8_t border,
+                          uint32_t blocks, const bool double_width,
+                          const CgaCompositeSettings& settings)
+{
+	// All rows have room for the vector loops reading and writing past
+	// their ends; the extra elements are never used
+	constexpr auto Padding = 16;
+
+	static int temp[SCALER_MAXWIDTH + 10 + Padding] = {0};
+	static int atemp[SCALER_MAXWIDTH + 2 + Padding] = {0};
+	static int btemp[SCALER_MAXWIDTH + 2 + Padding] = {0};
+	static int itemp[SCALER_MAXWIDTH + 2 + Padding] = {0};
+	static uint8_t doubled[SCALER_MAXWIDTH + Padding] = {0};
+
+	int w = blocks * 4;
+	assert(w * (double_width ? 2 : 1) <= SCALER_MAXWIDTH);
+
+	const uint8_t* rgbi = line;
+	if (double_width) {
+		auto x = 0;
+		for (; x + 16 <= w; x += 16) {
+			vec_u8x16_t lo = {};
+			vec_u8x16_t hi = {};
+			double_u8x16(load_u8x16(line + x), lo, hi);
+			store_u8x16(doubled + x * 2, lo);
+			store_u8x16(doubled + x * 2 + 16, hi);
+		}
+		for (; x < w; ++x) {
+			doubled[x * 2]     = line[x];
+			doubled[x * 2 + 1] = line[x];
+		}
+		rgbi = doubled;
+		blocks *= 2;
+		w *= 2;
+	}
+
+	// Simulate CGA composite output, exactly like the scalar version
+	const auto table = settings.table;
+	const int* b     = &table[border * 68];
+
+	int* o = temp;
+	for (int x = 0; x < 4; ++x) {
+		*o++ = b[(x + 3) & 3];
+	}
+	*o++ = table[(border << 6) | (rgbi[0] << 2) | 3];
+	for (int x = 0; x < w - 1; ++x) {
+		*o++ = table[(rgbi[x] << 6) | (rgbi[x + 1] << 2) | (x & 3)];
+	}
+	*o++ = table[(rgbi[w - 1] << 6) | (border << 2) | 3];
+	for (int x = 0; x < 5; ++x) {
+		*o++ = b[x & 3];
+	}
+
+	const auto sharpness = set1_i32x4(settings.sharpness);
+
+	// The luma of each pixel, from the pixel and its two neighbours
+	auto get_luma = [&](const vec_i32x4_t prev, const vec_i32x4_t curr,
+	                    const vec_i32x4_t next) {
+		const auto c = add_i32x4(curr, curr);
+		const auto d = add_i32x4(prev, next);
+		return add_i32x4(shl_i32x4<8>(add_i32x4(c, d)),
+		                 mul_i32x4(sharpness, sub_i32x4(c, d)));
+	};
+
+	// Pixel 'x' is at temp[x + 5]
+	const int* pixels = temp + 5;
+
+	if (settings.is_black_and_white) {
+		for (int x = 0; x < w; x += 4) {
+			const auto y = get_luma(shl_i32x4<3>(load_i32x4(pixels + x - 1)),
+			                        shl_i32x4<3>(load_i32x4(pixels + x)),
+			                        shl_i32x4<3>(load_i32x4(pixels + x + 1)));
+			store_rgb_x4(line + x * 4, y, y, y);
+		}
+		return;
+	}
+
+	// Store chroma for the pixels from -1 to 'w'
+	int* const ap = atemp + 1;
+	int* const bp = btemp + 1;
+	for (int x = -1; x < w + 1; x += 4) {
+		const auto i = pixels + x;
+
+		const auto a = add_i32x4(
+		        sub_i32x4(load_i32x4(i - 4),
+		                  shl_i32x4<1>(add_i32x4(sub_i32x4(load_i32x4(i - 2),
+		                                                   load_i32x4(i)),
+		                                         load_i32x4(i + 2)))),
+		        load_i32x4(i + 4));
+
+		const auto b = shl_i32x4<1>(sub_i32x4(
+		        add_i32x4(sub_i32x4(load_i32x4(i - 3), load_i32x4(i - 1)),
+		                  load_i32x4(i + 1)),
+		        load_i32x4(i + 3)));
+
+		store_i32x4(ap + x, a);
+		store_i32x4(bp + x, b);
+	}
+
+	// Remove the chroma from the same pixels
+	int* const ip = itemp + 1;
+	for (int x = -1; x < w + 1; x += 4) {
+		store_i32x4(ip + x,
+		            sub_i32x4(shl_i32x4<3>(load_i32x4(pixels + x)),
+		                      load_i32x4(ap + x)));
+	}
+
+	// Decode groups of four pixels, whose I and Q are taken from the
+	// chroma rotated through the four phases of the colour carrier:
+	// (a, b), (-b, a), (-a, -b) and (b, -a)
+	const auto even_lanes = set_i32x4(-1, 0, -1, 0);
+	const auto negated_i  = set_i32x4(0, -1, -1, 0);
+	const auto negated_q  = set_i32x4(0, 0, -1, -1);
+
+	const auto ri = set1_i32x4(settings.ri);
+	const auto rq = set1_i32x4(settings.rq);
+	const auto gi = set1_i32x4(settings.gi);
+	const auto gq = set1_i32x4(settings.gq);
+	const auto bi = set1_i32x4(settings.bi);
+	const auto bq = set1_i32x4(settings.bq);
+
+	for (int x = 0; x < w; x += 4) {
+		const auto y = get_luma(load_i32x4(ip + x - 1),
+		                        load_i32x4(ip + x),
+		                        load_i32x4(ip + x + 1));
+
+		const auto a = load_i32x4(ap + x);
+		const auto b = load_i32x4(bp + x);
+
+		const auto i = negate_i32x4(select_i32x4(even_lanes, a, b), negated_i);
+		const auto q = negate_i32x4(select_i32x4(even_lanes, b, a), negated_q);
+
+		const auto rr = add_i32x4(y, add_i32x4(mul_i32x4(ri, i), mul_i32x4(rq, q)));
+		const auto gg = add_i32x4(y, add_i32x4(mul_i32x4(gi, i), mul_i32x4(gq, q)));
+		const auto bb = add_i32x4(y, add_i32x4(mul_i32x4(bi, i), mul_i32x4(bq, q)));
+
+		store_rgb_x4(line + x * 4, rr, gg, bb);
+	}
+}
+
+#else
+
+void CGA_Decode1Bpp(const uint8_t* src, const int num_bytes,
+                    const uint32_t table[16], uint8_t* dest)
+{
+	CGA_Decode1BppScalar(src, num_bytes, table, dest);
+}
+
+void CGA_Decode2Bpp(const uint8_t* src, const int num_bytes,
+                    const uint32_t table[256], uint8_t* dest)
+{
+	CGA_Decode2BppScalar(src, num_bytes, table, dest);
+}
+
+void CGA_CompositeProcess(uint8_t* line, const uint8_t border,
+                          const uint32_t blocks, const bool double_width,
+                          const CgaCompositeSettings& settings)
+{
+	CGA_CompositeProcessScalar(line, border, blocks, double_width, settings);
+}
+
+#endif // __SSE2__ || __ARM_NEON
+
+void CGA_Decode4Bpp(const uint8_t* src, const int num_bytes,
+                    const uint8_t palette[16], const bool double_pixels,
+                    uint8_t* dest)
+{
+	const auto& lookup = get_palette_pairs(palette);
+
+	if (double_pixels) {
+		for (auto x = 0; x < num_bytes; ++x) {
+			std::memcpy(dest, lookup.doubled_pairs[src[x]].data(), 4);
+			dest += 4;
+		}
+	} else {
+		for (auto x = 0; x < num_bytes; ++x) {
+			std::memcpy(dest, lookup.pairs[src[x]].data(), 2);
+			dest += 2;
+		}
+	}
+}
@@ -21,6 +21,7 @@
 
 #include "inout.h"
 
+#include <array>
 #include <cassert>
 #include <limits>
 #include <cstring>
@@ -30,6 +31,8 @@
 #include "cpu.h"
 #include "../src/cpu/lazyflags.h"
 #include "callback.h"
+#include "perf_counters.h"
+#include "string_utils.h"
 
 //#define ENABLE_PORTLOG
 
@@ -163,8 +166,34 @@ void log_io(io_width_t width, bool write, io_port_t port, io_val_t val)
 #define log_io(W, X, Y, Z)
 #endif
 
+// Accesses per block of 16 ports for the performance counters, which is
+// enough to tell most devices apart
+constexpr int PortsPerBlock = 16;
+static std::array<uint64_t, 0x10000 / PortsPerBlock> port_block_accesses = {};
+
+static inline void count_port_access(const io_port_t port)
+{
+	if (PERF_IsEnabled()) {
+		++port_block_accesses[port / PortsPerBlock];
+	}
+}
+
+static void report_port_accesses(std::vector<PerfSample>& samples)
+{
+	for (size_t i = 0; i < port_block_accesses.size(); ++i) {
+		if (port_block_accesses[i]) {
+			const auto first_port = i * PortsPerBlock;
+			samples.push_back({format_string("io.ports.%04zx-%04zx",
+			                                 first_port,
+			                                 first_port + PortsPerBlock - 1),
+			                   port_block_accesses[i]});
+		}
+	}
+}
+
 void IO_WriteB(io_port_t port, uint8_t val)
 {
+	count_port_access(port);
 	log_io(io_width_t::byte, true, port, val);
 	if (GCC_UNLIKELY(GETFLAG(VM) && (CPU_IO_Exception(port,1)))) {
 		const auto old_lflags = lflags;
@@ -200,6 +229,7 @@ void IO_WriteB(io_port_t port, uint8_t val)
 
 void IO_WriteW(io_port_t port, uint16_t val)
 {
+	count_port_access(port);
 	log_io(io_width_t::word, true, port, val);
 	if (GCC_UNLIKELY(GETFLAG(VM) && (CPU_IO_Exception(port,2)))) {
 		const auto old_lflags = lflags;
@@ -235,6 +265,7 @@ void IO_WriteW(io_port_t port, uint16_t val)
 
 void IO_WriteD(io_port_t port, uint32_t val)
 {
+	count_port_access(port);
 	log_io(io_width_t::dword, true, port, val);
 	if (GCC_UNLIKELY(GETFLAG(VM) && (CPU_IO_Exception(port,4)))) {
 		const auto old_lflags = lflags;
@@ -268,6 +299,7 @@ void IO_WriteD(io_port_t port, uint32_t val)
 
 uint8_t IO_ReadB(io_port_t port)
 {
+	count_port_access(port);
 	uint8_t retval;
 	if (GCC_UNLIKELY(GETFLAG(VM) && (CPU_IO_Exception(port,1)))) {
 		const auto old_lflags = lflags;
@@ -306,6 +338,7 @@ uint8_t IO_ReadB(io_port_t port)
 
 uint16_t IO_ReadW(io_port_t port)
 {
+	count_port_access(port);
 	uint16_t retval;
 	if (GCC_UNLIKELY(GETFLAG(VM) && (CPU_IO_Exception(port,2)))) {
 		const auto old_lflags = lflags;
@@ -343,6 +376,7 @@ uint16_t IO_ReadW(io_port_t port)
 
 uint32_t IO_ReadD(io_port_t port)
 {
+	count_port_access(port);
 	uint32_t retval;
 	if (GCC_UNLIKELY(GETFLAG(VM) && (CPU_IO_Exception(port,4)))) {
 		const auto old_lflags = lflags;
@@ -413,4 +447,6 @@ void IO_Destroy(Section*) {
 void IO_Init(Section * sect) {
 	test = new IO(sect);
 	sect->AddDestroyFunction(&IO_Destroy);
+
+	PERF_AddProvider(&report_port_accesses);
 }
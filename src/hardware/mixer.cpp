@@ -35,6 +35,7 @@
 #include <speex/speex_resampler.h>
 
 #include "../capture/capture.h"
+#include "benchmark.h"
 #include "channel_names.h"
 #include "checks.h"
 #include "control.h"
@@ -44,6 +45,7 @@
 #include "math_utils.h"
 #include "mem.h"
 #include "midi.h"
+#include "perf_counters.h"
 #include "pic.h"
 #include "setup.h"
 #include "string_utils.h"
@@ -203,6 +205,8 @@ struct MixerSettings {
 	bool do_chorus        = false;
 
 	bool is_manually_muted = false;
+
+	std::atomic<bool> is_fast_forwarding = false;
 };
 
 static struct MixerSettings mixer = {};
@@ -1026,6 +1030,9 @@ void MixerChannel::Mix(const uint16_t frames_requested)
 	if (!is_enabled) {
 		return;
 	}
+	if (PERF_IsEnabled()) {
+		num_frames_mixed += frames_requested;
+	}
 
 	frames_needed = frames_requested;
 
@@ -1838,6 +1845,34 @@ bool MixerChannel::WakeUp()
 	return sleeper.WakeUp();
 }
 
+// Picks the nearest input frame for every output frame; plenty for audio
+// that's played many times faster than normal, and far cheaper than the
+// regular resamplers
+void MixerChannel::ResampleNearest()
+{
+	// The zero-order hold has already upsampled the input to its target
+	// rate, same as what the Speex resampler is configured with
+	const auto in_rate = do_zoh_upsample ? zoh_upsampler.target_freq
+	                                     : sample_rate;
+
+	const auto step = static_cast<float>(in_rate) /
+	                  static_cast<float>(mixer.sample_rate.load());
+
+	const auto& in        = mixer.resample_temp;
+	const auto in_frames  = static_cast<float>(in.size() / 2);
+	auto& out             = mixer.resample_out;
+	auto& pos             = nearest_resampler.pos;
+
+	out.resize(0);
+	while (pos < in_frames) {
+		const auto i = static_cast<size_t>(pos) * 2;
+		out.emplace_back(in[i]);
+		out.emplace_back(in[i + 1]);
+		pos += step;
+	}
+	pos -= in_frames;
+}
+
 template <class Type, bool stereo, bool signeddata, bool nativeorder>
 void MixerChannel::AddSamples(const uint16_t frames, const Type* data)
 {
@@ -1848,7 +1883,20 @@ void MixerChannel::AddSamples(const uint16_t frames, const Type* data)
 	auto& convert_out = do_resample ? mixer.resample_temp : mixer.resample_out;
 	ConvertSamples<Type, stereo, signeddata, nativeorder>(data, frames, convert_out);
 
-	if (do_resample) {
+	const auto is_fast_forwarding = mixer.is_fast_forwarding.load();
+
+	if (do_resample && is_fast_forwarding) {
+		ResampleNearest();
+		nearest_resampler.is_active = true;
+
+	} else if (do_resample) {
+		// Start from a clean state after fast-forwarding as the regular
+		// resamplers haven't seen the skipped input
+		if (nearest_resampler.is_active) {
+			ClearResampler();
+			nearest_resampler = {};
+		}
+
 		switch (resample_method) {
 		case ResampleMethod::LinearInterpolation: {
 			auto& s = lerp_upsampler;
@@ -1941,32 +1989,37 @@ void MixerChannel::AddSamples(const uint16_t frames, const Type* data)
 	auto mixpos = check_cast<work_index_t>((mixer.pos + frames_done) &
 	                                       MixerBufferMask);
 
+	// Fast-forwarded audio only needs to stay in step with the emulation
+	const auto do_filters_and_effects = !is_fast_forwarding;
+
 	while (pos != mixer.resample_out.end()) {
 		AudioFrame frame = {*pos++, *pos++};
 
-		if (do_highpass_filter) {
-			frame.left = filters.highpass.hpf[0].filter(frame.left);
-			frame.right = filters.highpass.hpf[1].filter(frame.right);
-		}
-		if (do_lowpass_filter) {
-			frame.left = filters.lowpass.lpf[0].filter(frame.left);
-			frame.right = filters.lowpass.lpf[1].filter(frame.right);
-		}
-		if (do_crossfeed) {
-			frame = ApplyCrossfeed(frame);
-		}
+		if (do_filters_and_effects) {
+			if (do_highpass_filter) {
+				frame.left = filters.highpass.hpf[0].filter(frame.left);
+				frame.right = filters.highpass.hpf[1].filter(frame.right);
+			}
+			if (do_lowpass_filter) {
+				frame.left = filters.lowpass.lpf[0].filter(frame.left);
+				frame.right = filters.lowpass.lpf[1].filter(frame.right);
+			}
+			if (do_crossfeed) {
+				frame = ApplyCrossfeed(frame);
+			}
 
-		if (do_reverb_send) {
-			// Mix samples to the reverb aux buffer, scaled by the
-			// reverb send volume
-			mixer.aux_reverb[mixpos][0] += frame.left * reverb.send_gain;
-			mixer.aux_reverb[mixpos][1] += frame.right * reverb.send_gain;
-		}
-		if (do_chorus_send) {
-			// Mix samples to the chorus aux buffer, scaled by the
-			// chorus send volume
-			mixer.aux_chorus[mixpos][0] += frame.left * chorus.send_gain;
-			mixer.aux_chorus[mixpos][1] += frame.right * chorus.send_gain;
+			if (do_reverb_send) {
+				// Mix samples to the reverb aux buffer, scaled by the
+				// reverb send volume
+				mixer.aux_reverb[mixpos][0] += frame.left * reverb.send_gain;
+				mixer.aux_reverb[mixpos][1] += frame.right * reverb.send_gain;
+			}
+			if (do_chorus_send) {
+				// Mix samples to the chorus aux buffer, scaled by the
+				// chorus send volume
+				mixer.aux_chorus[mixpos][0] += frame.left * chorus.send_gain;
+				mixer.aux_chorus[mixpos][1] += frame.right * chorus.send_gain;
+			}
 		}
 
 		if (do_sleep) {
@@ -2229,7 +2282,11 @@ static void mix_samples(const int frames_requested)
 		channel->Mix(check_cast<work_index_t>(frames_requested));
 	}
 
-	if (mixer.do_reverb) {
+	// Fast-forwarded audio is only a rough preview, so the master effects
+	// and filters are skipped
+	const auto do_effects = !mixer.is_fast_forwarding.load();
+
+	if (mixer.do_reverb && do_effects) {
 		// Apply reverb effect to the reverb aux buffer, then mix the
 		// results to the master output
 		auto pos = start_pos;
@@ -2264,7 +2321,7 @@ static void mix_samples(const int frames_requested)
 		}
 	}
 
-	if (mixer.do_chorus) {
+	if (mixer.do_chorus && do_effects) {
 		// Apply chorus effect to the chorus aux buffer, then mix the
 		// results to the master output
 		auto pos = start_pos;
@@ -2285,15 +2342,17 @@ static void mix_samples(const int frames_requested)
 	// Apply high-pass filter to the master output
 	auto pos = start_pos;
 
-	for (work_index_t i = 0; i < frames_added; ++i) {
-		for (size_t ch = 0; ch < 2; ++ch) {
-			mixer.work[pos][ch] = mixer.highpass_filter[ch].filter(
-			        mixer.work[pos][ch]);
+	if (do_effects) {
+		for (work_index_t i = 0; i < frames_added; ++i) {
+			for (size_t ch = 0; ch < 2; ++ch) {
+				mixer.work[pos][ch] = mixer.highpass_filter[ch].filter(
+				        mixer.work[pos][ch]);
+			}
+			pos = (pos + 1) & MixerBufferMask;
 		}
-		pos = (pos + 1) & MixerBufferMask;
 	}
 
-	if (mixer.do_compressor) {
+	if (mixer.do_compressor && do_effects) {
 		// Apply compressor to the master output as the very last step
 		pos = start_pos;
 
@@ -2309,8 +2368,12 @@ static void mix_samples(const int frames_requested)
 		}
 	}
 
-	// Capture audio output if requested
-	if (CAPTURE_IsCapturingAudio() || CAPTURE_IsCapturingVideo()) {
+	// Capture audio output if requested, or hash it when benchmarking
+	const auto is_capturing = CAPTURE_IsCapturingAudio() ||
+	                          CAPTURE_IsCapturingVideo() ||
+	                          CAPTURE_IsRecordingReplay();
+
+	if (is_capturing || BENCHMARK_IsEnabled()) {
 		int16_t out[capture_buf_frames][2];
 		auto pos = start_pos;
 
@@ -2327,9 +2390,15 @@ static void mix_samples(const int frames_requested)
 			pos = (pos + 1) & MixerBufferMask;
 		}
 
-		CAPTURE_AddAudioData(mixer.sample_rate,
-		                     frames_added,
-		                     reinterpret_cast<int16_t*>(out));
+		if (is_capturing) {
+			CAPTURE_AddAudioData(mixer.sample_rate,
+			                     frames_added,
+			                     reinterpret_cast<int16_t*>(out));
+		}
+		if (BENCHMARK_IsEnabled()) {
+			BENCHMARK_AddAudio(reinterpret_cast<int16_t*>(out),
+			                   frames_added);
+		}
 	}
 
 	// Reset the tick_add for constant speed
@@ -2753,10 +2822,23 @@ static void init_master_highpass_filter()
 	}
 }
 
+static void report_mixed_frames(std::vector<PerfSample>& samples)
+{
+	for (const auto& [name, channel] : mixer.channels) {
+		samples.push_back({"mixer.frames." + name, channel->num_frames_mixed});
+	}
+}
+
 void MIXER_Init(Section* sec)
 {
 	MIXER_CloseAudioDevice();
 
+	static bool is_perf_provider_added = false;
+	if (!is_perf_provider_added) {
+		PERF_AddProvider(&report_mixed_frames);
+		is_perf_provider_added = true;
+	}
+
 	sec->AddDestroyFunction(&stop_mixer);
 
 	Section_prop* section = static_cast<Section_prop*>(sec);
@@ -2841,6 +2923,17 @@ void MIXER_Unmute()
 	}
 }
 
+void MIXER_SetFastForward(const bool is_fast_forwarding)
+{
+	if (mixer.is_fast_forwarding == is_fast_forwarding) {
+		return;
+	}
+	mixer.is_fast_forwarding = is_fast_forwarding;
+
+	LOG_MSG("MIXER: %s fast-forward audio",
+	        is_fast_forwarding ? "Enabled" : "Disabled");
+}
+
 bool MIXER_IsManuallyMuted()
 {
 	return mixer.is_manually_muted;
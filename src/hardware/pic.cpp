@@ -20,6 +20,7 @@
 #include "inout.h"
 #include "cpu.h"
 #include "callback.h"
+#include "perf_counters.h"
 #include "pic.h"
 #include "timer.h"
 #include "setup.h"
@@ -517,6 +518,8 @@ void PIC_RemoveEvents(PIC_EventHandler handler) {
 }
 
 
+static PerfCounter events_serviced("pic.events");
+
 bool PIC_RunQueue(void) {
 	/* Check to see if a new millisecond needs to be started */
 	CPU_CycleLeft+=CPU_Cycles;
@@ -536,6 +539,7 @@ bool PIC_RunQueue(void) {
 
 		srv_lag = entry->index;
 		(entry->pic_event)(entry->value); // call the event handler
+		events_serviced.Add();
 
 		/* Put the entry in the free list */
 		entry->next=pic_queue.free_entry;
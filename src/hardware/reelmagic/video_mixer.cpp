@@ -25,12 +25,14 @@
 
 #include "reelmagic.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
 #include <exception>
 #include <string>
+#include <vector>
 
 #include "../../gui/render_scalers.h" //SCALER_MAXWIDTH SCALER_MAXHEIGHT
 #include "rgb565.h"
@@ -191,9 +193,10 @@ uint8_t VGAOverPalettePixel::_alphaChannelIndex      = 0;
 static ImageInfo _vgaImageInfo    = {};
 static double _vgaFramesPerSecond = 0.0;
 
-// state captured from current/active MPEG player
-static PlayerPicturePixel _mpegPictureBuffer[SCALER_MAXWIDTH * SCALER_MAXHEIGHT];
-static PlayerPicturePixel* _mpegPictureBufferPtr = _mpegPictureBuffer;
+// state captured from current/active MPEG player; the picture buffer is only
+// allocated once a player is pushed, and freed with the video mixer disabled
+static std::vector<PlayerPicturePixel> _mpegPictureBuffer = {};
+static PlayerPicturePixel* _mpegPictureBufferPtr = nullptr;
 
 static uint32_t _mpegPictureWidth  = 0;
 static uint32_t _mpegPictureHeight = 0;
@@ -245,8 +248,7 @@ static inline void MixPixel(RenderOutputPixel& out, const VGAPixelT& vga)
 
 static void ClearMpegPictureBuffer(const PlayerPicturePixel p)
 {
-	for (Bitu i = 0; i < (sizeof(_mpegPictureBuffer) / sizeof(_mpegPictureBuffer[0])); ++i)
-		_mpegPictureBuffer[i] = p;
+	std::fill(_mpegPictureBuffer.begin(), _mpegPictureBuffer.end(), p);
 }
 
 static void ClearMpegPictureBuffer()
@@ -463,9 +465,10 @@ static inline void RMR_DrawLine_VSO_GeneralResizeMPEGToVGA(const T* src)
 		         src[i],
 		         _mpegPictureBufferPtr[(i * _RMR_DrawLine_VSO_GeneralResizeMPEGToVGA_WidthRatio) >> 12]);
 	_mpegPictureBufferPtr =
-	        &_mpegPictureBuffer[_mpegPictureWidth * ((++_currentRenderLineNumber *
-	                                                  _RMR_DrawLine_VSO_GeneralResizeMPEGToVGA_HeightRatio) >>
-	                                                 12)];
+	        _mpegPictureBuffer.data() +
+	        _mpegPictureWidth * ((++_currentRenderLineNumber *
+	                              _RMR_DrawLine_VSO_GeneralResizeMPEGToVGA_HeightRatio) >>
+	                             12);
 	RENDER_DrawLine(_finalMixedRenderLineBuffer);
 }
 CREATE_RMR_VGA_TYPED_FUNCTIONS(RMR_DrawLine_VSO_GeneralResizeMPEGToVGA)
@@ -629,11 +632,11 @@ bool ReelMagic_RENDER_StartUpdate(void)
 {
 	if (_activeMpegProvider) {
 		VGAOverPalettePixel::_alphaChannelIndex = _activeMpegProvider->GetConfig().VgaAlphaIndex;
-		_activeMpegProvider->OnVerticalRefresh(_mpegPictureBuffer,
+		_activeMpegProvider->OnVerticalRefresh(_mpegPictureBuffer.data(),
 		                                       static_cast<float>(_vgaFramesPerSecond));
 	}
 	_currentRenderLineNumber = 0;
-	_mpegPictureBufferPtr    = _mpegPictureBuffer;
+	_mpegPictureBufferPtr    = _mpegPictureBuffer.data();
 	return RENDER_StartUpdate();
 }
 
@@ -659,6 +662,12 @@ void ReelMagic_SetVideoMixerEnabled(const bool enabled)
 
 	constexpr auto update_render_mode = true;
 	setup_video_mixer(update_render_mode);
+
+	// No player can be active while disabled, so give the memory back
+	if (!enabled) {
+		_mpegPictureBuffer    = {};
+		_mpegPictureBufferPtr = nullptr;
+	}
 }
 
 ReelMagic_VideoMixerMPEGProvider* ReelMagic_GetVideoMixerMPEGProvider()
@@ -686,6 +695,12 @@ void ReelMagic_SetVideoMixerMPEGProvider(ReelMagic_VideoMixerMPEGProvider* const
 		return;
 	}
 
+	// Allocated for the largest picture up front, so replacing a provider
+	// mid-frame never moves the buffer
+	if (_mpegPictureBuffer.empty()) {
+		_mpegPictureBuffer.resize(SCALER_MAXWIDTH * SCALER_MAXHEIGHT);
+	}
+
 	// clear the MPEG picture buffer when not replacing an existing provider
 	if (!_requestedMpegProvider) {
 		ClearMpegPictureBuffer();
@@ -58,6 +58,7 @@ void VGA_LogInitialization(const char *adapter_name,
 void VGA_SetModeNow(VGAModes mode) {
 	if (vga.mode == mode) return;
 	vga.mode=mode;
+	vga.draw.has_mid_frame_palette_changes = false;
 	VGA_SetupHandlers();
 	VGA_StartResizeAfter(0);
 }
@@ -66,6 +67,7 @@ void VGA_SetModeNow(VGAModes mode) {
 void VGA_SetMode(VGAModes mode) {
 	if (vga.mode == mode) return;
 	vga.mode=mode;
+	vga.draw.has_mid_frame_palette_changes = false;
 	VGA_SetupHandlers();
 	VGA_StartResize();
 }
@@ -394,6 +396,11 @@ void VGA_Init(Section* sec)
 {
 	vga.draw.resizing = false;
 	vga.mode          = M_ERROR; // For first init
+
+	const auto section = static_cast<Section_prop*>(control->GetSection("dosbox"));
+	assert(section);
+	vga.draw.full_playfield.enabled = section->Get_bool("vga_full_playfield");
+	vga.changes.skip_unchanged = section->Get_bool("vga_render_skip");
 	SVGA_Setup_Driver();
 	VGA_SetupMemory(sec);
 	VGA_SetupMisc();
@@ -353,7 +353,10 @@ void vga_write_p3d5(io_port_t, io_val_t value, io_width_t)
 		//      for byte mode, 4 for word mode and 8 for Double Word mode.
 		break;
 
-	case 0x14: // Underline Location Register
+	case 0x14: { // Underline Location Register
+		// Chained mode 13h is only drawn from vga.fastmem in dword mode,
+		// which decides whether its window can be mapped directly
+		const bool is_dword_mode_changed = (vga.crtc.underline_location ^ val) & 0x40;
 		vga.crtc.underline_location = val;
 		if (IS_VGA_ARCH) {
 			// Byte,word,dword mode
@@ -367,12 +370,16 @@ void vga_write_p3d5(io_port_t, io_val_t value, io_width_t)
 		} else {
 			vga.config.addr_shift = 1;
 		}
+		if (IS_VGA_ARCH && is_dword_mode_changed && vga.mode == M_VGA) {
+			VGA_SetupHandlers();
+		}
 
 		// 0-4	Position of underline within Character cell.
 		// 5	If set memory address is only changed every fourth character
 		// 		clock.
 		// 6	Double Word mode addressing if set.
 		break;
+	}
 
 	case 0x15: // Start Vertical Blank Register
 		if (val != vga.crtc.start_vertical_blanking) {
@@ -88,6 +88,17 @@ static void vga_dac_send_color(const uint8_t palette_idx, const uint8_t color_id
 
 	// Map the source color into palette's requested index
 	vga.dac.palette_map[palette_idx].Set(b8, g8, r8);
+	++vga.dac.palette_map_generation;
+
+	// The renderer's palette is only applied once per frame, so switch
+	// to per-line colour expansion if the palette changes mid-frame
+	const auto is_mid_frame = vga.draw.lines_done > 0 &&
+	                          vga.draw.lines_done < vga.draw.lines_total;
+	if (vga.mode == M_VGA && is_mid_frame &&
+	    !vga.draw.has_mid_frame_palette_changes) {
+		vga.draw.has_mid_frame_palette_changes = true;
+		VGA_StartResize();
+	}
 
 	ReelMagic_RENDER_SetPalette(palette_idx, r8, g8, b8);
 }
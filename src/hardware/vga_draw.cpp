@@ -23,15 +23,24 @@
 
 #include <algorithm>
 #include <array>
+#include <climits>
 #include <cmath>
 #include <cstring>
 #include <utility>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "../gui/render_scalers.h"
 #include "../ints/int10.h"
 #include "bitops.h"
+#include "cga_line_decoders.h"
 #include "math_utils.h"
 #include "mem_unaligned.h"
+#include "perf_counters.h"
 #include "pic.h"
 #include "reelmagic.h"
 #include "render.h"
@@ -58,27 +67,41 @@ constexpr auto max_line_bytes  = SCALER_MAXWIDTH * max_pixel_bytes;
 alignas(uint32_t) static std::array<uint8_t, max_line_bytes> templine_buffer;
 static auto TempLine = templine_buffer.data();
 
+// Returns the 'num_bytes' of video memory at 'vidstart' in one contiguous
+// block, copying them out first if they wrap around the address mask
+static const uint8_t* get_line_bytes(const uint8_t* base, const Bitu vidstart,
+                                     const Bitu addr_mask, const Bitu num_bytes)
+{
+	const auto offset = vidstart & addr_mask;
+	if (num_bytes == 0 || addr_mask - offset >= num_bytes - 1) {
+		return base + offset;
+	}
+	static std::array<uint8_t, SCALER_MAXWIDTH> wrapped_bytes = {};
+	assert(num_bytes <= wrapped_bytes.size());
+
+	for (Bitu i = 0; i < num_bytes; ++i) {
+		wrapped_bytes[i] = base[(vidstart + i) & addr_mask];
+	}
+	return wrapped_bytes.data();
+}
+
 static uint8_t * VGA_Draw_1BPP_Line(Bitu vidstart, Bitu line) {
 	const uint8_t *base = vga.tandy.draw_base + ((line & vga.tandy.line_mask) << vga.tandy.line_shift);
 
-	uint16_t i = 0;
-	for (Bitu x = vga.draw.blocks; x > 0; --x, ++vidstart) {
-		Bitu val = base[(vidstart & (8 * 1024 -1))];
-		write_unaligned_uint32_at(TempLine, i++, CGA_2_Table[val >> 4]);
-		write_unaligned_uint32_at(TempLine, i++, CGA_2_Table[val & 0xf]);
-	}
+	const auto num_bytes = vga.draw.blocks;
+	const auto src = get_line_bytes(base, vidstart, 8 * 1024 - 1, num_bytes);
+
+	CGA_Decode1Bpp(src, check_cast<int>(num_bytes), CGA_2_Table, TempLine);
 	return TempLine;
 }
 
 static uint8_t * VGA_Draw_2BPP_Line(Bitu vidstart, Bitu line) {
 	const uint8_t *base = vga.tandy.draw_base + ((line & vga.tandy.line_mask) << vga.tandy.line_shift);
 
-	uint16_t i = 0;
-	for (Bitu x = 0; x < vga.draw.blocks; ++x) {
-		Bitu val = base[vidstart & vga.tandy.addr_mask];
-		++vidstart;
-		write_unaligned_uint32_at(TempLine, i++, CGA_4_Table[val]);
-	}
+	const auto num_bytes = vga.draw.blocks;
+	const auto src = get_line_bytes(base, vidstart, vga.tandy.addr_mask, num_bytes);
+
+	CGA_Decode2Bpp(src, check_cast<int>(num_bytes), CGA_4_Table, TempLine);
 	return TempLine;
 }
 
@@ -142,116 +165,22 @@ static uint8_t *VGA_Draw_CGA16_Line(Bitu vidstart, Bitu line)
 	return TempLine;
 }
 
-static uint8_t byte_clamp(int v)
-{
-	v >>= 13;
-	return v < 0 ? 0u : (v > 255 ? 255u : static_cast<uint8_t>(v));
-}
-
 static uint8_t *Composite_Process(uint8_t border, uint32_t blocks, bool double_width)
 {
-	static int temp[SCALER_MAXWIDTH + 10] = {0};
-	static int atemp[SCALER_MAXWIDTH + 2] = {0};
-	static int btemp[SCALER_MAXWIDTH + 2] = {0};
-
-	int w = blocks * 4;
-
-	if (double_width) {
-		uint8_t *source = TempLine + w - 1;
-		uint8_t *dest = TempLine + w * 2 - 2;
-		for (int x = 0; x < w; ++x) {
-			*dest = *source;
-			*(dest + 1) = *source;
-			--source;
-			dest -= 2;
-		}
-		blocks *= 2;
-		w *= 2;
-	}
-
-	// Simulate CGA composite output
-	int *o = temp;
-	auto push_pixel = [&o](const int v) {
-		*o = v;
-		++o;
-	};
-
-	uint8_t *rgbi = TempLine;
-	int *b = &CGA_Composite_Table[border * 68];
-	for (int x = 0; x < 4; ++x)
-		push_pixel(b[(x + 3) & 3]);
-	push_pixel(CGA_Composite_Table[(border << 6) | ((*rgbi) << 2) | 3]);
-	for (int x = 0; x < w - 1; ++x) {
-		push_pixel(CGA_Composite_Table[(rgbi[0] << 6) | (rgbi[1] << 2) | (x & 3)]);
-		++rgbi;
-	}
-	push_pixel(CGA_Composite_Table[((*rgbi) << 6) | (border << 2) | 3]);
-	for (int x = 0; x < 5; ++x)
-		push_pixel(b[x & 3]);
-
-	if (vga.tandy.mode.is_black_and_white_mode) {
-		// Decode
-		int *i = temp + 5;
-		uint16_t idx = 0;
-		for (uint32_t x = 0; x < blocks * 4; ++x) {
-			int c = (i[0] + i[0]) << 3;
-			int d = (i[-1] + i[1]) << 3;
-			int y = ((c + d) << 8) + vga.composite.sharpness * (c - d);
-			++i;
-			write_unaligned_uint32_at(TempLine, idx++,
-			                          byte_clamp(y) * 0x10101);
-		}
-	} else {
-		// Store chroma
-		int *i = temp + 4;
-		int *ap = atemp + 1;
-		int *bp = btemp + 1;
-		for (int x = -1; x < w + 1; ++x) {
-			ap[x] = i[-4] - left_shift_signed(i[-2] - i[0] + i[2], 1) + i[4];
-			bp[x] = left_shift_signed(i[-3] - i[-1] + i[1] - i[3], 1);
-			++i;
-		}
-
-		// Decode
-		i = temp + 5;
-		i[-1] = (i[-1] << 3) - ap[-1];
-		i[0] = (i[0] << 3) - ap[0];
-
-		uint16_t idx = 0;
-
-		auto composite_convert = [&](const int ii, const int q) {
-			i[1]        = (i[1] << 3) - ap[1];
-			const int c = i[0] + i[0];
-			const int d = i[-1] + i[1];
-
-			const int y = left_shift_signed(c + d, 8) +
-			              vga.composite.sharpness * (c - d);
-
-			const int rr = y + vga.composite.ri * (ii) +
-			               vga.composite.rq * (q);
+	CgaCompositeSettings settings = {};
 
-			const int gg = y + vga.composite.gi * (ii) +
-			               vga.composite.gq * (q);
+	settings.table     = CGA_Composite_Table;
+	settings.ri        = vga.composite.ri;
+	settings.rq        = vga.composite.rq;
+	settings.gi        = vga.composite.gi;
+	settings.gq        = vga.composite.gq;
+	settings.bi        = vga.composite.bi;
+	settings.bq        = vga.composite.bq;
+	settings.sharpness = vga.composite.sharpness;
 
-			const int bb = y + vga.composite.bi * (ii) +
-			               vga.composite.bq * (q);
-			++i;
-			++ap;
-			++bp;
+	settings.is_black_and_white = vga.tandy.mode.is_black_and_white_mode;
 
-			const auto srgb = (byte_clamp(rr) << 16) |
-			                  (byte_clamp(gg) << 8) | byte_clamp(bb);
-
-			write_unaligned_uint32_at(TempLine, idx++, srgb);
-		};
-
-		for (uint32_t x = 0; x < blocks; ++x) {
-			composite_convert(ap[0], bp[0]);
-			composite_convert(-bp[0], ap[0]);
-			composite_convert(-ap[0], -bp[0]);
-			composite_convert(bp[0], -ap[0]);
-		}
-	}
+	CGA_CompositeProcess(TempLine, border, blocks, double_width, settings);
 	return TempLine;
 }
 
@@ -279,58 +208,113 @@ static uint8_t *VGA_Draw_CGA4_Composite_Line(Bitu vidstart, Bitu line)
 
 static uint8_t * VGA_Draw_4BPP_Line(Bitu vidstart, Bitu line) {
 	const uint8_t *base = vga.tandy.draw_base + ((line & vga.tandy.line_mask) << vga.tandy.line_shift);
-	uint8_t* draw=TempLine;
-	Bitu end = vga.draw.blocks*2;
-	while(end) {
-		uint8_t byte = base[vidstart & vga.tandy.addr_mask];
-		*draw++=vga.attr.palette[byte >> 4];
-		*draw++=vga.attr.palette[byte & 0x0f];
-		++vidstart;
-		--end;
-	}
+
+	const auto num_bytes = vga.draw.blocks * 2;
+	const auto src = get_line_bytes(base, vidstart, vga.tandy.addr_mask, num_bytes);
+
+	CGA_Decode4Bpp(src, check_cast<int>(num_bytes), vga.attr.palette, false, TempLine);
 	return TempLine;
 }
 
 static uint8_t * VGA_Draw_4BPP_Line_Double(Bitu vidstart, Bitu line) {
 	const uint8_t *base = vga.tandy.draw_base + ((line & vga.tandy.line_mask) << vga.tandy.line_shift);
-	uint8_t* draw=TempLine;
-	Bitu end = vga.draw.blocks;
-	while(end) {
-		uint8_t byte = base[vidstart & vga.tandy.addr_mask];
-		uint8_t data = vga.attr.palette[byte >> 4];
-		*draw++ = data; *draw++ = data;
-		data = vga.attr.palette[byte & 0x0f];
-		*draw++ = data; *draw++ = data;
-		++vidstart;
-		--end;
-	}
+
+	const auto num_bytes = vga.draw.blocks;
+	const auto src = get_line_bytes(base, vidstart, vga.tandy.addr_mask, num_bytes);
+
+	CGA_Decode4Bpp(src, check_cast<int>(num_bytes), vga.attr.palette, true, TempLine);
 	return TempLine;
 }
 
 #ifdef VGA_KEEP_CHANGES
-static uint8_t * VGA_Draw_Changes_Line(Bitu vidstart, Bitu line) {
-	Bitu checkMask = vga.changes.checkMask;
-	uint8_t *map = vga.changes.map;
-	Bitu start = (vidstart >> VGA_CHANGE_SHIFT);
-	Bitu end = ((vidstart + vga.draw.line_length ) >> VGA_CHANGE_SHIFT);
-	for (; start <= end; ++start) {
-		if ( map[start] & checkMask ) {
-			Bitu offset = vidstart & vga.draw.linear_mask;
-			if (vga.draw.linear_mask-offset < vga.draw.line_length)
-				memcpy(vga.draw.linear_base+vga.draw.linear_mask+1, vga.draw.linear_base, vga.draw.line_length);
-			uint8_t *ret = &vga.draw.linear_base[ offset ];
-#if !defined(C_UNALIGNED_MEMORY)
-			if (GCC_UNLIKELY( ((Bitu)ret) & (sizeof(Bitu)-1)) ) {
-				memcpy( TempLine, ret, vga.draw.line_length );
-				return TempLine;
-			}
+// The current mode's regular line drawer and the number of draw address units
+// one line spans. VGA_Draw_Changes_Line only defers to the drawer for lines
+// touching a block flagged in the change maps and returns nullptr otherwise,
+// which the scalers treat as an unchanged line.
+static VGA_Line_Handler changes_draw_line = nullptr;
+static Bitu changes_line_span             = 0;
+
+// Returns true if any of the whole words [first_word, last_word) are set in
+// either change map
+static bool are_change_words_set(const Bitu first_word, const Bitu last_word)
+{
+	const uint64_t* map      = vga.changes.map;
+	const uint64_t* previous = vga.changes.previous_map;
+
+	auto word = first_word;
+#if defined(__SSE2__)
+	auto any = _mm_setzero_si128();
+	for (; word + 2 <= last_word; word += 2) {
+		const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(map + word));
+		const auto b = _mm_loadu_si128(
+		        reinterpret_cast<const __m128i*>(previous + word));
+		any = _mm_or_si128(any, _mm_or_si128(a, b));
+	}
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xffff) {
+		return true;
+	}
+#elif defined(__ARM_NEON)
+	auto any = vdupq_n_u64(0);
+	for (; word + 2 <= last_word; word += 2) {
+		any = vorrq_u64(any,
+		                vorrq_u64(vld1q_u64(map + word),
+		                          vld1q_u64(previous + word)));
+	}
+	if (vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1)) {
+		return true;
+	}
 #endif
-			return ret;
+	for (; word < last_word; ++word) {
+		if (map[word] | previous[word]) {
+			return true;
 		}
 	}
-//	memset( TempLine, 0x30, vga.changes.lineWidth );
-//	return TempLine;
-	return 0;
+	return false;
+}
+
+// Returns true if any of the blocks [first_block, last_block] are flagged
+static bool are_blocks_changed(const Bitu first_block, const Bitu last_block)
+{
+	const auto first_word = first_block / 64;
+	const auto last_word  = last_block / 64;
+	const auto first_mask = ~uint64_t(0) << (first_block % 64);
+	const auto last_mask  = ~uint64_t(0) >> (63 - last_block % 64);
+
+	auto word_bits = [](const Bitu word) {
+		return vga.changes.map[word] | vga.changes.previous_map[word];
+	};
+	if (first_word == last_word) {
+		return word_bits(first_word) & first_mask & last_mask;
+	}
+	return (word_bits(first_word) & first_mask) ||
+	       (word_bits(last_word) & last_mask) ||
+	       are_change_words_set(first_word + 1, last_word);
+}
+
+// Returns true if any memory in the draw address range starting at 'vidstart'
+// and spanning 'num_units' changed, wrapping around the end of video memory
+static bool is_draw_range_changed(const Bitu vidstart, const Bitu num_units)
+{
+	const auto mask = vga.draw.linear_mask;
+	if (num_units > mask) {
+		return are_blocks_changed(0, mask >> VGA_CHANGE_SHIFT);
+	}
+	const auto first = vidstart & mask;
+	const auto last  = first + num_units - 1;
+	if (last <= mask) {
+		return are_blocks_changed(first >> VGA_CHANGE_SHIFT,
+		                          last >> VGA_CHANGE_SHIFT);
+	}
+	return are_blocks_changed(first >> VGA_CHANGE_SHIFT, mask >> VGA_CHANGE_SHIFT) ||
+	       are_blocks_changed(0, (last & mask) >> VGA_CHANGE_SHIFT);
+}
+
+static uint8_t* VGA_Draw_Changes_Line(Bitu vidstart, Bitu line)
+{
+	if (is_draw_range_changed(vidstart, changes_line_span)) {
+		return changes_draw_line(vidstart, line);
+	}
+	return nullptr;
 }
 
 #endif
@@ -367,6 +351,49 @@ static uint8_t * VGA_Draw_Linear_Line(Bitu vidstart, Bitu /*line*/) {
 	return ret;
 }
 
+// Returns the index of the darkest colour in the DAC palette (black, in
+// practically all cases)
+static uint8_t get_darkest_palette_index()
+{
+	static uint32_t palette_generation = UINT32_MAX;
+	static uint8_t darkest_index       = 0;
+
+	if (palette_generation == vga.dac.palette_map_generation) {
+		return darkest_index;
+	}
+	palette_generation = vga.dac.palette_map_generation;
+
+	auto min_brightness = INT_MAX;
+	for (auto i = 0; i < NumVgaColors; ++i) {
+		const auto& colour    = vga.dac.palette_map[i];
+		const auto brightness = colour.Red8() + colour.Green8() +
+		                        colour.Blue8();
+		if (brightness < min_brightness) {
+			min_brightness = brightness;
+			darkest_index  = static_cast<uint8_t>(i);
+		}
+		if (brightness == 0) {
+			break;
+		}
+	}
+	return darkest_index;
+}
+
+// Mode 13h and its tweaked variants hand the palette indexes straight to the
+// renderer. Its 8-bit scalers compare them against the cache, look up the
+// colours and write the doubled pixels in a single pass, which moves a
+// quarter of the data compared to expanding the colours here first.
+static uint8_t* draw_linear_line_indexed(Bitu vidstart, Bitu line)
+{
+	// If the screen is disabled, just paint black. This fixes screen
+	// fades in titles like Alien Carnage.
+	if (GCC_UNLIKELY(vga.seq.clocking_mode.is_screen_disabled)) {
+		memset(TempLine, get_darkest_palette_index(), vga.draw.line_length);
+		return TempLine;
+	}
+	return VGA_Draw_Linear_Line(vidstart, line);
+}
+
 static uint8_t* draw_unwrapped_line_from_dac_palette(Bitu vidstart,
                                                      [[maybe_unused]] const Bitu line = 0)
 {
@@ -789,6 +816,58 @@ static uint8_t *VGA_TEXT_Herc_Draw_Line(Bitu vidstart, Bitu line)
 	}
 	return TempLine;
 }
+// Text-mode glyph cache
+// ~~~~~~~~~~~~~~~~~~~~~
+// Text screens repeat the same few glyph rows in the same few colours, so
+// the palettized 9 pixels of a character cell's row are cached and drawn as
+// a single span copy. Entries are keyed by the row's font bits (so the
+// character and font line are implied and rewritten fonts simply miss)
+// plus the resolved foreground and background palette indexes (covering the
+// attribute, blink, and underline states). The cache is flushed whenever
+// the DAC palette changes.
+struct GlyphSpan {
+	uint32_t key = 0; // zero marks an unused entry
+	std::array<Bgrx8888, 9> pixels = {};
+};
+
+constexpr size_t glyph_cache_size = 4096;
+static std::array<GlyphSpan, glyph_cache_size> glyph_cache = {};
+static uint32_t glyph_cache_palette_generation = 0;
+
+static const GlyphSpan& get_glyph_span(const uint16_t font_bits,
+                                       const uint8_t fg_palette_idx,
+                                       const uint8_t bg_palette_idx)
+{
+	if (glyph_cache_palette_generation != vga.dac.palette_map_generation) {
+		for (auto& span : glyph_cache) {
+			span.key = 0;
+		}
+		glyph_cache_palette_generation = vga.dac.palette_map_generation;
+	}
+
+	constexpr uint32_t in_use = 1u << 31;
+	const uint32_t key = in_use | (font_bits << 8) | (fg_palette_idx << 4) |
+	                     bg_palette_idx;
+
+	// Fibonacci hash of the 17 key bits down to the cache's index range
+	constexpr auto index_shift = 32 - 12;
+	static_assert(glyph_cache_size == 1 << 12);
+	auto& span = glyph_cache[(key * 0x9e3779b1u) >> index_shift];
+
+	if (span.key != key) {
+		const auto fg_colour = vga.dac.palette_map[fg_palette_idx];
+		const auto bg_colour = vga.dac.palette_map[bg_palette_idx];
+
+		auto bits = font_bits;
+		for (auto& pixel : span.pixels) {
+			pixel = (bits & 0x100) ? fg_colour : bg_colour;
+			bits <<= 1;
+		}
+		span.key = key;
+	}
+	return span;
+}
+
 // combined 8/9-dot wide text mode line drawing function
 static uint8_t* draw_text_line_from_dac_palette(Bitu vidstart, Bitu line)
 {
@@ -833,30 +912,28 @@ static uint8_t* draw_text_line_from_dac_palette(Bitu vidstart, Bitu line)
 			bg_palette_idx = fg_palette_idx;
 
 		// The font's bits will indicate which color is used per pixel
-		const auto fg_colour = palette_map[fg_palette_idx];
-		const auto bg_colour = palette_map[bg_palette_idx];
+		font <<= 1; // 9 pixels
+
+		auto draw_addr = &TempLine[draw_idx * sizeof(palette_map[0])];
 
 		if (vga.seq.clocking_mode.is_eight_dot_mode) {
-			for (auto n = 0; n < 8; ++n) {
-				const auto color = (font & 0x80) ? fg_colour
-				                                 : bg_colour;
-				write_unaligned_uint32_at(TempLine, draw_idx++, color);
-				font <<= 1;
-			}
+			const auto& span = get_glyph_span(font,
+			                                  fg_palette_idx,
+			                                  bg_palette_idx);
+			memcpy(draw_addr, span.pixels.data(), 8 * sizeof(span.pixels[0]));
+			draw_idx += 8;
 		} else {
-			font <<= 1; // 9 pixels
 			// Extend to the 9th pixel if needed
 			if ((font & 0x2) &&
 			    vga.attr.mode_control.is_line_graphics_enabled &&
 			    (chr >= 0xc0) && (chr <= 0xdf)) {
 				font |= 1;
 			}
-			for (auto n = 0; n < 9; ++n) {
-				const auto color = (font & 0x100) ? fg_colour
-				                                  : bg_colour;
-				write_unaligned_uint32_at(TempLine, draw_idx++, color);
-				font <<= 1;
-			}
+			const auto& span = get_glyph_span(font,
+			                                  fg_palette_idx,
+			                                  bg_palette_idx);
+			memcpy(draw_addr, span.pixels.data(), 9 * sizeof(span.pixels[0]));
+			draw_idx += 9;
 		}
 	}
 	// draw the text mode cursor if needed
@@ -887,18 +964,13 @@ static uint8_t* draw_text_line_from_dac_palette(Bitu vidstart, Bitu line)
 }
 
 #ifdef VGA_KEEP_CHANGES
-static inline void VGA_ChangesEnd(void ) {
-	if ( vga.changes.active ) {
-//		vga.changes.active = false;
-		Bitu end = vga.draw.address >> VGA_CHANGE_SHIFT;
-		Bitu total = 4 + end - vga.changes.start;
-		uint32_t clearMask = vga.changes.clearMask;
-		total >>= 2;
-		uint32_t *clear = (uint32_t *)&vga.changes.map[  vga.changes.start & ~3 ];
-		while ( total-- ) {
-			clear[0] &= clearMask;
-			++clear;
-		}
+// Lines skipped by an aborted frame never had their change bits checked, so
+// draw everything, starting with the frame that replaces it
+static inline void VGA_ChangesAbort()
+{
+	vga.changes.lastAddress = UINT32_MAX;
+	if (VGA_DrawLine == VGA_Draw_Changes_Line) {
+		VGA_DrawLine = changes_draw_line;
 	}
 }
 #endif
@@ -922,7 +994,37 @@ static void VGA_ProcessSplit()
 	vga.draw.address_line = 0;
 }
 
+// Planar modes (M_EGA and M_LIN4) expand their pixels into vga.fastmem
+// lazily, so the span of each line is brought up to date right before it's
+// drawn. Zero for all other modes.
+static uint32_t planar_pixels_per_line = 0;
+
+static void expand_planar_line(const Bitu vidstart)
+{
+	const auto offset = check_cast<uint32_t>(vidstart & vga.draw.linear_mask);
+	VGA_ExpandPlanarPixels(offset, planar_pixels_per_line);
+
+	// The line drawers wrap back to the start of the buffer (see
+	// VGA_Draw_Linear_Line), so cover that as well
+	if (GCC_UNLIKELY((vga.draw.line_length + offset) & ~vga.draw.linear_mask)) {
+		VGA_ExpandPlanarPixels(0, planar_pixels_per_line);
+	}
+}
+
 static uint8_t bg_color_index = 0; // screen-off black index
+static PerfCounter lines_drawn("vga.lines_drawn");
+static PerfCounter lines_skipped("vga.lines_skipped");
+
+// The change-tracking line drawer returns no data for unchanged lines
+static void count_line(const uint8_t* data)
+{
+	if (data) {
+		lines_drawn.Add();
+	} else {
+		lines_skipped.Add();
+	}
+}
+
 static void VGA_DrawSingleLine(uint32_t /*blah*/)
 {
 	if (GCC_UNLIKELY(vga.attr.disabled)) {
@@ -1004,9 +1106,14 @@ static void VGA_DrawSingleLine(uint32_t /*blah*/)
 			}
 		}
 		ReelMagic_RENDER_DrawLine(TempLine);
+		lines_drawn.Add();
 	} else {
+		if (planar_pixels_per_line) {
+			expand_planar_line(vga.draw.address);
+		}
 		uint8_t * data=VGA_DrawLine( vga.draw.address, vga.draw.address_line );
 		ReelMagic_RENDER_DrawLine(data);
+		count_line(data);
 	}
 
 	++vga.draw.address_line;
@@ -1018,7 +1125,9 @@ static void VGA_DrawSingleLine(uint32_t /*blah*/)
 	if (vga.draw.split_line==vga.draw.lines_done) VGA_ProcessSplit();
 	if (vga.draw.lines_done < vga.draw.lines_total) {
 		PIC_AddEvent(VGA_DrawSingleLine, vga.draw.delay.per_line_ms);
-	} else RENDER_EndUpdate(false);
+	} else {
+		RENDER_EndUpdate(false);
+	}
 }
 
 static void VGA_DrawEGASingleLine(uint32_t /*blah*/)
@@ -1026,11 +1135,16 @@ static void VGA_DrawEGASingleLine(uint32_t /*blah*/)
 	if (GCC_UNLIKELY(vga.attr.disabled)) {
 		std::fill(templine_buffer.begin(), templine_buffer.end(), 0);
 		ReelMagic_RENDER_DrawLine(TempLine);
+		lines_drawn.Add();
 	} else {
 		Bitu address = vga.draw.address;
 		if (vga.mode!=M_TEXT) address += vga.draw.panning;
+		if (planar_pixels_per_line) {
+			expand_planar_line(address);
+		}
 		uint8_t * data=VGA_DrawLine(address, vga.draw.address_line );
 		ReelMagic_RENDER_DrawLine(data);
+		count_line(data);
 	}
 
 	++vga.draw.address_line;
@@ -1042,14 +1156,20 @@ static void VGA_DrawEGASingleLine(uint32_t /*blah*/)
 	if (vga.draw.split_line==vga.draw.lines_done) VGA_ProcessSplit();
 	if (vga.draw.lines_done < vga.draw.lines_total) {
 		PIC_AddEvent(VGA_DrawEGASingleLine, vga.draw.delay.per_line_ms);
-	} else RENDER_EndUpdate(false);
+	} else {
+		RENDER_EndUpdate(false);
+	}
 }
 
 static void VGA_DrawPart(uint32_t lines)
 {
 	while (lines--) {
+		if (planar_pixels_per_line) {
+			expand_planar_line(vga.draw.address);
+		}
 		uint8_t * data=VGA_DrawLine( vga.draw.address, vga.draw.address_line );
 		ReelMagic_RENDER_DrawLine(data);
+		count_line(data);
 		++vga.draw.address_line;
 		if (vga.draw.address_line>=vga.draw.address_line_total) {
 			vga.draw.address_line=0;
@@ -1057,13 +1177,7 @@ static void VGA_DrawPart(uint32_t lines)
 		}
 		++vga.draw.lines_done;
 		if (vga.draw.split_line==vga.draw.lines_done) {
-#ifdef VGA_KEEP_CHANGES
-			VGA_ChangesEnd( );
-#endif
 			VGA_ProcessSplit();
-#ifdef VGA_KEEP_CHANGES
-			vga.changes.start = vga.draw.address >> VGA_CHANGE_SHIFT;
-#endif
 		}
 	}
 	if (--vga.draw.parts_left) {
@@ -1072,9 +1186,6 @@ static void VGA_DrawPart(uint32_t lines)
 		                     ? vga.draw.parts_lines
 		                     : (vga.draw.lines_total - vga.draw.lines_done));
 	} else {
-#ifdef VGA_KEEP_CHANGES
-		VGA_ChangesEnd();
-#endif
 		RENDER_EndUpdate(false);
 	}
 }
@@ -1098,26 +1209,139 @@ void VGA_SetBlinking(const uint8_t enabled)
 	}
 }
 
+// Returns the size of the current mode's draw address space if its memory
+// writes are flagged in the change maps, or zero otherwise. Only the VGA
+// 256-colour and 16-colour modes drawn from the interleaved planes or the
+// vga.fastmem mirror share their draw address layout with the change maps.
+static Bitu get_changes_address_space()
+{
+	if (!IS_VGA_ARCH || ReelMagic_IsVideoMixerEnabled()) {
+		return 0;
+	}
+	switch (vga.mode) {
+	case M_VGA:
+		if (vga.config.chained) {
+			// Chained mode 13h is only tracked when drawn from the
+			// vga.fastmem mirror (see VGA_ChainedVGA_Handler)
+			if (!vga.config.compatible_chain4 ||
+			    !(vga.crtc.underline_location & 0x40)) {
+				return 0;
+			}
+			return 64 * 1024;
+		}
+		return vga.vmemwrap;
+	case M_EGA:
+	case M_LIN4:
+		// Draw addresses are pixel offsets with 8 pixels per planar
+		// address
+		return static_cast<Bitu>(vga.vmemwrap) * 2;
+	default: return 0;
+	}
+}
+
 #ifdef VGA_KEEP_CHANGES
-static void inline VGA_ChangesStart( void ) {
-	vga.changes.start = vga.draw.address >> VGA_CHANGE_SHIFT;
-	vga.changes.last = vga.changes.start;
-	if ( vga.changes.lastAddress != vga.draw.address ) {
-//		LOG_MSG("Address");
-		VGA_DrawLine = VGA_Draw_Linear_Line;
-		vga.changes.lastAddress = vga.draw.address;
-	} else if ( render.fullFrame ) {
-//		LOG_MSG("Full Frame");
-		VGA_DrawLine = VGA_Draw_Linear_Line;
-	} else {
-//		LOG_MSG("Changes");
-		VGA_DrawLine = VGA_Draw_Changes_Line;
-	}
-	vga.changes.active = true;
-	vga.changes.checkMask = vga.changes.writeMask;
-	vga.changes.clearMask = ~( 0x01010101 << (vga.changes.frame & 7));
-	++vga.changes.frame;
-	vga.changes.writeMask = 1 << (vga.changes.frame & 7);
+// Starts a new change tracking period by making the current map the previous
+// one and clearing the other. Writes older than that were either drawn by
+// the frame that just ended or fall outside of what it showed; a different
+// start address forces a full redraw anyway.
+static void rotate_change_maps()
+{
+	std::swap(vga.changes.map, vga.changes.previous_map);
+
+	uint64_t* map        = vga.changes.map;
+	const auto num_words = vga.changes.num_words;
+	assert(num_words % 2 == 0);
+
+#if defined(__SSE2__)
+	const auto zero = _mm_setzero_si128();
+	for (uint32_t word = 0; word < num_words; word += 2) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(map + word), zero);
+	}
+#elif defined(__ARM_NEON)
+	const auto zero = vdupq_n_u64(0);
+	for (uint32_t word = 0; word < num_words; word += 2) {
+		vst1q_u64(map + word, zero);
+	}
+#else
+	std::fill(map, map + num_words, 0);
+#endif
+}
+
+// Returns true if any memory the current frame is drawn from changed. The
+// ranges are padded by a row to cover the starting scanline offset and the
+// panning applied at the split line.
+static bool is_frame_changed()
+{
+	const auto rows_span = [](const Bitu num_lines) {
+		const auto num_rows = (num_lines + vga.draw.address_line_total - 1) /
+		                      vga.draw.address_line_total;
+		return (num_rows + 1) * vga.draw.address_add + changes_line_span;
+	};
+	const auto lines_total = vga.draw.lines_total;
+	const auto split_line  = vga.draw.split_line;
+
+	if (split_line >= lines_total) {
+		return is_draw_range_changed(vga.draw.address, rows_span(lines_total));
+	}
+	// Lines past the split are drawn from the start of video memory
+	return is_draw_range_changed(vga.draw.address, rows_span(split_line)) ||
+	       is_draw_range_changed(0, rows_span(lines_total - split_line));
+}
+
+// Picks the line drawer for the frame that's about to be drawn. Returns true
+// if nothing the frame is drawn from changed since it was last drawn, so it
+// can be skipped altogether.
+static bool VGA_ChangesStart()
+{
+	static uint32_t last_palette_generation = 0;
+	static Bitu last_split_line             = 0;
+	static Bitu last_address_line           = 0;
+	static uint8_t last_disabled            = 0;
+	static Bitu last_address_add            = 0;
+	static Bitu last_linear_mask            = 0;
+	static const uint8_t* last_linear_base  = nullptr;
+
+	const auto is_tracked = changes_draw_line &&
+	                        (vga.changes.skip_unchanged ||
+	                         vga.draw.full_playfield.active) &&
+	                        vga.draw.address_line_total &&
+	                        get_changes_address_space();
+	if (!is_tracked) {
+		VGA_ChangesAbort();
+		return false;
+	}
+
+	rotate_change_maps();
+
+	// Besides the memory, the line drawers depend on where drawing starts,
+	// the scan length, the memory window and mask they read through, and
+	// the DAC palette they look up
+	const auto needs_full_frame =
+	        render.fullFrame || vga.changes.lastAddress != vga.draw.address ||
+	        last_palette_generation != vga.dac.palette_map_generation ||
+	        last_split_line != vga.draw.split_line ||
+	        last_address_line != vga.draw.address_line ||
+	        last_disabled != vga.attr.disabled ||
+	        last_address_add != vga.draw.address_add ||
+	        last_linear_mask != vga.draw.linear_mask ||
+	        last_linear_base != vga.draw.linear_base;
+
+	vga.changes.lastAddress = check_cast<uint32_t>(vga.draw.address);
+	last_palette_generation = vga.dac.palette_map_generation;
+	last_split_line         = vga.draw.split_line;
+	last_address_line       = vga.draw.address_line;
+	last_disabled           = vga.attr.disabled;
+	last_address_add        = vga.draw.address_add;
+	last_linear_mask        = vga.draw.linear_mask;
+	last_linear_base        = vga.draw.linear_base;
+
+	if (needs_full_frame) {
+		VGA_DrawLine = changes_draw_line;
+		return false;
+	}
+	VGA_DrawLine = VGA_Draw_Changes_Line;
+
+	return vga.changes.skip_unchanged && !is_frame_changed();
 }
 #endif
 
@@ -1189,6 +1413,7 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 	++vga.draw.cursor.count; // Do this here, else the cursor speed depends
 	                         // on the frameskip
 	if (vga.draw.vga_override || !ReelMagic_RENDER_StartUpdate()) {
+		lines_skipped.Add(vga.draw.lines_total);
 		return;
 	}
 
@@ -1210,9 +1435,6 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 		++vga.draw.split_line; // EGA adds one buggy scanline
 	}
 //	if (machine==MCH_EGA) vga.draw.split_line = ((((vga.config.line_compare&0x5ff)+1)*2-1)/vga.draw.lines_scaled);
-#ifdef VGA_KEEP_CHANGES
-	bool startaddr_changed=false;
-#endif
 	switch (vga.mode) {
 	case M_EGA:
 		if (!(vga.crtc.mode_control.map_display_address_13)) {
@@ -1226,9 +1448,6 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 		vga.draw.address += vga.draw.bytes_skip;
 		vga.draw.address *= vga.draw.byte_panning_shift;
 		if (machine!=MCH_EGA) vga.draw.address += vga.draw.panning;
-#ifdef VGA_KEEP_CHANGES
-		startaddr_changed=true;
-#endif
 		break;
 	case M_VGA:
 		if (vga.config.compatible_chain4 && (vga.crtc.underline_location & 0x40)) {
@@ -1248,9 +1467,6 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 		vga.draw.address += vga.draw.bytes_skip;
 		vga.draw.address *= vga.draw.byte_panning_shift;
 		vga.draw.address += vga.draw.panning;
-#ifdef VGA_KEEP_CHANGES
-		startaddr_changed=true;
-#endif
 		break;
 	case M_TEXT:
 		vga.draw.byte_panning_shift = 2;
@@ -1285,10 +1501,13 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 	default:
 		break;
 	}
+	if (vga.draw.full_playfield.active) {
+		// The playfield is drawn from the start of video memory, so
+		// the display start address and split screen don't apply
+		vga.draw.address    = 0;
+		vga.draw.split_line = 0x10000;
+	}
 	if (GCC_UNLIKELY(vga.draw.split_line==0)) VGA_ProcessSplit();
-#ifdef VGA_KEEP_CHANGES
-	if (startaddr_changed) VGA_ChangesStart();
-#endif
 
 	// check if some lines at the top off the screen are blanked
 	double draw_skip = 0.0;
@@ -1297,12 +1516,29 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 		vga.draw.address += vga.draw.address_add * vga.draw.vblank_skip / vga.draw.address_line_total;
 	}
 
+	VGA_SyncDirectChain4Memory();
+
+#ifdef VGA_KEEP_CHANGES
+	const auto is_drawing = vga.draw.parts_left ||
+	                        vga.draw.lines_done < vga.draw.lines_total;
+	if (VGA_ChangesStart() && !is_drawing) {
+		// Nothing to draw or compare; the renderer keeps presenting the
+		// previous frame
+		lines_skipped.Add(vga.draw.lines_total);
+		RENDER_EndUpdate(false);
+		return;
+	}
+#endif
+
 	// add the draw event
 	switch (vga.draw.mode) {
 	case PART:
 		if (GCC_UNLIKELY(vga.draw.parts_left)) {
 			LOG(LOG_VGAMISC, LOG_NORMAL)("Parts left: %u", vga.draw.parts_left);
 			PIC_RemoveEvents(VGA_DrawPart);
+#ifdef VGA_KEEP_CHANGES
+			VGA_ChangesAbort();
+#endif
 			RENDER_EndUpdate(true);
 		}
 		vga.draw.lines_done = 0;
@@ -1318,6 +1554,9 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 				PIC_RemoveEvents(VGA_DrawEGASingleLine);
 			else
 				PIC_RemoveEvents(VGA_DrawSingleLine);
+#ifdef VGA_KEEP_CHANGES
+			VGA_ChangesAbort();
+#endif
 			RENDER_EndUpdate(true);
 		}
 		vga.draw.lines_done = 0;
@@ -1456,6 +1695,24 @@ static void setup_line_drawing_delays(const uint32_t total_lines)
 	vga.draw.delay.per_line_ms = vga.draw.delay.vdend / total_lines;
 }
 
+// Returns the number of lines needed to draw all of video memory from its start
+// at the current scan length, or zero if the current mode can't be drawn as a
+// full playfield. Only the modes whose memory writes are tracked by the change
+// maps are supported (see get_changes_address_space).
+static uint32_t get_full_playfield_height()
+{
+	if (!vga.draw.full_playfield.enabled || vga.draw.address_add == 0) {
+		return 0;
+	}
+	const auto address_space = get_changes_address_space();
+
+	const auto num_rows  = address_space / vga.draw.address_add;
+	const auto num_lines = num_rows * vga.draw.address_line_total;
+
+	return check_cast<uint32_t>(
+	        std::min(num_lines, static_cast<Bitu>(SCALER_MAXHEIGHT)));
+}
+
 // Determines pixel size as a pair of fractions (width and height)
 static std::pair<Fraction, Fraction> determine_pixel_size(const uint32_t htotal,
                                                           const uint32_t vtotal)
@@ -2205,14 +2462,22 @@ ImageInfo setup_drawing()
 		}
 
 		const auto is_reelmagic_vga_passthrough = !ReelMagic_IsVideoMixerEnabled();
-		if (is_reelmagic_vga_passthrough) {
-			// The ReelMagic video mixer expects linear VGA drawing
-			// (i.e.: Return to Zork's house intro), so limit the use
-			// of 18-bit palettized LUT routine to non-mixed output.
+		if (is_reelmagic_vga_passthrough &&
+		    vga.draw.has_mid_frame_palette_changes) {
+			// The renderer's palette only changes between frames, so
+			// raster effects (e.g., copper bars) need the colours
+			// expanded line by line from the DAC's current palette
 			pixel_format = PixelFormat::BGRX32_ByteArray;
 
 			VGA_DrawLine = draw_linear_line_from_dac_palette;
+		} else if (is_reelmagic_vga_passthrough) {
+			// The renderer's palette is kept in sync with the DAC's
+			// 18-bit palette LUT, so the indexes can be passed on
+			// and expanded by the scaler.
+			VGA_DrawLine = draw_linear_line_indexed;
 		} else {
+			// The ReelMagic video mixer expects linear VGA drawing
+			// (i.e.: Return to Zork's house intro).
 			VGA_DrawLine = VGA_Draw_Linear_Line;
 		}
 	} break;
@@ -2786,16 +3051,37 @@ ImageInfo setup_drawing()
 	video_mode.is_custom_mode = (CurMode->swidth != video_mode.width ||
 	                             CurMode->sheight != video_mode.height);
 
+	// The playfield lines below the visible window keep the pixel aspect
+	// ratio of the video mode, so this comes after the PAR calculations
+	const auto full_playfield_height = get_full_playfield_height();
+
+	vga.draw.full_playfield.active = (full_playfield_height > render_height);
+	if (vga.draw.full_playfield.active) {
+		render_height = full_playfield_height;
+		vblank_skip   = 0;
+	}
+
 	vga.draw.vblank_skip = vblank_skip;
 	setup_line_drawing_delays(render_height);
 
 	vga.draw.line_length = render_width *
 	                       ((get_bits_per_pixel(pixel_format) + 1) / 8);
 
+	// Any pixels still pending from a planar mode get expanded when
+	// switching away, as chained mode 13h also draws from vga.fastmem.
+	if (vga.mode == M_EGA || vga.mode == M_LIN4) {
+		planar_pixels_per_line = render_width;
+	} else {
+		planar_pixels_per_line = 0;
+		VGA_ExpandAllPlanarPixels();
+	}
+
 #ifdef VGA_KEEP_CHANGES
-	vga.changes.active    = false;
-	vga.changes.frame     = 0;
-	vga.changes.writeMask = 1;
+	VGA_ChangesAbort();
+	if (VGA_DrawLine != VGA_Draw_Changes_Line) {
+		changes_draw_line = VGA_DrawLine;
+	}
+	changes_line_span = render_width;
 #endif
 
 #ifdef DEBUG_VGA_DRAW
@@ -21,14 +21,20 @@
 
 #include "dosbox.h"
 
+#include <algorithm>
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "inout.h"
 #include "mem.h"
 #include "mem_host.h"
 #include "paging.h"
+#include "perf_counters.h"
 #include "pic.h"
 #include "setup.h"
 #include "vga.h"
@@ -52,12 +58,164 @@
 
 
 #ifdef VGA_KEEP_CHANGES
-#define MEM_CHANGED( _MEM ) vga.changes.map[ (_MEM) >> VGA_CHANGE_SHIFT ] |= vga.changes.writeMask;
-//#define MEM_CHANGED( _MEM ) vga.changes.map[ (_MEM) >> VGA_CHANGE_SHIFT ] = 1;
+static inline void mark_changed(const PhysPt addr)
+{
+	const auto block = addr >> VGA_CHANGE_SHIFT;
+	vga.changes.map[block / 64] |= uint64_t(1) << (block % 64);
+}
+
+// Flags every block a write of 'num_bytes' at 'addr' touches, so words and
+// dwords straddling a block boundary mark both blocks. The planar handlers
+// pass the shift that scales their addresses to draw addresses.
+void mark_changed_range(const PhysPt addr, const PhysPt num_bytes, const int shift)
+{
+	const auto first_block = (addr << shift) >> VGA_CHANGE_SHIFT;
+	const auto last_block = (((addr + num_bytes) << shift) - 1) >> VGA_CHANGE_SHIFT;
+
+	for (auto block = first_block; block <= last_block; ++block) {
+		vga.changes.map[block / 64] |= uint64_t(1) << (block % 64);
+	}
+}
+#define MEM_CHANGED( _MEM ) mark_changed(_MEM)
+#define MEM_CHANGED_RANGE( _MEM, _NUM_BYTES, _SHIFT ) mark_changed_range(_MEM, _NUM_BYTES, _SHIFT)
 #else
 #define MEM_CHANGED( _MEM ) 
+#define MEM_CHANGED_RANGE( _MEM, _NUM_BYTES, _SHIFT )
+#endif
+
+// Planar (M_EGA and M_LIN4) writes don't expand into the chunky pixel buffer
+// (vga.fastmem) immediately. Instead they flag the written planar address,
+// which covers 8 pixels, in this bitmap and the draw code calls
+// VGA_ExpandPlanarPixels for the span of each line right before drawing it.
+// Programs that rewrite the same memory several times per frame (or write to
+// off-screen pages) therefore only pay for the expansion once, if at all.
+static std::vector<uint64_t> planar_dirty_map = {};
+
+static inline void mark_planar_dirty(const PhysPt planar_addr)
+{
+	planar_dirty_map[planar_addr / 64] |= uint64_t(1) << (planar_addr % 64);
+}
+
+// Expands one planar address (a byte from each of the 4 planes) into 8
+// chunky pixels holding their 4-bit colour index.
+static void expand_planar_block(const uint32_t planar_addr)
+{
+	VgaLatch pixels;
+	pixels.d = reinterpret_cast<uint32_t*>(vga.mem.linear)[planar_addr];
+
+	uint8_t* write_pixels = &vga.fastmem[planar_addr << 3];
+
+	VgaLatch temp;
+	temp.d = (pixels.d >> 4) & 0x0f0f0f0f;
+	const uint32_t colors0_3 = Expand16Table[0][temp.b[0]] |
+	                           Expand16Table[1][temp.b[1]] |
+	                           Expand16Table[2][temp.b[2]] |
+	                           Expand16Table[3][temp.b[3]];
+	write_unaligned_uint32(write_pixels, colors0_3);
+
+	temp.d = pixels.d & 0x0f0f0f0f;
+	const uint32_t colors4_7 = Expand16Table[0][temp.b[0]] |
+	                           Expand16Table[1][temp.b[1]] |
+	                           Expand16Table[2][temp.b[2]] |
+	                           Expand16Table[3][temp.b[3]];
+	write_unaligned_uint32(write_pixels + 4, colors4_7);
+}
+
+#if defined(__SSE2__)
+// Bit-transposes two consecutive planar addresses into 16 chunky pixels.
+// Every plane byte is broadcast across the 8 lanes of its pixels, tested
+// against that pixel's bit (MSB first), and the results are OR'd together
+// as the plane's bit of the colour index.
+template <int plane>
+static inline __m128i transpose_plane(const __m128i first, const __m128i second)
+{
+	constexpr int lane = plane * 0x55;
+
+	const auto plane_bytes = _mm_unpacklo_epi64(_mm_shuffle_epi32(first, lane),
+	                                            _mm_shuffle_epi32(second, lane));
+	const auto pixel_bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+	                                     1, 2, 4, 8, 16, 32, 64, -128);
+	const auto is_set = _mm_cmpeq_epi8(_mm_and_si128(plane_bytes, pixel_bits),
+	                                   pixel_bits);
+	return _mm_and_si128(is_set, _mm_set1_epi8(1 << plane));
+}
+
+static void expand_planar_block_pair(const uint32_t planar_addr)
+{
+	const auto planes = _mm_loadl_epi64(
+	        reinterpret_cast<const __m128i*>(&vga.mem.linear[planar_addr << 2]));
+
+	// Widen each plane byte to a full dword: the first address's planes
+	// end up in 'first' and the second address's in 'second'.
+	const auto doubled = _mm_unpacklo_epi8(planes, planes);
+	const auto first   = _mm_unpacklo_epi16(doubled, doubled);
+	const auto second  = _mm_unpackhi_epi16(doubled, doubled);
+
+	const auto pixels = _mm_or_si128(
+	        _mm_or_si128(transpose_plane<0>(first, second),
+	                     transpose_plane<1>(first, second)),
+	        _mm_or_si128(transpose_plane<2>(first, second),
+	                     transpose_plane<3>(first, second)));
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(&vga.fastmem[planar_addr << 3]),
+	                 pixels);
+}
 #endif
 
+static void expand_planar_run(uint32_t planar_addr, const uint32_t end)
+{
+#if defined(__SSE2__)
+	for (; planar_addr + 2 <= end; planar_addr += 2) {
+		expand_planar_block_pair(planar_addr);
+	}
+#endif
+	for (; planar_addr < end; ++planar_addr) {
+		expand_planar_block(planar_addr);
+	}
+}
+
+void VGA_ExpandPlanarPixels(const uint32_t pixel_offset, const uint32_t num_pixels)
+{
+	const auto num_blocks = check_cast<uint32_t>(planar_dirty_map.size() * 64);
+
+	auto addr       = pixel_offset >> 3;
+	const auto last = std::min((pixel_offset + num_pixels + 7) >> 3, num_blocks);
+
+	auto is_dirty = [](const uint32_t a) {
+		return (planar_dirty_map[a / 64] >> (a % 64)) & 1;
+	};
+
+	while (addr < last) {
+		// Skip over fully clean words 64 blocks at a time
+		if (planar_dirty_map[addr / 64] == 0) {
+			addr = (addr | 63) + 1;
+			continue;
+		}
+		if (!is_dirty(addr)) {
+			++addr;
+			continue;
+		}
+		// Gather and expand the run of consecutive dirty blocks
+		auto run_end = addr;
+		while (run_end < last && is_dirty(run_end)) {
+			planar_dirty_map[run_end / 64] &= ~(uint64_t(1) << (run_end % 64));
+			++run_end;
+		}
+		expand_planar_run(addr, run_end);
+		addr = run_end;
+	}
+}
+
+void VGA_ExpandAllPlanarPixels()
+{
+	VGA_ExpandPlanarPixels(0, check_cast<uint32_t>(planar_dirty_map.size() * 64 * 8));
+}
+
+void VGA_DiscardPlanarPixels()
+{
+	std::fill(planar_dirty_map.begin(), planar_dirty_map.end(), 0);
+}
+
 #define TANDY_VIDBASE(_X_)  &MemBase[ 0x80000 + (_X_)]
 
 void VGA_MapMMIO(void);
@@ -169,29 +327,9 @@ public:
 	uint8_t readHandler(PhysPt addr) { return vga.mem.linear[addr]; }
 	void writeHandler(PhysPt start, uint8_t val) {
 		ModeOperation(val);
-		/* Update video memory and the pixel buffer */
-		VgaLatch pixels;
+		/* Update video memory and flag the pixel buffer as stale */
 		vga.mem.linear[start] = val;
-		start >>= 2;
-		pixels.d=((uint32_t*)vga.mem.linear)[start];
-
-		uint8_t * write_pixels=&vga.fastmem[start<<3];
-
-		uint32_t colors0_3, colors4_7;
-		VgaLatch temp;temp.d=(pixels.d>>4) & 0x0f0f0f0f;
-		colors0_3 = 
-			Expand16Table[0][temp.b[0]] |
-			Expand16Table[1][temp.b[1]] |
-			Expand16Table[2][temp.b[2]] |
-			Expand16Table[3][temp.b[3]];
-		*(uint32_t *)write_pixels=colors0_3;
-		temp.d=pixels.d & 0x0f0f0f0f;
-		colors4_7 = 
-			Expand16Table[0][temp.b[0]] |
-			Expand16Table[1][temp.b[1]] |
-			Expand16Table[2][temp.b[2]] |
-			Expand16Table[3][temp.b[3]];
-		*(uint32_t *)(write_pixels+4)=colors4_7;
+		mark_planar_dirty(start >> 2);
 	}
 public:	
 	VGA_ChainedEGA_Handler()  {
@@ -212,7 +350,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED( addr << 3);
+		MEM_CHANGED_RANGE(addr, 2, 3);
 		writeHandler(addr+0,(uint8_t)(val >> 0));
 		writeHandler(addr+1,(uint8_t)(val >> 8));
 	}
@@ -222,7 +360,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED( addr << 3);
+		MEM_CHANGED_RANGE(addr, 4, 3);
 		writeHandler(addr+0,(uint8_t)(val >> 0));
 		writeHandler(addr+1,(uint8_t)(val >> 8));
 		writeHandler(addr+2,(uint8_t)(val >> 16));
@@ -262,29 +400,13 @@ class VGA_UnchainedEGA_Handler : public VGA_UnchainedRead_Handler {
 public:
 	void writeHandler(PhysPt start, uint8_t val) {
 		uint32_t data=ModeOperation(val);
-		/* Update video memory and the pixel buffer */
+		/* Update video memory and flag the pixel buffer as stale */
 		VgaLatch pixels;
 		pixels.d=((uint32_t*)vga.mem.linear)[start];
 		pixels.d&=vga.config.full_not_map_mask;
 		pixels.d|=(data & vga.config.full_map_mask);
 		((uint32_t*)vga.mem.linear)[start]=pixels.d;
-		uint8_t * write_pixels=&vga.fastmem[start<<3];
-
-		uint32_t colors0_3, colors4_7;
-		VgaLatch temp;temp.d=(pixels.d>>4) & 0x0f0f0f0f;
-			colors0_3 = 
-			Expand16Table[0][temp.b[0]] |
-			Expand16Table[1][temp.b[1]] |
-			Expand16Table[2][temp.b[2]] |
-			Expand16Table[3][temp.b[3]];
-		*(uint32_t *)write_pixels=colors0_3;
-		temp.d=pixels.d & 0x0f0f0f0f;
-		colors4_7 = 
-			Expand16Table[0][temp.b[0]] |
-			Expand16Table[1][temp.b[1]] |
-			Expand16Table[2][temp.b[2]] |
-			Expand16Table[3][temp.b[3]];
-		*(uint32_t *)(write_pixels+4)=colors4_7;
+		mark_planar_dirty(start);
 	}
 public:	
 	VGA_UnchainedEGA_Handler()  {
@@ -305,7 +427,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
-		MEM_CHANGED( addr << 3);
+		MEM_CHANGED_RANGE(addr, 2, 3);
 		writeHandler(addr+0,(uint8_t)(val >> 0));
 		writeHandler(addr+1,(uint8_t)(val >> 8));
 	}
@@ -315,7 +437,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
-		MEM_CHANGED( addr << 3);
+		MEM_CHANGED_RANGE(addr, 4, 3);
 		writeHandler(addr+0,(uint8_t)(val >> 0));
 		writeHandler(addr+1,(uint8_t)(val >> 8));
 		writeHandler(addr+2,(uint8_t)(val >> 16));
@@ -443,8 +565,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED( addr );
-//		MEM_CHANGED( addr + 1);
+		MEM_CHANGED_RANGE(addr, 2, 0);
 		if (GCC_UNLIKELY(addr & 1)) {
 			writeHandler_byte(addr + 0, val >> 0);
 			writeHandler_byte(addr + 1, val >> 8);
@@ -459,8 +580,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED( addr );
-//		MEM_CHANGED( addr + 3);
+		MEM_CHANGED_RANGE(addr, 4, 0);
 		if (GCC_UNLIKELY(addr & 3)) {
 			writeHandler_byte(addr + 0, val >> 0);
 			writeHandler_byte(addr + 1, val >> 8);
@@ -504,7 +624,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
-		MEM_CHANGED( addr << 2);
+		MEM_CHANGED_RANGE(addr, 2, 2);
 		writeHandler(addr+0,(uint8_t)(val >> 0));
 		writeHandler(addr+1,(uint8_t)(val >> 8));
 	}
@@ -514,7 +634,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
-		MEM_CHANGED( addr << 2);
+		MEM_CHANGED_RANGE(addr, 4, 2);
 		writeHandler(addr+0,(uint8_t)(val >> 0));
 		writeHandler(addr+1,(uint8_t)(val >> 8));
 		writeHandler(addr+2,(uint8_t)(val >> 16));
@@ -576,6 +696,23 @@ public:
 	}
 };
 
+// Maps the window straight to the vga.fastmem copy of chained mode 13h memory
+// (see chain4_direct)
+class VGA_ChainedVGA_Direct_Handler final : public PageHandler {
+public:
+	VGA_ChainedVGA_Direct_Handler() {
+		flags=PFLAG_READABLE|PFLAG_WRITEABLE|PFLAG_NOCODE;
+	}
+	HostPt GetHostReadPt(Bitu phys_page) override {
+		phys_page-=vgapages.base;
+		return &vga.fastmem[vga.svga.bank_read_full+phys_page*4096];
+	}
+	HostPt GetHostWritePt(Bitu phys_page) override {
+		phys_page-=vgapages.base;
+		return &vga.fastmem[vga.svga.bank_write_full+phys_page*4096];
+	}
+};
+
 class VGA_Changes_Handler final : public PageHandler {
 public:
 	VGA_Changes_Handler() {
@@ -619,7 +756,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED(addr);
+		MEM_CHANGED_RANGE(addr, 2, 0);
 		host_writew_at(vga.mem.linear, addr, val);
 	}
 
@@ -628,7 +765,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED(addr);
+		MEM_CHANGED_RANGE(addr, 4, 0);
 		host_writed_at(vga.mem.linear, addr, val);
 	}
 };
@@ -650,7 +787,7 @@ public:
 	{
 		addr = vga.svga.bank_write_full + (PAGING_GetPhysicalAddress(addr) & 0xffff);
 		addr = CHECKED4(addr);
-		MEM_CHANGED( addr << 3 );
+		MEM_CHANGED_RANGE(addr, 2, 3);
 		writeHandler(addr+0,(uint8_t)(val >> 0));
 		writeHandler(addr+1,(uint8_t)(val >> 8));
 	}
@@ -659,7 +796,7 @@ public:
 	{
 		addr = vga.svga.bank_write_full + (PAGING_GetPhysicalAddress(addr) & 0xffff);
 		addr = CHECKED4(addr);
-		MEM_CHANGED( addr << 3 );
+		MEM_CHANGED_RANGE(addr, 4, 3);
 		writeHandler(addr+0,(uint8_t)(val >> 0));
 		writeHandler(addr+1,(uint8_t)(val >> 8));
 		writeHandler(addr+2,(uint8_t)(val >> 16));
@@ -733,7 +870,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) - vga.lfb.addr;
 		addr = CHECKED(addr);
 		host_writew_at(vga.mem.linear, addr, val);
-		MEM_CHANGED( addr );
+		MEM_CHANGED_RANGE(addr, 2, 0);
 	}
 
 	void writed(PhysPt addr, uint32_t val) override
@@ -741,7 +878,7 @@ public:
 		addr = PAGING_GetPhysicalAddress(addr) - vga.lfb.addr;
 		addr = CHECKED(addr);
 		host_writed_at(vga.mem.linear, addr, val);
-		MEM_CHANGED( addr );
+		MEM_CHANGED_RANGE(addr, 4, 0);
 	}
 };
 
@@ -882,6 +1019,7 @@ static struct vg {
 	VGA_TANDY_PageHandler tandy = {};
 	VGA_ChainedEGA_Handler cega = {};
 	VGA_ChainedVGA_Handler cvga = {};
+	VGA_ChainedVGA_Direct_Handler cvga_direct = {};
 	VGA_UnchainedEGA_Handler uega = {};
 	VGA_UnchainedVGA_Handler uvga = {};
 	VGA_PCJR_Handler pcjr = {};
@@ -893,21 +1031,134 @@ static struct vg {
 	VGA_Empty_Handler empty = {};
 } vgaph;
 
-void VGA_ChangedBank(void) {
-#ifndef VGA_LFB_MAPPED
-	//If the mode is accurate than the correct mapper must have been installed already
-	if ( vga.mode >= M_LIN4 && vga.mode <= M_LIN32 ) {
+static PerfCounter bank_switches("vga.bank_switches");
+
+// Chained mode 13h memory exists twice: interleaved into the planes in
+// vga.mem.linear, where VGA_ChainedVGA_Handler reads it from, and as plain
+// bytes in vga.fastmem, which the mode is drawn from. Most 320x200x256 games
+// never look at the planes, so while nothing that can see them is programmed
+// the window is mapped straight to vga.fastmem and CPU accesses cost the same
+// as ordinary RAM. The planes are only rebuilt once the guest switches to a
+// state that exposes them.
+static struct {
+	bool is_active = false;
+
+#ifdef VGA_KEEP_CHANGES
+	// vga.fastmem as of the last frame start, to find the blocks written
+	// since then as the direct mapping bypasses mark_changed
+	std::vector<uint8_t> drawn = {};
+#endif
+} chain4_direct = {};
+
+// Only the 64 KB that mode 13h is drawn from are mapped directly; vga.fastmem
+// holds the replicated first line right after them
+constexpr uint32_t Chain4DrawBytes    = 64 * 1024;
+constexpr uint32_t Chain4ReplicaBytes = 320;
+
+static bool can_map_chain4_directly(const uint32_t window_bytes)
+{
+	// Only the dword-mode layout is drawn from vga.fastmem
+	return IS_VGA_ARCH && vga.mode == M_VGA &&
+	       (vga.crtc.underline_location & 0x40) &&
+	       vga.svga.bank_read_full + window_bytes <= Chain4DrawBytes &&
+	       vga.svga.bank_write_full + window_bytes <= Chain4DrawBytes;
+}
+
+static void replicate_chain4_first_line()
+{
+	// The first line is replicated past the drawn memory so lines that
+	// wrap around can be drawn in one go (as VGA_ChainedVGA_Handler does)
+	std::copy_n(vga.fastmem, Chain4ReplicaBytes, vga.fastmem + Chain4DrawBytes);
+}
+
+static void enter_chain4_direct()
+{
+	if (chain4_direct.is_active) {
 		return;
 	}
+	// Pending planar pixels would otherwise be expanded over the chunky
+	// bytes later
+	VGA_ExpandAllPlanarPixels();
+
+	// The planes are authoritative while the handler is in use, and
+	// vga.fastmem can be stale if unchained mode was used in the meantime
+	for (uint32_t addr = 0; addr < Chain4DrawBytes; ++addr) {
+		vga.fastmem[addr] = *VGA_ChainedVGA_Handler::ToLinear(addr);
+	}
+	replicate_chain4_first_line();
+
+#ifdef VGA_KEEP_CHANGES
+	chain4_direct.drawn.assign(vga.fastmem, vga.fastmem + Chain4DrawBytes);
 #endif
-	VGA_SetupHandlers();
+	chain4_direct.is_active = true;
+}
+
+static void leave_chain4_direct()
+{
+	if (!chain4_direct.is_active) {
+		return;
+	}
+	for (uint32_t addr = 0; addr < Chain4DrawBytes; ++addr) {
+		*VGA_ChainedVGA_Handler::ToLinear(addr) = vga.fastmem[addr];
+	}
+	chain4_direct.is_active = false;
+}
+
+void VGA_SyncDirectChain4Memory()
+{
+	if (!chain4_direct.is_active) {
+		return;
+	}
+	replicate_chain4_first_line();
+
+#ifdef VGA_KEEP_CHANGES
+	constexpr uint32_t block_bytes = 1 << VGA_CHANGE_SHIFT;
+
+	auto drawn = chain4_direct.drawn.data();
+	for (uint32_t addr = 0; addr < Chain4DrawBytes; addr += block_bytes) {
+		if (memcmp(drawn + addr, vga.fastmem + addr, block_bytes) != 0) {
+			memcpy(drawn + addr, vga.fastmem + addr, block_bytes);
+			mark_changed(addr);
+		}
+	}
+#endif
+}
+
+// The installed page handlers don't depend on the selected banks, so a bank
+// switch only has to update the bank offsets and refresh the TLB entries that
+// link the window straight to video memory. Banked SVGA modes switch banks
+// thousands of times per frame; rebuilding the handlers and flushing the
+// whole TLB on each switch used to dominate their emulation time.
+void VGA_ChangedBank()
+{
+	bank_switches.Add();
+
+	vga.svga.bank_read_full  = vga.svga.bank_read * vga.svga.bank_size;
+	vga.svga.bank_write_full = vga.svga.bank_write * vga.svga.bank_size;
+
+	if (chain4_direct.is_active &&
+	    !can_map_chain4_directly(static_cast<uint32_t>(vgapages.mask + 1))) {
+		VGA_SetupHandlers();
+		return;
+	}
+
+	constexpr uint32_t window_pages = 32; // A0000-BFFFF
+	PAGING_RelinkPhysPages(VGA_PAGE_A0, window_pages);
 }
 
 void VGA_SetupHandlers(void) {
 	vga.svga.bank_read_full = vga.svga.bank_read*vga.svga.bank_size;
 	vga.svga.bank_write_full = vga.svga.bank_write*vga.svga.bank_size;
 
+	// The non-planar handlers write vga.fastmem directly, so pending
+	// planar pixels must be expanded now rather than over their writes
+	// when the new mode's drawing is set up
+	if (vga.mode != M_EGA && vga.mode != M_LIN4) {
+		VGA_ExpandAllPlanarPixels();
+	}
+
 	PageHandler *newHandler;
+	bool is_chain4_direct = false;
 	switch (machine) {
 	case MCH_CGA:
 	case MCH_PCJR:
@@ -1042,9 +1293,20 @@ void VGA_SetupHandlers(void) {
 		MEM_SetPageHandler( VGA_PAGE_B0, 8, &vgaph.empty );
 		break;
 	}
-	if(svgaCard == SVGA_S3Trio && (vga.s3.ext_mem_ctrl & 0x10))
+	if(svgaCard == SVGA_S3Trio && (vga.s3.ext_mem_ctrl & 0x10)) {
 		MEM_SetPageHandler(VGA_PAGE_A0, 16, &vgaph.mmio);
+	} else if (newHandler == &vgaph.cvga) {
+		const auto window_bytes = static_cast<uint32_t>(vgapages.mask + 1);
+		if (can_map_chain4_directly(window_bytes)) {
+			enter_chain4_direct();
+			MEM_SetPageHandler(vgapages.base, window_bytes / 4096, &vgaph.cvga_direct);
+			is_chain4_direct = true;
+		}
+	}
 range_done:
+	if (!is_chain4_direct) {
+		leave_chain4_direct();
+	}
 	PAGING_ClearTLB();
 }
 
@@ -1060,10 +1322,12 @@ void VGA_StartUpdateLFB(void) {
 }
 
 static void VGA_Memory_ShutDown(Section * /*sec*/) {
-#ifdef VGA_KEEP_CHANGES
-	delete[] vga.changes.map;
 	vga.mem.linear = {};
 	vga.fastmem    = {};
+	chain4_direct.is_active = false;
+#ifdef VGA_KEEP_CHANGES
+	vga.changes.map          = nullptr;
+	vga.changes.previous_map = nullptr;
 #endif
 }
 
@@ -1101,15 +1365,28 @@ void VGA_SetupMemory(Section* sec)
 	                                                           num_fastmem_bytes);
 	assert(reinterpret_cast<uintptr_t>(vga.fastmem) % vmem_alignment == 0);
 
+	// One dirty bit per planar address, each of which expands into 8 pixels
+	const auto num_planar_addrs = num_linear_bytes / 4;
+	planar_dirty_map.assign((num_planar_addrs + 63) / 64, 0);
+
 	// In most cases these values stay the same. Assumptions: vmemwrap is power of 2,
 	// vmemwrap <= vmemsize, fastmem implicitly has mem wrap twice as big
 	vga.vmemwrap = vga.vmemsize;
 
 #ifdef VGA_KEEP_CHANGES
-	memset( &vga.changes, 0, sizeof( vga.changes ));
-	int changesMapSize = (vga.vmemsize >> VGA_CHANGE_SHIFT) + 32;
-	vga.changes.map = new uint8_t[changesMapSize];
-	memset(vga.changes.map, 0, changesMapSize);
+	// Both change maps share one buffer. Each gets a spare word and is
+	// rounded up to whole 128-bit vectors for the SIMD clearing and
+	// checking done by the draw code.
+	static std::vector<uint64_t> changes_buffer = {};
+
+	const auto num_change_blocks = (vga.vmemsize * 2) >> VGA_CHANGE_SHIFT;
+	const auto num_change_words  = ((num_change_blocks / 64 + 1) + 1) & ~1u;
+	changes_buffer.assign(num_change_words * 2, 0);
+
+	vga.changes.map          = changes_buffer.data();
+	vga.changes.previous_map = changes_buffer.data() + num_change_words;
+	vga.changes.num_words    = num_change_words;
+	vga.changes.lastAddress  = UINT32_MAX;
 #endif
 	vga.svga.bank_read = vga.svga.bank_write = 0;
 	vga.svga.bank_read_full = vga.svga.bank_write_full = 0;
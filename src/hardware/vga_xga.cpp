@@ -21,6 +21,7 @@
 
 #include "dosbox.h"
 
+#include <algorithm>
 #include <cassert>
 #include <math.h>
 #include <stdio.h>
@@ -257,6 +258,357 @@ static Bitu GetMixResult(uint32_t mixmode, Bitu srcval, Bitu dstdata)
 	return destval;
 }
 
+// Span kernels
+// ~~~~~~~~~~~~
+// The rectangle fill, BitBLT and pattern fill commands are the bulk of what
+// the Windows 3.x S3 drivers do. Rather than calling XGA_GetPoint and
+// XGA_DrawPoint per pixel (which recompute the address and switch on the
+// colour depth every time), the commands below are handled a row at a time
+// with the colour depth fixed at compile time, as long as all the memory
+// they touch is within video memory.
+//
+// Pixels are still processed one after the other in the direction given by
+// the command, so overlapping blits give the same result as the per-pixel
+// path. Everything else (PIX_TRANS sources, the rare mix selects, or
+// rectangles reaching outside of video memory) uses the per-pixel path.
+
+constexpr uint32_t xga_mix_src      = 0x07;
+constexpr uint32_t xga_mix_src_xor  = 0x05;
+constexpr uint32_t xga_mix_bitmap   = 0x67;
+
+enum class XgaSource : uint8_t { BackColor, ForeColor, PixTrans, Bitmap };
+
+static XgaSource get_mix_source(const uint32_t mixmode)
+{
+	return static_cast<XgaSource>((mixmode >> 5) & 0x03);
+}
+
+static Bitu get_source_color(const uint32_t mixmode)
+{
+	return get_mix_source(mixmode) == XgaSource::ForeColor ? xga.forecolor
+	                                                       : xga.backcolor;
+}
+
+static bool is_drawing_enabled()
+{
+	return (xga.curcommand & 0x1) && (xga.curcommand & 0x10);
+}
+
+// Is every pixel of the rectangle starting at (x, y) and extending in the
+// (dx, dy) direction within video memory?
+template <typename pixel_t>
+static bool is_rect_in_vmem(const Bits x, const Bits y, const Bits dx,
+                            const Bits dy, const Bits width, const Bits height)
+{
+	const auto x_end = x + dx * (width - 1);
+	const auto y_end = y + dy * (height - 1);
+	if (std::min(x, x_end) < 0 || std::min(y, y_end) < 0) {
+		return false;
+	}
+	const auto last_addr = static_cast<uint64_t>(std::max(y, y_end)) *
+	                               XGA_SCREEN_WIDTH +
+	                       static_cast<uint64_t>(std::max(x, x_end));
+	return last_addr * sizeof(pixel_t) < vga.vmemsize;
+}
+
+// Clips a row of 'width' destination pixels starting at 'x' and stepping
+// by 'dx' against the scissors. Returns the index of the first column
+// inside and the number of columns, or false if the row is fully clipped.
+static bool clip_span(const Bits x, const Bits dx, const Bits width,
+                      Bits& first, Bits& num_pixels)
+{
+	Bits lo = 0;
+	Bits hi = 0;
+	if (dx > 0) {
+		lo = xga.scissors.x1 - x;
+		hi = xga.scissors.x2 - x;
+	} else {
+		lo = x - xga.scissors.x2;
+		hi = x - xga.scissors.x1;
+	}
+	lo = std::max(lo, Bits(0));
+	hi = std::min(hi, width - 1);
+	if (lo > hi) {
+		return false;
+	}
+	first      = lo;
+	num_pixels = hi - lo + 1;
+	return true;
+}
+
+static bool is_row_in_scissors(const Bits y)
+{
+	return y >= xga.scissors.y1 && y <= xga.scissors.y2;
+}
+
+template <typename pixel_t>
+static pixel_t* get_pixel_ptr(const Bits x, const Bits y)
+{
+	return reinterpret_cast<pixel_t*>(vga.mem.linear) +
+	       static_cast<size_t>(y) * XGA_SCREEN_WIDTH + static_cast<size_t>(x);
+}
+
+// Walks 'num_pixels' destination pixels in 'step' direction, replacing each
+// with the result of pixel(column, current destination value).
+template <typename pixel_t, pixel_t write_mask, typename PixelFunc>
+static void draw_span(pixel_t* dst, const Bits step, const Bits num_pixels,
+                      PixelFunc pixel)
+{
+	for (Bits i = 0; i < num_pixels; ++i, dst += step) {
+		*dst = static_cast<pixel_t>(pixel(i, *dst) & write_mask);
+	}
+}
+
+template <typename pixel_t, pixel_t write_mask>
+static void fill_span(pixel_t* dst, const Bits step, const Bits num_pixels,
+                      const Bitu color)
+{
+	const auto value = static_cast<pixel_t>(color & write_mask);
+	std::fill_n(step > 0 ? dst : dst - (num_pixels - 1), num_pixels, value);
+}
+
+template <typename pixel_t, pixel_t write_mask>
+static void copy_span(pixel_t* dst, const pixel_t* src, const Bits step,
+                      const Bits num_pixels)
+{
+	// A plain block move gives the same result as copying pixel-by-pixel
+	// unless the destination starts inside the source span in the
+	// direction of travel, in which case the source pixels get repeated.
+	const auto distance = (dst - src) * step;
+	const auto repeats_source = distance > 0 && distance < num_pixels;
+
+	if (write_mask == static_cast<pixel_t>(~0) && !repeats_source) {
+		const auto offset = step > 0 ? 0 : num_pixels - 1;
+		memmove(dst - offset, src - offset, num_pixels * sizeof(pixel_t));
+		return;
+	}
+	draw_span<pixel_t, write_mask>(dst, step, num_pixels, [&](const Bits i, Bitu) {
+		return static_cast<Bitu>(src[i * step]);
+	});
+}
+
+template <typename pixel_t, pixel_t write_mask>
+static bool draw_rectangle_spans(const Bits dx, const Bits dy, const Bits width)
+{
+	const Bits height    = xga.MIPcount + 1;
+	const auto mixselect = (xga.pix_cntl >> 6) & 0x3;
+	const auto mixmode   = xga.foremix;
+	const auto source    = get_mix_source(mixmode);
+
+	if (mixselect != 0x00 || source == XgaSource::PixTrans ||
+	    source == XgaSource::Bitmap || !is_drawing_enabled() ||
+	    !is_rect_in_vmem<pixel_t>(xga.curx, xga.cury, dx, dy, width, height)) {
+		return false;
+	}
+
+	const auto color = get_source_color(mixmode);
+
+	for (Bits row = 0; row < height; ++row) {
+		const Bits y = xga.cury + dy * row;
+		Bits first = 0, num_pixels = 0;
+		if (!is_row_in_scissors(y) ||
+		    !clip_span(xga.curx, dx, width, first, num_pixels)) {
+			continue;
+		}
+		auto dst = get_pixel_ptr<pixel_t>(xga.curx + dx * first, y);
+
+		switch (mixmode & 0xf) {
+		case xga_mix_src:
+			fill_span<pixel_t, write_mask>(dst, dx, num_pixels, color);
+			break;
+		case xga_mix_src_xor:
+			draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](Bits, const Bitu d) {
+				return color ^ d;
+			});
+			break;
+		default:
+			draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](Bits, const Bitu d) {
+				return GetMixResult(mixmode, color, d);
+			});
+			break;
+		}
+	}
+	return true;
+}
+
+template <typename pixel_t, pixel_t write_mask>
+static bool blit_rect_spans(const Bits dx, const Bits dy, const uint32_t mixselect,
+                            const uint32_t mixmode)
+{
+	const Bits width  = xga.MAPcount + 1;
+	const Bits height = xga.MIPcount + 1;
+
+	// Only the foreground mix and the video memory (transparency) mix
+	// selects are handled here
+	bool is_supported = false;
+	if (mixselect == 0x00) {
+		is_supported = get_mix_source(mixmode) != XgaSource::PixTrans;
+	} else if (mixselect == 0x03) {
+		is_supported = get_mix_source(xga.foremix) != XgaSource::PixTrans &&
+		               get_mix_source(xga.backmix) != XgaSource::PixTrans;
+	}
+	if (!is_supported || !is_drawing_enabled() ||
+	    !is_rect_in_vmem<pixel_t>(xga.curx, xga.cury, dx, dy, width, height) ||
+	    !is_rect_in_vmem<pixel_t>(xga.destx, xga.desty, dx, dy, width, height)) {
+		return false;
+	}
+
+	const auto source = get_mix_source(mixmode);
+	const auto color  = get_source_color(mixmode);
+
+	for (Bits row = 0; row < height; ++row) {
+		const Bits tary = xga.desty + dy * row;
+		Bits first = 0, num_pixels = 0;
+		if (!is_row_in_scissors(tary) ||
+		    !clip_span(xga.destx, dx, width, first, num_pixels)) {
+			continue;
+		}
+		auto dst = get_pixel_ptr<pixel_t>(xga.destx + dx * first, tary);
+		const auto src = get_pixel_ptr<pixel_t>(xga.curx + dx * first,
+		                                        xga.cury + dy * row);
+
+		if (mixselect == 0x03) {
+			// Source pixels matching the foreground or background
+			// colour select that mix, others are copied as-is
+			draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](const Bits i, const Bitu d) {
+				const Bitu s = src[i * dx];
+				const auto mix = (s == xga.forecolor) ? xga.foremix
+				               : (s == xga.backcolor) ? xga.backmix
+				                                      : xga_mix_bitmap;
+				const auto value = get_mix_source(mix) == XgaSource::Bitmap
+				                         ? s
+				                         : get_source_color(mix);
+				return GetMixResult(mix, value, d);
+			});
+			continue;
+		}
+		if (source != XgaSource::Bitmap) {
+			if ((mixmode & 0xf) == xga_mix_src) {
+				fill_span<pixel_t, write_mask>(dst, dx, num_pixels, color);
+			} else {
+				draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](Bits, const Bitu d) {
+					return GetMixResult(mixmode, color, d);
+				});
+			}
+			continue;
+		}
+		switch (mixmode & 0xf) {
+		case xga_mix_src:
+			copy_span<pixel_t, write_mask>(dst, src, dx, num_pixels);
+			break;
+		case xga_mix_src_xor:
+			draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](const Bits i, const Bitu d) {
+				return src[i * dx] ^ d;
+			});
+			break;
+		default:
+			draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](const Bits i, const Bitu d) {
+				return GetMixResult(mixmode, src[i * dx], d);
+			});
+			break;
+		}
+	}
+	return true;
+}
+
+template <typename pixel_t, pixel_t write_mask>
+static bool draw_pattern_spans(const Bits dx, const Bits dy, const uint32_t mixselect,
+                               const uint32_t mixmode)
+{
+	const Bits width  = xga.MAPcount + 1;
+	const Bits height = xga.MIPcount + 1;
+
+	bool is_supported = false;
+	if (mixselect == 0x00) {
+		is_supported = get_mix_source(mixmode) != XgaSource::PixTrans;
+	} else if (mixselect == 0x03) {
+		is_supported = get_mix_source(xga.foremix) != XgaSource::PixTrans &&
+		               get_mix_source(xga.backmix) != XgaSource::PixTrans;
+	}
+	// The 8x8 pattern sits at (curx, cury)
+	if (!is_supported || !is_drawing_enabled() ||
+	    !is_rect_in_vmem<pixel_t>(xga.curx, xga.cury, 1, 1, 8, 8) ||
+	    !is_rect_in_vmem<pixel_t>(xga.destx, xga.desty, dx, dy, width, height)) {
+		return false;
+	}
+
+	for (Bits row = 0; row < height; ++row) {
+		const Bits tary = xga.desty + dy * row;
+		Bits first = 0, num_pixels = 0;
+		if (!is_row_in_scissors(tary) ||
+		    !clip_span(xga.destx, dx, width, first, num_pixels)) {
+			continue;
+		}
+		const Bits tarx = xga.destx + dx * first;
+		auto dst = get_pixel_ptr<pixel_t>(tarx, tary);
+		const auto pattern = get_pixel_ptr<pixel_t>(xga.curx, xga.cury + (tary & 0x7));
+
+		auto pattern_pixel = [=](const Bits i) -> Bitu {
+			return pattern[(tarx + dx * i) & 0x7];
+		};
+
+		if (mixselect == 0x03) {
+			// TODO lots of guessing here but best results this way
+			draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](const Bits i, const Bitu d) {
+				const auto s   = pattern_pixel(i);
+				const auto mix = s ? xga.foremix : xga.backmix;
+				const auto value = get_mix_source(mix) == XgaSource::Bitmap
+				                         ? s
+				                         : get_source_color(mix);
+				return GetMixResult(mix, value, d);
+			});
+		} else if (get_mix_source(mixmode) != XgaSource::Bitmap) {
+			const auto color = get_source_color(mixmode);
+			if ((mixmode & 0xf) == xga_mix_src) {
+				fill_span<pixel_t, write_mask>(dst, dx, num_pixels, color);
+			} else {
+				draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](Bits, const Bitu d) {
+					return GetMixResult(mixmode, color, d);
+				});
+			}
+		} else if ((mixmode & 0xf) == xga_mix_src) {
+			draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](const Bits i, Bitu) {
+				return pattern_pixel(i);
+			});
+		} else {
+			draw_span<pixel_t, write_mask>(dst, dx, num_pixels, [=](const Bits i, const Bitu d) {
+				return GetMixResult(mixmode, pattern_pixel(i), d);
+			});
+		}
+	}
+	return true;
+}
+
+// Dispatches to the span kernel matching the current colour depth. Returns
+// false if the command needs to take the per-pixel path instead.
+#define XGA_DISPATCH_SPANS(kernel, ...) \
+	switch (XGA_COLOR_MODE) { \
+	case M_LIN8: return kernel<uint8_t, 0xff>(__VA_ARGS__); \
+	case M_LIN15: return kernel<uint16_t, 0x7fff>(__VA_ARGS__); \
+	case M_LIN16: return kernel<uint16_t, 0xffff>(__VA_ARGS__); \
+	case M_LIN32: return kernel<uint32_t, 0xffffffff>(__VA_ARGS__); \
+	default: return false; \
+	}
+
+static bool XGA_DrawRectangleSpans(const Bits dx, const Bits dy, const Bits width)
+{
+	XGA_DISPATCH_SPANS(draw_rectangle_spans, dx, dy, width)
+}
+
+static bool XGA_BlitRectSpans(const Bits dx, const Bits dy,
+                              const uint32_t mixselect, const uint32_t mixmode)
+{
+	XGA_DISPATCH_SPANS(blit_rect_spans, dx, dy, mixselect, mixmode)
+}
+
+static bool XGA_DrawPatternSpans(const Bits dx, const Bits dy,
+                                 const uint32_t mixselect, const uint32_t mixmode)
+{
+	XGA_DISPATCH_SPANS(draw_pattern_spans, dx, dy, mixselect, mixmode)
+}
+
+#undef XGA_DISPATCH_SPANS
+
 static void XGA_DrawLineVector(const uint32_t val, const bool skip_last_pixel)
 {
 	// No work to do with a zero-length line
@@ -518,6 +870,12 @@ static void XGA_DrawRectangle(const uint32_t val, const bool skip_last_pixel)
 	// one pixel too wide (but don't underflow below zero).
 	const auto xrun = xga.MAPcount - (xga.MAPcount && skip_last_pixel);
 
+	if (XGA_DrawRectangleSpans(dx, dy, xrun + 1)) {
+		xga.curx = static_cast<uint16_t>(xga.curx + dx * (xrun + 1));
+		xga.cury = static_cast<uint16_t>(srcy + dy * (xga.MIPcount + 1));
+		return;
+	}
+
 	for (auto yat = 0; yat <= xga.MIPcount; ++yat) {
 		srcx = xga.curx;
 		for (auto xat = 0; xat <= xrun; ++xat) {
@@ -823,6 +1181,10 @@ void XGA_BlitRect(Bitu val) {
 			break;
 	}
 
+	if (XGA_BlitRectSpans(dx, dy, check_cast<uint32_t>(mixselect), mixmode)) {
+		return;
+	}
+
 	/* Copy source to video ram */
 	srcy = xga.cury;
 	tary = xga.desty;
@@ -914,6 +1276,10 @@ void XGA_DrawPattern(Bitu val) {
 			break;
 	}
 
+	if (XGA_DrawPatternSpans(dx, dy, check_cast<uint32_t>(mixselect), mixmode)) {
+		return;
+	}
+
 	for(yat=0;yat<=xga.MIPcount;yat++) {
 		tarx = xga.destx;
 		for(xat=0;xat<=xga.MAPcount;xat++) {
@@ -229,6 +229,10 @@ void INT10_SetCurMode(void);
 
 bool INT10_IsTextMode(const VideoModeBlock& mode_block);
 
+// True if the INT 10h vector still points at our video BIOS handler, so
+// calling the handler functions directly is equivalent to the interrupt
+bool INT10_IsBiosHandlerActive();
+
 void INT10_ScrollWindow(uint8_t rul,uint8_t cul,uint8_t rlr,uint8_t clr,int8_t nlines,uint8_t attr,uint8_t page);
 
 void INT10_SetActivePage(uint8_t page);
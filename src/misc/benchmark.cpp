@@ -0,0 +1,222 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+#include "dosbox.h"
+#include "logging.h"
+#include "perf_counters.h"
+#include "string_utils.h"
+#include "timer.h"
+
+extern bool ticksLocked;
+
+// 64-bit FNV-1a; fast, simple, and stable across hosts and releases
+class Fnv1aHash {
+public:
+	void Add(const uint8_t* data, const size_t num_bytes)
+	{
+		for (size_t i = 0; i < num_bytes; ++i) {
+			value = (value ^ data[i]) * Prime;
+		}
+	}
+
+	uint64_t Get() const
+	{
+		return value;
+	}
+
+private:
+	static constexpr uint64_t OffsetBasis = 0xcbf29ce484222325;
+	static constexpr uint64_t Prime       = 0x100000001b3;
+
+	uint64_t value = OffsetBasis;
+};
+
+struct FrameHash {
+	int frame_number = 0;
+	uint64_t hash    = 0;
+};
+
+static struct {
+	bool is_enabled = false;
+
+	int emulated_ms_limit   = 0;
+	int frame_hash_interval = 0;
+
+	int emulated_ms = 0;
+	std::chrono::steady_clock::time_point start_time = {};
+	std::chrono::steady_clock::time_point end_time   = {};
+
+	int num_frames          = 0;
+	Fnv1aHash all_frames    = {};
+	std::vector<FrameHash> frame_hashes = {};
+
+	int64_t num_audio_frames = 0;
+	Fnv1aHash audio          = {};
+} benchmark = {};
+
+void BENCHMARK_Enable(const int emulated_seconds, const int frame_hash_interval)
+{
+	assert(emulated_seconds > 0);
+
+	benchmark.is_enabled          = true;
+	benchmark.emulated_ms_limit   = emulated_seconds * 1000;
+	benchmark.frame_hash_interval = std::max(frame_hash_interval, 1);
+}
+
+bool BENCHMARK_IsEnabled()
+{
+	return benchmark.is_enabled;
+}
+
+static void benchmark_tick_handler()
+{
+	// Every tick is one emulated millisecond
+	if (++benchmark.emulated_ms < benchmark.emulated_ms_limit) {
+		return;
+	}
+	if (!shutdown_requested) {
+		benchmark.end_time = std::chrono::steady_clock::now();
+		shutdown_requested = true;
+	}
+}
+
+void BENCHMARK_Start()
+{
+	if (!benchmark.is_enabled) {
+		return;
+	}
+	// Free-running emulated time, as in fast-forward mode
+	ticksLocked = true;
+
+	PERF_Reset();
+	TIMER_AddTickHandler(&benchmark_tick_handler);
+
+	benchmark.start_time = std::chrono::steady_clock::now();
+
+	LOG_MSG("BENCHMARK: Running for %d emulated seconds",
+	        benchmark.emulated_ms_limit / 1000);
+}
+
+void BENCHMARK_AddFrame(const RenderedImage& image)
+{
+	assert(benchmark.is_enabled);
+	assert(image.image_data);
+
+	const auto& params = image.params;
+
+	const auto bytes_per_row = static_cast<size_t>(params.width) *
+	                           get_bits_per_pixel(params.pixel_format) / 8;
+
+	Fnv1aHash frame = {};
+	auto row        = image.image_data;
+	for (auto y = 0; y < params.height; ++y) {
+		frame.Add(row, bytes_per_row);
+		row += image.pitch;
+	}
+	if (image.is_paletted()) {
+		constexpr auto PaletteBytes = 256 * 4;
+		frame.Add(image.palette_data, PaletteBytes);
+	}
+
+	const auto hash = frame.Get();
+	benchmark.all_frames.Add(reinterpret_cast<const uint8_t*>(&hash),
+	                         sizeof(hash));
+
+	if (++benchmark.num_frames % benchmark.frame_hash_interval == 0) {
+		benchmark.frame_hashes.push_back({benchmark.num_frames, hash});
+	}
+}
+
+void BENCHMARK_AddAudio(const int16_t* frames, const int num_frames)
+{
+	assert(benchmark.is_enabled);
+	assert(frames || num_frames == 0);
+
+	// The samples are already stored in little-endian order
+	constexpr auto BytesPerFrame = 2 * sizeof(int16_t);
+
+	benchmark.audio.Add(reinterpret_cast<const uint8_t*>(frames),
+	                    static_cast<size_t>(num_frames) * BytesPerFrame);
+	benchmark.num_audio_frames += num_frames;
+}
+
+void BENCHMARK_PrintReport()
+{
+	if (!benchmark.is_enabled) {
+		return;
+	}
+	using namespace std::chrono;
+
+	// The emulation might have ended before reaching the time limit
+	if (benchmark.end_time < benchmark.start_time) {
+		benchmark.end_time = steady_clock::now();
+	}
+	const auto wall_seconds = duration<double>(benchmark.end_time -
+	                                           benchmark.start_time)
+	                                  .count();
+	const auto emulated_seconds = static_cast<double>(benchmark.emulated_ms) /
+	                              1000.0;
+
+	const auto samples = PERF_GetSamples();
+
+	uint64_t num_cycles = 0;
+	for (const auto& sample : samples) {
+		if (starts_with(sample.name, "cpu.cycles.")) {
+			num_cycles += sample.value;
+		}
+	}
+	const auto mips = wall_seconds > 0.0
+	                        ? static_cast<double>(num_cycles) / wall_seconds / 1e6
+	                        : 0.0;
+
+	printf("\nBenchmark results\n"
+	       "-----------------\n");
+	printf("Emulated time:      %.3f s\n", emulated_seconds);
+	printf("Wall time:          %.3f s\n", wall_seconds);
+	printf("Speed:              %.2fx real time\n",
+	       wall_seconds > 0.0 ? emulated_seconds / wall_seconds : 0.0);
+	printf("Emulated cycles:    %" PRIu64 "\n", num_cycles);
+	printf("Emulated MIPS:      %.2f\n", mips);
+	printf("Rendered frames:    %d\n", benchmark.num_frames);
+	printf("Video hash:         %016" PRIx64 "\n", benchmark.all_frames.Get());
+	printf("Mixed audio frames: %" PRId64 "\n", benchmark.num_audio_frames);
+	printf("Audio hash:         %016" PRIx64 "\n", benchmark.audio.Get());
+
+	printf("\nFrame hashes (every %d frames)\n", benchmark.frame_hash_interval);
+	for (const auto& frame : benchmark.frame_hashes) {
+		printf("%10d  %016" PRIx64 "\n", frame.frame_number, frame.hash);
+	}
+
+	printf("\nCounters\n");
+	for (const auto& sample : samples) {
+		printf("%-34s %20" PRIu64 "\n", sample.name.c_str(), sample.value);
+	}
+	fflush(stdout);
+}
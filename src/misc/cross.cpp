@@ -36,6 +36,7 @@
 
 #ifdef WIN32
 #	include <winnls.h>
+#	include <psapi.h>
 
 #	ifndef _WIN32_IE
 #		define _WIN32_IE 0x0400
@@ -54,6 +55,10 @@
 #	include <pwd.h>
 #endif
 
+#if defined(MACOSX)
+#	include <mach/mach.h>
+#endif
+
 #include "fs_utils.h"
 #include "string_utils.h"
 #include "support.h"
@@ -715,6 +720,44 @@ std::string cfstr_to_string(CFStringRef source)
 	return lang;
 }
 
+// ***************************************************************************
+// Memory usage
+// ***************************************************************************
+
+std::optional<size_t> get_resident_memory_bytes()
+{
+#if defined(WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.WorkingSetSize;
+	}
+#elif defined(MACOSX)
+	mach_task_basic_info_data_t info = {};
+	mach_msg_type_number_t count     = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(),
+	              MACH_TASK_BASIC_INFO,
+	              reinterpret_cast<task_info_t>(&info),
+	              &count) == KERN_SUCCESS) {
+		return info.resident_size;
+	}
+#else
+	// The second field of statm is the number of resident pages
+	if (auto file = fopen("/proc/self/statm", "r"); file) {
+		unsigned long total_pages    = 0;
+		unsigned long resident_pages = 0;
+		const auto num_read = fscanf(file, "%lu %lu", &total_pages, &resident_pages);
+		fclose(file);
+
+		const auto page_size = sysconf(_SC_PAGESIZE);
+		if (num_read == 2 && page_size > 0) {
+			return static_cast<size_t>(resident_pages) *
+			       static_cast<size_t>(page_size);
+		}
+	}
+#endif
+	return {};
+}
+
 // ***************************************************************************
 // Local time support
 // ***************************************************************************
@@ -0,0 +1,267 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "logging.h"
+#include "setup.h"
+#include "string_utils.h"
+#include "timer.h"
+
+std::atomic<bool> perf_counters_enabled = false;
+thread_local PerfCounterShard* perf_thread_shard = nullptr;
+
+// Constructed on first use, as the counters register themselves during
+// static initialisation
+static auto& get_registry()
+{
+	static struct {
+		std::mutex mutex = {};
+		std::vector<std::string> names = {};
+
+		// Shards outlive their threads, so nothing counted gets lost
+		std::vector<std::unique_ptr<PerfCounterShard>> shards = {};
+
+		std::vector<PerfCounterProvider> providers = {};
+
+		// Registrations refused for exceeding MaxPerfCounters
+		int num_refused = 0;
+	} registry = {};
+
+	return registry;
+}
+
+// State of the main thread only
+static struct {
+	std::map<std::string, uint64_t> baseline = {};
+	int64_t baseline_ms = 0;
+
+	FILE* dump_file = nullptr;
+	bool is_dump_json = false;
+	int64_t last_dump_ms = 0;
+} perf = {};
+
+constexpr int64_t DumpIntervalMs = 1000;
+
+PerfCounterShard* PERF_CreateThreadShard()
+{
+	auto& registry = get_registry();
+	const std::lock_guard<std::mutex> lock(registry.mutex);
+
+	registry.shards.emplace_back(std::make_unique<PerfCounterShard>());
+	perf_thread_shard = registry.shards.back().get();
+	return perf_thread_shard;
+}
+
+PerfCounter::PerfCounter(const char* name)
+{
+	auto& registry = get_registry();
+	const std::lock_guard<std::mutex> lock(registry.mutex);
+
+	// Raise MaxPerfCounters if this fires
+	assert(registry.names.size() < MaxPerfCounters);
+
+	// Counters past the cap count into the unreported overflow slot; this
+	// runs during static initialisation, so the warning is deferred to
+	// PERF_Init
+	if (registry.names.size() >= MaxPerfCounters) {
+		index = MaxPerfCounters;
+		++registry.num_refused;
+		return;
+	}
+	index = static_cast<int>(registry.names.size());
+	registry.names.emplace_back(name);
+}
+
+PerfTimer::PerfTimer(const std::string& name)
+        : calls_name(name + ".calls"),
+          nanoseconds_name(name + ".ns"),
+          calls(calls_name.c_str()),
+          nanoseconds(nanoseconds_name.c_str())
+{}
+
+void PERF_AddProvider(PerfCounterProvider provider)
+{
+	auto& registry = get_registry();
+	const std::lock_guard<std::mutex> lock(registry.mutex);
+
+	registry.providers.emplace_back(std::move(provider));
+}
+
+static std::vector<PerfSample> get_raw_samples()
+{
+	std::vector<PerfSample> samples = {};
+
+	auto& registry = get_registry();
+	{
+		const std::lock_guard<std::mutex> lock(registry.mutex);
+		for (size_t i = 0; i < registry.names.size(); ++i) {
+			uint64_t total = 0;
+			for (const auto& shard : registry.shards) {
+				total += shard->values[i].load(std::memory_order_relaxed);
+			}
+			samples.push_back({registry.names[i], total});
+		}
+	}
+	for (const auto& provider : registry.providers) {
+		provider(samples);
+	}
+	return samples;
+}
+
+std::vector<PerfSample> PERF_GetSamples()
+{
+	std::vector<PerfSample> samples = {};
+
+	for (auto& sample : get_raw_samples()) {
+		const auto it = perf.baseline.find(sample.name);
+		if (it != perf.baseline.end()) {
+			sample.value -= std::min(sample.value, it->second);
+		}
+		if (sample.value) {
+			samples.push_back(std::move(sample));
+		}
+	}
+	std::sort(samples.begin(), samples.end(), [](const auto& a, const auto& b) {
+		return a.name < b.name;
+	});
+	return samples;
+}
+
+int64_t PERF_GetSampledMs()
+{
+	return GetTicksSince(perf.baseline_ms);
+}
+
+void PERF_Reset()
+{
+	perf.baseline.clear();
+	for (const auto& sample : get_raw_samples()) {
+		perf.baseline[sample.name] = sample.value;
+	}
+	perf.baseline_ms  = GetTicks();
+	perf.last_dump_ms = perf.baseline_ms;
+}
+
+static void dump_samples()
+{
+	assert(perf.dump_file);
+
+	const auto ms = PERF_GetSampledMs();
+	const auto samples = PERF_GetSamples();
+
+	if (perf.is_dump_json) {
+		// One object per line (JSON Lines)
+		fprintf(perf.dump_file, "{\"ms\": %" PRId64 ", \"counters\": {", ms);
+		for (size_t i = 0; i < samples.size(); ++i) {
+			fprintf(perf.dump_file,
+			        "%s\"%s\": %" PRIu64,
+			        i ? ", " : "",
+			        samples[i].name.c_str(),
+			        samples[i].value);
+		}
+		fprintf(perf.dump_file, "}}\n");
+	} else {
+		for (const auto& sample : samples) {
+			fprintf(perf.dump_file,
+			        "%" PRId64 ",%s,%" PRIu64 "\n",
+			        ms,
+			        sample.name.c_str(),
+			        sample.value);
+		}
+	}
+	fflush(perf.dump_file);
+}
+
+static void perf_tick_handler()
+{
+	const auto now = GetTicks();
+	if (now - perf.last_dump_ms < DumpIntervalMs) {
+		return;
+	}
+	perf.last_dump_ms = now;
+	dump_samples();
+}
+
+static void open_dump_file(const std::string& path)
+{
+	perf.dump_file = fopen(path.c_str(), "w");
+	if (!perf.dump_file) {
+		LOG_WARNING("PERF: Can't open '%s' to write the performance counters",
+		            path.c_str());
+		return;
+	}
+	std::string extension = std_fs::path(path).extension().string();
+	lowcase(extension);
+	perf.is_dump_json = (extension == ".json");
+
+	if (!perf.is_dump_json) {
+		fprintf(perf.dump_file, "ms,counter,value\n");
+	}
+	TIMER_AddTickHandler(&perf_tick_handler);
+
+	LOG_MSG("PERF: Writing the performance counters to '%s' every %" PRId64 " ms",
+	        path.c_str(),
+	        DumpIntervalMs);
+}
+
+static void perf_destroy(Section*)
+{
+	if (perf.dump_file) {
+		TIMER_DelTickHandler(&perf_tick_handler);
+		dump_samples();
+		fclose(perf.dump_file);
+		perf.dump_file = nullptr;
+	}
+	perf_counters_enabled = false;
+}
+
+void PERF_Init(Section* sec)
+{
+	assert(sec);
+	const auto section = static_cast<Section_prop*>(sec);
+
+	constexpr auto changeable_at_runtime = true;
+	sec->AddDestroyFunction(&perf_destroy, changeable_at_runtime);
+
+	const std::string setting = section->Get_string("perf_counters");
+	if (setting.empty() || has_false(setting)) {
+		return;
+	}
+	if (const auto num_refused = get_registry().num_refused; num_refused > 0) {
+		LOG_WARNING("PERF: %d performance counters exceed the limit of %d and won't be reported",
+		            num_refused,
+		            MaxPerfCounters);
+	}
+	PERF_Reset();
+	perf_counters_enabled = true;
+
+	if (!has_true(setting)) {
+		open_dump_file(setting);
+	}
+}
@@ -107,6 +107,20 @@ bool RWQueue<T>::Enqueue(T&& item)
 	return is_running;
 }
 
+template <typename T>
+bool RWQueue<T>::NonblockingEnqueue(T&& item)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!is_running || queue.size() >= capacity) {
+		return false;
+	}
+	queue.emplace(queue.end(), std::move(item));
+
+	lock.unlock();
+	has_items.notify_one();
+	return true;
+}
+
 // In both bulk methods, the best case scenario is if the queue can absorb or
 // fill the entire request in one pass.
 
@@ -254,3 +268,6 @@ template class RWQueue<MidiWork>;
 
 #include "render.h"
 template class RWQueue<SaveImageTask>;
+
+#include "../capture/capture_writer.h"
+template class RWQueue<CaptureWriteTask>;
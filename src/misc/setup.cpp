@@ -33,6 +33,7 @@
 #include "control.h"
 #include "cross.h"
 #include "fs_utils.h"
+#include "startup_trace.h"
 #include "string_utils.h"
 #include "support.h"
 
@@ -1202,11 +1203,90 @@ Config::Config(Config&& source) noexcept
 	*this = std::move(source);
 }
 
+static double to_megabytes(const size_t bytes)
+{
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+// Reports the sections that noticeably grew the resident memory, so the
+// memory footprint of each part of the emulator can be tracked
+static void log_section_memory_usage(const char* section_name,
+                                     const std::optional<size_t> rss_before,
+                                     const std::optional<size_t> rss_after)
+{
+	constexpr size_t ReportThresholdBytes = 1024 * 1024;
+
+	if (!rss_before || !rss_after || *rss_after < *rss_before + ReportThresholdBytes) {
+		return;
+	}
+	LOG_MSG("MEMORY: Initialising the [%s] section added %.1f MB of resident memory",
+	        section_name,
+	        to_megabytes(*rss_after - *rss_before));
+}
+
 void Config::Init() const
 {
+	// Get the independent preparation work of all sections going first so
+	// it overlaps with the serial initialisation below
+	for (const auto& sec : sectionlist) {
+		sec->StartPreparation();
+	}
+	const auto rss_at_start = get_resident_memory_bytes();
+
 	for (const auto& sec : sectionlist) {
-		sec->ExecuteInit();
+		sec->FinishPreparation();
+
+		const auto rss_before = get_resident_memory_bytes();
+		{
+			const StartupTraceScope trace_scope(std::string("[") +
+			                                    sec->GetName() + "]");
+			sec->ExecuteInit();
+		}
+		log_section_memory_usage(sec->GetName(),
+		                         rss_before,
+		                         get_resident_memory_bytes());
+	}
+
+	if (const auto rss = get_resident_memory_bytes(); rss && rss_at_start) {
+		LOG_MSG("MEMORY: Resident memory after initialising all sections: "
+		        "%.1f MB (%.1f MB added by the sections)",
+		        to_megabytes(*rss),
+		        to_megabytes(*rss - std::min(*rss, *rss_at_start)));
+	}
+}
+
+void Section::AddPrepareFunction(SectionFunction func)
+{
+	if (func) {
+		prepare_functions.emplace_back(func);
+	}
+}
+
+void Section::StartPreparation()
+{
+	for (const auto func : prepare_functions) {
+		auto prepare = [this, func] {
+			const StartupTraceScope trace_scope(
+			        std::string("[") + GetName() + "] preparation");
+			func(this);
+		};
+		preparations.emplace_back(std::async(std::launch::async, prepare));
+	}
+}
+
+void Section::FinishPreparation()
+{
+	if (preparations.empty()) {
+		return;
+	}
+	const StartupTraceScope trace_scope(std::string("[") + GetName() +
+	                                    "] waiting for preparation");
+
+	// Rethrows any exception from the worker threads on the main thread
+	for (auto& preparation : preparations) {
+		preparation.get();
 	}
+	preparations.clear();
 }
 
 void Section::AddInitFunction(SectionFunction func, bool changeable_at_runtime)
@@ -1793,8 +1873,12 @@ void Config::ParseArguments()
 	arguments.working_dir = cmdline->FindRemoveStringArgument("working-dir");
 	arguments.lang = cmdline->FindRemoveStringArgument("lang");
 	arguments.machine = cmdline->FindRemoveStringArgument("machine");
+	arguments.startup_trace = cmdline->FindRemoveStringArgument("startup-trace");
 
 	arguments.socket = cmdline->FindRemoveIntArgument("socket");
+	arguments.benchmark = cmdline->FindRemoveIntArgument("benchmark");
+	arguments.benchmark_hash_interval = cmdline->FindRemoveIntArgument(
+	        "benchmark-hash-interval");
 
 	arguments.conf = cmdline->FindRemoveVectorArgument("conf");
 	arguments.set  = cmdline->FindRemoveVectorArgument("set");
@@ -0,0 +1,216 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "startup_trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "logging.h"
+
+// Taken during static initialisation, so the timeline starts as close to the
+// launch of the process as we can get
+static const auto trace_epoch = startup_trace_clock::now();
+
+struct TraceEvent {
+	std::string name    = {};
+	int64_t start_us    = 0;
+	int64_t duration_us = 0;
+	int thread_index    = 0;
+	bool is_milestone   = false;
+};
+
+static std::atomic<bool> is_trace_enabled = false;
+
+static struct {
+	std::mutex mutex = {};
+	std_fs::path path = {};
+	std::vector<TraceEvent> events = {};
+	std::vector<std::thread::id> threads = {};
+	bool is_written = false;
+} trace = {};
+
+static int64_t to_trace_us(const startup_trace_clock::time_point time)
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(time - trace_epoch).count();
+}
+
+// Numbers the threads in the order they first record something, so the main
+// thread comes first. Needs the trace mutex to be held.
+static int get_thread_index()
+{
+	const auto id = std::this_thread::get_id();
+	for (size_t i = 0; i < trace.threads.size(); ++i) {
+		if (trace.threads[i] == id) {
+			return static_cast<int>(i);
+		}
+	}
+	trace.threads.push_back(id);
+	return static_cast<int>(trace.threads.size() - 1);
+}
+
+void STARTUP_EnableTrace(const std_fs::path& path)
+{
+	const std::lock_guard<std::mutex> lock(trace.mutex);
+	trace.path = path;
+
+	// Claim the first timeline row for the calling (main) thread
+	get_thread_index();
+
+	is_trace_enabled = true;
+}
+
+bool STARTUP_IsTraceEnabled()
+{
+	return is_trace_enabled;
+}
+
+void STARTUP_TraceEvent(const std::string& name,
+                        const startup_trace_clock::time_point start,
+                        const startup_trace_clock::time_point end)
+{
+	if (!is_trace_enabled) {
+		return;
+	}
+	TraceEvent event = {};
+	event.name        = name;
+	event.start_us    = to_trace_us(start);
+	event.duration_us = to_trace_us(end) - event.start_us;
+
+	const std::lock_guard<std::mutex> lock(trace.mutex);
+	event.thread_index = get_thread_index();
+	trace.events.push_back(std::move(event));
+}
+
+void STARTUP_TraceMilestone(const std::string& name)
+{
+	if (!is_trace_enabled) {
+		return;
+	}
+	TraceEvent event  = {};
+	event.name         = name;
+	event.start_us     = to_trace_us(startup_trace_clock::now());
+	event.is_milestone = true;
+
+	const std::lock_guard<std::mutex> lock(trace.mutex);
+	event.thread_index = get_thread_index();
+	trace.events.push_back(std::move(event));
+}
+
+static std::string escape_json(const std::string& str)
+{
+	std::string escaped = {};
+	for (const auto c : str) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		if (static_cast<unsigned char>(c) >= ' ') {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+void STARTUP_WriteTrace()
+{
+	if (!is_trace_enabled) {
+		return;
+	}
+	const std::lock_guard<std::mutex> lock(trace.mutex);
+	if (trace.is_written) {
+		return;
+	}
+	trace.is_written = true;
+
+	auto file = fopen(trace.path.string().c_str(), "w");
+	if (!file) {
+		LOG_WARNING("STARTUP: Can't write the startup trace to '%s'",
+		            trace.path.string().c_str());
+		return;
+	}
+
+	// Every entry but the first is preceded by a separator
+	auto is_first_entry = true;
+	auto begin_entry = [&] {
+		fprintf(file, is_first_entry ? "\n" : ",\n");
+		is_first_entry = false;
+	};
+
+	fprintf(file, "{\"traceEvents\": [");
+	for (size_t i = 0; i < trace.threads.size(); ++i) {
+		begin_entry();
+		fprintf(file,
+		        "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+		        "\"tid\": %zu, \"args\": {\"name\": \"%s\"}}",
+		        i,
+		        i == 0 ? "main" : "worker");
+	}
+
+	int64_t last_us = 0;
+	for (const auto& event : trace.events) {
+		begin_entry();
+		if (event.is_milestone) {
+			fprintf(file,
+			        "{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"g\", "
+			        "\"pid\": 1, \"tid\": %d, \"ts\": %" PRId64 "}",
+			        escape_json(event.name).c_str(),
+			        event.thread_index,
+			        event.start_us);
+		} else {
+			fprintf(file,
+			        "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+			        "\"tid\": %d, \"ts\": %" PRId64 ", \"dur\": %" PRId64 "}",
+			        escape_json(event.name).c_str(),
+			        event.thread_index,
+			        event.start_us,
+			        event.duration_us);
+		}
+		last_us = std::max(last_us, event.start_us + event.duration_us);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	LOG_MSG("STARTUP: Wrote the startup trace covering %.1f ms to '%s'",
+	        static_cast<double>(last_us) / 1000.0,
+	        trace.path.string().c_str());
+}
+
+StartupTraceScope::StartupTraceScope(std::string event_name)
+        : is_enabled(is_trace_enabled)
+{
+	if (is_enabled) {
+		name  = std::move(event_name);
+		start = startup_trace_clock::now();
+	}
+}
+
+StartupTraceScope::~StartupTraceScope()
+{
+	if (is_enabled) {
+		STARTUP_TraceEvent(name, start, startup_trace_clock::now());
+	}
+}
@@ -272,11 +272,9 @@ const std_fs::path &GetExecutablePath()
 	return exe_path;
 }
 
-static const std::deque<std_fs::path> &GetResourceParentPaths()
+static std::deque<std_fs::path> find_resource_parent_paths()
 {
-	static std::deque<std_fs::path> paths = {};
-	if (!paths.empty())
-		return paths;
+	std::deque<std_fs::path> paths = {};
 
 	auto add_if_exists = [&](const std_fs::path &p) {
 		std::error_code ec = {};
@@ -328,6 +326,14 @@ static const std::deque<std_fs::path> &GetResourceParentPaths()
 	return paths;
 }
 
+static const std::deque<std_fs::path> &GetResourceParentPaths()
+{
+	// Looked up only once, in a thread-safe manner, as resources are also
+	// loaded by the worker threads preparing the config sections
+	static const auto paths = find_resource_parent_paths();
+	return paths;
+}
+
 // Select either an integer or real-based uniform distribution
 template <typename T>
 	using uniform_distributor_t =
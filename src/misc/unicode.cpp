@@ -22,6 +22,7 @@
 #include <cctype>
 #include <fstream>
 #include <map>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
@@ -1952,17 +1953,18 @@ static bool prepare_code_page(const uint16_t code_page)
 static void load_config_if_needed()
 {
 	// If this is the first time we are requested to prepare the code page,
-	// load the top-level configuration and fallback 7-bit ASCII mapping
+	// load the top-level configuration and fallback 7-bit ASCII mapping.
+	// This can happen on a worker thread during startup (see
+	// 'load_unicode_mappings'), so any other caller waits for it to finish.
 
-	static bool config_loaded = false;
-	if (!config_loaded) {
+	static std::once_flag config_loaded = {};
+	std::call_once(config_loaded, [] {
 		const auto path_root = GetResourcePath(dir_name_mapping);
 		import_decomposition(path_root);
 		import_mapping_ascii(path_root);
 		import_mapping_case(path_root);
 		import_config_main(path_root);
-		config_loaded = true;
-	}
+	});
 }
 
 static uint16_t get_custom_code_page(const uint16_t in_code_page)
@@ -1985,6 +1987,11 @@ static uint16_t get_custom_code_page(const uint16_t in_code_page)
 // External interface
 // ***************************************************************************
 
+void load_unicode_mappings()
+{
+	load_config_if_needed();
+}
+
 uint16_t get_utf8_code_page()
 {
 	load_config_if_needed();
@@ -34,6 +34,7 @@
 #include "fs_utils.h"
 #include "mapper.h"
 #include "regs.h"
+#include "startup_trace.h"
 #include "string_utils.h"
 #include "support.h"
 #include "timer.h"
@@ -445,6 +446,10 @@ void DOS_Shell::Run()
 			RunBatchFile();
 		} else {
 			if (echo) ShowPrompt();
+			if (STARTUP_IsTraceEnabled()) {
+				STARTUP_TraceMilestone("First DOS prompt");
+				STARTUP_WriteTrace();
+			}
 			InputCommand(input_line);
 			ParseLine(input_line);
 		}
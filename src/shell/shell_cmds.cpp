@@ -1201,13 +1201,17 @@ void DOS_Shell::CMD_COPY(char* args)
 						//In concat mode. Open the target and seek to the eof
 						if (!oldsource.concat || (DOS_OpenFile(nameTarget,OPEN_READWRITE,&targetHandle) &&
 					        	                  DOS_SeekFile(targetHandle,&dummy,DOS_SEEK_END))) {
-							// Copy
-							static uint8_t buffer[0x8000]; // static, otherwise stack overflow possible.
-							uint16_t toread = 0x8000;
-							do {
-								DOS_ReadFile(sourceHandle, buffer, &toread);
-								DOS_WriteFile(targetHandle, buffer, &toread);
-							} while (toread == 0x8000);
+							// Copy, directly on the host if both
+							// files live there
+							if (!DOS_CopyFileOnHost(sourceHandle,
+							                        targetHandle)) {
+								static uint8_t buffer[0x8000]; // static, otherwise stack overflow possible.
+								uint16_t toread = 0x8000;
+								do {
+									DOS_ReadFile(sourceHandle, buffer, &toread);
+									DOS_WriteFile(targetHandle, buffer, &toread);
+								} while (toread == 0x8000);
+							}
 							if (!oldsource.concat) {
 								DOS_GetFileDate(
 								        sourceHandle,
@@ -1640,13 +1644,24 @@ nextfile:
 		WriteOut(MSG_Get("SHELL_FILE_NOT_FOUND"),word);
 		return;
 	}
-	uint16_t n;uint8_t c;
+	// Pass the file on in blocks so the console can print whole runs of
+	// text at once
+	constexpr uint8_t code_eof = 0x1a;
+	uint8_t buffer[512];
+	uint16_t n;
+	bool is_eof_found = false;
 	do {
-		n=1;
-		DOS_ReadFile(handle,&c,&n);
-		if (c == 0x1a) break; // stop at EOF
-		DOS_WriteFile(STDOUT,&c,&n);
-	} while (n);
+		n = sizeof(buffer);
+		DOS_ReadFile(handle, buffer, &n);
+
+		const auto eof = std::find(buffer, buffer + n, code_eof);
+		is_eof_found   = (eof != buffer + n);
+
+		n = static_cast<uint16_t>(eof - buffer);
+		if (n > 0) {
+			DOS_WriteFile(STDOUT, buffer, &n);
+		}
+	} while (n && !is_eof_found);
 	DOS_CloseFile(handle);
 	if (*args) goto nextfile;
 }
@@ -2434,7 +2449,11 @@ void DOS_Shell::CMD_MOVE(char* args)
 			uint8_t buffer[buffer_capacity];
 			uint16_t bytes_requested = buffer_capacity;
 			bool success             = true;
-			do {
+
+			// Copy directly on the host if both files live there
+			const auto copied_on_host = DOS_CopyFileOnHost(source_handle,
+			                                               dest_handle);
+			while (!copied_on_host) {
 				if (!DOS_ReadFile(source_handle, buffer, &bytes_requested)) {
 					WriteOut(MSG_Get("SHELL_READ_ERROR"),
 					         source.c_str());
@@ -2449,7 +2468,10 @@ void DOS_Shell::CMD_MOVE(char* args)
 					success = false;
 					break;
 				}
-			} while (bytes_requested == buffer_capacity);
+				if (bytes_requested != buffer_capacity) {
+					break;
+				}
+			}
 
 			if (success) {
 				WriteOut("%s => %s\n",
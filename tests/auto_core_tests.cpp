@@ -0,0 +1,271 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "auto_core.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+
+// declarations of private functions to test
+std::string make_core_profile_key(const std::string& dos_path,
+                                  const uint32_t file_size);
+
+std::map<std::string, CoreProfile> parse_core_profiles(std::istream& in);
+
+bool is_host_busy(const AutoCoreSamples& samples, const int64_t slice_us);
+
+bool is_dynamic_core_thrashing(const AutoCoreSamples& samples);
+
+std::optional<CoreProfile> decide_core_switch(
+        AutoCoreSliceState& state, const std::optional<CoreProfile> active_core,
+        const bool is_busy, const bool is_thrashing);
+
+namespace {
+
+std::map<std::string, CoreProfile> parse(const std::string& text)
+{
+	std::istringstream in(text);
+	return parse_core_profiles(in);
+}
+
+TEST(make_core_profile_key, path_and_size)
+{
+	EXPECT_EQ(make_core_profile_key("C:\\GAMES\\DOOM\\DOOM.EXE", 709753),
+	          "C:\\GAMES\\DOOM\\DOOM.EXE 709753");
+}
+
+TEST(make_core_profile_key, normalises_case)
+{
+	EXPECT_EQ(make_core_profile_key("c:\\games\\doom.exe", 10),
+	          make_core_profile_key("C:\\GAMES\\DOOM.EXE", 10));
+}
+
+TEST(make_core_profile_key, same_name_different_size)
+{
+	EXPECT_NE(make_core_profile_key("C:\\GAME.EXE", 1000),
+	          make_core_profile_key("C:\\GAME.EXE", 1001));
+}
+
+TEST(parse_core_profiles, valid_entries)
+{
+	const auto profiles = parse("C:\\GAMES\\DOOM.EXE 709753 = dynamic\n"
+	                            "C:\\GAMES\\SMC.COM 1234 = normal\n");
+
+	ASSERT_EQ(profiles.size(), 2);
+	EXPECT_EQ(profiles.at("C:\\GAMES\\DOOM.EXE 709753"), CoreProfile::Dynamic);
+	EXPECT_EQ(profiles.at("C:\\GAMES\\SMC.COM 1234"), CoreProfile::Normal);
+}
+
+TEST(parse_core_profiles, skips_comments_and_blank_lines)
+{
+	const auto profiles = parse("# a comment\n"
+	                            "\n"
+	                            "   \n"
+	                            "  # indented comment = dynamic\n"
+	                            "C:\\A.EXE 1 = dynamic\n");
+
+	ASSERT_EQ(profiles.size(), 1);
+	EXPECT_EQ(profiles.at("C:\\A.EXE 1"), CoreProfile::Dynamic);
+}
+
+TEST(parse_core_profiles, normalises_case_and_whitespace)
+{
+	const auto profiles = parse("  c:\\games\\a.exe 42\t=\tDYNAMIC  \r\n");
+
+	ASSERT_EQ(profiles.size(), 1);
+	EXPECT_EQ(profiles.at("C:\\GAMES\\A.EXE 42"), CoreProfile::Dynamic);
+}
+
+TEST(parse_core_profiles, skips_invalid_lines)
+{
+	const auto profiles = parse("C:\\A.EXE 1 dynamic\n"
+	                            "C:\\B.EXE 2 = turbo\n"
+	                            " = normal\n"
+	                            "C:\\C.EXE 3 =\n");
+	EXPECT_TRUE(profiles.empty());
+}
+
+TEST(parse_core_profiles, last_entry_wins)
+{
+	const auto profiles = parse("C:\\A.EXE 1 = dynamic\n"
+	                            "C:\\A.EXE 1 = normal\n");
+
+	ASSERT_EQ(profiles.size(), 1);
+	EXPECT_EQ(profiles.at("C:\\A.EXE 1"), CoreProfile::Normal);
+}
+
+constexpr int64_t SliceUs = 1'000'000;
+
+TEST(is_host_busy, no_idle_time)
+{
+	AutoCoreSamples samples = {};
+	EXPECT_TRUE(is_host_busy(samples, SliceUs));
+}
+
+TEST(is_host_busy, little_idle_time)
+{
+	AutoCoreSamples samples = {};
+	samples.host_idle_us    = SliceUs / 20;
+	EXPECT_TRUE(is_host_busy(samples, SliceUs));
+}
+
+TEST(is_host_busy, mostly_idle)
+{
+	AutoCoreSamples samples = {};
+	samples.host_idle_us    = SliceUs / 2;
+	EXPECT_FALSE(is_host_busy(samples, SliceUs));
+}
+
+TEST(is_dynamic_core_thrashing, quiet_slice)
+{
+	AutoCoreSamples samples   = {};
+	samples.blocks_translated = 500;
+	EXPECT_FALSE(is_dynamic_core_thrashing(samples));
+}
+
+TEST(is_dynamic_core_thrashing, few_invalidations)
+{
+	AutoCoreSamples samples    = {};
+	samples.blocks_translated  = 100;
+	samples.blocks_invalidated = 100;
+	EXPECT_FALSE(is_dynamic_core_thrashing(samples));
+}
+
+TEST(is_dynamic_core_thrashing, retranslating_invalidated_blocks)
+{
+	AutoCoreSamples samples    = {};
+	samples.blocks_translated  = 5000;
+	samples.blocks_invalidated = 5000;
+	EXPECT_TRUE(is_dynamic_core_thrashing(samples));
+}
+
+TEST(is_dynamic_core_thrashing, invalidations_outweighed_by_new_code)
+{
+	AutoCoreSamples samples    = {};
+	samples.blocks_translated  = 100'000;
+	samples.blocks_invalidated = 5000;
+	EXPECT_FALSE(is_dynamic_core_thrashing(samples));
+}
+
+TEST(is_dynamic_core_thrashing, frequent_code_page_writes)
+{
+	AutoCoreSamples samples  = {};
+	samples.code_page_writes = 10'000'000;
+	EXPECT_TRUE(is_dynamic_core_thrashing(samples));
+}
+
+constexpr auto Normal  = CoreProfile::Normal;
+constexpr auto Dynamic = CoreProfile::Dynamic;
+
+TEST(decide_core_switch, busy_normal_core_switches_after_two_slices)
+{
+	AutoCoreSliceState state = {};
+
+	EXPECT_EQ(decide_core_switch(state, Normal, true, false), std::nullopt);
+	EXPECT_EQ(decide_core_switch(state, Normal, true, false), Dynamic);
+}
+
+TEST(decide_core_switch, idle_slice_resets_busy_count)
+{
+	AutoCoreSliceState state = {};
+
+	EXPECT_EQ(decide_core_switch(state, Normal, true, false), std::nullopt);
+	EXPECT_EQ(decide_core_switch(state, Normal, false, false), std::nullopt);
+	EXPECT_EQ(decide_core_switch(state, Normal, true, false), std::nullopt);
+}
+
+TEST(decide_core_switch, single_thrashing_slice_keeps_dynamic_core)
+{
+	AutoCoreSliceState state = {};
+
+	// E.g., a loader or unpacker stage at start-up
+	EXPECT_EQ(decide_core_switch(state, Dynamic, true, true), std::nullopt);
+	for (auto i = 0; i < 10; ++i) {
+		EXPECT_EQ(decide_core_switch(state, Dynamic, true, false),
+		          std::nullopt);
+	}
+	EXPECT_EQ(state.pinned_slices_left, 0);
+}
+
+TEST(decide_core_switch, persistent_thrashing_pins_normal_core)
+{
+	AutoCoreSliceState state = {};
+
+	EXPECT_EQ(decide_core_switch(state, Dynamic, true, true), std::nullopt);
+	EXPECT_EQ(decide_core_switch(state, Dynamic, true, true), std::nullopt);
+	EXPECT_EQ(decide_core_switch(state, Dynamic, true, true), Normal);
+	EXPECT_GT(state.pinned_slices_left, 0);
+}
+
+TEST(decide_core_switch, pin_expires_and_grows)
+{
+	AutoCoreSliceState state = {};
+
+	auto pin_normal_core = [&] {
+		while (!decide_core_switch(state, Dynamic, true, true)) {}
+		return state.pinned_slices_left;
+	};
+
+	const auto first_pin = pin_normal_core();
+
+	// No switch while pinned, however busy the host is
+	for (auto i = 0; i < first_pin; ++i) {
+		EXPECT_EQ(decide_core_switch(state, Normal, true, false),
+		          std::nullopt);
+	}
+	EXPECT_EQ(state.pinned_slices_left, 0);
+
+	// Then the dynamic core is tried again
+	EXPECT_EQ(decide_core_switch(state, Normal, true, false), std::nullopt);
+	EXPECT_EQ(decide_core_switch(state, Normal, true, false), Dynamic);
+
+	EXPECT_EQ(pin_normal_core(), first_pin * 2);
+}
+
+TEST(decide_core_switch, pin_length_is_capped)
+{
+	AutoCoreSliceState state = {};
+
+	int last_pin = 0;
+	for (auto i = 0; i < 20; ++i) {
+		while (!decide_core_switch(state, Dynamic, true, true)) {}
+		EXPECT_GE(state.pinned_slices_left, last_pin);
+		last_pin                 = state.pinned_slices_left;
+		state.pinned_slices_left = 0;
+	}
+	// Eight minutes at most
+	EXPECT_EQ(last_pin, 480);
+}
+
+TEST(decide_core_switch, other_cores_are_left_alone)
+{
+	AutoCoreSliceState state = {};
+
+	for (auto i = 0; i < 10; ++i) {
+		EXPECT_EQ(decide_core_switch(state, std::nullopt, true, true),
+		          std::nullopt);
+	}
+}
+
+} // namespace
@@ -0,0 +1,220 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "cga_line_decoders.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "vga.h"
+
+namespace {
+
+// Room for the widest composite output of 1280 32-bit pixels
+constexpr size_t LineBytes = 2048 * 4;
+
+std::vector<uint8_t> make_random_bytes(std::mt19937& rng, const size_t num_bytes,
+                                       const int max_value = 255)
+{
+	std::uniform_int_distribution<int> dist(0, max_value);
+
+	std::vector<uint8_t> bytes(num_bytes);
+	for (auto& byte : bytes) {
+		byte = static_cast<uint8_t>(dist(rng));
+	}
+	return bytes;
+}
+
+constexpr int ByteCounts[] = {0, 1, 15, 16, 17, 40, 80, 99, 160};
+
+TEST(CgaLineDecoders, Decode1BppMatchesScalar)
+{
+	std::mt19937 rng(1);
+
+	constexpr std::pair<uint8_t, uint8_t> Colors[] = {{0, 1}, {0, 15}, {9, 4}};
+
+	for (const auto& [color_0, color_1] : Colors) {
+		VGA_SetCGA2Table(color_0, color_1);
+
+		for (const auto num_bytes : ByteCounts) {
+			const auto src = make_random_bytes(rng, num_bytes);
+
+			std::vector<uint8_t> expected(LineBytes, 0xcd);
+			std::vector<uint8_t> actual(LineBytes, 0xcd);
+
+			CGA_Decode1BppScalar(src.data(), num_bytes, CGA_2_Table, expected.data());
+			CGA_Decode1Bpp(src.data(), num_bytes, CGA_2_Table, actual.data());
+
+			EXPECT_EQ(actual, expected) << num_bytes << " bytes";
+		}
+	}
+}
+
+TEST(CgaLineDecoders, Decode2BppMatchesScalar)
+{
+	std::mt19937 rng(2);
+
+	VGA_SetCGA4Table(0, 3, 5, 7);
+	for (const auto num_bytes : ByteCounts) {
+		const auto src = make_random_bytes(rng, num_bytes);
+
+		std::vector<uint8_t> expected(LineBytes, 0xcd);
+		std::vector<uint8_t> actual(LineBytes, 0xcd);
+
+		CGA_Decode2BppScalar(src.data(), num_bytes, CGA_4_Table, expected.data());
+		CGA_Decode2Bpp(src.data(), num_bytes, CGA_4_Table, actual.data());
+
+		EXPECT_EQ(actual, expected) << num_bytes << " bytes";
+	}
+	VGA_SetCGA4Table(0, 1, 2, 3);
+}
+
+TEST(CgaLineDecoders, Decode4BppMatchesScalar)
+{
+	std::mt19937 rng(4);
+
+	for (auto i = 0; i < 3; ++i) {
+		// The decoder must notice the palette changing
+		const auto palette = make_random_bytes(rng, 16);
+
+		for (const auto double_pixels : {false, true}) {
+			for (const auto num_bytes : ByteCounts) {
+				const auto src = make_random_bytes(rng, num_bytes);
+
+				std::vector<uint8_t> expected(LineBytes, 0xcd);
+				std::vector<uint8_t> actual(LineBytes, 0xcd);
+
+				CGA_Decode4BppScalar(src.data(), num_bytes, palette.data(),
+				                     double_pixels, expected.data());
+				CGA_Decode4Bpp(src.data(), num_bytes, palette.data(),
+				               double_pixels, actual.data());
+
+				EXPECT_EQ(actual, expected) << num_bytes << " bytes";
+			}
+		}
+	}
+}
+
+struct CompositeTestSetup {
+	std::vector<int> table = std::vector<int>(1024);
+	CgaCompositeSettings settings = {};
+
+	CompositeTestSetup(std::mt19937& rng, const bool is_black_and_white)
+	{
+		// Generous value ranges compared to the default monitor settings
+		std::uniform_int_distribution<int> level(0, 8192);
+		for (auto& value : table) {
+			value = level(rng);
+		}
+		std::uniform_int_distribution<int> coefficient(-2000, 2000);
+
+		settings.table     = table.data();
+		settings.ri        = coefficient(rng);
+		settings.rq        = coefficient(rng);
+		settings.gi        = coefficient(rng);
+		settings.gq        = coefficient(rng);
+		settings.bi        = coefficient(rng);
+		settings.bq        = coefficient(rng);
+		settings.sharpness = std::uniform_int_distribution<int>(0, 256)(rng);
+
+		settings.is_black_and_white = is_black_and_white;
+	}
+};
+
+void assert_composite_matches_scalar(const bool is_black_and_white)
+{
+	std::mt19937 rng(is_black_and_white ? 5 : 6);
+
+	for (auto i = 0; i < 4; ++i) {
+		const CompositeTestSetup setup(rng, is_black_and_white);
+
+		for (const auto double_width : {false, true}) {
+			for (const uint32_t blocks : {1, 3, 4, 40, 80, 160}) {
+				const auto num_pixels = blocks * 4;
+				const auto border = static_cast<uint8_t>(i * 5 % 16);
+
+				auto expected = make_random_bytes(rng, LineBytes, 15);
+				auto actual   = expected;
+
+				CGA_CompositeProcessScalar(expected.data(), border, blocks,
+				                           double_width, setup.settings);
+				CGA_CompositeProcess(actual.data(), border, blocks,
+				                     double_width, setup.settings);
+
+				// Only the output pixels are defined
+				const auto num_output_bytes = num_pixels * 4 *
+				                              (double_width ? 2 : 1);
+				expected.resize(num_output_bytes);
+				actual.resize(num_output_bytes);
+
+				EXPECT_EQ(actual, expected)
+				        << blocks << " blocks, double width: " << double_width;
+			}
+		}
+	}
+}
+
+TEST(CgaLineDecoders, CompositeColourMatchesScalar)
+{
+	assert_composite_matches_scalar(false);
+}
+
+TEST(CgaLineDecoders, CompositeBlackAndWhiteMatchesScalar)
+{
+	assert_composite_matches_scalar(true);
+}
+
+// Not a correctness test; reports the per-line cost of the composite filter
+// on a 640-pixel line to keep an eye on regressions.
+TEST(CgaLineDecoders, BenchmarkComposite)
+{
+	constexpr uint32_t Blocks = 160;
+	constexpr auto Iterations = 20000;
+
+	std::mt19937 rng(7);
+	const CompositeTestSetup setup(rng, false);
+	const auto input = make_random_bytes(rng, LineBytes, 15);
+
+	auto benchmark = [&](const char* name, auto process) {
+		auto line = input;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (auto i = 0; i < Iterations; ++i) {
+			std::copy_n(input.begin(), Blocks * 4, line.begin());
+			process(line.data(), 0, Blocks, false, setup.settings);
+		}
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+
+		printf("[          ] %-10s composite 640 pixels: %6.2f us/line\n",
+		       name,
+		       std::chrono::duration<double, std::micro>(elapsed).count() /
+		               Iterations);
+	};
+	benchmark("Scalar", CGA_CompositeProcessScalar);
+	benchmark("Vectorised", CGA_CompositeProcess);
+}
+
+} // namespace
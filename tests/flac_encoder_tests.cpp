@@ -0,0 +1,115 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "../src/capture/flac_encoder.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "decoders/dr_flac.h"
+#include "std_filesystem.h"
+
+namespace {
+
+constexpr uint32_t SampleRate = 44100;
+
+std::vector<int16_t> generate_test_signal(const size_t num_frames)
+{
+	std::vector<int16_t> samples(num_frames * FlacEncoder::NumChannels);
+
+	constexpr auto Pi = 3.14159265358979;
+
+	for (size_t i = 0; i < num_frames; ++i) {
+		const auto t = static_cast<double>(i) / SampleRate;
+
+		// A tone with some deterministic noise on the left, and bursts
+		// of a full-scale tone separated by silence on the right
+		const auto noise = static_cast<double>((i * 7919) % 2001) - 1000.0;
+		const auto left  = 20000.0 * std::sin(2 * Pi * 440 * t) + noise;
+		const auto right = ((i / 1000) % 3 == 0)
+		                         ? 0.0
+		                         : 32767.0 * std::sin(2 * Pi * 55 * t);
+
+		samples[i * 2]     = static_cast<int16_t>(left);
+		samples[i * 2 + 1] = static_cast<int16_t>(right);
+	}
+	return samples;
+}
+
+// Encodes the samples in chunks of the given size, then decodes the result
+// with the reference decoder
+void expect_lossless_round_trip(const size_t num_frames, const size_t chunk_frames)
+{
+	const auto samples = generate_test_signal(num_frames);
+
+	const auto path = (std_fs::temp_directory_path() / "flac_encoder_test.flac")
+	                          .string();
+
+	FILE* fp = fopen(path.c_str(), "wb");
+	ASSERT_TRUE(fp);
+
+	FlacEncoder encoder(fp, SampleRate);
+	for (size_t pos = 0; pos < num_frames; pos += chunk_frames) {
+		const auto n = std::min(chunk_frames, num_frames - pos);
+		encoder.AddFrames(&samples[pos * FlacEncoder::NumChannels], n);
+	}
+	encoder.Finish();
+
+	unsigned int channels         = 0;
+	unsigned int sample_rate      = 0;
+	drflac_uint64 decoded_frames  = 0;
+	drflac_int16* decoded_samples = drflac_open_file_and_read_pcm_frames_s16(
+	        path.c_str(), &channels, &sample_rate, &decoded_frames, nullptr);
+
+	ASSERT_TRUE(decoded_samples);
+	EXPECT_EQ(channels, FlacEncoder::NumChannels);
+	EXPECT_EQ(sample_rate, SampleRate);
+	ASSERT_EQ(decoded_frames, num_frames);
+
+	const std::vector<int16_t> decoded(decoded_samples,
+	                                   decoded_samples + samples.size());
+	EXPECT_EQ(decoded, samples);
+
+	drflac_free(decoded_samples, nullptr);
+
+	std::error_code ec = {};
+	std_fs::remove(path, ec);
+}
+
+TEST(FlacEncoder, ShorterThanOneBlock)
+{
+	expect_lossless_round_trip(100, 100);
+}
+
+TEST(FlacEncoder, ExactlyOneBlock)
+{
+	expect_lossless_round_trip(FlacEncoder::BlockSize, 1000);
+}
+
+TEST(FlacEncoder, ManyBlocksWithPartialLastBlock)
+{
+	// Enough blocks for multi-byte frame numbers in the frame headers
+	expect_lossless_round_trip(FlacEncoder::BlockSize * 200 + 17, 3001);
+}
+
+} // namespace
@@ -0,0 +1,145 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "frame_mailbox.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr int Pitch  = 16;
+constexpr int Height = 8;
+
+// Renders 'value' into the given rows of the back buffer, like the scalers
+// do with changed lines, and publishes it
+void render_rows(FrameMailbox& mailbox, std::vector<uint8_t>& image,
+                 const int first_row, const int num_rows, const uint8_t value)
+{
+	auto back = mailbox.AcquireBackBuffer();
+
+	// The back buffer always starts out with the previous frame
+	EXPECT_EQ(std::memcmp(back, image.data(), image.size()), 0);
+
+	for (auto y = first_row; y < first_row + num_rows; ++y) {
+		std::memset(back + y * Pitch, value, Pitch);
+		std::memset(image.data() + y * Pitch, value, Pitch);
+	}
+	const uint16_t changed_lines[] = {static_cast<uint16_t>(first_row),
+	                                  static_cast<uint16_t>(num_rows),
+	                                  static_cast<uint16_t>(
+	                                          Height - first_row - num_rows)};
+	mailbox.Publish(changed_lines);
+}
+
+TEST(FrameMailbox, BackBufferHoldsLatestFrame)
+{
+	FrameMailbox mailbox = {};
+	mailbox.Resize(Pitch, Height);
+
+	std::vector<uint8_t> image(Pitch * Height, 0);
+	std::vector<uint8_t> changed_rows = {};
+
+	for (uint8_t frame = 1; frame < 20; ++frame) {
+		render_rows(mailbox, image, frame % Height, 1, frame);
+
+		// Only take every third frame so some get dropped
+		if (frame % 3 == 0) {
+			const auto front = mailbox.TakeFrame(changed_rows);
+			ASSERT_NE(front, nullptr);
+			EXPECT_EQ(std::memcmp(front, image.data(), image.size()), 0);
+		}
+	}
+	EXPECT_EQ(mailbox.GetNumPublished(), 19u);
+	EXPECT_EQ(mailbox.GetNumDropped(), 12u);
+}
+
+TEST(FrameMailbox, ChangedRowsAccumulateUntilTaken)
+{
+	FrameMailbox mailbox = {};
+	mailbox.Resize(Pitch, Height);
+
+	std::vector<uint8_t> image(Pitch * Height, 0);
+	std::vector<uint8_t> changed_rows = {};
+
+	EXPECT_EQ(mailbox.TakeFrame(changed_rows), nullptr);
+
+	render_rows(mailbox, image, 1, 2, 0x11);
+	render_rows(mailbox, image, 5, 1, 0x22);
+
+	ASSERT_NE(mailbox.TakeFrame(changed_rows), nullptr);
+	const std::vector<uint8_t> expected = {0, 1, 1, 0, 0, 1, 0, 0};
+	EXPECT_EQ(changed_rows, expected);
+
+	// Nothing new was published
+	EXPECT_EQ(mailbox.TakeFrame(changed_rows), nullptr);
+
+	render_rows(mailbox, image, 0, 1, 0x33);
+	ASSERT_NE(mailbox.TakeFrame(changed_rows), nullptr);
+	const std::vector<uint8_t> expected_next = {1, 0, 0, 0, 0, 0, 0, 0};
+	EXPECT_EQ(changed_rows, expected_next);
+}
+
+TEST(FrameMailbox, ConsumerThreadSeesCompleteFrames)
+{
+	FrameMailbox mailbox = {};
+	mailbox.Resize(Pitch, Height);
+
+	constexpr uint8_t NumFrames = 200;
+	std::atomic<bool> is_done   = false;
+	std::atomic<int> num_torn   = 0;
+
+	// Every frame rewrites all rows with the frame number, so any mix of
+	// values in a taken frame means the buffers were shared
+	std::thread consumer([&] {
+		std::vector<uint8_t> changed_rows = {};
+		while (!is_done) {
+			const auto front = mailbox.TakeFrame(changed_rows);
+			if (!front) {
+				std::this_thread::yield();
+				continue;
+			}
+			for (auto i = 1; i < Pitch * Height; ++i) {
+				if (front[i] != front[0]) {
+					++num_torn;
+					break;
+				}
+			}
+		}
+	});
+
+	for (uint8_t frame = 1; frame <= NumFrames; ++frame) {
+		auto back = mailbox.AcquireBackBuffer();
+		std::memset(back, frame, Pitch * Height);
+		const uint16_t changed_lines[] = {0, Height};
+		mailbox.Publish(changed_lines);
+	}
+	is_done = true;
+	consumer.join();
+
+	EXPECT_EQ(num_torn, 0);
+	EXPECT_EQ(mailbox.GetNumPublished(), NumFrames);
+}
+
+} // namespace
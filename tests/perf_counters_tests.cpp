@@ -0,0 +1,101 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "perf_counters.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+static PerfCounter test_events("test.events");
+
+uint64_t get_value(const std::string& name)
+{
+	for (const auto& sample : PERF_GetSamples()) {
+		if (sample.name == name) {
+			return sample.value;
+		}
+	}
+	return 0;
+}
+
+TEST(PerfCounters, NothingCountedWhileDisabled)
+{
+	perf_counters_enabled = false;
+	PERF_Reset();
+
+	test_events.Add(5);
+	EXPECT_EQ(get_value("test.events"), 0);
+}
+
+TEST(PerfCounters, SumsTheShardsOfAllThreads)
+{
+	perf_counters_enabled = true;
+	PERF_Reset();
+
+	constexpr int NumThreads = 4;
+	constexpr int NumEvents  = 1000;
+
+	std::vector<std::thread> threads = {};
+	for (int i = 0; i < NumThreads; ++i) {
+		threads.emplace_back([] {
+			for (int j = 0; j < NumEvents; ++j) {
+				test_events.Add();
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	test_events.Add(10);
+
+	EXPECT_EQ(get_value("test.events"), NumThreads * NumEvents + 10);
+	perf_counters_enabled = false;
+}
+
+TEST(PerfCounters, ResetStartsFromZero)
+{
+	perf_counters_enabled = true;
+	test_events.Add(3);
+	PERF_Reset();
+	EXPECT_EQ(get_value("test.events"), 0);
+
+	test_events.Add(2);
+	EXPECT_EQ(get_value("test.events"), 2);
+	perf_counters_enabled = false;
+}
+
+TEST(PerfCounters, IncludesProviderSamples)
+{
+	PERF_AddProvider([](std::vector<PerfSample>& samples) {
+		samples.push_back({"test.provided", 42});
+	});
+	EXPECT_EQ(get_value("test.provided"), 42);
+
+	// Provided values are relative to the last reset, like the counters
+	PERF_Reset();
+	EXPECT_EQ(get_value("test.provided"), 0);
+}
+
+} // namespace
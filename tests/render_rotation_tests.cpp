@@ -0,0 +1,313 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "render_rotation.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+template <typename pixel_t>
+struct Image {
+	int width  = 0;
+	int height = 0;
+	std::vector<pixel_t> pixels = {};
+
+	Image(const int w, const int h, const pixel_t fill = 0)
+	        : width(w),
+	          height(h),
+	          pixels(static_cast<size_t>(w * h), fill)
+	{}
+
+	int Pitch() const
+	{
+		return width * static_cast<int>(sizeof(pixel_t));
+	}
+
+	const uint8_t* Data() const
+	{
+		return reinterpret_cast<const uint8_t*>(pixels.data());
+	}
+
+	uint8_t* Data()
+	{
+		return reinterpret_cast<uint8_t*>(pixels.data());
+	}
+
+	pixel_t& At(const int x, const int y)
+	{
+		return pixels[static_cast<size_t>(y * width + x)];
+	}
+};
+
+template <typename pixel_t>
+Image<pixel_t> make_test_image(const int width, const int height)
+{
+	Image<pixel_t> image(width, height);
+	for (auto y = 0; y < height; ++y) {
+		for (auto x = 0; x < width; ++x) {
+			image.At(x, y) = static_cast<pixel_t>(y * 7919 + x * 31 + 1);
+		}
+	}
+	return image;
+}
+
+template <typename pixel_t>
+Image<pixel_t> rotate_reference(Image<pixel_t>& src, const Rotation rotation)
+{
+	const auto w = src.width;
+	const auto h = src.height;
+
+	Image<pixel_t> dst = is_rotated_sideways(rotation) ? Image<pixel_t>(h, w)
+	                                                   : Image<pixel_t>(w, h);
+	for (auto y = 0; y < h; ++y) {
+		for (auto x = 0; x < w; ++x) {
+			switch (rotation) {
+			case Rotation::Deg0: dst.At(x, y) = src.At(x, y); break;
+			case Rotation::Deg90: dst.At(h - 1 - y, x) = src.At(x, y); break;
+			case Rotation::Deg180:
+				dst.At(w - 1 - x, h - 1 - y) = src.At(x, y);
+				break;
+			case Rotation::Deg270: dst.At(y, w - 1 - x) = src.At(x, y); break;
+			}
+		}
+	}
+	return dst;
+}
+
+template <typename pixel_t>
+Image<pixel_t> rotate(const Image<pixel_t>& src, const Rotation rotation,
+                      const int first_row, const int num_rows)
+{
+	Image<pixel_t> dst = is_rotated_sideways(rotation)
+	                           ? Image<pixel_t>(src.height, src.width)
+	                           : Image<pixel_t>(src.width, src.height);
+	RENDER_RotateRows(rotation,
+	                  sizeof(pixel_t),
+	                  src.Data(),
+	                  src.Pitch(),
+	                  src.width,
+	                  src.height,
+	                  first_row,
+	                  num_rows,
+	                  dst.Data(),
+	                  dst.Pitch());
+	return dst;
+}
+
+constexpr Rotation AllRotations[] = {
+        Rotation::Deg0, Rotation::Deg90, Rotation::Deg180, Rotation::Deg270};
+
+template <typename pixel_t>
+void assert_matches_reference(const int width, const int height)
+{
+	auto src = make_test_image<pixel_t>(width, height);
+
+	for (const auto rotation : AllRotations) {
+		const auto expected = rotate_reference(src, rotation);
+		const auto actual   = rotate(src, rotation, 0, height);
+
+		EXPECT_EQ(actual.pixels, expected.pixels)
+		        << width << "x" << height << " rotated by "
+		        << static_cast<int>(rotation);
+	}
+}
+
+TEST(RenderRotation, MatchesReference8Bit)
+{
+	assert_matches_reference<uint8_t>(320, 200);
+	assert_matches_reference<uint8_t>(37, 13);
+}
+
+TEST(RenderRotation, MatchesReference16Bit)
+{
+	assert_matches_reference<uint16_t>(640, 350);
+	assert_matches_reference<uint16_t>(5, 71);
+}
+
+TEST(RenderRotation, MatchesReference32Bit)
+{
+	assert_matches_reference<uint32_t>(640, 480);
+	assert_matches_reference<uint32_t>(720, 400);
+	assert_matches_reference<uint32_t>(1, 1);
+	assert_matches_reference<uint32_t>(3, 5);
+	assert_matches_reference<uint32_t>(67, 33);
+}
+
+TEST(RenderRotation, OnlyRotatesRequestedRows)
+{
+	constexpr auto Width     = 83;
+	constexpr auto Height    = 61;
+	constexpr auto FirstRow  = 17;
+	constexpr auto NumRows   = 23;
+	constexpr uint32_t Blank = 0xdeadbeef;
+
+	auto src = make_test_image<uint32_t>(Width, Height);
+
+	for (const auto rotation : AllRotations) {
+		auto expected = rotate_reference(src, rotation);
+
+		// Blank out everything that came from rows outside the band
+		Image<uint32_t> mask(Width, Height, 0);
+		for (auto y = FirstRow; y < FirstRow + NumRows; ++y) {
+			for (auto x = 0; x < Width; ++x) {
+				mask.At(x, y) = 1;
+			}
+		}
+		const auto rotated_mask = rotate_reference(mask, rotation);
+		for (size_t i = 0; i < expected.pixels.size(); ++i) {
+			if (!rotated_mask.pixels[i]) {
+				expected.pixels[i] = Blank;
+			}
+		}
+
+		auto actual = is_rotated_sideways(rotation)
+		                    ? Image<uint32_t>(Height, Width, Blank)
+		                    : Image<uint32_t>(Width, Height, Blank);
+		RENDER_RotateRows(rotation,
+		                  sizeof(uint32_t),
+		                  src.Data(),
+		                  src.Pitch(),
+		                  Width,
+		                  Height,
+		                  FirstRow,
+		                  NumRows,
+		                  actual.Data(),
+		                  actual.Pitch());
+
+		EXPECT_EQ(actual.pixels, expected.pixels)
+		        << "rotated by " << static_cast<int>(rotation);
+	}
+}
+
+// Mouse positions on the rotated output must land on the source pixel that
+// was rotated there
+TEST(RenderRotation, UnrotatesPoints)
+{
+	constexpr auto Width  = 7;
+	constexpr auto Height = 5;
+
+	auto src = make_test_image<uint32_t>(Width, Height);
+
+	for (const auto rotation : AllRotations) {
+		auto dst = rotate_reference(src, rotation);
+
+		const DosBox::Rect output_rect = {10.0f,
+		                                  20.0f,
+		                                  static_cast<float>(dst.width),
+		                                  static_cast<float>(dst.height)};
+
+		const auto unrotated_rect = RENDER_UnrotateRect(rotation, output_rect);
+		EXPECT_EQ(unrotated_rect.x, output_rect.x);
+		EXPECT_EQ(unrotated_rect.y, output_rect.y);
+		EXPECT_EQ(unrotated_rect.w, static_cast<float>(Width));
+		EXPECT_EQ(unrotated_rect.h, static_cast<float>(Height));
+
+		for (auto y = 0; y < dst.height; ++y) {
+			for (auto x = 0; x < dst.width; ++x) {
+				// Centre of the output pixel
+				auto px = output_rect.x + static_cast<float>(x) + 0.5f;
+				auto py = output_rect.y + static_cast<float>(y) + 0.5f;
+				RENDER_UnrotatePoint(rotation, output_rect, px, py);
+
+				const auto src_x = static_cast<int>(px - unrotated_rect.x);
+				const auto src_y = static_cast<int>(py - unrotated_rect.y);
+				ASSERT_GE(src_x, 0);
+				ASSERT_LT(src_x, Width);
+				ASSERT_GE(src_y, 0);
+				ASSERT_LT(src_y, Height);
+
+				EXPECT_EQ(src.At(src_x, src_y), dst.At(x, y))
+				        << "rotated by " << static_cast<int>(rotation);
+			}
+		}
+	}
+}
+
+TEST(RenderRotation, UnrotatesDeltas)
+{
+	const DosBox::Rect output_rect = {0.0f, 0.0f, 100.0f, 100.0f};
+
+	for (const auto rotation : AllRotations) {
+		// A movement must match the difference of the unrotated points
+		float x1 = 40.0f;
+		float y1 = 30.0f;
+		float x2 = 43.0f;
+		float y2 = 25.0f;
+
+		float dx = x2 - x1;
+		float dy = y2 - y1;
+
+		RENDER_UnrotatePoint(rotation, output_rect, x1, y1);
+		RENDER_UnrotatePoint(rotation, output_rect, x2, y2);
+		RENDER_UnrotateDelta(rotation, dx, dy);
+
+		EXPECT_EQ(dx, x2 - x1) << "rotated by " << static_cast<int>(rotation);
+		EXPECT_EQ(dy, y2 - y1) << "rotated by " << static_cast<int>(rotation);
+	}
+}
+
+// Not a correctness test; reports the per-frame cost of rotating a full
+// 640x480 32-bit frame to keep an eye on regressions.
+TEST(RenderRotation, Benchmark640x480)
+{
+	constexpr auto Width      = 640;
+	constexpr auto Height     = 480;
+	constexpr auto Iterations = 200;
+
+	const auto src = make_test_image<uint32_t>(Width, Height);
+	Image<uint32_t> dst(Width, Height);
+
+	for (const auto rotation : AllRotations) {
+		const auto dst_pitch = is_rotated_sideways(rotation)
+		                             ? Height * 4
+		                             : Width * 4;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (auto i = 0; i < Iterations; ++i) {
+			RENDER_RotateRows(rotation,
+			                  sizeof(uint32_t),
+			                  src.Data(),
+			                  src.Pitch(),
+			                  Width,
+			                  Height,
+			                  0,
+			                  Height,
+			                  dst.Data(),
+			                  dst_pitch);
+		}
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		const auto us_per_frame =
+		        std::chrono::duration<double, std::micro>(elapsed).count() /
+		        Iterations;
+
+		printf("[          ] %dx%d rotated by %3d degrees: %7.1f us/frame\n",
+		       Width,
+		       Height,
+		       static_cast<int>(rotation),
+		       us_per_frame);
+	}
+}
+
+} // namespace
@@ -62,6 +62,23 @@ TEST(RWQueue, TrivialSerial)
 	}
 }
 
+TEST(RWQueue, NonblockingEnqueueWhenFull)
+{
+	RWQueue<int> q(2);
+	EXPECT_TRUE(q.NonblockingEnqueue(1));
+	EXPECT_TRUE(q.NonblockingEnqueue(2));
+	EXPECT_FALSE(q.NonblockingEnqueue(3));
+	EXPECT_EQ(q.Size(), 2);
+
+	EXPECT_EQ(*q.Dequeue(), 1);
+	EXPECT_TRUE(q.NonblockingEnqueue(4));
+	EXPECT_EQ(*q.Dequeue(), 2);
+	EXPECT_EQ(*q.Dequeue(), 4);
+
+	q.Stop();
+	EXPECT_FALSE(q.NonblockingEnqueue(5));
+}
+
 TEST(RWQueue, TrivialZeroCapacity)
 {
 	// Zero capacity
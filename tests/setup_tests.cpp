@@ -23,6 +23,7 @@
 #include <gtest/gtest.h>
 
 #include <string>
+#include <thread>
 
 namespace {
 
@@ -98,4 +99,31 @@ TEST(ParseEnv, FilterOutEmptyPropname)
 	EXPECT_EQ(expected_empty, parse_environ(test_environ));
 }
 
+std::thread::id prepare_thread_id = {};
+bool was_prepared_before_init       = false;
+
+void prepare_section(Section*)
+{
+	prepare_thread_id = std::this_thread::get_id();
+}
+
+void init_section(Section*)
+{
+	was_prepared_before_init = (prepare_thread_id != std::thread::id());
+}
+
+TEST(SectionPreparation, RunsOnWorkerThreadBeforeInit)
+{
+	Section_prop section("prepared");
+	section.AddPrepareFunction(&prepare_section);
+	section.AddInitFunction(&init_section);
+
+	section.StartPreparation();
+	section.FinishPreparation();
+	section.ExecuteInit();
+
+	EXPECT_NE(prepare_thread_id, std::this_thread::get_id());
+	EXPECT_TRUE(was_prepared_before_init);
+}
+
 } // namespace
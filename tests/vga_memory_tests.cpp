@@ -0,0 +1,118 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2024-2024  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "vga.h"
+
+#include <array>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+// declarations of private functions to test
+void mark_changed_range(const PhysPt addr, const PhysPt num_bytes, const int shift);
+
+namespace {
+
+class VgaChangesTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		map.fill(0);
+		saved_map     = vga.changes.map;
+		vga.changes.map = map.data();
+	}
+
+	void TearDown() override
+	{
+		vga.changes.map = saved_map;
+	}
+
+	bool IsBlockMarked(const uint32_t block) const
+	{
+		return map[block / 64] & (uint64_t(1) << (block % 64));
+	}
+
+	int NumMarkedBlocks() const
+	{
+		auto num_marked = 0;
+		for (const auto word : map) {
+			for (auto bits = word; bits; bits &= bits - 1) {
+				++num_marked;
+			}
+		}
+		return num_marked;
+	}
+
+	std::array<uint64_t, 4> map = {};
+	uint64_t* saved_map         = nullptr;
+};
+
+constexpr PhysPt BlockBytes = 1 << VGA_CHANGE_SHIFT;
+
+TEST_F(VgaChangesTest, ByteMarksItsBlock)
+{
+	mark_changed_range(BlockBytes + 5, 1, 0);
+	EXPECT_TRUE(IsBlockMarked(1));
+	EXPECT_EQ(NumMarkedBlocks(), 1);
+}
+
+TEST_F(VgaChangesTest, WordWithinBlockMarksOneBlock)
+{
+	mark_changed_range(BlockBytes - 2, 2, 0);
+	EXPECT_TRUE(IsBlockMarked(0));
+	EXPECT_EQ(NumMarkedBlocks(), 1);
+}
+
+TEST_F(VgaChangesTest, WordAcrossBlocksMarksBoth)
+{
+	mark_changed_range(BlockBytes - 1, 2, 0);
+	EXPECT_TRUE(IsBlockMarked(0));
+	EXPECT_TRUE(IsBlockMarked(1));
+	EXPECT_EQ(NumMarkedBlocks(), 2);
+}
+
+TEST_F(VgaChangesTest, DwordAcrossBlocksMarksBoth)
+{
+	mark_changed_range(3 * BlockBytes - 3, 4, 0);
+	EXPECT_TRUE(IsBlockMarked(2));
+	EXPECT_TRUE(IsBlockMarked(3));
+	EXPECT_EQ(NumMarkedBlocks(), 2);
+}
+
+TEST_F(VgaChangesTest, PlanarWordAcrossBlocksMarksBoth)
+{
+	// Each planar address covers 8 pixels of draw address space
+	constexpr auto Shift = 3;
+	mark_changed_range((BlockBytes >> Shift) - 1, 2, Shift);
+	EXPECT_TRUE(IsBlockMarked(0));
+	EXPECT_TRUE(IsBlockMarked(1));
+	EXPECT_EQ(NumMarkedBlocks(), 2);
+}
+
+TEST_F(VgaChangesTest, UnchainedDwordAcrossBlocksMarksBoth)
+{
+	constexpr auto Shift = 2;
+	mark_changed_range((BlockBytes >> Shift) - 1, 4, Shift);
+	EXPECT_TRUE(IsBlockMarked(0));
+	EXPECT_TRUE(IsBlockMarked(1));
+	EXPECT_EQ(NumMarkedBlocks(), 2);
+}
+
+} // namespace